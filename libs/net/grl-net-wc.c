@@ -62,6 +62,10 @@ GRL_LOG_DOMAIN_STATIC(wc_log_domain);
 
 #define GRL_NET_CAPTURE_DIR_VAR "GRL_NET_CAPTURE_DIR"
 
+/* Requests for interactive operations go this much ahead of the normal
+   ones, and twice as much behind for background operations */
+#define REQUEST_PRIORITY_SPREAD 50
+
 enum {
   PROP_0,
   PROP_LOG_LEVEL,
@@ -434,6 +438,10 @@ struct request_clos {
   GAsyncResult *result;
   GCancellable *cancellable;
   GHashTable *headers;
+  GMainContext *context;
+  GrlOperationPriority priority;
+  /* when a delayed request is sent, or 0 if it is not delayed */
+  glong slot;
   guint source_id;
 };
 
@@ -446,6 +454,10 @@ request_clos_destroy (gpointer data)
   if (c->headers) {
     g_hash_table_unref (c->headers);
   }
+  if (c->cancellable) {
+    g_object_unref (c->cancellable);
+  }
+  g_main_context_unref (c->context);
   g_free (c);
 }
 
@@ -725,57 +737,176 @@ get_url_cb (gpointer user_data)
 {
   struct request_clos *c = (struct request_clos *) user_data;
 
-  /* validation */
-  {
-    GrlNetWcPrivate *priv = c->self->priv;
-    struct request_clos *d = g_queue_pop_tail (priv->pending);
-    g_assert (c == d);
-  }
+  g_queue_remove (c->self->priv->pending, c);
 
-  if (is_mocked ())
+  /* Do not even start requests cancelled while waiting their turn */
+  if (c->cancellable && g_cancellable_is_cancelled (c->cancellable)) {
+    g_simple_async_result_set_error (G_SIMPLE_ASYNC_RESULT (c->result),
+                                     GRL_NET_WC_ERROR,
+                                     GRL_NET_WC_ERROR_CANCELLED,
+                                     _("Operation was cancelled"));
+    g_simple_async_result_complete (G_SIMPLE_ASYNC_RESULT (c->result));
+    g_object_unref (c->result);
+  } else if (is_mocked ()) {
     get_url_mocked (c->self, c->url, c->headers, c->result, c->cancellable);
-  else
+  } else {
     get_url_now (c->self, c->url, c->headers, c->result, c->cancellable);
+  }
+
+  request_clos_destroy (c);
 
   return FALSE;
 }
 
+static void
+request_clos_attach (struct request_clos *c,
+                     GSource *source)
+{
+  GSource *previous;
+
+  if (c->source_id) {
+    previous = g_main_context_find_source_by_id (c->context, c->source_id);
+    if (previous) {
+      g_source_destroy (previous);
+    }
+  }
+
+  g_source_set_callback (source, get_url_cb, c, NULL);
+  c->source_id = g_source_attach (source, c->context);
+  g_source_unref (source);
+}
+
+static gint
+compare_delayed_requests (gconstpointer a,
+                          gconstpointer b)
+{
+  const struct request_clos *c = *((const struct request_clos **) a);
+  const struct request_clos *d = *((const struct request_clos **) b);
+
+  if (c->priority != d->priority) {
+    return c->priority - d->priority;
+  }
+
+  return (c->slot > d->slot) - (c->slot < d->slot);
+}
+
+static gint
+compare_slots (gconstpointer a,
+               gconstpointer b)
+{
+  glong slot_a = *((const glong *) a);
+  glong slot_b = *((const glong *) b);
+
+  return (slot_a > slot_b) - (slot_a < slot_b);
+}
+
+/*
+ * Delayed requests are sent one every "throttling" seconds. Each new one
+ * takes the next free slot, and then the slots are given again to the
+ * delayed requests, the most urgent first, so background requests yield to
+ * the ones the user is waiting for.
+ */
+static void
+delay_request (GrlNetWc *self,
+               struct request_clos *c,
+               GTimeVal *now)
+{
+  GrlNetWcPrivate *priv = self->priv;
+  struct request_clos *d;
+  GPtrArray *delayed;
+  GArray *slots;
+  GList *iter;
+  glong slot;
+  guint i;
+
+  priv->last_request.tv_sec += priv->throttling;
+  c->slot = priv->last_request.tv_sec;
+
+  delayed = g_ptr_array_new ();
+  slots = g_array_new (FALSE, FALSE, sizeof (glong));
+
+  g_ptr_array_add (delayed, c);
+  g_array_append_val (slots, c->slot);
+  for (iter = priv->pending->head; iter; iter = g_list_next (iter)) {
+    d = (struct request_clos *) iter->data;
+    if (d->slot) {
+      g_ptr_array_add (delayed, d);
+      g_array_append_val (slots, d->slot);
+    }
+  }
+
+  g_ptr_array_sort (delayed, compare_delayed_requests);
+  g_array_sort (slots, compare_slots);
+
+  for (i = 0; i < delayed->len; i++) {
+    d = g_ptr_array_index (delayed, i);
+    slot = g_array_index (slots, glong, i);
+    if (d == c || d->slot != slot) {
+      d->slot = slot;
+      request_clos_attach (d,
+                           g_timeout_source_new_seconds (MAX (slot - now->tv_sec,
+                                                              0)));
+    }
+  }
+
+  g_ptr_array_free (delayed, TRUE);
+  g_array_free (slots, TRUE);
+}
+
 static void
 get_url (GrlNetWc *self,
          const char *url,
          GHashTable *headers,
+         GrlOperationPriority priority,
          GAsyncResult *result,
          GCancellable *cancellable)
 {
-  guint id;
+  GSource *source;
   GTimeVal now;
   struct request_clos *c;
   GrlNetWcPrivate *priv = self->priv;
 
   /* closure */
-  c = g_new (struct request_clos, 1);
+  c = g_new0 (struct request_clos, 1);
   c->self = self;
+  c->priority = priority;
   c->url = g_strdup (url);
   c->headers = headers? g_hash_table_ref (headers): NULL;
   c->result = result;
-  c->cancellable = cancellable;
+  c->cancellable = cancellable? g_object_ref (cancellable): NULL;
+
+  /* Start the request in the main context of the caller, which is also the
+     one the session completes it in */
+  c->context = g_main_context_get_thread_default ();
+  if (!c->context) {
+    c->context = g_main_context_default ();
+  }
+  g_main_context_ref (c->context);
 
   g_get_current_time (&now);
 
   if ((now.tv_sec - priv->last_request.tv_sec) > priv->throttling
           || is_mocked()) {
-    id = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
-                          get_url_cb, c, request_clos_destroy);
+    source = g_idle_source_new ();
+    switch (priority) {
+    case GRL_OPERATION_PRIORITY_INTERACTIVE:
+      g_source_set_priority (source,
+                             G_PRIORITY_HIGH_IDLE - REQUEST_PRIORITY_SPREAD);
+      break;
+    case GRL_OPERATION_PRIORITY_BACKGROUND:
+      g_source_set_priority (source,
+                             G_PRIORITY_HIGH_IDLE + 2 * REQUEST_PRIORITY_SPREAD);
+      break;
+    default:
+      g_source_set_priority (source, G_PRIORITY_HIGH_IDLE);
+      break;
+    }
+    request_clos_attach (c, source);
   } else {
     GRL_DEBUG ("delaying web request");
-
-    priv->last_request.tv_sec += priv->throttling;
-    id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT,
-                                     priv->last_request.tv_sec - now.tv_sec,
-                                     get_url_cb, c, request_clos_destroy);
+    delay_request (self, c, &now);
   }
 
-  c->source_id = id;
   g_queue_push_head (self->priv->pending, c);
 }
 
@@ -930,6 +1061,42 @@ grl_net_wc_request_with_headers_hash_async (GrlNetWc *self,
                                             GCancellable *cancellable,
                                             GAsyncReadyCallback callback,
                                             gpointer user_data)
+{
+  grl_net_wc_request_with_priority_async (self,
+                                          uri,
+                                          headers,
+                                          GRL_OPERATION_PRIORITY_NORMAL,
+                                          cancellable,
+                                          callback,
+                                          user_data);
+}
+
+/**
+ * grl_net_wc_request_with_priority_async:
+ * @self: a #GrlNetWc instance
+ * @uri: The URI of the resource to request
+ * @headers: (allow-none) (element-type utf8 utf8): a set of additional HTTP
+ * headers for this request or %NULL to ignore
+ * @priority: how urgent the request is, usually the priority of the
+ * operation it is done for (see grl_operation_options_get_priority())
+ * @cancellable: (allow-none): a #GCancellable instance or %NULL to ignore
+ * @callback: The callback when the result is ready
+ * @user_data: User data set for the @callback
+ *
+ * Like grl_net_wc_request_with_headers_hash_async(), but requests waiting to
+ * be sent (see grl_net_wc_set_throttling()) are sent the most urgent
+ * first.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_net_wc_request_with_priority_async (GrlNetWc *self,
+                                        const char *uri,
+                                        GHashTable *headers,
+                                        GrlOperationPriority priority,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data)
 {
   GSimpleAsyncResult *result;
 
@@ -938,7 +1105,7 @@ grl_net_wc_request_with_headers_hash_async (GrlNetWc *self,
                                       user_data,
                                       grl_net_wc_request_async);
 
-  get_url (self, uri, headers, G_ASYNC_RESULT (result), cancellable);
+  get_url (self, uri, headers, priority, G_ASYNC_RESULT (result), cancellable);
 }
 
 
@@ -986,6 +1153,10 @@ grl_net_wc_request_finish (GrlNetWc *self,
     get_content(self, op, content, length);
 
 end_func:
+  /* Requests cancelled before being sent have no data */
+  if (!op)
+    return ret;
+
   if (is_mocked ())
     free_mock_op_res (op);
   else
@@ -1105,7 +1276,8 @@ grl_net_wc_set_cache_size (GrlNetWc *self,
  * grl_net_wc_flush_delayed_requests:
  * @self: a #GrlNetWc instance
  *
- * This method will flush all the pending request in the queue.
+ * This method will flush all the pending request in the queue. Their
+ * callbacks are invoked with a %G_IO_ERROR_CANCELLED error.
  */
 void
 grl_net_wc_flush_delayed_requests (GrlNetWc *self)
@@ -1114,12 +1286,20 @@ grl_net_wc_flush_delayed_requests (GrlNetWc *self)
 
   GrlNetWcPrivate *priv = self->priv;
   struct request_clos *c;
+  GSource *source;
 
   while ((c = g_queue_pop_head (priv->pending))) {
-    g_source_remove (c->source_id);
-    g_object_unref (c->cancellable);
-    g_free (c->url);
-    g_free (c);
+    source = g_main_context_find_source_by_id (c->context, c->source_id);
+    if (source) {
+      g_source_destroy (source);
+    }
+    g_simple_async_result_set_error (G_SIMPLE_ASYNC_RESULT (c->result),
+                                     G_IO_ERROR,
+                                     G_IO_ERROR_CANCELLED,
+                                     _("Operation was cancelled"));
+    g_simple_async_result_complete_in_idle (G_SIMPLE_ASYNC_RESULT (c->result));
+    g_object_unref (c->result);
+    request_clos_destroy (c);
   }
 
   g_get_current_time (&priv->last_request);
@@ -36,6 +36,7 @@
  */
 
 #include "grl-config.h"
+#include "grl-config-priv.h"
 #include "grl-log.h"
 
 #define GROUP_NAME "none"
@@ -665,3 +666,17 @@ grl_config_has_param (GrlConfig *config, const gchar *param)
   g_return_val_if_fail (GRL_IS_CONFIG (config), FALSE);
   return g_key_file_has_key (config->priv->config, GROUP_NAME, param, NULL);
 }
+
+/*
+ * grl_config_get_params:
+ * @config: the config instance
+ *
+ * Returns: a %NULL-terminated array with the params defined within @config.
+ * Use g_strfreev() to free it.
+ */
+gchar **
+grl_config_get_params (GrlConfig *config)
+{
+  g_return_val_if_fail (GRL_IS_CONFIG (config), NULL);
+  return g_key_file_get_keys (config->priv->config, GROUP_NAME, NULL, NULL);
+}
@@ -1060,7 +1060,8 @@ grl_data_dup (GrlData *data)
 
   g_return_val_if_fail (GRL_IS_DATA (data), NULL);
 
-  dup_data = grl_data_new ();
+  /* Keep the type, so medias are duplicated as medias of the same kind */
+  dup_data = g_object_new (G_OBJECT_TYPE (data), NULL);
   keys = g_hash_table_get_keys (data->priv->data);
   for (key = keys; key; key = g_list_next (key)) {
     dup_relkeys_list = NULL;
@@ -1073,7 +1074,7 @@ grl_data_dup (GrlData *data)
     }
     g_hash_table_insert (dup_data->priv->data,
                          key->data,
-                         g_list_reverse (relkeys_list));
+                         g_list_reverse (dup_relkeys_list));
   }
 
   g_list_free (keys);
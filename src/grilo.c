@@ -95,6 +95,13 @@ grl_init (gint *argc,
   g_type_init ();
 #endif
 
+#if !GLIB_CHECK_VERSION(2,31,0)
+  /* Sources can run blocking work in threads */
+  if (!g_thread_supported ()) {
+    g_thread_init (NULL);
+  }
+#endif
+
   /* Initialize i18n */
   bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
   bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
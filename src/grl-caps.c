@@ -63,6 +63,7 @@ struct _GrlCapsPrivate {
   GrlTypeFilter type_filter;
   GList *key_filter;
   GList *key_range_filter;
+  GList *key_sort;
 };
 
 
@@ -79,6 +80,7 @@ grl_caps_finalize (GrlCaps *self)
   g_hash_table_unref (self->priv->data);
   g_list_free (self->priv->key_filter);
   g_list_free (self->priv->key_range_filter);
+  g_list_free (self->priv->key_sort);
 
   G_OBJECT_CLASS (grl_caps_parent_class)->finalize ((GObject *) self);
 }
@@ -95,6 +97,7 @@ grl_caps_init (GrlCaps *self)
   self->priv->type_filter = GRL_TYPE_FILTER_NONE;
   self->priv->key_filter = NULL;
   self->priv->key_range_filter = NULL;
+  self->priv->key_sort = NULL;
 }
 
 static void
@@ -145,6 +148,16 @@ grl_caps_test_option (GrlCaps *caps, const gchar *key, const GValue *value)
     /* these options must always be handled by plugins */
     return TRUE;
 
+  if (0 == g_strcmp0 (key, GRL_OPERATION_OPTION_SORT_KEY)) {
+    GrlKeyID grl_key = g_value_get_grl_key_id (value);
+    return grl_key == GRL_METADATA_KEY_INVALID ||
+        grl_caps_is_key_sort (caps, grl_key);
+  }
+
+  if (0 == g_strcmp0 (key, GRL_OPERATION_OPTION_SORT_ORDER))
+    /* only meaningful along with the sort key */
+    return TRUE;
+
   if (0 == g_strcmp0 (key, GRL_OPERATION_OPTION_TYPE_FILTER)) {
     GrlTypeFilter filter, supported_filter;
 
@@ -316,3 +329,63 @@ grl_caps_is_key_range_filter (GrlCaps *caps, GrlKeyID key)
 
   return FALSE;
 }
+
+/**
+ * grl_caps_get_key_sort:
+ * @caps: a #GrlCaps instance
+ *
+ * Returns: (transfer none) (element-type GrlKeyID):
+ *
+ * Since: 0.2.7
+ */
+GList *
+grl_caps_get_key_sort (GrlCaps *caps)
+{
+  g_return_val_if_fail (caps, NULL);
+
+  return caps->priv->key_sort;
+}
+
+/**
+ * grl_caps_set_key_sort:
+ * @caps: a #GrlCaps instance
+ * @keys: (transfer none) (element-type GrlKeyID):
+ *
+ * Sets the keys the source can sort the results by.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_caps_set_key_sort (GrlCaps *caps, GList *keys)
+{
+  g_return_if_fail (caps);
+
+  if (caps->priv->key_sort) {
+    g_list_free (caps->priv->key_sort);
+  }
+
+  caps->priv->key_sort = g_list_copy (keys);
+}
+
+/**
+ * grl_caps_is_key_sort:
+ * @caps: a #GrlCaps instance
+ * @key: a #GrlKeyID
+ *
+ * Checks if @key is supported for sorting in @caps.
+ *
+ * Returns: %TRUE if @key can be used for sorting
+ *
+ * Since: 0.2.7
+ **/
+gboolean
+grl_caps_is_key_sort (GrlCaps *caps, GrlKeyID key)
+{
+  g_return_val_if_fail (caps, FALSE);
+
+  if (caps->priv->key_sort) {
+    return g_list_find (caps->priv->key_sort, GRLKEYID_TO_POINTER (key)) != NULL;
+  }
+
+  return FALSE;
+}
@@ -31,6 +31,17 @@
  *
  * Also you can set %NULL that sources list, so the function will use all
  * the available sources with the search capability.
+ *
+ * The same machinery is available for queries and for browsing the root
+ * container of several sources at once, see grl_multiple_query() and
+ * grl_multiple_browse_root().
+ *
+ * By default results are sent to the user as soon as they arrive. Use
+ * grl_operation_options_set_merge_mode() to get them in a deterministic
+ * order instead, or merged by relevance with %GRL_MERGE_MODE_RANKED.
+ *
+ * Results found in several sources can be sent only once, see
+ * grl_operation_options_set_dedup().
  */
 
 #include "grl-multiple.h"
@@ -42,41 +53,101 @@
 #include "grl-sync-priv.h"
 #include "grl-operation.h"
 #include "grl-operation-priv.h"
-#include "grl-registry.h"
+#include "grl-registry-priv.h"
 #include "grl-error.h"
 #include "grl-log.h"
 
 #include <glib/gi18n-lib.h>
+#include <string.h>
 
 #define GRL_LOG_DOMAIN_DEFAULT  multiple_log_domain
 GRL_LOG_DOMAIN(multiple_log_domain);
 
+/* Weight of the last operation in the per-source statistics */
+#define STATS_ALPHA 0.3
+
+/* Sources that never return anything still get a small share, so we
+   notice when they start returning results */
+#define STATS_MIN_YIELD 0.1
+
+/* Sources that usually fill their share are asked for the results the
+   others are expected to miss, plus a bit more, saving a round-trip */
+#define STATS_HIGH_YIELD 0.75
+#define STATS_EXTRA_PERCENT 10
+
+/* Initial number of slots of the set of results seen when removing
+   duplicates; must be a power of 2 */
+#define DEDUP_SET_SIZE 64
+
+/* Identities of the results seen, as 64-bit digests of the values of the
+   keys identifying them, in an open-addressing table */
+struct DedupSet {
+  guint64 *slots;
+  guint size;
+  guint used;
+};
+
 struct MultipleSearchData {
+  GrlSupportedOps operation_type;
+  GrlMergeMode merge_mode;
+  GrlKeyID score_key;
+  guint merge_deadline;
+  guint confirm_id;
+  GMainContext *context;
+  GList *dedup_keys;
+  gboolean dedup_merge;
+  struct DedupSet *dedup_seen;
+  GHashTable *dedup_pending;
+  guint received;
+  guint duplicates;
   GHashTable *table;
+  gint count;
   guint remaining;
-  GList *search_ids;
   GList *sources;
   GList *keys;
   guint search_id;
   gboolean cancelled;
-  guint pending;
-  guint sources_done;
-  guint sources_count;
-  GList *sources_more;
+  guint running;
+  guint requests;
   gchar *text;
   GrlOperationOptions *options;
   GrlSourceResultCb user_callback;
   gpointer user_data;
 };
 
+/* Keeps track of the results requested to a source. Each time a source
+   provides all the results it was asked for and the user still misses
+   some, the source is asked for the next slice of results */
 struct ResultCount {
+  struct MultipleSearchData *msd;
+  GrlSource *source;
+  guint operation_id;
   guint count;
-  guint remaining;
   guint received;
   guint skip;
+  gint64 start_time;
+  gboolean running;
+  gboolean exhausted;
+  guint deadline_id;
+  gboolean deadline_passed;
+  GQueue *buffer;
+};
+
+/* A buffered result, that could still be replaced by a duplicate from a
+   source with a higher rank */
+struct DedupPending {
+  GrlMedia *media;
+  struct ResultCount *rc;
+};
+
+struct SourceStats {
+  gdouble yield;
+  gdouble latency;
+  guint samples;
 };
 
 struct CallbackData {
+  GrlSupportedOps operation_type;
   GrlSourceResultCb user_callback;
   gpointer user_data;
 };
@@ -87,6 +158,39 @@ struct MediaFromUriCallbackData {
   gpointer user_data;
 };
 
+struct UriRoute {
+  gchar *source_id;
+  gchar **rejected;
+};
+
+struct MediaFromUrisRoute {
+  GrlSource *source;
+  GQueue *uris;
+  guint running;
+};
+
+struct MediaFromUrisData {
+  guint operation_id;
+  GList *uris;
+  GList *routes;
+  GList *items;
+  GList *keys;
+  GrlOperationOptions *options;
+  guint max_concurrent;
+  guint remaining;
+  guint running;
+  gboolean cancelled;
+  GrlSourceResultCb user_callback;
+  gpointer user_data;
+};
+
+struct MediaFromUrisItem {
+  struct MediaFromUrisData *mfud;
+  struct MediaFromUrisRoute *route;
+  gchar *uri;
+  guint operation_id;
+};
+
 static void multiple_search_cb (GrlSource *source,
                                 guint search_id,
                                 GrlMedia *media,
@@ -96,27 +200,734 @@ static void multiple_search_cb (GrlSource *source,
 
 static void multiple_search_cancel_cb (struct MultipleSearchData *msd);
 
+static void multiple_search_flow_cb (struct MultipleSearchData *msd);
+
+static void start_source_slice (struct MultipleSearchData *msd,
+                                struct ResultCount *rc,
+                                guint skip,
+                                gint count);
+
 /* ================ Utitilies ================ */
 
+/* Statistics are kept by source id, so they survive sources being
+   unloaded and loaded again. They are shared by the operations of all the
+   threads, so they are protected by the source_stats lock */
+G_LOCK_DEFINE_STATIC (source_stats);
+static GHashTable *source_stats = NULL;
+
+/* Must be called with the source_stats lock held */
+static struct SourceStats *
+get_source_stats (GrlSource *source)
+{
+  if (!source_stats) {
+    return NULL;
+  }
+
+  return g_hash_table_lookup (source_stats, grl_source_get_id (source));
+}
+
+static void
+update_source_stats (GrlSource *source,
+                     gint requested,
+                     guint received,
+                     gint64 elapsed)
+{
+  struct SourceStats *stats;
+  gdouble latency, yield;
+
+  G_LOCK (source_stats);
+
+  if (!source_stats) {
+    source_stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, g_free);
+  }
+
+  latency = elapsed / 1000.0;
+
+  stats = get_source_stats (source);
+  if (!stats) {
+    stats = g_new0 (struct SourceStats, 1);
+    stats->yield = 1.0;
+    stats->latency = latency;
+    g_hash_table_insert (source_stats,
+                         g_strdup (grl_source_get_id (source)),
+                         stats);
+  }
+
+  stats->latency = STATS_ALPHA * latency + (1 - STATS_ALPHA) * stats->latency;
+
+  /* With no limit the yield tells nothing */
+  if (requested != GRL_COUNT_INFINITY && requested > 0) {
+    yield = MIN ((gdouble) received / requested, 1.0);
+    if (stats->samples == 0) {
+      stats->yield = yield;
+    } else {
+      stats->yield = STATS_ALPHA * yield + (1 - STATS_ALPHA) * stats->yield;
+    }
+    stats->samples++;
+  }
+
+  GRL_DEBUG ("Source %s: yield %.2f, latency %.1f ms",
+             grl_source_get_id (source), stats->yield, stats->latency);
+
+  G_UNLOCK (source_stats);
+}
+
+/* Splits count among sources, giving more to those that usually return
+   more results and answer faster. Sources we know nothing about get an
+   even share. */
+static gint *
+allocate_source_counts (const GList *sources, gint count)
+{
+  const GList *iter;
+  struct SourceStats *stats;
+  gdouble *weights, *shares, *yields;
+  gdouble total_weight = 0, high_weight = 0, expected = 0;
+  gint *counts;
+  gint assigned = 0;
+  guint n, i, best;
+
+  n = g_list_length ((GList *) sources);
+  counts = g_new0 (gint, n);
+
+  if (count == GRL_COUNT_INFINITY) {
+    for (i = 0; i < n; i++) {
+      counts[i] = GRL_COUNT_INFINITY;
+    }
+    return counts;
+  }
+
+  weights = g_new (gdouble, n);
+  shares = g_new (gdouble, n);
+  yields = g_new (gdouble, n);
+
+  G_LOCK (source_stats);
+  for (iter = sources, i = 0; iter; iter = g_list_next (iter), i++) {
+    stats = get_source_stats (GRL_SOURCE (iter->data));
+    if (stats && stats->samples > 0) {
+      yields[i] = stats->yield;
+      weights[i] = MAX (stats->yield, STATS_MIN_YIELD) /
+        (1.0 + stats->latency / 1000.0);
+    } else {
+      yields[i] = -1.0;
+      weights[i] = 1.0;
+    }
+    total_weight += weights[i];
+  }
+  G_UNLOCK (source_stats);
+
+  for (i = 0; i < n; i++) {
+    shares[i] = count * weights[i] / total_weight;
+    counts[i] = (gint) shares[i];
+    assigned += counts[i];
+  }
+
+  /* Hand out what is left because of rounding to the sources that lost
+     most of their share */
+  while (assigned < count) {
+    best = 0;
+    for (i = 1; i < n; i++) {
+      if (shares[i] - counts[i] > shares[best] - counts[best]) {
+        best = i;
+      }
+    }
+    counts[best]++;
+    assigned++;
+  }
+
+  /* Ask reliable sources for what the others will likely miss, and some
+     extra results; the surplus is cancelled as soon as the count is
+     reached */
+  for (i = 0; i < n; i++) {
+    expected += (yields[i] < 0) ? counts[i] : counts[i] * yields[i];
+    if (counts[i] > 0 && yields[i] >= STATS_HIGH_YIELD) {
+      high_weight += weights[i];
+    }
+  }
+
+  if (n > 1 && high_weight > 0) {
+    for (i = 0; i < n; i++) {
+      if (counts[i] > 0 && yields[i] >= STATS_HIGH_YIELD) {
+        if (expected < count) {
+          counts[i] += (gint) ((count - expected) * weights[i] / high_weight + 0.5);
+        }
+        counts[i] += (counts[i] * STATS_EXTRA_PERCENT + 99) / 100;
+      }
+    }
+  }
+
+  g_free (weights);
+  g_free (shares);
+  g_free (yields);
+
+  return counts;
+}
+
+/* URI routing index: remembers which source accepted the URIs sharing a
+   prefix (scheme, host and path up to the last slash), and which sources
+   ranked before it rejected them, so the next ones go straight to that
+   source as long as no other higher-ranked source is a candidate. It also
+   keeps the URI patterns declared by the plugins of the sources, keyed by
+   source id. Routes to a source are dropped when it is removed, and its
+   patterns when it comes or goes. Each table is protected by its own lock,
+   which is never held while calling the sources */
+G_LOCK_DEFINE_STATIC (uri_routes);
+G_LOCK_DEFINE_STATIC (uri_patterns);
+static GHashTable *uri_routes = NULL;
+static GHashTable *uri_patterns = NULL;
+
+static void
+free_uri_patterns (GList *patterns)
+{
+  g_list_free_full (patterns, (GDestroyNotify) g_pattern_spec_free);
+}
+
+static struct UriRoute *
+uri_route_new (const gchar *source_id, gchar **rejected)
+{
+  struct UriRoute *route = g_slice_new (struct UriRoute);
+
+  route->source_id = g_strdup (source_id);
+  route->rejected = g_strdupv (rejected);
+
+  return route;
+}
+
+static void
+uri_route_free (struct UriRoute *route)
+{
+  g_free (route->source_id);
+  g_strfreev (route->rejected);
+  g_slice_free (struct UriRoute, route);
+}
+
+static gboolean
+uri_route_rejected (struct UriRoute *route, const gchar *source_id)
+{
+  gchar **id;
+
+  for (id = route->rejected; *id; id++) {
+    if (g_strcmp0 (*id, source_id) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static gboolean
+uri_route_to_source (gpointer key,
+                     gpointer value,
+                     gpointer user_data)
+{
+  struct UriRoute *route = (struct UriRoute *) value;
+
+  return g_strcmp0 (route->source_id, user_data) == 0;
+}
+
+static void
+uri_index_source_added_cb (GrlRegistry *registry,
+                           GrlSource *source,
+                           gpointer user_data)
+{
+  G_LOCK (uri_patterns);
+  g_hash_table_remove (uri_patterns, grl_source_get_id (source));
+  G_UNLOCK (uri_patterns);
+}
+
+static void
+uri_index_source_removed_cb (GrlRegistry *registry,
+                             GrlSource *source,
+                             gpointer user_data)
+{
+  G_LOCK (uri_routes);
+  g_hash_table_foreach_remove (uri_routes,
+                               uri_route_to_source,
+                               (gpointer) grl_source_get_id (source));
+  G_UNLOCK (uri_routes);
+
+  G_LOCK (uri_patterns);
+  g_hash_table_remove (uri_patterns, grl_source_get_id (source));
+  G_UNLOCK (uri_patterns);
+}
+
+static void
+ensure_uri_index (void)
+{
+  GrlRegistry *registry;
+
+  G_LOCK (uri_routes);
+
+  if (uri_routes) {
+    G_UNLOCK (uri_routes);
+    return;
+  }
+
+  uri_routes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                      g_free,
+                                      (GDestroyNotify) uri_route_free);
+  uri_patterns = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free,
+                                        (GDestroyNotify) free_uri_patterns);
+
+  registry = grl_registry_get_default ();
+  g_signal_connect (registry, "source-added",
+                    G_CALLBACK (uri_index_source_added_cb), NULL);
+  g_signal_connect (registry, "source-removed",
+                    G_CALLBACK (uri_index_source_removed_cb), NULL);
+
+  G_UNLOCK (uri_routes);
+}
+
+static gchar *
+get_uri_route_key (const gchar *uri)
+{
+  const gchar *colon;
+  const gchar *slash;
+
+  colon = strchr (uri, ':');
+  slash = strrchr (uri, '/');
+
+  if (colon && slash && slash > colon) {
+    return g_strndup (uri, slash - uri + 1);
+  } else if (colon) {
+    return g_strndup (uri, colon - uri + 1);
+  } else {
+    return g_strdup (uri);
+  }
+}
+
+/* Checks the URI against the patterns declared by the plugin of the
+   source, if any */
+static gboolean
+source_may_accept_uri (GrlSource *source, const gchar *uri)
+{
+  GrlPlugin *plugin;
+  const gchar *declared;
+  gchar **patterns, **pattern;
+  GList *specs = NULL;
+  GList *iter;
+  gpointer value;
+  gboolean accepted = FALSE;
+
+  G_LOCK (uri_patterns);
+
+  if (!g_hash_table_lookup_extended (uri_patterns,
+                                     grl_source_get_id (source),
+                                     NULL,
+                                     &value)) {
+    plugin = grl_source_get_plugin (source);
+    declared = plugin? grl_plugin_get_info (plugin, GRL_PLUGIN_URI_PATTERNS): NULL;
+    if (declared) {
+      patterns = g_strsplit (declared, ";", -1);
+      for (pattern = patterns; *pattern; pattern++) {
+        g_strstrip (*pattern);
+        if (**pattern) {
+          specs = g_list_prepend (specs, g_pattern_spec_new (*pattern));
+        }
+      }
+      g_strfreev (patterns);
+    }
+    g_hash_table_insert (uri_patterns,
+                         g_strdup (grl_source_get_id (source)),
+                         specs);
+    value = specs;
+  }
+
+  /* No declared patterns: the source must be tested */
+  if (!value) {
+    accepted = TRUE;
+  }
+
+  for (iter = (GList *) value; iter && !accepted; iter = g_list_next (iter)) {
+    accepted = g_pattern_match_string (iter->data, uri);
+  }
+
+  G_UNLOCK (uri_patterns);
+
+  return accepted;
+}
+
+/* Returns the source @route leads to if it is in @sources and all the
+   sources ranked before it are known to reject the URIs of the route, so
+   the rank order is kept. %NULL means the route can not be taken */
+static GrlSource *
+find_routed_source (GList *sources, struct UriRoute *route)
+{
+  GList *iter;
+  const gchar *source_id;
+
+  for (iter = sources; iter; iter = g_list_next (iter)) {
+    source_id = grl_source_get_id (GRL_SOURCE (iter->data));
+    if (g_strcmp0 (source_id, route->source_id) == 0) {
+      return GRL_SOURCE (iter->data);
+    }
+    if (!uri_route_rejected (route, source_id)) {
+      return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+/* Returns the first source, in @sources order, that can create a media
+   from @uri. test_media_from_uri() is synchronous, so sources are tested
+   one after the other; the routing index and the declared patterns keep
+   that to a single test for most URIs */
+static GrlSource *
+find_source_for_uri (GList *sources, const gchar *uri)
+{
+  GrlSource *source;
+  GrlSource *routed = NULL;
+  struct UriRoute *route;
+  GPtrArray *rejected;
+  GList *iter;
+  gchar *key;
+
+  ensure_uri_index ();
+
+  key = get_uri_route_key (uri);
+
+  G_LOCK (uri_routes);
+  route = g_hash_table_lookup (uri_routes, key);
+  if (route) {
+    routed = find_routed_source (sources, route);
+  }
+  G_UNLOCK (uri_routes);
+
+  if (routed &&
+      source_may_accept_uri (routed, uri) &&
+      grl_source_test_media_from_uri (routed, uri)) {
+    g_free (key);
+    return routed;
+  }
+
+  rejected = g_ptr_array_new ();
+
+  for (iter = sources; iter; iter = g_list_next (iter)) {
+    source = GRL_SOURCE (iter->data);
+    /* Do not test again the source the URI was routed to */
+    if (source != routed &&
+        source_may_accept_uri (source, uri) &&
+        grl_source_test_media_from_uri (source, uri)) {
+      g_ptr_array_add (rejected, NULL);
+      G_LOCK (uri_routes);
+      g_hash_table_insert (uri_routes,
+                           key,
+                           uri_route_new (grl_source_get_id (source),
+                                          (gchar **) rejected->pdata));
+      G_UNLOCK (uri_routes);
+      g_ptr_array_free (rejected, TRUE);
+      return source;
+    }
+    g_ptr_array_add (rejected, (gpointer) grl_source_get_id (source));
+  }
+
+  g_ptr_array_free (rejected, TRUE);
+  g_free (key);
+
+  return NULL;
+}
+
+static struct DedupSet *
+dedup_set_new (void)
+{
+  struct DedupSet *set = g_new0 (struct DedupSet, 1);
+
+  set->size = DEDUP_SET_SIZE;
+  set->slots = g_new0 (guint64, set->size);
+
+  return set;
+}
+
+static void
+dedup_set_free (struct DedupSet *set)
+{
+  g_free (set->slots);
+  g_free (set);
+}
+
+static void
+dedup_set_insert (guint64 *slots, guint size, guint64 digest)
+{
+  guint i = digest & (size - 1);
+
+  while (slots[i]) {
+    i = (i + 1) & (size - 1);
+  }
+  slots[i] = digest;
+}
+
+/* Adds @digest to @set; returns %FALSE if it was already there */
+static gboolean
+dedup_set_add (struct DedupSet *set, guint64 digest)
+{
+  guint64 *slots;
+  guint i;
+
+  for (i = digest & (set->size - 1);
+       set->slots[i];
+       i = (i + 1) & (set->size - 1)) {
+    if (set->slots[i] == digest) {
+      return FALSE;
+    }
+  }
+
+  /* Keep the table at most half full */
+  if ((set->used + 1) * 2 > set->size) {
+    slots = g_new0 (guint64, set->size * 2);
+    for (i = 0; i < set->size; i++) {
+      if (set->slots[i]) {
+        dedup_set_insert (slots, set->size * 2, set->slots[i]);
+      }
+    }
+    g_free (set->slots);
+    set->slots = slots;
+    set->size *= 2;
+  }
+
+  dedup_set_insert (set->slots, set->size, digest);
+  set->used++;
+
+  return TRUE;
+}
+
+/* Computes a digest of the values of the keys identifying @media, using
+   64-bit FNV-1a. Returns 0 if @media lacks any of the keys */
+static guint64
+get_media_digest (struct MultipleSearchData *msd, GrlMedia *media)
+{
+  const GValue *value;
+  const gchar *c;
+  gchar *contents;
+  GList *key;
+  guint64 digest = G_GUINT64_CONSTANT (14695981039346656037);
+
+  for (key = msd->dedup_keys; key; key = g_list_next (key)) {
+    value = grl_data_get (GRL_DATA (media), GRLPOINTER_TO_KEYID (key->data));
+    if (!value) {
+      return 0;
+    }
+
+    if (G_VALUE_HOLDS_STRING (value)) {
+      if (!g_value_get_string (value)) {
+        return 0;
+      }
+      contents = g_utf8_casefold (g_value_get_string (value), -1);
+    } else {
+      contents = g_strdup_value_contents (value);
+    }
+
+    /* Include the terminating nul, so values are not mixed up */
+    c = contents;
+    do {
+      digest ^= (guchar) *c;
+      digest *= G_GUINT64_CONSTANT (1099511628211);
+    } while (*c++);
+
+    g_free (contents);
+  }
+
+  return digest? digest: 1;
+}
+
+/* Adds the keys of @loser missing in @winner to it */
+static void
+merge_media_metadata (GrlMedia *winner, GrlMedia *loser)
+{
+  GList *keys;
+  GList *key;
+  const GValue *value;
+
+  keys = grl_data_get_keys (GRL_DATA (loser));
+  for (key = keys; key; key = g_list_next (key)) {
+    if (!grl_data_has_key (GRL_DATA (winner),
+                           GRLPOINTER_TO_KEYID (key->data))) {
+      value = grl_data_get (GRL_DATA (loser), GRLPOINTER_TO_KEYID (key->data));
+      if (value) {
+        grl_data_set (GRL_DATA (winner), GRLPOINTER_TO_KEYID (key->data), value);
+      }
+    }
+  }
+  g_list_free (keys);
+}
+
+/* Whether the results of @a win over the duplicates from @b: the source
+   with the highest rank wins, or the first one given on a tie, so the
+   result kept does not depend on which source answers first */
+static gboolean
+source_preferred (struct MultipleSearchData *msd,
+                  GrlSource *a,
+                  GrlSource *b)
+{
+  gint rank_a = grl_source_get_rank (a);
+  gint rank_b = grl_source_get_rank (b);
+
+  if (rank_a != rank_b) {
+    return rank_a > rank_b;
+  }
+
+  return g_list_index (msd->sources, a) < g_list_index (msd->sources, b);
+}
+
+/* Checks whether @media duplicates a previous result. Returns %TRUE if it
+   must be kept, otherwise @media is freed */
+static gboolean
+dedup_result (struct MultipleSearchData *msd,
+              struct ResultCount *rc,
+              GrlMedia *media)
+{
+  struct DedupPending *pending = NULL;
+  guint64 digest;
+  gint64 *key;
+
+  digest = get_media_digest (msd, media);
+  if (digest == 0) {
+    /* It can not be identified */
+    return TRUE;
+  }
+
+  if (dedup_set_add (msd->dedup_seen, digest)) {
+    key = g_new (gint64, 1);
+    *key = (gint64) digest;
+    pending = g_new (struct DedupPending, 1);
+    pending->media = media;
+    pending->rc = rc;
+    g_hash_table_insert (msd->dedup_pending, key, pending);
+    return TRUE;
+  }
+
+  msd->duplicates++;
+
+  key = (gint64 *) &digest;
+  pending = g_hash_table_lookup (msd->dedup_pending, key);
+
+  if (!pending) {
+    /* The result kept was already sent */
+    GRL_DEBUG ("Dropping duplicated result from %s",
+               grl_source_get_name (rc->source));
+    g_object_unref (media);
+    return FALSE;
+  }
+
+  if (source_preferred (msd, rc->source, pending->rc->source)) {
+    GRL_DEBUG ("Replacing duplicated result from %s by the one from %s",
+               grl_source_get_name (pending->rc->source),
+               grl_source_get_name (rc->source));
+    if (msd->dedup_merge) {
+      merge_media_metadata (media, pending->media);
+    }
+    g_queue_remove (pending->rc->buffer, pending->media);
+    g_object_unref (pending->media);
+    pending->media = media;
+    pending->rc = rc;
+    return TRUE;
+  }
+
+  GRL_DEBUG ("Dropping duplicated result from %s",
+             grl_source_get_name (rc->source));
+  if (msd->dedup_merge) {
+    merge_media_metadata (pending->media, media);
+  }
+  g_object_unref (media);
+
+  return FALSE;
+}
+
+static void
+free_result_count (struct ResultCount *rc)
+{
+  if (rc->deadline_id) {
+    grl_context_source_remove (rc->msd->context, rc->deadline_id);
+  }
+  g_queue_free_full (rc->buffer, g_object_unref);
+  g_free (rc);
+}
+
 static void
 free_multiple_search_data (struct MultipleSearchData *msd)
 {
   GRL_DEBUG ("free_multiple_search_data");
+  if (msd->confirm_id) {
+    grl_context_source_remove (msd->context, msd->confirm_id);
+  }
+  if (msd->dedup_seen) {
+    dedup_set_free (msd->dedup_seen);
+  }
+  if (msd->dedup_pending) {
+    g_hash_table_unref (msd->dedup_pending);
+  }
+  g_list_free (msd->dedup_keys);
   g_hash_table_unref (msd->table);
-  g_list_free (msd->search_ids);
   g_list_free (msd->sources);
-  g_list_free (msd->sources_more);
   g_list_free (msd->keys);
   g_object_unref (msd->options);
   g_free (msd->text);
+  g_main_context_unref (msd->context);
   g_free (msd);
 }
 
+/* Cancels the operations of the sources that could still send results */
+static void
+cancel_source_operations (struct MultipleSearchData *msd)
+{
+  GList *iter;
+  struct ResultCount *rc;
+
+  msd->cancelled = TRUE;
+
+  for (iter = msd->sources; iter; iter = g_list_next (iter)) {
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+    if (rc->running) {
+      GRL_DEBUG ("cancelling operation %s:%u",
+                 grl_source_get_name (rc->source), rc->operation_id);
+      grl_operation_cancel (rc->operation_id);
+    }
+  }
+}
+
+static void
+emit_result (struct MultipleSearchData *msd,
+             GrlSource *source,
+             GrlMedia *media)
+{
+  guint remaining = msd->remaining--;
+  guint64 digest;
+
+  /* Once sent, a result can not be replaced by a duplicate any more */
+  if (msd->dedup_seen && media) {
+    digest = get_media_digest (msd, media);
+    if (digest) {
+      g_hash_table_remove (msd->dedup_pending, &digest);
+    }
+  }
+
+  msd->user_callback (source,
+                      msd->search_id,
+                      media,
+                      remaining,
+                      msd->user_data,
+                      NULL);
+
+  /* The user got all the results; cancel the extra ones we asked for */
+  if (media && remaining == 0) {
+    cancel_source_operations (msd);
+  }
+}
+
 static gboolean
 confirm_cancel_idle (gpointer user_data)
 {
   struct MultipleSearchData *msd = (struct MultipleSearchData *) user_data;
+
+  msd->confirm_id = 0;
   msd->user_callback (NULL, msd->search_id, NULL, 0, msd->user_data, NULL);
+
+  /* The sources may have confirmed the cancellation already */
+  if (msd->running == 0) {
+    grl_operation_remove (msd->search_id);
+  }
+
   return FALSE;
 }
 
@@ -126,8 +937,20 @@ handle_no_searchable_sources_idle (gpointer user_data)
   GError *error;
   struct CallbackData *callback_data = (struct CallbackData *) user_data;
 
-  error = g_error_new (GRL_CORE_ERROR, GRL_CORE_ERROR_SEARCH_FAILED,
-                       _("No searchable sources available"));
+  switch (callback_data->operation_type) {
+  case GRL_OP_BROWSE:
+    error = g_error_new (GRL_CORE_ERROR, GRL_CORE_ERROR_BROWSE_FAILED,
+                         _("No browsable sources available"));
+    break;
+  case GRL_OP_QUERY:
+    error = g_error_new (GRL_CORE_ERROR, GRL_CORE_ERROR_QUERY_FAILED,
+                         _("No queryable sources available"));
+    break;
+  default:
+    error = g_error_new (GRL_CORE_ERROR, GRL_CORE_ERROR_SEARCH_FAILED,
+                         _("No searchable sources available"));
+    break;
+  }
   callback_data->user_callback (NULL, 0, NULL, 0, callback_data->user_data, error);
 
   g_error_free (error);
@@ -137,20 +960,364 @@ handle_no_searchable_sources_idle (gpointer user_data)
 }
 
 static void
-handle_no_searchable_sources (GrlSourceResultCb callback, gpointer user_data)
+handle_no_searchable_sources (GrlSupportedOps operation_type,
+                              GrlSourceResultCb callback,
+                              gpointer user_data)
 {
   struct CallbackData *callback_data = g_new0 (struct CallbackData, 1);
+  callback_data->operation_type = operation_type;
   callback_data->user_callback = callback;
   callback_data->user_data = user_data;
-  g_idle_add (handle_no_searchable_sources_idle, callback_data);
+  grl_context_idle_add (NULL, G_PRIORITY_DEFAULT_IDLE,
+                        handle_no_searchable_sources_idle, callback_data);
+}
+
+static guint
+run_source_operation (struct MultipleSearchData *msd,
+                      GrlSource *source,
+                      GrlOperationOptions *options)
+{
+  switch (msd->operation_type) {
+  case GRL_OP_BROWSE:
+    return grl_source_browse (source, NULL, msd->keys, options,
+                              multiple_search_cb, msd);
+  case GRL_OP_QUERY:
+    return grl_source_query (source, msd->text, msd->keys, options,
+                             multiple_search_cb, msd);
+  default:
+    return grl_source_search (source, msd->text, msd->keys, options,
+                              multiple_search_cb, msd);
+  }
+}
+
+/* Sends the results buffered in ordered merge mode, following the order of
+   the sources, until it finds a source that could still send more */
+static void
+flush_ordered_results (struct MultipleSearchData *msd)
+{
+  GList *iter;
+  GrlMedia *media;
+  struct ResultCount *rc;
+
+  for (iter = msd->sources; iter; iter = g_list_next (iter)) {
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+    while (!msd->cancelled && (media = g_queue_pop_head (rc->buffer))) {
+      emit_result (msd, rc->source, media);
+    }
+    /* A source that is not exhausted will be asked for more results, that
+       go before the ones of the following sources */
+    if (msd->cancelled || !rc->exhausted) {
+      break;
+    }
+  }
+}
+
+/* Returns the first source, in the order they were given, that could still
+   provide more results */
+static struct ResultCount *
+get_first_pending_source (struct MultipleSearchData *msd)
+{
+  GList *iter;
+  struct ResultCount *rc;
+
+  for (iter = msd->sources; iter; iter = g_list_next (iter)) {
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+    if (!rc->exhausted) {
+      return rc;
+    }
+  }
+
+  return NULL;
+}
+
+static gdouble
+get_media_score (struct MultipleSearchData *msd, GrlMedia *media)
+{
+  const GValue *value;
+  GValue score = { 0, };
+  gdouble result = -G_MAXDOUBLE;
+
+  if (msd->score_key == GRL_METADATA_KEY_INVALID) {
+    return result;
+  }
+
+  value = grl_data_get (GRL_DATA (media), msd->score_key);
+  if (value &&
+      g_value_type_transformable (G_VALUE_TYPE (value), G_TYPE_DOUBLE)) {
+    g_value_init (&score, G_TYPE_DOUBLE);
+    g_value_transform (value, &score);
+    result = g_value_get_double (&score);
+    g_value_unset (&score);
+  }
+
+  return result;
+}
+
+/* Sends the results buffered in ranked merge mode. Each source sends its
+   results in its own order of relevance, so we only need to compare the
+   first pending result of each source; but that means we can only send
+   anything once each source that can still send results has one to
+   compare with. A running source is waited for until its merge deadline
+   passes. A source that is idle but not exhausted could have better results
+   than the ones left, so it is asked for more right away, and waited for */
+static void
+flush_ranked_results (struct MultipleSearchData *msd)
+{
+  GList *iter;
+  GrlSource *best_source;
+  GrlMedia *media;
+  gdouble best_score, score;
+  gint best_rank, rank;
+  gboolean wait;
+  struct ResultCount *rc;
+
+  while (!msd->cancelled) {
+    best_source = NULL;
+    best_score = -G_MAXDOUBLE;
+    best_rank = G_MININT;
+    wait = FALSE;
+
+    for (iter = msd->sources; iter; iter = g_list_next (iter)) {
+      rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+      media = g_queue_peek_head (rc->buffer);
+      if (!media) {
+        if (!rc->running && !rc->exhausted) {
+          start_source_slice (msd, rc, rc->skip + rc->count,
+                              (msd->count == GRL_COUNT_INFINITY)?
+                              GRL_COUNT_INFINITY: (gint) msd->remaining + 1);
+        }
+        if (rc->running && !rc->deadline_passed) {
+          /* This source could still send a better result */
+          wait = TRUE;
+        }
+        continue;
+      }
+
+      score = get_media_score (msd, media);
+      rank = grl_source_get_rank (rc->source);
+      if (!best_source ||
+          score > best_score ||
+          (score == best_score && rank > best_rank)) {
+        best_source = rc->source;
+        best_score = score;
+        best_rank = rank;
+      }
+    }
+
+    if (wait || !best_source) {
+      return;
+    }
+
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, best_source);
+    emit_result (msd, best_source, g_queue_pop_head (rc->buffer));
+  }
+}
+
+/* Sends the results buffered when removing duplicates without a merge
+   mode. Results are sent as they arrive, except that they wait while a
+   preferred source is running, as it could send a duplicate that must win
+   over them */
+static void
+flush_unordered_results (struct MultipleSearchData *msd)
+{
+  GList *iter;
+  GList *other;
+  GrlMedia *media;
+  struct ResultCount *rc;
+  struct ResultCount *other_rc;
+  gboolean held;
+
+  for (iter = msd->sources; iter && !msd->cancelled; iter = g_list_next (iter)) {
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+    if (g_queue_is_empty (rc->buffer)) {
+      continue;
+    }
+
+    held = FALSE;
+    for (other = msd->sources; other && !held; other = g_list_next (other)) {
+      other_rc = (struct ResultCount *) g_hash_table_lookup (msd->table,
+                                                             other->data);
+      held = other_rc != rc && other_rc->running &&
+        source_preferred (msd, other_rc->source, rc->source);
+    }
+
+    while (!held && !msd->cancelled && (media = g_queue_pop_head (rc->buffer))) {
+      emit_result (msd, rc->source, media);
+    }
+  }
+}
+
+static void
+flush_merged_results (struct MultipleSearchData *msd)
+{
+  if (msd->merge_mode == GRL_MERGE_MODE_RANKED) {
+    flush_ranked_results (msd);
+  } else if (msd->merge_mode == GRL_MERGE_MODE_ORDERED) {
+    flush_ordered_results (msd);
+  } else {
+    flush_unordered_results (msd);
+  }
+}
+
+static gboolean
+merge_deadline_cb (gpointer user_data)
+{
+  struct ResultCount *rc = (struct ResultCount *) user_data;
+  struct MultipleSearchData *msd = rc->msd;
+
+  GRL_DEBUG ("merge deadline passed for %s (%u)",
+             grl_source_get_name (rc->source), msd->search_id);
+
+  rc->deadline_id = 0;
+  rc->deadline_passed = TRUE;
+  if (!msd->cancelled) {
+    flush_ranked_results (msd);
+  }
+
+  return FALSE;
+}
+
+static void
+start_source_slice (struct MultipleSearchData *msd,
+                    struct ResultCount *rc,
+                    guint skip,
+                    gint count)
+{
+  GrlOperationOptions *source_options;
+
+  rc->skip = skip;
+  rc->count = count;
+  rc->received = 0;
+  rc->running = TRUE;
+  rc->start_time = g_get_monotonic_time ();
+  msd->running++;
+  msd->requests++;
+
+  /* Each request of a source has its own time to send a first result */
+  if (rc->deadline_id) {
+    grl_context_source_remove (msd->context, rc->deadline_id);
+    rc->deadline_id = 0;
+  }
+  rc->deadline_passed = FALSE;
+  if (msd->merge_mode == GRL_MERGE_MODE_RANKED && msd->merge_deadline > 0) {
+    rc->deadline_id = grl_context_timeout_add (msd->context,
+                                               msd->merge_deadline,
+                                               merge_deadline_cb, rc);
+  }
+
+  /* Filters and sorting the source does not support are applied by the core
+     on its results, so keep all the options */
+  source_options = grl_operation_options_copy (msd->options);
+  grl_operation_options_set_skip (source_options, skip);
+  grl_operation_options_set_count (source_options, count);
+
+  /* Execute the operation on this source */
+  rc->operation_id = run_source_operation (msd, rc->source, source_options);
+  if (rc->operation_id > 0) {
+    grl_operation_set_parent (rc->operation_id, msd->search_id);
+  }
+  if (grl_operation_is_paused (msd->search_id)) {
+    grl_operation_pause (rc->operation_id);
+  }
+
+  GRL_DEBUG ("Operation %s:%u: Requesting %u items from offset %u",
+             grl_source_get_name (rc->source),
+             rc->operation_id, rc->count, skip);
+
+  g_object_unref (source_options);
+}
+
+/* Number of results the user would still miss if every running source
+   provided all the results it was asked for */
+static gint
+compute_deficit (struct MultipleSearchData *msd)
+{
+  GList *iter;
+  struct ResultCount *rc;
+  gint deficit;
+
+  if (msd->count == GRL_COUNT_INFINITY) {
+    return 0;
+  }
+
+  deficit = msd->remaining + 1;
+  for (iter = msd->sources; iter; iter = g_list_next (iter)) {
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+    deficit -= g_queue_get_length (rc->buffer);
+    if (rc->running && rc->count > rc->received) {
+      deficit -= rc->count - rc->received;
+    }
+  }
+
+  return deficit;
+}
+
+/* Asks the idle sources that can still provide results for the ones the
+   user would miss, without waiting for the other sources to finish */
+static void
+refill_sources (struct MultipleSearchData *msd)
+{
+  GList *candidates = NULL;
+  GList *iter;
+  struct ResultCount *rc;
+  gint deficit;
+  gint *counts;
+  guint i;
+
+  /* In ordered merge mode, the results of the following sources wait for
+     the first source that is not exhausted, so it is asked for all the
+     results the user still misses */
+  if (msd->merge_mode == GRL_MERGE_MODE_ORDERED) {
+    rc = get_first_pending_source (msd);
+    if (rc && !rc->running) {
+      start_source_slice (msd, rc, rc->skip + rc->count,
+                          (msd->count == GRL_COUNT_INFINITY)?
+                          GRL_COUNT_INFINITY: (gint) msd->remaining + 1);
+    }
+  }
+
+  deficit = compute_deficit (msd);
+  if (deficit <= 0) {
+    return;
+  }
+
+  for (iter = msd->sources; iter; iter = g_list_next (iter)) {
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+    if (!rc->running && !rc->exhausted) {
+      candidates = g_list_append (candidates, rc->source);
+    }
+  }
+
+  if (!candidates) {
+    return;
+  }
+
+  /* Duplicates are expected to keep showing up at the same rate */
+  if (msd->duplicates > 0 && msd->received > msd->duplicates) {
+    deficit += (gint) ((gdouble) deficit * msd->duplicates /
+                       (msd->received - msd->duplicates) + 0.5);
+  }
+
+  GRL_DEBUG ("Requesting %d more results", deficit);
+
+  counts = allocate_source_counts (candidates, deficit);
+  for (iter = candidates, i = 0; iter; iter = g_list_next (iter), i++) {
+    if (counts[i] > 0) {
+      rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+      start_source_slice (msd, rc, rc->skip + rc->count, counts[i]);
+    }
+  }
+
+  g_free (counts);
+  g_list_free (candidates);
 }
 
 static struct MultipleSearchData *
 start_multiple_search_operation (guint search_id,
+                                 GrlSupportedOps operation_type,
 				 const GList *sources,
 				 const gchar *text,
 				 const GList *keys,
-				 const GList *skip_counts,
 				 gint count,
 				 GrlOperationOptions *options,
 				 GrlSourceResultCb user_callback,
@@ -159,141 +1326,74 @@ start_multiple_search_operation (guint search_id,
   GRL_DEBUG ("start_multiple_search_operation");
 
   struct MultipleSearchData *msd;
-  GList *iter_sources, *iter_skips;
+  const GList *iter;
+  GList *key;
+  struct ResultCount *rc;
+  gint *counts;
   guint n;
-  gint first_count, individual_count;
 
   /* Prepare data required to execute the operation */
   msd = g_new0 (struct MultipleSearchData, 1);
   msd->table = g_hash_table_new_full (g_direct_hash, g_direct_equal,
-				      NULL, g_free);
+				      NULL, (GDestroyNotify) free_result_count);
+  msd->count = count;
   msd->remaining =
       (count == GRL_COUNT_INFINITY) ? GRL_COUNT_INFINITY : (count - 1);
   msd->search_id = search_id;
+  msd->context = grl_operation_ref_context (search_id);
+  msd->operation_type = operation_type;
+  msd->merge_mode = grl_operation_options_get_merge_mode (options);
+  msd->score_key = grl_operation_options_get_merge_score_key (options);
+  msd->merge_deadline = grl_operation_options_get_merge_deadline (options);
   msd->text = g_strdup (text);
   msd->keys = g_list_copy ((GList *) keys);
   msd->options = g_object_ref (options);
-  msd->user_callback = user_callback;
-  msd->user_data = user_data;
 
-  /* Compute the # of items to request by each source */
-  n = g_list_length ((GList *) sources);
-  if (count == GRL_COUNT_INFINITY) {
-    individual_count = GRL_COUNT_INFINITY;
-    first_count = GRL_COUNT_INFINITY;
-  } else {
-    individual_count = count / n;
-    first_count = individual_count + count % n;
-  }
-
-  /* Issue search operations on each source */
-  iter_sources = (GList *) sources;
-  iter_skips = (GList *) skip_counts;
-  n = 0;
-  while (iter_sources) {
-    GrlSource *source;
-    guint c, id;
-    struct ResultCount *rc;
-    guint skip;
-
-    source = GRL_SOURCE (iter_sources->data);
-
-    /* c is the count to use for this source */
-    c = (n == 0) ? first_count : individual_count;
-    n++;
-
-    /* Only interested in sources with c != 0 */
-    if (c != 0) {
-      GrlOperationOptions *source_options = NULL;
-      GrlCaps *source_caps;
-
-      /* We use ResultCount to keep track of results emitted by this source */
-      rc = g_new0 (struct ResultCount, 1);
-      rc->count = c;
-      g_hash_table_insert (msd->table, source, rc);
-
-      /* Check if we have to apply a "skip" parameter to this source
-	 (useful when we are chaining queries to complete the result count) */
-      if (iter_skips) {
-	skip = GPOINTER_TO_INT (iter_skips->data);
-      } else {
-	skip = 0;
+  msd->dedup_keys = grl_operation_options_get_dedup_keys (options);
+  if (msd->dedup_keys) {
+    msd->dedup_merge = grl_operation_options_get_dedup_merge (options);
+    msd->dedup_seen = dedup_set_new ();
+    msd->dedup_pending = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                                g_free, g_free);
+    /* Make sure sources fill in the keys identifying the results */
+    for (key = msd->dedup_keys; key; key = g_list_next (key)) {
+      if (!g_list_find (msd->keys, key->data)) {
+        msd->keys = g_list_append (msd->keys, key->data);
       }
-
-      source_caps = grl_source_get_caps (source, GRL_OP_SEARCH);
-      grl_operation_options_obey_caps (options, source_caps, &source_options, NULL);
-      grl_operation_options_set_skip (source_options, skip);
-      grl_operation_options_set_count (source_options, rc->count);
-
-      /* Execute the search on this source */
-      id = grl_source_search (source,
-				    msd->text,
-				    msd->keys,
-				    source_options,
-				    multiple_search_cb,
-				    msd);
-
-      GRL_DEBUG ("Operation %s:%u: Searching %u items from offset %u",
-                 grl_source_get_name (GRL_SOURCE (source)),
-                 id, rc->count, skip);
-
-      g_object_unref (source_options);
-
-      /* Keep track of this operation and this source */
-      msd->search_ids = g_list_prepend (msd->search_ids, GINT_TO_POINTER (id));
-      msd->sources = g_list_prepend (msd->sources, source);
-      msd->sources_count++;
     }
+  }
+  msd->user_callback = user_callback;
+  msd->user_data = user_data;
 
-    /* Move to the next source */
-    iter_sources = g_list_next (iter_sources);
-    iter_skips = g_list_next (iter_skips);
+  /* We use ResultCount to keep track of results emitted by each source */
+  for (iter = sources; iter; iter = g_list_next (iter)) {
+    rc = g_new0 (struct ResultCount, 1);
+    rc->msd = msd;
+    rc->source = GRL_SOURCE (iter->data);
+    rc->buffer = g_queue_new ();
+    g_hash_table_insert (msd->table, rc->source, rc);
+    msd->sources = g_list_prepend (msd->sources, rc->source);
   }
+  msd->sources = g_list_reverse (msd->sources);
 
-  /* This frees the previous msd structure (if this operation is chained) */
   grl_operation_set_private_data (msd->search_id,
                                   msd,
                                   (GrlOperationCancelCb) multiple_search_cancel_cb,
                                   (GDestroyNotify) free_multiple_search_data);
-
-  return msd;
-}
-
-static struct MultipleSearchData *
-chain_multiple_search_operation (struct MultipleSearchData *old_msd)
-{
-  GList *skip_list = NULL;
-  GList *source_iter;
-  struct ResultCount *rc;
-  GrlSource *source;
-  struct MultipleSearchData *msd;
-
-  /* Compute skip parameter for each of the sources that can still
-     provide more results */
-  source_iter = old_msd->sources_more;
-  while (source_iter) {
-    source = GRL_SOURCE (source_iter->data);
-    rc = (struct ResultCount *)
-      g_hash_table_lookup (old_msd->table, (gpointer) source);
-    skip_list = g_list_prepend (skip_list,
-				GINT_TO_POINTER (rc->count + rc->skip));
-    source_iter = g_list_next (source_iter);
-  }
-
-  /* Reverse the sources list so that they match the skip list */
-  old_msd->sources_more = g_list_reverse (old_msd->sources_more);
-
-  /* Continue the search process with the same search_id */
-  msd = start_multiple_search_operation (old_msd->search_id,
-					 old_msd->sources_more,
-					 old_msd->text,
-					 old_msd->keys,
-					 skip_list,
-					 old_msd->pending,
-					 old_msd->options,
-					 old_msd->user_callback,
-					 old_msd->user_data);
-  g_list_free (skip_list);
+  grl_operation_set_flow_control (msd->search_id,
+                                  (GrlOperationFlowCb) multiple_search_flow_cb,
+                                  (GrlOperationFlowCb) multiple_search_flow_cb);
+
+  /* Compute the # of items to request by each source, and issue the
+     operations; sources with nothing to do now may be asked later */
+  counts = allocate_source_counts (sources, count);
+  for (iter = sources, n = 0; iter; iter = g_list_next (iter), n++) {
+    if (counts[n] != 0) {
+      rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+      start_source_slice (msd, rc, 0, counts[n]);
+    }
+  }
+  g_free (counts);
 
   return msd;
 }
@@ -342,23 +1442,23 @@ multiple_search_cb (GrlSource *source,
   GRL_DEBUG (__FUNCTION__);
 
   struct MultipleSearchData *msd;
-  gboolean emit;
-  gboolean operation_done = FALSE;
   struct ResultCount *rc;
 
   msd = (struct MultipleSearchData *) user_data;
+  rc = (struct ResultCount *)
+    g_hash_table_lookup (msd->table, (gpointer) source);
 
   GRL_DEBUG ("multiple:remaining == %u, source:remaining = %u (%s)",
              msd->remaining, remaining,
              grl_source_get_name (GRL_SOURCE (source)));
 
-  /* Check if operation is done, that is, if all the sources involved
-     in the multiple operation have emitted remaining=0 */
+  /* Check if this source is done with the results we asked for */
   if (remaining == 0) {
-    msd->sources_done++;
-    if (msd->sources_done == msd->sources_count) {
-      operation_done = TRUE;
-      GRL_DEBUG ("multiple operation chunk done");
+    rc->running = FALSE;
+    msd->running--;
+    if (rc->deadline_id) {
+      grl_context_source_remove (msd->context, rc->deadline_id);
+      rc->deadline_id = 0;
     }
   }
 
@@ -370,7 +1470,7 @@ multiple_search_cb (GrlSource *source,
       g_object_unref (media);
       media = NULL;
     }
-    if (operation_done) {
+    if (msd->running == 0 && msd->confirm_id == 0) {
       /* This was the last result and the operation is cancelled
 	 so we don't have anything else to do*/
       goto operation_done;
@@ -383,80 +1483,81 @@ multiple_search_cb (GrlSource *source,
 
   /* --- Update remaining count --- */
 
-  rc = (struct ResultCount *)
-    g_hash_table_lookup (msd->table, (gpointer) source);
-
   if (media) {
     rc->received++;
+    msd->received++;
   }
 
-  rc->remaining = remaining;
-
-  if (rc->remaining == 0 && rc->received != rc->count) {
-    /* This source failed to provide as many results as we requested,
-       we will have to check if other sources can provide the missing
-       results */
-    if (rc->count != GRL_COUNT_INFINITY)
-      msd->pending += rc->count - rc->received;
-  } else if (remaining == 0) {
-    /* This source provided all requested results, if others did not
-       we can use this to request more */
-    msd->sources_more = g_list_prepend (msd->sources_more, source);
-    GRL_DEBUG ("Source %s provided all requested results",
-               grl_source_get_name (GRL_SOURCE (source)));
+  if (remaining == 0) {
+    update_source_stats (source,
+                         rc->count,
+                         rc->received,
+                         g_get_monotonic_time () - rc->start_time);
+
+    if (rc->count == GRL_COUNT_INFINITY || rc->received < rc->count) {
+      /* This source failed to provide as many results as we requested,
+         so it has no more */
+      rc->exhausted = TRUE;
+    } else {
+      GRL_DEBUG ("Source %s provided all requested results",
+                 grl_source_get_name (GRL_SOURCE (source)));
+    }
   }
 
-  /* --- Manage NULL results --- */
+  /* --- Result emission --- */
 
-  if (remaining == 0 && media == NULL && msd->remaining > 0) {
-    /* A source emitted a NULL result to finish its search operation
-       we don't want to relay this to the client (unless this is the
-       last one in the multiple search) */
-    GRL_DEBUG ("Skipping NULL result");
-    emit = FALSE;
-  } else {
-    emit = TRUE;
+  /* NULL results only tell a source is done: we don't relay them to the
+     client, the last result sent carries remaining == 0, or we send a NULL
+     one once every source is done */
+  if (media && msd->dedup_seen && !dedup_result (msd, rc, media)) {
+    media = NULL;
   }
 
-  /* --- Result emission --- */
+  /* Without a merge mode, results are buffered only to let the preferred
+     duplicates win */
+  if (msd->merge_mode != GRL_MERGE_MODE_NONE || msd->dedup_seen) {
+    if (media) {
+      g_queue_push_tail (rc->buffer, media);
+    }
+    flush_merged_results (msd);
+  } else if (media) {
+    emit_result (msd, source, media);
+  }
 
-  if (emit) {
-    msd->user_callback (source,
-  		        msd->search_id,
- 		        media,
-		        msd->remaining--,
-		        msd->user_data,
-		        NULL);
+  if (msd->cancelled) {
+    /* The user got all the results; the sources we asked for extra ones
+       still have to confirm the cancellation */
+    if (msd->running == 0) {
+      goto operation_done;
+    }
+    return;
   }
 
   /* --- Manage pending results --- */
 
-  if (operation_done && msd->pending > 0 && msd->sources_more) {
-    /* We did not get all the requested results and have sources
-       that can still provide more */
-    GRL_DEBUG ("Requesting next chunk");
-    chain_multiple_search_operation (msd);
-    return;
-  } else if (operation_done && msd->pending > 0) {
-    /* We don't have sources capable of providing more results,
-       finish operation now */
-    msd->user_callback (source,
-			msd->search_id,
-			NULL,
-			0,
-			msd->user_data,
-			NULL);
-    goto operation_done;
-  } else if (operation_done) {
-    /* We provided all the results */
-    goto operation_done;
-  } else {
+  if (remaining == 0) {
+    /* Ask the sources that can provide more results for the ones we miss,
+       without waiting for the others */
+    refill_sources (msd);
+  }
+
+  if (msd->running > 0) {
     /* We are still receiving results */
     return;
   }
 
+  /* We don't have sources capable of providing more results,
+     finish operation now */
+  msd->user_callback (source,
+                      msd->search_id,
+                      NULL,
+                      0,
+                      msd->user_data,
+                      NULL);
+
  operation_done:
-  GRL_DEBUG ("Multiple operation finished (%u)", msd->search_id);
+  GRL_DEBUG ("Multiple operation finished (%u) after %u request(s)",
+             msd->search_id, msd->requests);
   grl_operation_remove (msd->search_id);
 }
 
@@ -495,6 +1596,275 @@ media_from_uri_cb (GrlSource *source,
   free_media_from_uri_data (mfucd);
 }
 
+static void
+free_media_from_uris_route (struct MediaFromUrisRoute *route)
+{
+  g_queue_free (route->uris);
+  g_free (route);
+}
+
+static void
+free_media_from_uris_data (struct MediaFromUrisData *mfud)
+{
+  GRL_DEBUG ("free_media_from_uris_data");
+  g_list_free_full (mfud->uris, g_free);
+  g_list_free_full (mfud->routes, (GDestroyNotify) free_media_from_uris_route);
+  g_list_free (mfud->items);
+  g_list_free (mfud->keys);
+  g_object_unref (mfud->options);
+  g_free (mfud);
+}
+
+static void
+media_from_uris_check_done (struct MediaFromUrisData *mfud)
+{
+  if (mfud->running > 0) {
+    return;
+  }
+
+  if (mfud->cancelled) {
+    mfud->user_callback (NULL, mfud->operation_id, NULL, 0,
+                         mfud->user_data, NULL);
+  } else if (mfud->remaining > 0) {
+    return;
+  }
+
+  GRL_DEBUG ("Media from URIs operation finished (%u)", mfud->operation_id);
+  grl_operation_remove (mfud->operation_id);
+}
+
+static void media_from_uris_dispatch (struct MediaFromUrisData *mfud,
+                                      struct MediaFromUrisRoute *route);
+
+static void
+media_from_uris_item_cb (GrlSource *source,
+                         guint operation_id,
+                         GrlMedia *media,
+                         gpointer user_data,
+                         const GError *error)
+{
+  struct MediaFromUrisItem *item = (struct MediaFromUrisItem *) user_data;
+  struct MediaFromUrisData *mfud = item->mfud;
+  GError *_error = NULL;
+
+  item->route->running--;
+  mfud->running--;
+  mfud->items = g_list_remove (mfud->items, item);
+
+  if (mfud->cancelled) {
+    if (media) {
+      g_object_unref (media);
+    }
+  } else {
+    if (!media && !error) {
+      _error = g_error_new (GRL_CORE_ERROR,
+                            GRL_CORE_ERROR_MEDIA_FROM_URI_FAILED,
+                            _("Could not resolve media for URI '%s'"),
+                            item->uri);
+    }
+    mfud->user_callback (source, mfud->operation_id, media,
+                         --mfud->remaining,
+                         mfud->user_data,
+                         error? error: _error);
+    if (_error) {
+      g_error_free (_error);
+    }
+
+    media_from_uris_dispatch (mfud, item->route);
+  }
+
+  g_free (item);
+
+  media_from_uris_check_done (mfud);
+}
+
+/* Resolves the next URIs routed to a source, without exceeding the
+   maximum number of operations running at once in a source */
+static void
+media_from_uris_dispatch (struct MediaFromUrisData *mfud,
+                          struct MediaFromUrisRoute *route)
+{
+  struct MediaFromUrisItem *item;
+
+  while (!g_queue_is_empty (route->uris) &&
+         (mfud->max_concurrent == 0 ||
+          route->running < mfud->max_concurrent)) {
+    item = g_new0 (struct MediaFromUrisItem, 1);
+    item->mfud = mfud;
+    item->route = route;
+    item->uri = g_queue_pop_head (route->uris);
+
+    route->running++;
+    mfud->running++;
+    mfud->items = g_list_prepend (mfud->items, item);
+
+    item->operation_id =
+      grl_source_get_media_from_uri (route->source, item->uri, mfud->keys,
+                                     mfud->options, media_from_uris_item_cb,
+                                     item);
+  }
+}
+
+static gboolean
+media_from_uris_idle (gpointer user_data)
+{
+  struct MediaFromUrisData *mfud = (struct MediaFromUrisData *) user_data;
+  struct MediaFromUrisRoute *route;
+  GHashTable *routes;
+  GrlRegistry *registry;
+  GList *sources, *iter;
+  GrlSource *source;
+  GError *error;
+
+  if (mfud->cancelled) {
+    media_from_uris_check_done (mfud);
+    return FALSE;
+  }
+
+  registry = grl_registry_get_default ();
+  sources =
+    grl_registry_get_sources_by_operations (registry,
+                                            GRL_OP_MEDIA_FROM_URI,
+                                            TRUE);
+
+  /* Group URIs per source */
+  routes = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (iter = mfud->uris; iter; iter = g_list_next (iter)) {
+    source = find_source_for_uri (sources, iter->data);
+    if (!source) {
+      error = g_error_new (GRL_CORE_ERROR,
+                           GRL_CORE_ERROR_MEDIA_FROM_URI_FAILED,
+                           _("Could not resolve media for URI '%s'"),
+                           (gchar *) iter->data);
+      mfud->user_callback (NULL, mfud->operation_id, NULL,
+                           --mfud->remaining,
+                           mfud->user_data, error);
+      g_error_free (error);
+      continue;
+    }
+
+    route = g_hash_table_lookup (routes, source);
+    if (!route) {
+      route = g_new0 (struct MediaFromUrisRoute, 1);
+      route->source = source;
+      route->uris = g_queue_new ();
+      g_hash_table_insert (routes, source, route);
+      mfud->routes = g_list_prepend (mfud->routes, route);
+    }
+    g_queue_push_tail (route->uris, iter->data);
+  }
+  g_hash_table_unref (routes);
+  g_list_free (sources);
+
+  /* Resolve them in all the sources at once */
+  for (iter = mfud->routes; iter; iter = g_list_next (iter)) {
+    media_from_uris_dispatch (mfud, iter->data);
+  }
+
+  media_from_uris_check_done (mfud);
+
+  return FALSE;
+}
+
+static void
+media_from_uris_cancel_cb (struct MediaFromUrisData *mfud)
+{
+  GList *iter, *ids;
+
+  if (mfud->cancelled) {
+    return;
+  }
+
+  mfud->cancelled = TRUE;
+
+  for (iter = mfud->routes; iter; iter = g_list_next (iter)) {
+    g_queue_clear (((struct MediaFromUrisRoute *) iter->data)->uris);
+  }
+
+  /* Sources may confirm the cancellation right away, changing the list */
+  ids = NULL;
+  for (iter = mfud->items; iter; iter = g_list_next (iter)) {
+    ids = g_list_prepend (ids,
+                          GUINT_TO_POINTER (((struct MediaFromUrisItem *) iter->data)->operation_id));
+  }
+
+  for (iter = ids; iter; iter = g_list_next (iter)) {
+    grl_operation_cancel (GPOINTER_TO_UINT (iter->data));
+  }
+  g_list_free (ids);
+}
+
+static guint
+multiple_operation (GrlSupportedOps operation_type,
+                    const GList *sources,
+                    const gchar *text,
+                    const GList *keys,
+                    GrlOperationOptions *options,
+                    GrlSourceResultCb callback,
+                    gpointer user_data)
+{
+  GrlRegistry *registry;
+  GList *sources_list;
+  GList *healthy = NULL;
+  const GList *iter;
+  struct MultipleSearchData *msd;
+  gboolean allocated_sources_list = FALSE;
+  guint operation_id;
+
+  registry = grl_registry_get_default ();
+
+  /* If no sources have been provided then get the list of all
+     sources supporting the operation from the registry */
+  if (!sources) {
+    sources_list =
+      grl_registry_get_sources_by_operations (registry,
+                                              operation_type,
+                                              TRUE);
+    if (sources_list == NULL) {
+      /* No suitable sources? Raise error and bail out */
+      g_list_free (sources_list);
+      handle_no_searchable_sources (operation_type, callback, user_data);
+      return 0;
+    } else {
+      sources = sources_list;
+      allocated_sources_list = TRUE;
+    }
+  }
+
+  /* Leave out the sources failing too much, unless there is nothing else */
+  for (iter = sources; iter; iter = g_list_next (iter)) {
+    if (!grl_registry_source_is_tripped (registry, GRL_SOURCE (iter->data))) {
+      healthy = g_list_prepend (healthy, iter->data);
+    }
+  }
+  if (healthy && g_list_length (healthy) < g_list_length ((GList *) sources)) {
+    if (allocated_sources_list) {
+      g_list_free ((GList *) sources);
+    }
+    sources = g_list_reverse (healthy);
+    allocated_sources_list = TRUE;
+  } else {
+    g_list_free (healthy);
+  }
+
+  /* Start multiple operation */
+  operation_id = grl_operation_generate_id ();
+  msd = start_multiple_search_operation (operation_id,
+                                         operation_type,
+					 sources,
+					 text,
+					 keys,
+					 grl_operation_options_get_count (options),
+					 options,
+					 callback,
+					 user_data);
+  if  (allocated_sources_list) {
+    g_list_free ((GList *) sources);
+  }
+
+  return msd->search_id;
+}
+
 /* ================ API ================ */
 
 /**
@@ -528,76 +1898,132 @@ grl_multiple_search (const GList *sources,
 		     GrlSourceResultCb callback,
 		     gpointer user_data)
 {
-  GrlRegistry *registry;
-  GList *sources_list;
-  struct MultipleSearchData *msd;
-  gboolean allocated_sources_list = FALSE;
-  guint operation_id;
-
   GRL_DEBUG ("grl_multiple_search");
 
   g_return_val_if_fail (callback != NULL, 0);
   g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
 
-  /* If no sources have been provided then get the list of all
-     searchable sources from the registry */
-  if (!sources) {
-    registry = grl_registry_get_default ();
-    sources_list =
-      grl_registry_get_sources_by_operations (registry,
-                                              GRL_OP_SEARCH,
-                                              TRUE);
-    if (sources_list == NULL) {
-      /* No searchable sources? Raise error and bail out */
-      g_list_free (sources_list);
-      handle_no_searchable_sources (callback, user_data);
-      return 0;
-    } else {
-      sources = sources_list;
-      allocated_sources_list = TRUE;
-    }
-  }
+  return multiple_operation (GRL_OP_SEARCH, sources, text, keys, options,
+                             callback, user_data);
+}
 
-  /* Start multiple search operation */
-  operation_id = grl_operation_generate_id ();
-  msd = start_multiple_search_operation (operation_id,
-					 sources,
-					 text,
-					 keys,
-					 NULL,
-					 grl_operation_options_get_count (options),
-					 options,
-					 callback,
-					 user_data);
-  if  (allocated_sources_list) {
-    g_list_free ((GList *) sources);
-  }
+/**
+ * grl_multiple_query:
+ * @sources: (element-type Grl.Source) (allow-none):
+ * a #GList of #GrlSource<!-- -->s to query (%NULL for all
+ * queryable sources)
+ * @query: the query to process
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID to retrieve
+ * @options: options wanted for that operation
+ * @callback: (scope notified): the user defined callback
+ * @user_data: the user data to pass to the user callback
+ *
+ * Executes @query in all the sources specified in @sources. Sources
+ * typically use their own query syntax, so @sources would usually contain
+ * sources sharing the same one.
+ *
+ * Results are requested and completed the same way as with
+ * grl_multiple_search().
+ *
+ * This method is asynchronous.
+ *
+ * Returns: the operation identifier
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_multiple_query (const GList *sources,
+                    const gchar *query,
+                    const GList *keys,
+                    GrlOperationOptions *options,
+                    GrlSourceResultCb callback,
+                    gpointer user_data)
+{
+  GRL_DEBUG ("grl_multiple_query");
 
-  return msd->search_id;
+  g_return_val_if_fail (query != NULL, 0);
+  g_return_val_if_fail (callback != NULL, 0);
+  g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
+
+  return multiple_operation (GRL_OP_QUERY, sources, query, keys, options,
+                             callback, user_data);
+}
+
+/**
+ * grl_multiple_browse_root:
+ * @sources: (element-type Grl.Source) (allow-none):
+ * a #GList of #GrlSource<!-- -->s to browse (%NULL for all
+ * browsable sources)
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID to retrieve
+ * @options: options wanted for that operation
+ * @callback: (scope notified): the user defined callback
+ * @user_data: the user data to pass to the user callback
+ *
+ * Browses the root container of all the sources specified in @sources.
+ *
+ * Results are requested and completed the same way as with
+ * grl_multiple_search().
+ *
+ * This method is asynchronous.
+ *
+ * Returns: the operation identifier
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_multiple_browse_root (const GList *sources,
+                          const GList *keys,
+                          GrlOperationOptions *options,
+                          GrlSourceResultCb callback,
+                          gpointer user_data)
+{
+  GRL_DEBUG ("grl_multiple_browse_root");
+
+  g_return_val_if_fail (callback != NULL, 0);
+  g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
+
+  return multiple_operation (GRL_OP_BROWSE, sources, NULL, keys, options,
+                             callback, user_data);
 }
 
 static void
 multiple_search_cancel_cb (struct MultipleSearchData *msd)
 {
-  GList *sources, *ids;
+  /* The user already got all the results */
+  if (msd->cancelled) {
+    return;
+  }
 
   /* Go through all the sources involved in that operation and issue
      cancel() operations for each one */
-  sources = msd->sources;
-  ids = msd->search_ids;
-  while (sources) {
-    GRL_DEBUG ("cancelling operation %s:%u",
-               grl_source_get_name (GRL_SOURCE (sources->data)),
-               GPOINTER_TO_UINT (ids->data));
-    grl_operation_cancel (GPOINTER_TO_INT (ids->data));
-    sources = g_list_next (sources);
-    ids = g_list_next (ids);
-  }
-
-  msd->cancelled = TRUE;
+  cancel_source_operations (msd);
 
   /* Send operation finished message now to client (remaining == 0) */
-  g_idle_add (confirm_cancel_idle, msd);
+  msd->confirm_id = grl_context_idle_add (msd->context,
+                                          G_PRIORITY_DEFAULT_IDLE,
+                                          confirm_cancel_idle, msd);
+}
+
+/* Pauses or resumes the operations of the sources along with the user's */
+static void
+multiple_search_flow_cb (struct MultipleSearchData *msd)
+{
+  GList *iter;
+  struct ResultCount *rc;
+  gboolean paused = grl_operation_is_paused (msd->search_id);
+
+  for (iter = msd->sources; iter; iter = g_list_next (iter)) {
+    rc = (struct ResultCount *) g_hash_table_lookup (msd->table, iter->data);
+    if (rc->running) {
+      if (paused) {
+        grl_operation_pause (rc->operation_id);
+      } else {
+        grl_operation_resume (rc->operation_id);
+      }
+    }
+  }
 }
 
 /**
@@ -629,7 +2055,7 @@ grl_multiple_search_sync (const GList *sources,
   GrlDataSync *ds;
   GList *result;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_multiple_search (sources,
                            text,
@@ -648,7 +2074,7 @@ grl_multiple_search_sync (const GList *sources,
   }
 
   result = (GList *) ds->data;
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
 
   return result;
 }
@@ -677,8 +2103,8 @@ grl_multiple_get_media_from_uri (const gchar *uri,
 				      gpointer user_data)
 {
   GrlRegistry *registry;
-  GList *sources, *iter;
-  gboolean found = FALSE;
+  GList *sources;
+  GrlSource *source;
 
   g_return_if_fail (uri != NULL);
   g_return_if_fail (keys != NULL);
@@ -692,33 +2118,98 @@ grl_multiple_get_media_from_uri (const gchar *uri,
                                             TRUE);
 
   /* Look for the first source that knows how to deal with 'uri' */
-  iter = sources;
-  while (iter && !found) {
-    GrlSource *source = GRL_SOURCE (iter->data);
-    if (grl_source_test_media_from_uri (source, uri)) {
-      struct MediaFromUriCallbackData *mfucd =
-	g_new0 (struct MediaFromUriCallbackData, 1);
-
-      mfucd->user_callback = callback;
-      mfucd->user_data = user_data;
-      mfucd->uri = g_strdup (uri);
-
-      grl_source_get_media_from_uri (source,
-					   uri,
-					   keys,
-					   options,
-					   media_from_uri_cb,
-					   mfucd);
-      found = TRUE;
-    }
-    iter = g_list_next (iter);
+  source = find_source_for_uri (sources, uri);
+  if (source) {
+    struct MediaFromUriCallbackData *mfucd =
+      g_new0 (struct MediaFromUriCallbackData, 1);
+
+    mfucd->user_callback = callback;
+    mfucd->user_data = user_data;
+    mfucd->uri = g_strdup (uri);
+
+    grl_source_get_media_from_uri (source,
+                                   uri,
+                                   keys,
+                                   options,
+                                   media_from_uri_cb,
+                                   mfucd);
   }
 
   g_list_free (sources);
 
   /* No source knows how to deal with 'uri', invoke user callback
      with NULL GrlMedia */
-  if (!found) {
+  if (!source) {
     callback (NULL, 0, NULL, user_data, NULL);
   }
 }
+
+/**
+ * grl_multiple_get_media_from_uris:
+ * @uris: (element-type utf8): a #GList of URIs identifying media resources
+ * @keys: (element-type GrlKeyID): List of metadata keys we want to obtain.
+ * @options: options wanted for that operation
+ * @max_concurrent: maximum number of URIs being resolved at once by each
+ * source, or 0 for no limit
+ * @callback: (scope notified): the user defined callback
+ * @user_data: the user data to pass to the user callback
+ *
+ * Like grl_multiple_get_media_from_uri(), but for many URIs at once. URIs are
+ * grouped per source, and the sources resolve their URIs concurrently. Note
+ * that choosing the source of each URI is not concurrent, as
+ * grl_source_test_media_from_uri() is synchronous.
+ *
+ * @callback is invoked once per URI, in no particular order, with the
+ * #GrlMedia created for it, or with a %NULL media and an error if it could not
+ * be resolved. The last invocation has remaining set to 0.
+ *
+ * Sources are chosen per URI the same way as grl_multiple_get_media_from_uri()
+ * does, remembering the source chosen for each prefix of the URIs to speed up
+ * the next look ups.
+ *
+ * This method is asynchronous.
+ *
+ * Returns: the operation identifier
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_multiple_get_media_from_uris (const GList *uris,
+                                  const GList *keys,
+                                  GrlOperationOptions *options,
+                                  guint max_concurrent,
+                                  GrlSourceResultCb callback,
+                                  gpointer user_data)
+{
+  struct MediaFromUrisData *mfud;
+  const GList *iter;
+
+  g_return_val_if_fail (uris != NULL, 0);
+  g_return_val_if_fail (keys != NULL, 0);
+  g_return_val_if_fail (callback != NULL, 0);
+  g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
+
+  mfud = g_new0 (struct MediaFromUrisData, 1);
+  mfud->operation_id = grl_operation_generate_id ();
+  for (iter = uris; iter; iter = g_list_next (iter)) {
+    mfud->uris = g_list_prepend (mfud->uris, g_strdup (iter->data));
+    mfud->remaining++;
+  }
+  mfud->uris = g_list_reverse (mfud->uris);
+  mfud->keys = g_list_copy ((GList *) keys);
+  mfud->options = g_object_ref (options);
+  mfud->max_concurrent = max_concurrent;
+  mfud->user_callback = callback;
+  mfud->user_data = user_data;
+
+  grl_operation_set_private_data (mfud->operation_id,
+                                  mfud,
+                                  (GrlOperationCancelCb) media_from_uris_cancel_cb,
+                                  (GDestroyNotify) free_media_from_uris_data);
+
+  grl_operation_idle_add (mfud->operation_id,
+                          G_PRIORITY_DEFAULT_IDLE,
+                          media_from_uris_idle, mfud);
+
+  return mfud->operation_id;
+}
@@ -47,12 +47,32 @@ GList *grl_multiple_search_sync (const GList *sources,
                                  GrlOperationOptions *options,
                                  GError **error);
 
+guint grl_multiple_query (const GList *sources,
+                          const gchar *query,
+                          const GList *keys,
+                          GrlOperationOptions *options,
+                          GrlSourceResultCb callback,
+                          gpointer user_data);
+
+guint grl_multiple_browse_root (const GList *sources,
+                                const GList *keys,
+                                GrlOperationOptions *options,
+                                GrlSourceResultCb callback,
+                                gpointer user_data);
+
 void grl_multiple_get_media_from_uri (const gchar *uri,
 				      const GList *keys,
 				      GrlOperationOptions *options,
 				      GrlSourceResolveCb callback,
 				      gpointer user_data);
 
+guint grl_multiple_get_media_from_uris (const GList *uris,
+                                        const GList *keys,
+                                        GrlOperationOptions *options,
+                                        guint max_concurrent,
+                                        GrlSourceResultCb callback,
+                                        gpointer user_data);
+
 G_END_DECLS
 
 #endif
@@ -35,10 +35,23 @@
 #define GRL_OPERATION_OPTION_COUNT "count"
 #define GRL_OPERATION_OPTION_FLAGS "flags"
 #define GRL_OPERATION_OPTION_TYPE_FILTER "type-filter"
+#define GRL_OPERATION_OPTION_MERGE_MODE "merge-mode"
+#define GRL_OPERATION_OPTION_MERGE_SCORE_KEY "merge-score-key"
+#define GRL_OPERATION_OPTION_MERGE_DEADLINE "merge-deadline"
+#define GRL_OPERATION_OPTION_DEDUP_KEYS "dedup-keys"
+#define GRL_OPERATION_OPTION_DEDUP_MERGE "dedup-merge"
+#define GRL_OPERATION_OPTION_SORT_KEY "sort-key"
+#define GRL_OPERATION_OPTION_SORT_ORDER "sort-order"
+#define GRL_OPERATION_OPTION_HIGH_WATER_MARK "high-water-mark"
+#define GRL_OPERATION_OPTION_DEADLINE "deadline"
+#define GRL_OPERATION_OPTION_DECORATION_DEADLINE "decoration-deadline"
+#define GRL_OPERATION_OPTION_PRIORITY "priority"
 #define GRL_OPERATION_OPTION_KEY_EQUAL_FILTER "key-equal-filter"
 #define GRL_OPERATION_OPTION_KEY_RANGE_FILTER "key-range-filter"
 
 gboolean grl_operation_options_key_is_set (GrlOperationOptions *options,
                                            const gchar *key);
 
+gchar *grl_operation_options_get_signature (GrlOperationOptions *options);
+
 #endif /* _GRL_OPERATION_OPTIONS_PRIV_H_ */
@@ -37,6 +37,8 @@
 #include "grl-operation-options-priv.h"
 #include "grl-type-builtins.h"
 
+#include <stdlib.h>
+
 G_DEFINE_TYPE (GrlOperationOptions, grl_operation_options, G_TYPE_OBJECT);
 
 #define GRL_OPERATION_OPTIONS_GET_PRIVATE(o)\
@@ -54,6 +56,16 @@ struct _GrlOperationOptionsPrivate {
 #define COUNT_DEFAULT GRL_COUNT_INFINITY;
 #define FLAGS_DEFAULT GRL_RESOLVE_NORMAL;
 #define TYPE_FILTER_DEFAULT GRL_TYPE_FILTER_ALL;
+#define MERGE_MODE_DEFAULT GRL_MERGE_MODE_NONE;
+#define MERGE_SCORE_KEY_DEFAULT GRL_METADATA_KEY_INVALID;
+#define MERGE_DEADLINE_DEFAULT 0;
+#define DEDUP_MERGE_DEFAULT FALSE;
+#define SORT_KEY_DEFAULT GRL_METADATA_KEY_INVALID;
+#define SORT_ORDER_DEFAULT GRL_SORT_ORDER_ASCENDING;
+#define HIGH_WATER_MARK_DEFAULT 0;
+#define DEADLINE_DEFAULT 0;
+#define DECORATION_DEADLINE_DEFAULT 0;
+#define PRIORITY_DEFAULT GRL_OPERATION_PRIORITY_NORMAL;
 
 static void
 grl_operation_options_dispose (GrlOperationOptions *self)
@@ -214,6 +226,15 @@ grl_operation_options_obey_caps (GrlOperationOptions *options,
     copy_option (options, *supported_options, GRL_OPERATION_OPTION_SKIP);
     copy_option (options, *supported_options, GRL_OPERATION_OPTION_COUNT);
     copy_option (options, *supported_options, GRL_OPERATION_OPTION_FLAGS);
+
+    /* these options are handled by the core, which must still find them in
+       the operations it runs on behalf of @options */
+    copy_option (options, *supported_options,
+                 GRL_OPERATION_OPTION_HIGH_WATER_MARK);
+    copy_option (options, *supported_options, GRL_OPERATION_OPTION_DEADLINE);
+    copy_option (options, *supported_options,
+                 GRL_OPERATION_OPTION_DECORATION_DEADLINE);
+    copy_option (options, *supported_options, GRL_OPERATION_OPTION_PRIORITY);
   }
 
   if (unsupported_options)
@@ -225,6 +246,20 @@ grl_operation_options_obey_caps (GrlOperationOptions *options,
                                 supported_options,
                                 unsupported_options);
 
+  /* Check sorting; the order goes along with the key */
+  if (check_and_copy_option (options,
+                             caps,
+                             GRL_OPERATION_OPTION_SORT_KEY,
+                             supported_options,
+                             unsupported_options)) {
+    if (supported_options)
+      copy_option (options, *supported_options, GRL_OPERATION_OPTION_SORT_ORDER);
+  } else {
+    ret = FALSE;
+    if (unsupported_options)
+      copy_option (options, *unsupported_options, GRL_OPERATION_OPTION_SORT_ORDER);
+  }
+
   /* Check filter-by-equal-key */
   g_hash_table_iter_init (&table_iter, options->priv->key_filter);
   while (g_hash_table_iter_next (&table_iter, &key_ptr, (gpointer *)&value)) {
@@ -286,6 +321,17 @@ grl_operation_options_copy (GrlOperationOptions *options)
   copy_option (options, copy, GRL_OPERATION_OPTION_COUNT);
   copy_option (options, copy, GRL_OPERATION_OPTION_FLAGS);
   copy_option (options, copy, GRL_OPERATION_OPTION_TYPE_FILTER);
+  copy_option (options, copy, GRL_OPERATION_OPTION_MERGE_MODE);
+  copy_option (options, copy, GRL_OPERATION_OPTION_MERGE_SCORE_KEY);
+  copy_option (options, copy, GRL_OPERATION_OPTION_MERGE_DEADLINE);
+  copy_option (options, copy, GRL_OPERATION_OPTION_DEDUP_KEYS);
+  copy_option (options, copy, GRL_OPERATION_OPTION_DEDUP_MERGE);
+  copy_option (options, copy, GRL_OPERATION_OPTION_SORT_KEY);
+  copy_option (options, copy, GRL_OPERATION_OPTION_SORT_ORDER);
+  copy_option (options, copy, GRL_OPERATION_OPTION_HIGH_WATER_MARK);
+  copy_option (options, copy, GRL_OPERATION_OPTION_DEADLINE);
+  copy_option (options, copy, GRL_OPERATION_OPTION_DECORATION_DEADLINE);
+  copy_option (options, copy, GRL_OPERATION_OPTION_PRIORITY);
 
   g_hash_table_foreach (options->priv->key_filter,
                         (GHFunc) key_filter_dup,
@@ -316,6 +362,94 @@ grl_operation_options_key_is_set (GrlOperationOptions *options,
   return g_hash_table_lookup_extended (options->priv->data, key, NULL, NULL);
 }
 
+static gint
+compare_pointers (gconstpointer a,
+                  gconstpointer b)
+{
+  return GPOINTER_TO_UINT (a) - GPOINTER_TO_UINT (b);
+}
+
+static void
+append_value_contents (GString *signature,
+                       const GValue *value)
+{
+  gchar *contents;
+
+  if (value) {
+    contents = g_strdup_value_contents (value);
+    g_string_append (signature, contents);
+    g_free (contents);
+  }
+}
+
+/**
+ * grl_operation_options_get_signature:
+ * @options: a #GrlOperationOptions instance
+ *
+ * This is an internal method that shouldn't be used outside of Grilo.
+ *
+ * Builds a string that identifies the contents of @options, except the skip,
+ * count and priority values. Two options with the same values get the same signature.
+ *
+ * Returns: (transfer full): a newly-allocated string.
+ *
+ * Since: 0.2.7
+ */
+gchar *
+grl_operation_options_get_signature (GrlOperationOptions *options)
+{
+  GList *keys;
+  GList *key;
+  GString *signature;
+  GrlRangeValue *range;
+
+  signature = g_string_new ("");
+
+  keys = g_hash_table_get_keys (options->priv->data);
+  keys = g_list_sort (keys, (GCompareFunc) g_strcmp0);
+  for (key = keys; key; key = g_list_next (key)) {
+    if (g_strcmp0 (key->data, GRL_OPERATION_OPTION_SKIP) == 0 ||
+        g_strcmp0 (key->data, GRL_OPERATION_OPTION_COUNT) == 0 ||
+        g_strcmp0 (key->data, GRL_OPERATION_OPTION_PRIORITY) == 0) {
+      continue;
+    }
+    g_string_append_printf (signature, "%s=", (gchar *) key->data);
+    append_value_contents (signature,
+                           g_hash_table_lookup (options->priv->data, key->data));
+    g_string_append_c (signature, ';');
+  }
+  g_list_free (keys);
+
+  keys = g_hash_table_get_keys (options->priv->key_filter);
+  keys = g_list_sort (keys, compare_pointers);
+  for (key = keys; key; key = g_list_next (key)) {
+    g_string_append_printf (signature, "%s=%u:",
+                            GRL_OPERATION_OPTION_KEY_EQUAL_FILTER,
+                            GPOINTER_TO_UINT (key->data));
+    append_value_contents (signature,
+                           g_hash_table_lookup (options->priv->key_filter,
+                                                key->data));
+    g_string_append_c (signature, ';');
+  }
+  g_list_free (keys);
+
+  keys = g_hash_table_get_keys (options->priv->key_range_filter);
+  keys = g_list_sort (keys, compare_pointers);
+  for (key = keys; key; key = g_list_next (key)) {
+    range = g_hash_table_lookup (options->priv->key_range_filter, key->data);
+    g_string_append_printf (signature, "%s=%u:",
+                            GRL_OPERATION_OPTION_KEY_RANGE_FILTER,
+                            GPOINTER_TO_UINT (key->data));
+    append_value_contents (signature, range->min);
+    g_string_append (signature, "..");
+    append_value_contents (signature, range->max);
+    g_string_append_c (signature, ';');
+  }
+  g_list_free (keys);
+
+  return g_string_free (signature, FALSE);
+}
+
 /**
  * grl_operation_options_set_skip:
  * @options: a #GrlOperationOptions instance
@@ -465,6 +599,464 @@ grl_operation_options_get_flags (GrlOperationOptions *options)
   return FLAGS_DEFAULT;
 }
 
+/**
+ * grl_operation_options_set_merge_mode:
+ * @options: a #GrlOperationOptions instance
+ * @mode: how results from several sources are merged
+ *
+ * Set how results are merged when running an operation over several sources
+ * at once, like grl_multiple_search(). Sources themselves ignore this option.
+ *
+ * Returns: %TRUE if @mode could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_merge_mode (GrlOperationOptions *options,
+                                      GrlMergeMode mode)
+{
+  GValue value = { 0, };
+
+  g_value_init (&value, GRL_TYPE_MERGE_MODE);
+  g_value_set_enum (&value, mode);
+  set_value (options, GRL_OPERATION_OPTION_MERGE_MODE, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_merge_mode:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: merge mode of @options.
+ *
+ * Since: 0.2.7
+ */
+GrlMergeMode
+grl_operation_options_get_merge_mode (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_MERGE_MODE);
+
+  if (value) {
+    return g_value_get_enum (value);
+  }
+
+  return MERGE_MODE_DEFAULT;
+}
+
+/**
+ * grl_operation_options_set_merge_score_key:
+ * @options: a #GrlOperationOptions instance
+ * @key: a numeric #GrlKeyID, or %GRL_METADATA_KEY_INVALID
+ *
+ * Set the key used to score results in %GRL_MERGE_MODE_RANKED mode. Results
+ * with a higher value for @key are sent first; ties, as well as results
+ * lacking @key, are sorted by the rank of their source.
+ *
+ * Remember to request @key in the operation, so sources fill it in.
+ *
+ * Returns: %TRUE if @key could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_merge_score_key (GrlOperationOptions *options,
+                                           GrlKeyID key)
+{
+  GValue value = { 0, };
+
+  g_value_init (&value, G_TYPE_UINT);
+  g_value_set_grl_key_id (&value, key);
+  set_value (options, GRL_OPERATION_OPTION_MERGE_SCORE_KEY, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_merge_score_key:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: the key used to score results in %GRL_MERGE_MODE_RANKED mode.
+ *
+ * Since: 0.2.7
+ */
+GrlKeyID
+grl_operation_options_get_merge_score_key (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_MERGE_SCORE_KEY);
+
+  if (value) {
+    return g_value_get_grl_key_id (value);
+  }
+
+  return MERGE_SCORE_KEY_DEFAULT;
+}
+
+/**
+ * grl_operation_options_set_merge_deadline:
+ * @options: a #GrlOperationOptions instance
+ * @deadline: time in milliseconds, or 0 to wait for every source
+ *
+ * In %GRL_MERGE_MODE_RANKED mode a result is only sent once every source
+ * that can still send results has sent one to compare it with. Set how
+ * long each source can keep the others waiting: every time a source is
+ * asked for results, it has @deadline milliseconds to send them; after
+ * that, it is left out of the comparison until it sends a result or is
+ * asked again.
+ *
+ * Returns: %TRUE if @deadline could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_merge_deadline (GrlOperationOptions *options,
+                                          guint deadline)
+{
+  GValue value = { 0, };
+
+  g_value_init (&value, G_TYPE_UINT);
+  g_value_set_uint (&value, deadline);
+  set_value (options, GRL_OPERATION_OPTION_MERGE_DEADLINE, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_merge_deadline:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: the merge deadline of @options, in milliseconds.
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_operation_options_get_merge_deadline (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_MERGE_DEADLINE);
+
+  if (value) {
+    return g_value_get_uint (value);
+  }
+
+  return MERGE_DEADLINE_DEFAULT;
+}
+
+/**
+ * grl_operation_options_set_high_water_mark:
+ * @options: a #GrlOperationOptions instance
+ * @mark: number of results, or 0 for no limit
+ *
+ * Set how many results can be waiting to be sent to the user. Once @mark
+ * results are waiting, for instance because the operation is paused with
+ * grl_operation_pause() or because the results are still being resolved,
+ * the source is asked to stop sending more until half of them are sent.
+ *
+ * Returns: %TRUE if @mark could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_high_water_mark (GrlOperationOptions *options,
+                                           guint mark)
+{
+  GValue value = { 0, };
+
+  g_value_init (&value, G_TYPE_UINT);
+  g_value_set_uint (&value, mark);
+  set_value (options, GRL_OPERATION_OPTION_HIGH_WATER_MARK, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_high_water_mark:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: the high water mark of @options, or 0 if there is no limit.
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_operation_options_get_high_water_mark (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_HIGH_WATER_MARK);
+
+  if (value) {
+    return g_value_get_uint (value);
+  }
+
+  return HIGH_WATER_MARK_DEFAULT;
+}
+
+/**
+ * grl_operation_options_set_deadline:
+ * @options: a #GrlOperationOptions instance
+ * @deadline: time in milliseconds, or 0 to wait as long as needed
+ *
+ * With %GRL_RESOLVE_FULL, browse, search, query and media from URI
+ * operations ask other sources for the keys the main source does not know
+ * before sending each result. Set how long, since the operation
+ * starts, the core waits for those sources. Once @deadline expires, the
+ * pending requests are cancelled and the results are sent with the keys
+ * known so far, along with a %GRL_CORE_ERROR_DEADLINE_EXCEEDED error listing
+ * the missing keys.
+ *
+ * Returns: %TRUE if @deadline could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_deadline (GrlOperationOptions *options,
+                                    guint deadline)
+{
+  GValue value = { 0, };
+
+  g_value_init (&value, G_TYPE_UINT);
+  g_value_set_uint (&value, deadline);
+  set_value (options, GRL_OPERATION_OPTION_DEADLINE, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_deadline:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: the deadline of @options, in milliseconds.
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_operation_options_get_deadline (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_DEADLINE);
+
+  if (value) {
+    return g_value_get_uint (value);
+  }
+
+  return DEADLINE_DEFAULT;
+}
+
+/**
+ * grl_operation_options_set_decoration_deadline:
+ * @options: a #GrlOperationOptions instance
+ * @deadline: time in milliseconds, or 0 to wait as long as needed
+ *
+ * Like grl_operation_options_set_deadline(), but the time is counted for
+ * each result separately, since the core starts asking other sources for its
+ * missing keys.
+ *
+ * Returns: %TRUE if @deadline could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_decoration_deadline (GrlOperationOptions *options,
+                                               guint deadline)
+{
+  GValue value = { 0, };
+
+  g_value_init (&value, G_TYPE_UINT);
+  g_value_set_uint (&value, deadline);
+  set_value (options, GRL_OPERATION_OPTION_DECORATION_DEADLINE, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_decoration_deadline:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: the decoration deadline of @options, in milliseconds.
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_operation_options_get_decoration_deadline (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_DECORATION_DEADLINE);
+
+  if (value) {
+    return g_value_get_uint (value);
+  }
+
+  return DECORATION_DEADLINE_DEFAULT;
+}
+
+/**
+ * grl_operation_options_set_priority:
+ * @options: a #GrlOperationOptions instance
+ * @priority: how urgent the operation is
+ *
+ * Set how urgent the operation is. The core dispatches the results of
+ * operations with a higher priority first, including the resolution of their
+ * missing keys, and sources can use it to schedule their own work (see
+ * grl_net_wc_request_with_priority_async()), so background work yields to
+ * the operations the user is waiting for.
+ *
+ * Returns: %TRUE if @priority could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_priority (GrlOperationOptions *options,
+                                    GrlOperationPriority priority)
+{
+  GValue value = { 0, };
+
+  g_value_init (&value, GRL_TYPE_OPERATION_PRIORITY);
+  g_value_set_enum (&value, priority);
+  set_value (options, GRL_OPERATION_OPTION_PRIORITY, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_priority:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: priority of @options.
+ *
+ * Since: 0.2.7
+ */
+GrlOperationPriority
+grl_operation_options_get_priority (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_PRIORITY);
+
+  if (value) {
+    return g_value_get_enum (value);
+  }
+
+  return PRIORITY_DEFAULT;
+}
+
+/**
+ * grl_operation_options_set_dedup:
+ * @options: a #GrlOperationOptions instance
+ * @keys: (element-type GrlKeyID) (allow-none): the keys identifying a
+ * result, or %NULL to not remove duplicates
+ * @merge: whether to complete the results with the metadata of their
+ * duplicates
+ *
+ * When running an operation over several sources at once, like
+ * grl_multiple_search(), remove the results having the same values for all
+ * of @keys as a previous one: for instance, the same URL, or the same title,
+ * artist and duration. Duplicates are not counted in the number of results
+ * requested. Sources themselves ignore this option.
+ *
+ * Among duplicates, the result from the source with the highest rank is
+ * kept (or from the first one in the list of sources, if they have the same
+ * rank), whatever the order the sources answer in. To that end, with
+ * %GRL_MERGE_MODE_NONE results are held while a source with a higher rank
+ * is still running. A result already sent is not replaced, though, by a
+ * duplicate found when a source is asked again for more results. If
+ * @merge is %TRUE, the keys missing in the result kept are taken from the
+ * ones removed before sending it.
+ *
+ * Remember to request @keys in the operation, so sources fill them in.
+ *
+ * Returns: %TRUE if @keys could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_dedup (GrlOperationOptions *options,
+                                 const GList *keys,
+                                 gboolean merge)
+{
+  GValue value = { 0, };
+  GString *ids;
+
+  ids = g_string_new ("");
+  for (; keys; keys = g_list_next (keys)) {
+    g_string_append_printf (ids, "%u;", GRLPOINTER_TO_KEYID (keys->data));
+  }
+
+  g_value_init (&value, G_TYPE_STRING);
+  g_value_take_string (&value, g_string_free (ids, FALSE));
+  set_value (options, GRL_OPERATION_OPTION_DEDUP_KEYS, &value);
+  g_value_unset (&value);
+
+  g_value_init (&value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&value, merge);
+  set_value (options, GRL_OPERATION_OPTION_DEDUP_MERGE, &value);
+  g_value_unset (&value);
+
+  return TRUE;
+}
+
+/**
+ * grl_operation_options_get_dedup_keys:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: (transfer container) (element-type GrlKeyID): the keys
+ * identifying duplicated results, or %NULL if they are not removed.
+ *
+ * Since: 0.2.7
+ */
+GList *
+grl_operation_options_get_dedup_keys (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_DEDUP_KEYS);
+  GList *keys = NULL;
+  gchar **ids;
+  gchar **id;
+
+  if (!value || !g_value_get_string (value)) {
+    return NULL;
+  }
+
+  ids = g_strsplit (g_value_get_string (value), ";", -1);
+  for (id = ids; *id; id++) {
+    if (**id) {
+      keys = g_list_prepend (keys,
+                             GRLKEYID_TO_POINTER (strtoul (*id, NULL, 10)));
+    }
+  }
+  g_strfreev (ids);
+
+  return g_list_reverse (keys);
+}
+
+/**
+ * grl_operation_options_get_dedup_merge:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: whether results are completed with the metadata of their
+ * duplicates.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_get_dedup_merge (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_DEDUP_MERGE);
+
+  if (value) {
+    return g_value_get_boolean (value);
+  }
+
+  return DEDUP_MERGE_DEFAULT;
+}
+
 /**
  * grl_operation_options_set_type_filter:
  * @options: a #GrlOperationOptions instance
@@ -522,6 +1114,95 @@ grl_operation_options_get_type_filter (GrlOperationOptions *options)
   return TYPE_FILTER_DEFAULT;
 }
 
+/**
+ * grl_operation_options_set_sort:
+ * @options: a #GrlOperationOptions instance
+ * @key: the #GrlKeyID to sort by, or %GRL_METADATA_KEY_INVALID to not sort
+ * @order: the sort order
+ *
+ * Set the key used to sort the results of an operation. Will only succeed if
+ * @key obeys to the inherent capabilities of @options.
+ *
+ * Sources that can not sort by @key (see grl_caps_is_key_sort()) get the
+ * results sorted by the core, which needs to fetch all of them first. Only
+ * the elements within skip and count are kept meanwhile.
+ *
+ * Returns: %TRUE if the sort key could be set, %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_options_set_sort (GrlOperationOptions *options,
+                                GrlKeyID key,
+                                GrlSortOrder order)
+{
+  GValue value = { 0, };
+  gboolean ret;
+
+  g_value_init (&value, G_TYPE_UINT);
+  g_value_set_grl_key_id (&value, key);
+
+  ret = (options->priv->caps == NULL) ||
+      grl_caps_test_option (options->priv->caps,
+                            GRL_OPERATION_OPTION_SORT_KEY, &value);
+
+  if (ret) {
+    set_value (options, GRL_OPERATION_OPTION_SORT_KEY, &value);
+    g_value_unset (&value);
+
+    g_value_init (&value, GRL_TYPE_SORT_ORDER);
+    g_value_set_enum (&value, order);
+    set_value (options, GRL_OPERATION_OPTION_SORT_ORDER, &value);
+  }
+
+  g_value_unset (&value);
+
+  return ret;
+}
+
+/**
+ * grl_operation_options_get_sort_key:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: the key used to sort the results, or %GRL_METADATA_KEY_INVALID if
+ * they are not sorted.
+ *
+ * Since: 0.2.7
+ */
+GrlKeyID
+grl_operation_options_get_sort_key (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_SORT_KEY);
+
+  if (value) {
+    return g_value_get_grl_key_id (value);
+  }
+
+  return SORT_KEY_DEFAULT;
+}
+
+/**
+ * grl_operation_options_get_sort_order:
+ * @options: a #GrlOperationOptions instance
+ *
+ * Returns: the order in which the results are sorted.
+ *
+ * Since: 0.2.7
+ */
+GrlSortOrder
+grl_operation_options_get_sort_order (GrlOperationOptions *options)
+{
+  const GValue *value = g_hash_table_lookup (options->priv->data,
+                                             GRL_OPERATION_OPTION_SORT_ORDER);
+
+  if (value) {
+    return g_value_get_enum (value);
+  }
+
+  return SORT_ORDER_DEFAULT;
+}
+
 /**
  * grl_operation_options_set_key_filter_value:
  * @options: a #GrlOperationOptions instance
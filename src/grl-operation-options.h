@@ -88,6 +88,51 @@ typedef enum {
   GRL_WRITE_FULL       = (1 << 0)  /* Try other plugins if necessary */
 } GrlWriteFlags;
 
+/**
+ * GrlMergeMode:
+ * @GRL_MERGE_MODE_NONE: Results are sent as soon as they arrive.
+ * @GRL_MERGE_MODE_ORDERED: Results are sent grouped by source, following the
+ * order in which the sources were given.
+ * @GRL_MERGE_MODE_RANKED: Results are merged by score and source rank, see
+ * grl_operation_options_set_merge_score_key().
+ *
+ * How results coming from several sources are merged together by the
+ * grl_multiple_* operations.
+ */
+typedef enum {
+  GRL_MERGE_MODE_NONE = 0,
+  GRL_MERGE_MODE_ORDERED,
+  GRL_MERGE_MODE_RANKED
+} GrlMergeMode;
+
+/**
+ * GrlOperationPriority:
+ * @GRL_OPERATION_PRIORITY_INTERACTIVE: The user is waiting for the results.
+ * @GRL_OPERATION_PRIORITY_NORMAL: The default priority.
+ * @GRL_OPERATION_PRIORITY_BACKGROUND: Nobody is waiting for the results,
+ * like when indexing a library.
+ *
+ * How urgent an operation is, compared to the others running at the same
+ * time. See grl_operation_options_set_priority().
+ */
+typedef enum {
+  GRL_OPERATION_PRIORITY_INTERACTIVE = 0,
+  GRL_OPERATION_PRIORITY_NORMAL,
+  GRL_OPERATION_PRIORITY_BACKGROUND
+} GrlOperationPriority;
+
+/**
+ * GrlSortOrder:
+ * @GRL_SORT_ORDER_ASCENDING: Lower values first.
+ * @GRL_SORT_ORDER_DESCENDING: Higher values first.
+ *
+ * Order in which results are sorted, see grl_operation_options_set_sort().
+ */
+typedef enum {
+  GRL_SORT_ORDER_ASCENDING = 0,
+  GRL_SORT_ORDER_DESCENDING
+} GrlSortOrder;
+
 #define GRL_COUNT_INFINITY (-1)
 
 GType grl_operation_options_get_type (void);
@@ -112,11 +157,62 @@ gboolean grl_operation_options_set_flags (GrlOperationOptions *options,
 GrlResolutionFlags
     grl_operation_options_get_flags (GrlOperationOptions *options);
 
+gboolean grl_operation_options_set_merge_mode (GrlOperationOptions *options,
+                                               GrlMergeMode mode);
+
+GrlMergeMode grl_operation_options_get_merge_mode (GrlOperationOptions *options);
+
+gboolean grl_operation_options_set_merge_score_key (GrlOperationOptions *options,
+                                                    GrlKeyID key);
+
+GrlKeyID grl_operation_options_get_merge_score_key (GrlOperationOptions *options);
+
+gboolean grl_operation_options_set_merge_deadline (GrlOperationOptions *options,
+                                                   guint deadline);
+
+guint grl_operation_options_get_merge_deadline (GrlOperationOptions *options);
+
+gboolean grl_operation_options_set_high_water_mark (GrlOperationOptions *options,
+                                                    guint mark);
+
+guint grl_operation_options_get_high_water_mark (GrlOperationOptions *options);
+
+gboolean grl_operation_options_set_deadline (GrlOperationOptions *options,
+                                             guint deadline);
+
+guint grl_operation_options_get_deadline (GrlOperationOptions *options);
+
+gboolean grl_operation_options_set_decoration_deadline (GrlOperationOptions *options,
+                                                        guint deadline);
+
+guint grl_operation_options_get_decoration_deadline (GrlOperationOptions *options);
+
+gboolean grl_operation_options_set_priority (GrlOperationOptions *options,
+                                             GrlOperationPriority priority);
+
+GrlOperationPriority grl_operation_options_get_priority (GrlOperationOptions *options);
+
+gboolean grl_operation_options_set_dedup (GrlOperationOptions *options,
+                                          const GList *keys,
+                                          gboolean merge);
+
+GList *grl_operation_options_get_dedup_keys (GrlOperationOptions *options);
+
+gboolean grl_operation_options_get_dedup_merge (GrlOperationOptions *options);
+
 gboolean grl_operation_options_set_type_filter (GrlOperationOptions *options,
                                                 GrlTypeFilter filter);
 
 GrlTypeFilter grl_operation_options_get_type_filter (GrlOperationOptions *options);
 
+gboolean grl_operation_options_set_sort (GrlOperationOptions *options,
+                                         GrlKeyID key,
+                                         GrlSortOrder order);
+
+GrlKeyID grl_operation_options_get_sort_key (GrlOperationOptions *options);
+
+GrlSortOrder grl_operation_options_get_sort_order (GrlOperationOptions *options);
+
 gboolean grl_operation_options_set_key_filter_value (GrlOperationOptions *options,
                                                      GrlKeyID key,
                                                      GValue *value);
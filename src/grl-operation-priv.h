@@ -27,6 +27,8 @@
 
 typedef void (*GrlOperationCancelCb) (gpointer data);
 
+typedef void (*GrlOperationFlowCb) (gpointer data);
+
 void grl_operation_init (void);
 
 guint grl_operation_generate_id (void);
@@ -36,8 +38,35 @@ void grl_operation_set_private_data (guint                operation_id,
                                      GrlOperationCancelCb cancel_cb,
                                      GDestroyNotify       destroy_cb);
 
+void grl_operation_set_flow_control (guint              operation_id,
+                                     GrlOperationFlowCb pause_cb,
+                                     GrlOperationFlowCb resume_cb);
+
+void grl_operation_set_parent (guint operation_id,
+                               guint parent_id);
+
 gpointer grl_operation_get_private_data (guint operation_id);
 
 void grl_operation_remove (guint operation_id);
 
+GMainContext *grl_operation_ref_context (guint operation_id);
+
+guint grl_operation_idle_add (guint operation_id,
+                              gint priority,
+                              GSourceFunc function,
+                              gpointer data);
+
+guint grl_context_idle_add (GMainContext *context,
+                            gint priority,
+                            GSourceFunc function,
+                            gpointer data);
+
+guint grl_context_timeout_add (GMainContext *context,
+                               guint interval,
+                               GSourceFunc function,
+                               gpointer data);
+
+void grl_context_source_remove (GMainContext *context,
+                                guint id);
+
 #endif /* _GRL_OPERATION_PRIV_H_ */
@@ -26,14 +26,107 @@
 
 typedef struct
 {
+  volatile gint        ref_count;
   GrlOperationCancelCb cancel_cb;
+  GrlOperationFlowCb   pause_cb;
+  GrlOperationFlowCb   resume_cb;
   GDestroyNotify       destroy_cb;
   gpointer             private_data;
   gpointer             user_data;
+  volatile gint        paused;
+  GCancellable        *cancellable;
+  GCancellable        *parent_cancellable;
+  gulong               parent_handler;
+  GMainContext        *context;
 } OperationData;
 
-static guint       operations_id;
-static GHashTable *operations;
+/* Operations can be driven from several threads, each one with its own
+   thread-default main context. To keep them from contending for a single
+   lock, operations are spread over several tables according to their
+   identifier, each one protected by its own bit lock */
+#define OPERATION_SHARDS 16
+
+typedef struct
+{
+  volatile gint  lock;
+  GHashTable    *table;
+} OperationShard;
+
+static volatile gint  operations_id;
+static OperationShard operations[OPERATION_SHARDS];
+
+#define OPERATION_SHARD(id) (&operations[(id) % OPERATION_SHARDS])
+
+/* Cancellables are created on demand, and linked to the ones of other
+   operations */
+G_LOCK_DEFINE_STATIC (cancellables);
+
+static void operation_data_free (OperationData *data);
+
+static OperationData *
+operation_data_ref (OperationData *data)
+{
+  g_atomic_int_inc (&data->ref_count);
+
+  return data;
+}
+
+static void
+operation_data_unref (OperationData *data)
+{
+  if (g_atomic_int_dec_and_test (&data->ref_count)) {
+    operation_data_free (data);
+  }
+}
+
+/*
+ * Returns a new reference to the data of @operation_id, so it is not freed
+ * if another thread removes the operation meanwhile; or %NULL if it is not
+ * known. Release it with operation_data_unref().
+ */
+static OperationData *
+operation_lookup (guint operation_id)
+{
+  OperationShard *shard = OPERATION_SHARD (operation_id);
+  OperationData *data;
+
+  g_bit_lock (&shard->lock, 0);
+  data = g_hash_table_lookup (shard->table, GUINT_TO_POINTER (operation_id));
+  if (data) {
+    operation_data_ref (data);
+  }
+  g_bit_unlock (&shard->lock, 0);
+
+  return data;
+}
+
+static GCancellable *
+operation_data_get_cancellable (OperationData *data)
+{
+  GCancellable *cancellable;
+
+  G_LOCK (cancellables);
+  if (!data->cancellable) {
+    data->cancellable = g_cancellable_new ();
+  }
+  cancellable = data->cancellable;
+  G_UNLOCK (cancellables);
+
+  return cancellable;
+}
+
+static GMainContext *
+thread_default_context (void)
+{
+  GMainContext *context;
+
+  context = g_main_context_get_thread_default ();
+  if (!context) {
+    context = g_main_context_default ();
+  }
+
+  return context;
+}
 
 static void
 operation_data_free (OperationData *data)
@@ -42,6 +135,17 @@ operation_data_free (OperationData *data)
     data->destroy_cb (data->private_data);
   }
 
+  if (data->parent_cancellable) {
+    g_cancellable_disconnect (data->parent_cancellable, data->parent_handler);
+    g_object_unref (data->parent_cancellable);
+  }
+
+  if (data->cancellable) {
+    g_object_unref (data->cancellable);
+  }
+
+  g_main_context_unref (data->context);
+
   g_slice_free (OperationData, data);
 }
 
@@ -49,24 +153,40 @@ void
 grl_operation_init (void)
 {
   static gboolean initialized = FALSE;
+  guint i;
 
   if (G_LIKELY (initialized))
     return;
 
   initialized = TRUE;
-  operations = g_hash_table_new_full (g_direct_hash, g_direct_equal,
-                                      NULL,
-                                      (GDestroyNotify) operation_data_free);
+  for (i = 0; i < OPERATION_SHARDS; i++) {
+    operations[i].table =
+      g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                             NULL,
+                             (GDestroyNotify) operation_data_unref);
+  }
   operations_id = 1;
 }
 
 guint
 grl_operation_generate_id (void)
 {
-  guint operation_id = operations_id++;
+  OperationShard *shard;
+  guint operation_id;
   OperationData *data = g_slice_new0 (OperationData);
 
-  g_hash_table_insert (operations, GUINT_TO_POINTER (operation_id), data);
+  /* The reference is owned by the table */
+  data->ref_count = 1;
+
+  /* All the continuations of the operation run where it was started */
+  data->context = g_main_context_ref (thread_default_context ());
+
+  operation_id = (guint) g_atomic_int_add (&operations_id, 1);
+  shard = OPERATION_SHARD (operation_id);
+
+  g_bit_lock (&shard->lock, 0);
+  g_hash_table_insert (shard->table, GUINT_TO_POINTER (operation_id), data);
+  g_bit_unlock (&shard->lock, 0);
 
   return operation_id;
 }
@@ -77,14 +197,84 @@ grl_operation_set_private_data (guint                operation_id,
                                 GrlOperationCancelCb cancel_cb,
                                 GDestroyNotify       destroy_cb)
 {
-  OperationData *data = g_hash_table_lookup (operations,
-                                             GUINT_TO_POINTER (operation_id));
+  OperationData *data = operation_lookup (operation_id);
 
   g_return_if_fail (data != NULL);
 
   data->cancel_cb    = cancel_cb;
   data->destroy_cb   = destroy_cb;
   data->private_data = private_data;
+
+  operation_data_unref (data);
+}
+
+/*
+ * grl_operation_set_flow_control: (skip)
+ * @operation_id: operation identifier
+ * @pause_cb: function called when the operation is paused
+ * @resume_cb: function called when the operation is resumed
+ *
+ * Both functions get the private data of the operation.
+ */
+void
+grl_operation_set_flow_control (guint              operation_id,
+                                GrlOperationFlowCb pause_cb,
+                                GrlOperationFlowCb resume_cb)
+{
+  OperationData *data = operation_lookup (operation_id);
+
+  g_return_if_fail (data != NULL);
+
+  data->pause_cb  = pause_cb;
+  data->resume_cb = resume_cb;
+
+  operation_data_unref (data);
+}
+
+static void
+parent_cancelled_cb (GCancellable *parent_cancellable,
+                     GCancellable *cancellable)
+{
+  g_cancellable_cancel (cancellable);
+}
+
+/*
+ * grl_operation_set_parent: (skip)
+ * @operation_id: operation identifier
+ * @parent_id: identifier of the operation @operation_id is done for
+ *
+ * Links the #GCancellable of @operation_id to the one of @parent_id, so
+ * cancelling the parent operation also stops the I/O of this one.
+ */
+void
+grl_operation_set_parent (guint operation_id,
+                          guint parent_id)
+{
+  OperationData *data;
+  OperationData *parent;
+  GCancellable *cancellable;
+
+  data = operation_lookup (operation_id);
+  g_return_if_fail (data != NULL);
+
+  parent = operation_lookup (parent_id);
+  if (data->parent_cancellable) {
+    GRL_WARNING ("Operation %u already has a parent", operation_id);
+  } else if (parent && parent != data) {
+    cancellable = operation_data_get_cancellable (data);
+    data->parent_cancellable =
+      g_object_ref (operation_data_get_cancellable (parent));
+    data->parent_handler =
+      g_cancellable_connect (data->parent_cancellable,
+                             G_CALLBACK (parent_cancelled_cb),
+                             cancellable,
+                             NULL);
+  }
+
+  if (parent) {
+    operation_data_unref (parent);
+  }
+  operation_data_unref (data);
 }
 
 /*
@@ -94,18 +284,163 @@ grl_operation_set_private_data (guint                operation_id,
 gpointer
 grl_operation_get_private_data (guint operation_id)
 {
-  OperationData *data = g_hash_table_lookup (operations,
-                                             GUINT_TO_POINTER (operation_id));
+  OperationData *data = operation_lookup (operation_id);
+  gpointer private_data;
 
   g_return_val_if_fail (data != NULL, NULL);
 
-  return data->private_data;
+  private_data = data->private_data;
+  operation_data_unref (data);
+
+  return private_data;
 }
 
 void
 grl_operation_remove (guint operation_id)
 {
-  g_hash_table_remove (operations, GUINT_TO_POINTER (operation_id));
+  OperationShard *shard = OPERATION_SHARD (operation_id);
+  OperationData *data;
+
+  g_bit_lock (&shard->lock, 0);
+  data = g_hash_table_lookup (shard->table, GUINT_TO_POINTER (operation_id));
+  g_hash_table_steal (shard->table, GUINT_TO_POINTER (operation_id));
+  g_bit_unlock (&shard->lock, 0);
+
+  /* Outside the lock, as it runs the destroy function of the operation, unless
+     another thread is still using it */
+  if (data) {
+    operation_data_unref (data);
+  }
+}
+
+/*
+ * grl_operation_ref_context: (skip)
+ * @operation_id: operation identifier
+ *
+ * The operation may finish in another thread at any time, so a reference
+ * is returned, to be released with g_main_context_unref().
+ *
+ * Returns: (transfer full): the thread-default main context at the time
+ * @operation_id was started, where all its continuations must be
+ * dispatched; or the current thread-default one if @operation_id is not
+ * known.
+ */
+GMainContext *
+grl_operation_ref_context (guint operation_id)
+{
+  OperationData *data = operation_lookup (operation_id);
+  GMainContext *context;
+
+  if (!data) {
+    return g_main_context_ref (thread_default_context ());
+  }
+
+  context = g_main_context_ref (data->context);
+  operation_data_unref (data);
+
+  return context;
+}
+
+/*
+ * grl_operation_idle_add: (skip)
+ *
+ * Like grl_context_idle_add(), dispatching @function in the main context of
+ * @operation_id (see grl_operation_ref_context()).
+ */
+guint
+grl_operation_idle_add (guint operation_id,
+                        gint priority,
+                        GSourceFunc function,
+                        gpointer data)
+{
+  GMainContext *context;
+  guint id;
+
+  context = grl_operation_ref_context (operation_id);
+  id = grl_context_idle_add (context, priority, function, data);
+  g_main_context_unref (context);
+
+  return id;
+}
+
+/*
+ * grl_context_idle_add: (skip)
+ *
+ * Like g_idle_add_full(), but dispatching @function in @context, or in the
+ * thread-default main context if %NULL.
+ */
+guint
+grl_context_idle_add (GMainContext *context,
+                      gint priority,
+                      GSourceFunc function,
+                      gpointer data)
+{
+  GSource *source;
+  guint id;
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, priority);
+  g_source_set_callback (source, function, data, NULL);
+  id = g_source_attach (source, context? context: thread_default_context ());
+  g_source_unref (source);
+
+  return id;
+}
+
+/*
+ * grl_context_timeout_add: (skip)
+ *
+ * Like g_timeout_add(), but dispatching @function in @context, or in the
+ * thread-default main context if %NULL.
+ */
+guint
+grl_context_timeout_add (GMainContext *context,
+                         guint interval,
+                         GSourceFunc function,
+                         gpointer data)
+{
+  GSource *source;
+  guint id;
+
+  source = g_timeout_source_new (interval);
+  g_source_set_callback (source, function, data, NULL);
+  id = g_source_attach (source, context? context: thread_default_context ());
+  g_source_unref (source);
+
+  return id;
+}
+
+/*
+ * grl_context_source_remove: (skip)
+ *
+ * Like g_source_remove(), for a source added to @context.
+ */
+void
+grl_context_source_remove (GMainContext *context,
+                           guint id)
+{
+  GSource *source;
+
+  if (!context) {
+    context = thread_default_context ();
+  }
+
+  source = g_main_context_find_source_by_id (context, id);
+  if (source) {
+    g_source_destroy (source);
+  }
+}
+
+static gboolean
+operation_cancel_cb (gpointer user_data)
+{
+  OperationData *data = (OperationData *) user_data;
+
+  if (data->cancel_cb) {
+    data->cancel_cb (data->private_data);
+  }
+
+  return FALSE;
 }
 
 /*** PUBLIC API ***/
@@ -114,24 +449,151 @@ grl_operation_remove (guint operation_id)
  * grl_operation_cancel:
  * @operation_id: the identifier of a running operation
  *
- * Cancel an operation.
+ * Cancel an operation. When called from a thread other than the one running
+ * the operation, the cancellation is completed in that thread.
  */
 void
 grl_operation_cancel (guint operation_id)
 {
-  OperationData *data = g_hash_table_lookup (operations,
-                                             GUINT_TO_POINTER (operation_id));
+  OperationData *data = operation_lookup (operation_id);
+  GCancellable *cancellable;
 
   if (!data) {
     GRL_WARNING ("Invalid operation %u", operation_id);
     return;
   }
 
-  g_return_if_fail (data != NULL);
+  /* Stop the I/O first, as the operation might be gone after cancel_cb */
+  G_LOCK (cancellables);
+  cancellable = data->cancellable? g_object_ref (data->cancellable): NULL;
+  G_UNLOCK (cancellables);
+  if (cancellable) {
+    g_cancellable_cancel (cancellable);
+    g_object_unref (cancellable);
+  }
 
-  if (data->cancel_cb) {
-    data->cancel_cb (data->private_data);
+  /* The operation is cancelled where it runs; right away if it is the
+     current thread */
+  g_main_context_invoke_full (data->context,
+                              G_PRIORITY_DEFAULT,
+                              operation_cancel_cb,
+                              data,
+                              (GDestroyNotify) operation_data_unref);
+}
+
+/**
+ * grl_operation_get_cancellable:
+ * @operation_id: the identifier of a running operation
+ *
+ * Gets a #GCancellable that is cancelled when the operation is, either by
+ * grl_operation_cancel() or because the operation it was started for is
+ * cancelled. Sources should pass it to their I/O, like
+ * grl_net_wc_request_async(), so the requests of a cancelled operation stop
+ * right away.
+ *
+ * Returns: (transfer none): the #GCancellable of the operation, valid until
+ * the operation finishes, or %NULL if @operation_id is not a running
+ * operation
+ *
+ * Since: 0.2.7
+ */
+GCancellable *
+grl_operation_get_cancellable (guint operation_id)
+{
+  OperationData *data = operation_lookup (operation_id);
+  GCancellable *cancellable;
+
+  if (!data) {
+    GRL_WARNING ("Invalid operation %u", operation_id);
+    return NULL;
+  }
+
+  cancellable = operation_data_get_cancellable (data);
+  operation_data_unref (data);
+
+  return cancellable;
+}
+
+/**
+ * grl_operation_pause:
+ * @operation_id: the identifier of a running operation
+ *
+ * Pause an operation: no more results are sent to the user until
+ * grl_operation_resume() is called. Results already received from the
+ * source are kept meanwhile, and the source is asked to stop sending more
+ * if it can. Only operations sending several results, like browse, search
+ * or query, can be paused.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_operation_pause (guint operation_id)
+{
+  OperationData *data = operation_lookup (operation_id);
+
+  if (!data) {
+    GRL_WARNING ("Invalid operation %u", operation_id);
+    return;
   }
+
+  if (g_atomic_int_compare_and_exchange (&data->paused, FALSE, TRUE)) {
+    if (data->pause_cb) {
+      data->pause_cb (data->private_data);
+    }
+  }
+
+  operation_data_unref (data);
+}
+
+/**
+ * grl_operation_resume:
+ * @operation_id: the identifier of a paused operation
+ *
+ * Resume an operation paused with grl_operation_pause().
+ *
+ * Since: 0.2.7
+ */
+void
+grl_operation_resume (guint operation_id)
+{
+  OperationData *data = operation_lookup (operation_id);
+
+  if (!data) {
+    GRL_WARNING ("Invalid operation %u", operation_id);
+    return;
+  }
+
+  if (g_atomic_int_compare_and_exchange (&data->paused, TRUE, FALSE)) {
+    if (data->resume_cb) {
+      data->resume_cb (data->private_data);
+    }
+  }
+
+  operation_data_unref (data);
+}
+
+/**
+ * grl_operation_is_paused:
+ * @operation_id: the identifier of an operation
+ *
+ * Returns: %TRUE if the operation is paused
+ *
+ * Since: 0.2.7
+ */
+gboolean
+grl_operation_is_paused (guint operation_id)
+{
+  OperationData *data = operation_lookup (operation_id);
+  gboolean paused;
+
+  if (!data) {
+    return FALSE;
+  }
+
+  paused = g_atomic_int_get (&data->paused);
+  operation_data_unref (data);
+
+  return paused;
 }
 
 /**
@@ -145,15 +607,18 @@ grl_operation_cancel (guint operation_id)
 gpointer
 grl_operation_get_data (guint operation_id)
 {
-  OperationData *data = g_hash_table_lookup (operations,
-                                             GUINT_TO_POINTER (operation_id));
+  OperationData *data = operation_lookup (operation_id);
+  gpointer user_data;
 
   if (!data) {
     GRL_WARNING ("Invalid operation %u", operation_id);
     return NULL;
   }
 
-  return data->user_data;
+  user_data = data->user_data;
+  operation_data_unref (data);
+
+  return user_data;
 }
 
 /**
@@ -166,13 +631,13 @@ grl_operation_get_data (guint operation_id)
 void
 grl_operation_set_data (guint operation_id, gpointer user_data)
 {
-  OperationData *data = g_hash_table_lookup (operations,
-                                             GUINT_TO_POINTER (operation_id));
+  OperationData *data = operation_lookup (operation_id);
 
   if (!data) {
     GRL_WARNING ("Invalid operation %u", operation_id);
   } else {
     data->user_data = user_data;
+    operation_data_unref (data);
   }
 }
 
@@ -28,11 +28,20 @@
 #define _GRL_OPERATION_H_
 
 #include <glib.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
 void grl_operation_cancel (guint operation_id);
 
+GCancellable *grl_operation_get_cancellable (guint operation_id);
+
+void grl_operation_pause (guint operation_id);
+
+void grl_operation_resume (guint operation_id);
+
+gboolean grl_operation_is_paused (guint operation_id);
+
 gpointer grl_operation_get_data (guint operation_id);
 
 void grl_operation_set_data (guint operation_id, gpointer user_data);
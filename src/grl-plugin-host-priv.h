@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_PLUGIN_HOST_PRIV_H_
+#define _GRL_PLUGIN_HOST_PRIV_H_
+
+#include <glib.h>
+#include <stdarg.h>
+
+#include "grl-plugin.h"
+#include "grl-registry.h"
+
+/* The core and a plugin host talk through a Unix socket, one message per
+ * line. A message is a command followed by its fields, separated by tabs;
+ * tabs, newlines and backslashes within fields are escaped. Media travel
+ * encoded with grl_plugin_host_media_to_string(), which keeps the exact
+ * values, and keys as a comma separated list of key names.
+ *
+ * From the core to the host:
+ *   CONFIG <param> <value> [<param> <value> ...]
+ *   LOAD
+ *   BROWSE <op> <source> <container> <keys> <skip> <count> <flags> <filter>
+ *   SEARCH <op> <source> <text> <keys> <skip> <count> <flags> <filter>
+ *   QUERY <op> <source> <query> <keys> <skip> <count> <flags> <filter>
+ *   RESOLVE <op> <source> <media> <keys> <flags>
+ *   CANCEL <op>
+ *
+ * From the host to the core:
+ *   PLUGIN <plugin id>
+ *   SOURCE <id> <name> <desc> <rank> <ops> <supported media> <keys> <slow keys>
+ *   REMOVED <id>
+ *   READY
+ *   FAILED <message>
+ *   RESULT <op> <remaining> <media> <error code> <error message>
+ *   RESOLVED <op> <media> <error code> <error message>
+ *
+ * Operations are identified by their id in the core. An error code of 0
+ * means there is no error.
+ */
+
+#define GRL_PLUGIN_HOST_CMD_CONFIG   "CONFIG"
+#define GRL_PLUGIN_HOST_CMD_LOAD     "LOAD"
+#define GRL_PLUGIN_HOST_CMD_BROWSE   "BROWSE"
+#define GRL_PLUGIN_HOST_CMD_SEARCH   "SEARCH"
+#define GRL_PLUGIN_HOST_CMD_QUERY    "QUERY"
+#define GRL_PLUGIN_HOST_CMD_RESOLVE  "RESOLVE"
+#define GRL_PLUGIN_HOST_CMD_CANCEL   "CANCEL"
+
+#define GRL_PLUGIN_HOST_CMD_PLUGIN   "PLUGIN"
+#define GRL_PLUGIN_HOST_CMD_SOURCE   "SOURCE"
+#define GRL_PLUGIN_HOST_CMD_REMOVED  "REMOVED"
+#define GRL_PLUGIN_HOST_CMD_READY    "READY"
+#define GRL_PLUGIN_HOST_CMD_FAILED   "FAILED"
+#define GRL_PLUGIN_HOST_CMD_RESULT   "RESULT"
+#define GRL_PLUGIN_HOST_CMD_RESOLVED "RESOLVED"
+
+/* Operations forwarded to the plugin host */
+#define GRL_PLUGIN_HOST_OPS (GRL_OP_BROWSE | GRL_OP_SEARCH | GRL_OP_QUERY | \
+                             GRL_OP_RESOLVE)
+
+/* The socket is the standard input of the plugin host */
+#define GRL_PLUGIN_HOST_FD 0
+
+typedef struct _GrlPluginHost GrlPluginHost;
+
+gchar *grl_plugin_host_message_valist (const gchar *command,
+                                       va_list args);
+
+gchar *grl_plugin_host_message (const gchar *command,
+                                ...) G_GNUC_NULL_TERMINATED;
+
+gchar **grl_plugin_host_parse_message (const gchar *line);
+
+gchar *grl_plugin_host_keys_to_string (const GList *keys);
+
+GList *grl_plugin_host_keys_from_string (const gchar *keys);
+
+gchar *grl_plugin_host_media_to_string (GrlMedia *media);
+
+GrlMedia *grl_plugin_host_media_from_string (const gchar *string);
+
+GrlPluginHost *grl_plugin_host_spawn (const gchar *library_filename,
+                                      GSList *plugin_dirs,
+                                      GError **error);
+
+const gchar *grl_plugin_host_get_plugin_id (GrlPluginHost *host);
+
+void grl_plugin_host_attach (GrlPluginHost *host,
+                             GrlPlugin *plugin);
+
+void grl_plugin_host_unref (GrlPluginHost *host);
+
+#endif /* _GRL_PLUGIN_HOST_PRIV_H_ */
@@ -0,0 +1,1565 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Out-of-process plugins.
+ *
+ * When plugin isolation is enabled, the registry does not open the plugin
+ * modules itself. Each one is loaded by its own plugin host process instead,
+ * and the sources it registers are represented in the core by proxy sources,
+ * forwarding operations to the host. A plugin leaking or blocking does not
+ * affect the application nor the other plugins, and a plugin crashing just
+ * takes its own sources away.
+ *
+ * Replies from the host are read by a dedicated thread, and handed out in
+ * the main context each operation was started in.
+ */
+
+#include "grl-plugin-host-priv.h"
+#include "grl-plugin-priv.h"
+#include "grl-operation-priv.h"
+#include "grl-config-priv.h"
+#include "grl-log-priv.h"
+#include "grl-error.h"
+#include "data/grl-media-audio.h"
+#include "data/grl-media-video.h"
+#include "data/grl-media-image.h"
+
+#include <glib/gi18n-lib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define GRL_LOG_DOMAIN_DEFAULT  plugin_log_domain
+
+#define PLUGIN_HOST_DATA "grl-plugin-host"
+
+/* Bits of GrlPluginHost.lock */
+#define OPERATIONS_LOCK 0
+#define SEND_LOCK       1
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct _GrlPluginHost {
+  volatile gint refcount;
+  volatile gint lock;
+  gchar *plugin_id;
+  GrlPlugin *plugin;
+  GPid pid;
+  gint fd;
+  GIOChannel *channel;
+  gboolean reading;
+  gboolean stopped;
+  GHashTable *operations;
+};
+
+typedef struct {
+  GrlPluginHost *host;
+  GrlSource *source;
+  guint operation_id;
+  GrlCoreError error_code;
+  GMainContext *context;
+  GrlSourceResultCb callback;
+  GrlSourceResolveCb resolve_callback;
+  GrlMedia *media;
+  gpointer user_data;
+  GQueue *results;
+  gboolean flushing;
+  gboolean finished;
+} HostOperation;
+
+typedef struct {
+  gint remaining;
+  gchar *media;
+  GError *error;
+} HostResult;
+
+/* ================ Proxy source ================ */
+
+#define GRL_TYPE_PROXY_SOURCE (grl_proxy_source_get_type ())
+
+#define GRL_PROXY_SOURCE(obj)                                   \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj),                           \
+                               GRL_TYPE_PROXY_SOURCE,           \
+                               GrlProxySource))
+
+#define GRL_IS_PROXY_SOURCE(obj)                                \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj),                           \
+                               GRL_TYPE_PROXY_SOURCE))
+
+typedef struct {
+  GrlSource parent;
+  GrlPluginHost *host;
+  GrlSupportedOps operations;
+  GList *supported_keys;
+  GList *slow_keys;
+} GrlProxySource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} GrlProxySourceClass;
+
+GType grl_proxy_source_get_type (void);
+
+G_DEFINE_TYPE (GrlProxySource, grl_proxy_source, GRL_TYPE_SOURCE);
+
+static GrlPluginHost *plugin_host_ref (GrlPluginHost *host);
+
+static void plugin_host_stop (GrlPluginHost *host);
+
+static gboolean plugin_host_send (GrlPluginHost *host,
+                                  const gchar *command,
+                                  ...) G_GNUC_NULL_TERMINATED;
+
+static HostOperation *plugin_host_start_operation (GrlPluginHost *host,
+                                                   GrlSource *source,
+                                                   guint operation_id,
+                                                   GrlCoreError error_code,
+                                                   gpointer user_data);
+
+static void plugin_host_fail_operation (GrlPluginHost *host,
+                                        guint operation_id);
+
+static void
+grl_proxy_source_finalize (GObject *object)
+{
+  GrlProxySource *proxy = GRL_PROXY_SOURCE (object);
+
+  if (proxy->host) {
+    grl_plugin_host_unref (proxy->host);
+  }
+  g_list_free (proxy->supported_keys);
+  g_list_free (proxy->slow_keys);
+
+  G_OBJECT_CLASS (grl_proxy_source_parent_class)->finalize (object);
+}
+
+static GrlSupportedOps
+grl_proxy_source_supported_operations (GrlSource *source)
+{
+  return GRL_PROXY_SOURCE (source)->operations;
+}
+
+static const GList *
+grl_proxy_source_supported_keys (GrlSource *source)
+{
+  return GRL_PROXY_SOURCE (source)->supported_keys;
+}
+
+static const GList *
+grl_proxy_source_slow_keys (GrlSource *source)
+{
+  return GRL_PROXY_SOURCE (source)->slow_keys;
+}
+
+static void
+proxy_forward_results (GrlSource *source,
+                       const gchar *command,
+                       guint operation_id,
+                       const gchar *target,
+                       GList *keys,
+                       GrlOperationOptions *options,
+                       GrlSourceResultCb callback,
+                       gpointer user_data,
+                       GrlCoreError error_code)
+{
+  GrlPluginHost *host = GRL_PROXY_SOURCE (source)->host;
+  HostOperation *op;
+  gchar *id, *skip, *count, *flags, *filter, *key_names;
+  gboolean sent;
+
+  op = plugin_host_start_operation (host, source, operation_id, error_code,
+                                    user_data);
+  op->callback = callback;
+
+  id = g_strdup_printf ("%u", operation_id);
+  skip = g_strdup_printf ("%u", grl_operation_options_get_skip (options));
+  count = g_strdup_printf ("%d", grl_operation_options_get_count (options));
+  /* Full resolution is done here, with all the sources available */
+  flags = g_strdup_printf ("%d",
+                           grl_operation_options_get_flags (options) &
+                           ~GRL_RESOLVE_FULL);
+  filter = g_strdup_printf ("%d",
+                            grl_operation_options_get_type_filter (options));
+  key_names = grl_plugin_host_keys_to_string (keys);
+
+  sent = plugin_host_send (host, command, id, grl_source_get_id (source),
+                           target, key_names, skip, count, flags, filter,
+                           NULL);
+
+  g_free (id);
+  g_free (skip);
+  g_free (count);
+  g_free (flags);
+  g_free (filter);
+  g_free (key_names);
+
+  if (!sent) {
+    plugin_host_fail_operation (host, operation_id);
+  }
+}
+
+static void
+grl_proxy_source_browse (GrlSource *source,
+                         GrlSourceBrowseSpec *bs)
+{
+  gchar *container;
+
+  container = grl_plugin_host_media_to_string (bs->container);
+  proxy_forward_results (source, GRL_PLUGIN_HOST_CMD_BROWSE,
+                         bs->operation_id, container, bs->keys, bs->options,
+                         bs->callback, bs->user_data,
+                         GRL_CORE_ERROR_BROWSE_FAILED);
+  g_free (container);
+}
+
+static void
+grl_proxy_source_search (GrlSource *source,
+                         GrlSourceSearchSpec *ss)
+{
+  proxy_forward_results (source, GRL_PLUGIN_HOST_CMD_SEARCH,
+                         ss->operation_id, ss->text? ss->text: "", ss->keys,
+                         ss->options, ss->callback, ss->user_data,
+                         GRL_CORE_ERROR_SEARCH_FAILED);
+}
+
+static void
+grl_proxy_source_query (GrlSource *source,
+                        GrlSourceQuerySpec *qs)
+{
+  proxy_forward_results (source, GRL_PLUGIN_HOST_CMD_QUERY,
+                         qs->operation_id, qs->query, qs->keys, qs->options,
+                         qs->callback, qs->user_data,
+                         GRL_CORE_ERROR_QUERY_FAILED);
+}
+
+static void
+grl_proxy_source_resolve (GrlSource *source,
+                          GrlSourceResolveSpec *rs)
+{
+  GrlPluginHost *host = GRL_PROXY_SOURCE (source)->host;
+  HostOperation *op;
+  gchar *id, *media, *key_names, *flags;
+  gboolean sent;
+
+  op = plugin_host_start_operation (host, source, rs->operation_id,
+                                    GRL_CORE_ERROR_RESOLVE_FAILED,
+                                    rs->user_data);
+  op->resolve_callback = rs->callback;
+  op->media = g_object_ref (rs->media);
+
+  id = g_strdup_printf ("%u", rs->operation_id);
+  media = grl_plugin_host_media_to_string (rs->media);
+  key_names = grl_plugin_host_keys_to_string (rs->keys);
+  flags = g_strdup_printf ("%d",
+                           grl_operation_options_get_flags (rs->options) &
+                           ~GRL_RESOLVE_FULL);
+
+  sent = plugin_host_send (host, GRL_PLUGIN_HOST_CMD_RESOLVE, id,
+                           grl_source_get_id (source), media, key_names, flags,
+                           NULL);
+
+  g_free (id);
+  g_free (media);
+  g_free (key_names);
+  g_free (flags);
+
+  if (!sent) {
+    plugin_host_fail_operation (host, rs->operation_id);
+  }
+}
+
+static void
+grl_proxy_source_cancel (GrlSource *source,
+                         guint operation_id)
+{
+  gchar *id;
+
+  id = g_strdup_printf ("%u", operation_id);
+  plugin_host_send (GRL_PROXY_SOURCE (source)->host,
+                    GRL_PLUGIN_HOST_CMD_CANCEL, id, NULL);
+  g_free (id);
+}
+
+static void
+grl_proxy_source_class_init (GrlProxySourceClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  gobject_class->finalize = grl_proxy_source_finalize;
+
+  source_class->supported_operations = grl_proxy_source_supported_operations;
+  source_class->supported_keys = grl_proxy_source_supported_keys;
+  source_class->slow_keys = grl_proxy_source_slow_keys;
+  source_class->browse = grl_proxy_source_browse;
+  source_class->search = grl_proxy_source_search;
+  source_class->query = grl_proxy_source_query;
+  source_class->resolve = grl_proxy_source_resolve;
+  source_class->cancel = grl_proxy_source_cancel;
+}
+
+static void
+grl_proxy_source_init (GrlProxySource *source)
+{
+}
+
+/* ================ Messages ================ */
+
+static void
+append_field (GString *message,
+              const gchar *field)
+{
+  const gchar *c;
+
+  for (c = field; c && *c; c++) {
+    switch (*c) {
+    case '\\':
+      g_string_append (message, "\\\\");
+      break;
+    case '\t':
+      g_string_append (message, "\\t");
+      break;
+    case '\n':
+      g_string_append (message, "\\n");
+      break;
+    default:
+      g_string_append_c (message, *c);
+    }
+  }
+}
+
+/*
+ * grl_plugin_host_message_valist:
+ * @command: the message command
+ * @args: the message fields, terminated by %NULL
+ *
+ * Builds a message for the plugin host protocol. Fields are strings; use an
+ * empty string for a missing value.
+ *
+ * Returns: the message, including its line terminator
+ */
+gchar *
+grl_plugin_host_message_valist (const gchar *command,
+                                va_list args)
+{
+  GString *message;
+  const gchar *field;
+
+  message = g_string_new (command);
+  while ((field = va_arg (args, const gchar *))) {
+    g_string_append_c (message, '\t');
+    append_field (message, field);
+  }
+  g_string_append_c (message, '\n');
+
+  return g_string_free (message, FALSE);
+}
+
+/*
+ * grl_plugin_host_message:
+ * @command: the message command
+ * @...: the message fields, terminated by %NULL
+ *
+ * Like grl_plugin_host_message_valist().
+ */
+gchar *
+grl_plugin_host_message (const gchar *command,
+                         ...)
+{
+  va_list args;
+  gchar *message;
+
+  va_start (args, command);
+  message = grl_plugin_host_message_valist (command, args);
+  va_end (args);
+
+  return message;
+}
+
+/*
+ * grl_plugin_host_parse_message:
+ * @line: a line read from the plugin host protocol
+ *
+ * Returns: a %NULL-terminated array with the command followed by the
+ * unescaped fields. Use g_strfreev() to free it.
+ */
+gchar **
+grl_plugin_host_parse_message (const gchar *line)
+{
+  gchar **fields;
+  gchar *field;
+  gsize length;
+  guint i;
+
+  length = strlen (line);
+  if (length > 0 && line[length - 1] == '\n') {
+    length--;
+  }
+
+  field = g_strndup (line, length);
+  fields = g_strsplit (field, "\t", -1);
+  g_free (field);
+
+  for (i = 0; fields[i]; i++) {
+    field = fields[i];
+    fields[i] = g_strcompress (field);
+    g_free (field);
+  }
+
+  return fields;
+}
+
+/*
+ * grl_plugin_host_keys_to_string:
+ * @keys: a list of keys
+ *
+ * Returns: the names of @keys, separated by commas
+ */
+gchar *
+grl_plugin_host_keys_to_string (const GList *keys)
+{
+  GString *names;
+
+  names = g_string_new (NULL);
+  for (; keys; keys = g_list_next (keys)) {
+    if (names->len > 0) {
+      g_string_append_c (names, ',');
+    }
+    g_string_append (names,
+                     GRL_METADATA_KEY_GET_NAME (GRLPOINTER_TO_KEYID (keys->data)));
+  }
+
+  return g_string_free (names, FALSE);
+}
+
+/*
+ * grl_plugin_host_keys_from_string:
+ * @keys: key names, separated by commas
+ *
+ * Unknown keys are skipped.
+ *
+ * Returns: a list of keys. Use g_list_free() to free it.
+ */
+GList *
+grl_plugin_host_keys_from_string (const gchar *keys)
+{
+  GrlRegistry *registry;
+  GrlKeyID key;
+  GList *key_list = NULL;
+  gchar **names;
+  guint i;
+
+  registry = grl_registry_get_default ();
+  names = g_strsplit (keys, ",", -1);
+  for (i = 0; names[i]; i++) {
+    key = grl_registry_lookup_metadata_key (registry, names[i]);
+    if (key != GRL_METADATA_KEY_INVALID) {
+      key_list = g_list_prepend (key_list, GRLKEYID_TO_POINTER (key));
+    }
+  }
+  g_strfreev (names);
+
+  return g_list_reverse (key_list);
+}
+
+static GType
+media_type_from_name (const gchar *name)
+{
+  GType types[5];
+  guint i;
+
+  /* Getting the types registers them, if no media of that kind exists yet */
+  types[0] = GRL_TYPE_MEDIA;
+  types[1] = GRL_TYPE_MEDIA_BOX;
+  types[2] = GRL_TYPE_MEDIA_AUDIO;
+  types[3] = GRL_TYPE_MEDIA_VIDEO;
+  types[4] = GRL_TYPE_MEDIA_IMAGE;
+
+  for (i = 0; i < G_N_ELEMENTS (types); i++) {
+    if (g_strcmp0 (g_type_name (types[i]), name) == 0) {
+      return types[i];
+    }
+  }
+
+  return 0;
+}
+
+/* Returns NULL for values that cannot be sent */
+static gchar *
+value_to_string (const GValue *value)
+{
+  GByteArray *array;
+  GDateTime *date;
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar *date_string, *string;
+  gint offset;
+
+  if (G_VALUE_HOLDS_STRING (value)) {
+    return g_value_dup_string (value);
+  } else if (G_VALUE_HOLDS_INT (value)) {
+    return g_strdup_printf ("%d", g_value_get_int (value));
+  } else if (G_VALUE_HOLDS_INT64 (value)) {
+    return g_strdup_printf ("%" G_GINT64_FORMAT, g_value_get_int64 (value));
+  } else if (G_VALUE_HOLDS_BOOLEAN (value)) {
+    return g_strdup (g_value_get_boolean (value)? "1": "0");
+  } else if (G_VALUE_HOLDS_FLOAT (value)) {
+    return g_strdup (g_ascii_formatd (buffer, sizeof (buffer), "%.17g",
+                                      g_value_get_float (value)));
+  } else if (G_VALUE_HOLDS_DOUBLE (value)) {
+    return g_strdup (g_ascii_formatd (buffer, sizeof (buffer), "%.17g",
+                                      g_value_get_double (value)));
+  } else if (G_VALUE_TYPE (value) == G_TYPE_DATE_TIME) {
+    date = g_value_get_boxed (value);
+    if (!date) {
+      return NULL;
+    }
+    /* ISO 8601, keeping the microseconds and the offset */
+    offset = g_date_time_get_utc_offset (date) / G_TIME_SPAN_MINUTE;
+    date_string = g_date_time_format (date, "%Y-%m-%dT%H:%M:%S");
+    string = g_strdup_printf ("%s.%06d%c%02d:%02d",
+                              date_string,
+                              g_date_time_get_microsecond (date),
+                              offset < 0? '-': '+',
+                              ABS (offset) / 60,
+                              ABS (offset) % 60);
+    g_free (date_string);
+    return string;
+  } else if (G_VALUE_TYPE (value) == G_TYPE_BYTE_ARRAY) {
+    array = g_value_get_boxed (value);
+    if (!array) {
+      return NULL;
+    }
+    return g_base64_encode (array->data, array->len);
+  }
+
+  return NULL;
+}
+
+static GDateTime *
+date_time_from_string (const gchar *string)
+{
+  GDateTime *date, *exact_date;
+  GTimeZone *time_zone;
+  gchar *zone;
+  gchar sign;
+  gint year, month, day, hour, minute, second, microsecond;
+  gint offset_hours, offset_minutes;
+
+  if (sscanf (string, "%d-%d-%dT%d:%d:%d.%d%c%d:%d",
+              &year, &month, &day, &hour, &minute, &second, &microsecond,
+              &sign, &offset_hours, &offset_minutes) != 10) {
+    return NULL;
+  }
+
+  zone = g_strdup_printf ("%c%02d:%02d", sign, offset_hours, offset_minutes);
+  time_zone = g_time_zone_new (zone);
+  g_free (zone);
+
+  date = g_date_time_new (time_zone, year, month, day, hour, minute, second);
+  g_time_zone_unref (time_zone);
+
+  /* Added apart, as fractional seconds are not exact */
+  if (date && microsecond) {
+    exact_date = g_date_time_add (date, microsecond);
+    g_date_time_unref (date);
+    date = exact_date;
+  }
+
+  return date;
+}
+
+/* Initializes @value as @type; returns FALSE, leaving it unset, if @string
+   is not valid for @type */
+static gboolean
+value_from_string (GValue *value,
+                   GType type,
+                   const gchar *string)
+{
+  GByteArray *array;
+  GDateTime *date;
+  gchar *end = NULL;
+  guchar *data;
+  gsize length;
+
+  g_value_init (value, type);
+
+  if (type == G_TYPE_STRING) {
+    g_value_set_string (value, string);
+    return TRUE;
+  } else if (type == G_TYPE_INT) {
+    g_value_set_int (value, strtol (string, &end, 10));
+  } else if (type == G_TYPE_INT64) {
+    g_value_set_int64 (value, g_ascii_strtoll (string, &end, 10));
+  } else if (type == G_TYPE_BOOLEAN) {
+    g_value_set_boolean (value, strtol (string, &end, 10) != 0);
+  } else if (type == G_TYPE_FLOAT) {
+    g_value_set_float (value, g_ascii_strtod (string, &end));
+  } else if (type == G_TYPE_DOUBLE) {
+    g_value_set_double (value, g_ascii_strtod (string, &end));
+  } else if (type == G_TYPE_DATE_TIME) {
+    date = date_time_from_string (string);
+    if (date) {
+      g_value_take_boxed (value, date);
+      return TRUE;
+    }
+  } else if (type == G_TYPE_BYTE_ARRAY) {
+    data = g_base64_decode (string, &length);
+    array = g_byte_array_sized_new (length);
+    g_byte_array_append (array, data, length);
+    g_free (data);
+    g_value_take_boxed (value, array);
+    return TRUE;
+  }
+
+  if (end && end != string && *end == '\0') {
+    return TRUE;
+  }
+
+  g_value_unset (value);
+  return FALSE;
+}
+
+static void
+append_media_field (GString *string,
+                    const gchar *field)
+{
+  g_string_append_uri_escaped (string, field, NULL, FALSE);
+}
+
+/*
+ * grl_plugin_host_media_to_string:
+ * @media: (allow-none): a media
+ *
+ * Encodes @media for the plugin host protocol: its type name, followed by
+ * each group of related keys, separated by semicolons. A group is a comma
+ * separated list of values, each one being the key name, the value type
+ * name and the value, separated by colons and URI-escaped. Numbers, dates
+ * and binary values are written so that they are read back exactly.
+ *
+ * Returns: the encoded media, or an empty string if @media is %NULL
+ */
+gchar *
+grl_plugin_host_media_to_string (GrlMedia *media)
+{
+  GHashTable *groups;
+  GList *keys, *key, *group_keys, *group_key;
+  GString *string;
+  GrlKeyID key_id, value_key;
+  GrlRelatedKeys *relkeys;
+  const GValue *value;
+  gboolean first;
+  gchar *value_string;
+  guint i, length;
+
+  if (!media) {
+    return g_strdup ("");
+  }
+
+  string = g_string_new (G_OBJECT_TYPE_NAME (media));
+  groups = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  keys = grl_data_get_keys (GRL_DATA (media));
+  for (key = keys; key; key = g_list_next (key)) {
+    key_id = GRLPOINTER_TO_KEYID (key->data);
+    length = grl_data_length (GRL_DATA (media), key_id);
+    for (i = 0; i < length; i++) {
+      /* Related keys share their groups: send each one once */
+      relkeys = grl_data_get_related_keys (GRL_DATA (media), key_id, i);
+      if (!relkeys || g_hash_table_lookup (groups, relkeys)) {
+        continue;
+      }
+      g_hash_table_insert (groups, relkeys, relkeys);
+
+      g_string_append_c (string, ';');
+      first = TRUE;
+      group_keys = grl_related_keys_get_keys (relkeys);
+      for (group_key = group_keys;
+           group_key;
+           group_key = g_list_next (group_key)) {
+        value_key = GRLPOINTER_TO_KEYID (group_key->data);
+        value = grl_related_keys_get (relkeys, value_key);
+        value_string = value? value_to_string (value): NULL;
+        if (!value_string) {
+          GRL_DEBUG ("Cannot send the value of '%s'",
+                     GRL_METADATA_KEY_GET_NAME (value_key));
+          continue;
+        }
+
+        if (!first) {
+          g_string_append_c (string, ',');
+        }
+        first = FALSE;
+        append_media_field (string, GRL_METADATA_KEY_GET_NAME (value_key));
+        g_string_append_c (string, ':');
+        append_media_field (string, g_type_name (G_VALUE_TYPE (value)));
+        g_string_append_c (string, ':');
+        append_media_field (string, value_string);
+        g_free (value_string);
+      }
+      g_list_free (group_keys);
+    }
+  }
+  g_list_free (keys);
+  g_hash_table_unref (groups);
+
+  return g_string_free (string, FALSE);
+}
+
+/*
+ * grl_plugin_host_media_from_string:
+ * @string: a media encoded with grl_plugin_host_media_to_string()
+ *
+ * Unknown keys, and values not matching the type of their key, are skipped.
+ *
+ * Returns: (transfer full): the media, or %NULL if @string is empty or
+ * not valid
+ */
+GrlMedia *
+grl_plugin_host_media_from_string (const gchar *string)
+{
+  GList *keys;
+  GValue value = { 0, };
+  GrlKeyID key;
+  GrlMedia *media;
+  GrlRegistry *registry;
+  GrlRelatedKeys *relkeys;
+  GType type;
+  gchar **groups, **entries, **fields;
+  gchar *name, *type_name, *value_string;
+  guint i, j;
+
+  if (!string || !*string) {
+    return NULL;
+  }
+
+  groups = g_strsplit (string, ";", -1);
+  type = media_type_from_name (groups[0]);
+  if (!type) {
+    GRL_WARNING ("Unknown media type '%s'", groups[0]);
+    g_strfreev (groups);
+    return NULL;
+  }
+
+  media = g_object_new (type, NULL);
+  registry = grl_registry_get_default ();
+
+  for (i = 1; groups[i]; i++) {
+    relkeys = grl_related_keys_new ();
+    entries = g_strsplit (groups[i], ",", -1);
+    for (j = 0; entries[j]; j++) {
+      fields = g_strsplit (entries[j], ":", 3);
+      if (g_strv_length (fields) == 3) {
+        name = g_uri_unescape_string (fields[0], NULL);
+        type_name = g_uri_unescape_string (fields[1], NULL);
+        value_string = g_uri_unescape_string (fields[2], NULL);
+
+        key = name? grl_registry_lookup_metadata_key (registry, name):
+          GRL_METADATA_KEY_INVALID;
+        if (key != GRL_METADATA_KEY_INVALID &&
+            value_string &&
+            g_strcmp0 (type_name,
+                       g_type_name (GRL_METADATA_KEY_GET_TYPE (key))) == 0 &&
+            value_from_string (&value,
+                               GRL_METADATA_KEY_GET_TYPE (key),
+                               value_string)) {
+          grl_related_keys_set (relkeys, key, &value);
+          g_value_unset (&value);
+        } else {
+          GRL_DEBUG ("Skipping value of '%s'", name);
+        }
+
+        g_free (name);
+        g_free (type_name);
+        g_free (value_string);
+      }
+      g_strfreev (fields);
+    }
+    g_strfreev (entries);
+
+    keys = grl_related_keys_get_keys (relkeys);
+    if (keys) {
+      grl_data_add_related_keys (GRL_DATA (media), relkeys);
+    } else {
+      g_object_unref (relkeys);
+    }
+    g_list_free (keys);
+  }
+  g_strfreev (groups);
+
+  return media;
+}
+
+/* ================ Plugin host ================ */
+
+static GrlPluginHost *
+plugin_host_ref (GrlPluginHost *host)
+{
+  g_atomic_int_inc (&host->refcount);
+
+  return host;
+}
+
+void
+grl_plugin_host_unref (GrlPluginHost *host)
+{
+  if (!g_atomic_int_dec_and_test (&host->refcount)) {
+    return;
+  }
+
+  plugin_host_stop (host);
+  g_io_channel_unref (host->channel);
+  close (host->fd);
+  g_hash_table_unref (host->operations);
+  g_free (host->plugin_id);
+  g_slice_free (GrlPluginHost, host);
+}
+
+const gchar *
+grl_plugin_host_get_plugin_id (GrlPluginHost *host)
+{
+  return host->plugin_id;
+}
+
+static gboolean
+plugin_host_write (GrlPluginHost *host,
+                   const gchar *message)
+{
+  gsize length;
+  gsize sent = 0;
+  gssize written;
+
+  length = strlen (message);
+
+  g_bit_lock (&host->lock, SEND_LOCK);
+  while (sent < length) {
+    written = send (host->fd, message + sent, length - sent, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      GRL_DEBUG ("Cannot send to plugin host for '%s': %s",
+                 host->plugin_id, g_strerror (errno));
+      break;
+    }
+    sent += written;
+  }
+  g_bit_unlock (&host->lock, SEND_LOCK);
+
+  return sent == length;
+}
+
+static gboolean
+plugin_host_send (GrlPluginHost *host,
+                  const gchar *command,
+                  ...)
+{
+  va_list args;
+  gchar *message;
+  gboolean sent;
+
+  va_start (args, command);
+  message = grl_plugin_host_message_valist (command, args);
+  va_end (args);
+
+  sent = plugin_host_write (host, message);
+  g_free (message);
+
+  return sent;
+}
+
+static gchar **
+plugin_host_receive (GrlPluginHost *host)
+{
+  GIOStatus status;
+  gchar **message;
+  gchar *line = NULL;
+
+  do {
+    status = g_io_channel_read_line (host->channel, &line, NULL, NULL, NULL);
+  } while (status == G_IO_STATUS_AGAIN);
+
+  if (status != G_IO_STATUS_NORMAL) {
+    return NULL;
+  }
+
+  message = grl_plugin_host_parse_message (line);
+  g_free (line);
+
+  return message;
+}
+
+/* Asks the host to quit: it exits when its end of the socket is closed */
+static void
+plugin_host_stop (GrlPluginHost *host)
+{
+  if (host->stopped) {
+    return;
+  }
+
+  host->stopped = TRUE;
+  shutdown (host->fd, SHUT_WR);
+
+  /* Otherwise the reader thread waits for it */
+  if (!host->reading) {
+    waitpid (host->pid, NULL, 0);
+    g_spawn_close_pid (host->pid);
+  }
+}
+
+static void
+plugin_host_child_setup (gpointer user_data)
+{
+  dup2 (GPOINTER_TO_INT (user_data), GRL_PLUGIN_HOST_FD);
+}
+
+/*
+ * grl_plugin_host_spawn:
+ * @library_filename: the plugin module
+ * @plugin_dirs: the directories plugin information files are searched in
+ * @error: error return location or @NULL to ignore
+ *
+ * Starts a plugin host for the plugin in @library_filename, which is not
+ * loaded until the host is attached to a #GrlPlugin and the plugin is
+ * loaded.
+ *
+ * Returns: a new #GrlPluginHost, or %NULL if the module is not a valid
+ * plugin
+ */
+GrlPluginHost *
+grl_plugin_host_spawn (const gchar *library_filename,
+                       GSList *plugin_dirs,
+                       GError **error)
+{
+  GError *spawn_error = NULL;
+  GPid pid;
+  GString *dirs;
+  GrlPluginHost *host;
+  const gchar *host_path;
+  gchar *dirname;
+  gchar *argv[4];
+  gchar **message;
+  gint fds[2];
+  gboolean spawned;
+
+  host_path = g_getenv (GRL_PLUGIN_HOST_VAR);
+  if (!host_path) {
+    host_path = GRL_PLUGIN_HOST_PATH;
+  }
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    GRL_WARNING ("Failed to create plugin host socket: %s", g_strerror (errno));
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
+                 _("Failed to load plugin from %s"), library_filename);
+    return NULL;
+  }
+
+  /* The plugin information file is looked for where the core would */
+  dirname = g_path_get_dirname (library_filename);
+  dirs = g_string_new (dirname);
+  g_free (dirname);
+  for (; plugin_dirs; plugin_dirs = g_slist_next (plugin_dirs)) {
+    g_string_append (dirs, G_SEARCHPATH_SEPARATOR_S);
+    g_string_append (dirs, plugin_dirs->data);
+  }
+
+  argv[0] = (gchar *) host_path;
+  argv[1] = (gchar *) library_filename;
+  argv[2] = dirs->str;
+  argv[3] = NULL;
+
+  spawned = g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                           plugin_host_child_setup, GINT_TO_POINTER (fds[1]),
+                           &pid, &spawn_error);
+  close (fds[1]);
+  g_string_free (dirs, TRUE);
+
+  if (!spawned) {
+    GRL_WARNING ("Failed to start plugin host '%s': %s",
+                 host_path, spawn_error->message);
+    g_error_free (spawn_error);
+    close (fds[0]);
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
+                 _("Failed to load plugin from %s"), library_filename);
+    return NULL;
+  }
+
+  host = g_slice_new0 (GrlPluginHost);
+  host->refcount = 1;
+  host->pid = pid;
+  host->fd = fds[0];
+  host->channel = g_io_channel_unix_new (host->fd);
+  g_io_channel_set_encoding (host->channel, NULL, NULL);
+  host->operations = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  /* The host opens the module and tells which plugin it is */
+  message = plugin_host_receive (host);
+  if (!message ||
+      g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_PLUGIN) != 0 ||
+      !message[1] || !*message[1]) {
+    GRL_WARNING ("Plugin host failed to open '%s'", library_filename);
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
+                 _("Invalid plugin file %s"), library_filename);
+    g_strfreev (message);
+    grl_plugin_host_unref (host);
+    return NULL;
+  }
+
+  host->plugin_id = g_strdup (message[1]);
+  g_strfreev (message);
+
+  return host;
+}
+
+/* ================ Operations ================ */
+
+static void
+host_result_free (HostResult *result)
+{
+  g_free (result->media);
+  if (result->error) {
+    g_error_free (result->error);
+  }
+  g_slice_free (HostResult, result);
+}
+
+static void
+host_operation_free (HostOperation *op)
+{
+  g_queue_foreach (op->results, (GFunc) host_result_free, NULL);
+  g_queue_free (op->results);
+  g_main_context_unref (op->context);
+  if (op->media) {
+    g_object_unref (op->media);
+  }
+  g_object_unref (op->source);
+  grl_plugin_host_unref (op->host);
+  g_slice_free (HostOperation, op);
+}
+
+static HostOperation *
+plugin_host_start_operation (GrlPluginHost *host,
+                             GrlSource *source,
+                             guint operation_id,
+                             GrlCoreError error_code,
+                             gpointer user_data)
+{
+  HostOperation *op;
+
+  op = g_slice_new0 (HostOperation);
+  op->host = plugin_host_ref (host);
+  op->source = g_object_ref (source);
+  op->operation_id = operation_id;
+  op->error_code = error_code;
+  op->context = grl_operation_ref_context (operation_id);
+  op->user_data = user_data;
+  op->results = g_queue_new ();
+
+  g_bit_lock (&host->lock, OPERATIONS_LOCK);
+  g_hash_table_insert (host->operations, GUINT_TO_POINTER (operation_id), op);
+  g_bit_unlock (&host->lock, OPERATIONS_LOCK);
+
+  return op;
+}
+
+/* Replaces the values in @media with the ones resolved by the host */
+static void
+host_media_merge (GrlMedia *media,
+                  GrlMedia *resolved)
+{
+  GList *keys, *key;
+  GrlKeyID key_id;
+  GrlRelatedKeys *relkeys;
+  guint i, length;
+
+  keys = grl_data_get_keys (GRL_DATA (resolved));
+  for (key = keys; key; key = g_list_next (key)) {
+    key_id = GRLPOINTER_TO_KEYID (key->data);
+    if (key_id == GRL_METADATA_KEY_ID ||
+        key_id == GRL_METADATA_KEY_SOURCE) {
+      continue;
+    }
+
+    while (grl_data_length (GRL_DATA (media), key_id) > 0) {
+      grl_data_remove (GRL_DATA (media), key_id);
+    }
+
+    length = grl_data_length (GRL_DATA (resolved), key_id);
+    for (i = 0; i < length; i++) {
+      relkeys = grl_data_get_related_keys (GRL_DATA (resolved), key_id, i);
+      grl_data_add_related_keys (GRL_DATA (media),
+                                 grl_related_keys_dup (relkeys));
+    }
+  }
+  g_list_free (keys);
+}
+
+/* Hands out the results received so far, in the operation's context */
+static gboolean
+host_operation_flush (gpointer user_data)
+{
+  HostOperation *op = (HostOperation *) user_data;
+  GrlPluginHost *host = op->host;
+  HostResult *result;
+  GrlMedia *media;
+  GQueue *results;
+  gboolean finished;
+
+  g_bit_lock (&host->lock, OPERATIONS_LOCK);
+  results = op->results;
+  op->results = g_queue_new ();
+  op->flushing = FALSE;
+  finished = op->finished;
+  if (finished) {
+    g_hash_table_remove (host->operations,
+                         GUINT_TO_POINTER (op->operation_id));
+  }
+  g_bit_unlock (&host->lock, OPERATIONS_LOCK);
+
+  while ((result = g_queue_pop_head (results))) {
+    media = grl_plugin_host_media_from_string (result->media);
+
+    if (op->resolve_callback) {
+      if (media) {
+        host_media_merge (op->media, media);
+        g_object_unref (media);
+      }
+      op->resolve_callback (op->source, op->operation_id, op->media,
+                            op->user_data, result->error);
+    } else {
+      op->callback (op->source, op->operation_id, media, result->remaining,
+                    op->user_data, result->error);
+    }
+
+    host_result_free (result);
+  }
+  g_queue_free (results);
+
+  if (finished) {
+    host_operation_free (op);
+  }
+
+  return FALSE;
+}
+
+/* Must be called with the operations lock held; takes @media and @error */
+static void
+plugin_host_push_result_unlocked (GrlPluginHost *host,
+                                  HostOperation *op,
+                                  gint remaining,
+                                  gchar *media,
+                                  GError *error)
+{
+  HostResult *result;
+
+  result = g_slice_new (HostResult);
+  result->remaining = remaining;
+  result->media = media? media: g_strdup ("");
+  result->error = error;
+  g_queue_push_tail (op->results, result);
+
+  op->finished = (remaining == 0);
+  if (!op->flushing) {
+    op->flushing = TRUE;
+    grl_context_idle_add (op->context, G_PRIORITY_HIGH_IDLE,
+                          host_operation_flush, op);
+  }
+}
+
+static void
+plugin_host_push_result (GrlPluginHost *host,
+                         guint operation_id,
+                         gint remaining,
+                         gchar *media,
+                         GError *error)
+{
+  HostOperation *op;
+
+  g_bit_lock (&host->lock, OPERATIONS_LOCK);
+  op = g_hash_table_lookup (host->operations, GUINT_TO_POINTER (operation_id));
+  if (op && !op->finished) {
+    plugin_host_push_result_unlocked (host, op, remaining, media, error);
+  } else {
+    g_free (media);
+    if (error) {
+      g_error_free (error);
+    }
+  }
+  g_bit_unlock (&host->lock, OPERATIONS_LOCK);
+}
+
+static GError *
+host_operation_lost_error (HostOperation *op)
+{
+  return g_error_new (GRL_CORE_ERROR,
+                      op->error_code,
+                      _("Plugin '%s' is not running"),
+                      op->host->plugin_id);
+}
+
+static void
+plugin_host_fail_operation (GrlPluginHost *host,
+                            guint operation_id)
+{
+  HostOperation *op;
+
+  g_bit_lock (&host->lock, OPERATIONS_LOCK);
+  op = g_hash_table_lookup (host->operations, GUINT_TO_POINTER (operation_id));
+  if (op && !op->finished) {
+    plugin_host_push_result_unlocked (host, op, 0, NULL,
+                                      host_operation_lost_error (op));
+  }
+  g_bit_unlock (&host->lock, OPERATIONS_LOCK);
+}
+
+static void
+plugin_host_handle_result (GrlPluginHost *host,
+                           gchar **message,
+                           gboolean resolved)
+{
+  GError *error = NULL;
+  guint operation_id;
+  gint remaining = 0;
+  gchar **fields;
+  gint code;
+
+  /* RESULT has the remaining count before the media */
+  if (g_strv_length (message) < (resolved? 5: 6)) {
+    return;
+  }
+
+  operation_id = strtoul (message[1], NULL, 10);
+  if (!resolved) {
+    remaining = atoi (message[2]);
+  }
+  fields = message + (resolved? 2: 3);
+
+  code = atoi (fields[1]);
+  if (code != 0) {
+    error = g_error_new_literal (GRL_CORE_ERROR, code, fields[2]);
+  }
+
+  plugin_host_push_result (host, operation_id, remaining,
+                           g_strdup (fields[0]), error);
+}
+
+/* ================ Sources ================ */
+
+static void
+plugin_host_add_source (GrlPluginHost *host,
+                        GrlRegistry *registry,
+                        gchar **message)
+{
+  GrlProxySource *proxy;
+
+  if (g_strv_length (message) < 9) {
+    return;
+  }
+
+  proxy = g_object_new (GRL_TYPE_PROXY_SOURCE,
+                        "source-id", message[1],
+                        "source-name", message[2],
+                        "source-desc", message[3],
+                        "rank", atoi (message[4]),
+                        "supported-media", atoi (message[6]),
+                        NULL);
+  proxy->host = plugin_host_ref (host);
+  proxy->operations = atoi (message[5]) & GRL_PLUGIN_HOST_OPS;
+  proxy->supported_keys = grl_plugin_host_keys_from_string (message[7]);
+  proxy->slow_keys = grl_plugin_host_keys_from_string (message[8]);
+
+  GRL_DEBUG ("Plugin '%s' added source '%s'", host->plugin_id, message[1]);
+  grl_registry_register_source (registry, host->plugin,
+                                GRL_SOURCE (proxy), NULL);
+}
+
+static void
+plugin_host_remove_source (GrlPluginHost *host,
+                           GrlRegistry *registry,
+                           GrlSource *source)
+{
+  if (GRL_IS_PROXY_SOURCE (source) &&
+      GRL_PROXY_SOURCE (source)->host == host) {
+    GRL_DEBUG ("Plugin '%s' removed source '%s'",
+               host->plugin_id, grl_source_get_id (source));
+    grl_registry_unregister_source (registry, source, NULL);
+  }
+}
+
+static void
+plugin_host_remove_sources (GrlPluginHost *host,
+                            GrlRegistry *registry)
+{
+  GList *sources, *iter;
+
+  sources = grl_registry_get_sources (registry, FALSE);
+  for (iter = sources; iter; iter = g_list_next (iter)) {
+    plugin_host_remove_source (host, registry, iter->data);
+  }
+  g_list_free (sources);
+}
+
+typedef struct {
+  GrlPluginHost *host;
+  gchar **message;
+} HostSourceChange;
+
+/* Sources are registered in the main thread */
+static gboolean
+plugin_host_source_changed_idle (gpointer user_data)
+{
+  HostSourceChange *change = (HostSourceChange *) user_data;
+  GrlRegistry *registry;
+  GrlSource *source;
+
+  registry = grl_registry_get_default ();
+
+  if (!change->message) {
+    /* The host is gone: take all its sources away */
+    plugin_host_remove_sources (change->host, registry);
+  } else if (g_strcmp0 (change->message[0],
+                        GRL_PLUGIN_HOST_CMD_SOURCE) == 0) {
+    plugin_host_add_source (change->host, registry, change->message);
+  } else if (change->message[1]) {
+    source = grl_registry_lookup_source (registry, change->message[1]);
+    if (source) {
+      plugin_host_remove_source (change->host, registry, source);
+    }
+  }
+
+  g_strfreev (change->message);
+  grl_plugin_host_unref (change->host);
+  g_slice_free (HostSourceChange, change);
+
+  return FALSE;
+}
+
+static void
+plugin_host_source_changed (GrlPluginHost *host,
+                            gchar **message)
+{
+  HostSourceChange *change;
+
+  change = g_slice_new (HostSourceChange);
+  change->host = plugin_host_ref (host);
+  change->message = message;
+  g_idle_add (plugin_host_source_changed_idle, change);
+}
+
+static void
+plugin_host_exited (GrlPluginHost *host)
+{
+  GHashTableIter iter;
+  HostOperation *op;
+  gint status;
+
+  if (waitpid (host->pid, &status, 0) > 0 && WIFSIGNALED (status)) {
+    GRL_WARNING ("Plugin host for '%s' was killed by signal %d",
+                 host->plugin_id, WTERMSIG (status));
+  }
+  g_spawn_close_pid (host->pid);
+
+  /* Nobody is going to answer the pending operations */
+  g_bit_lock (&host->lock, OPERATIONS_LOCK);
+  g_hash_table_iter_init (&iter, host->operations);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &op)) {
+    if (!op->finished) {
+      plugin_host_push_result_unlocked (host, op, 0, NULL,
+                                        host_operation_lost_error (op));
+    }
+  }
+  g_bit_unlock (&host->lock, OPERATIONS_LOCK);
+
+  plugin_host_source_changed (host, NULL);
+}
+
+static gpointer
+plugin_host_reader (gpointer user_data)
+{
+  GrlPluginHost *host = (GrlPluginHost *) user_data;
+  gchar **message;
+
+  while ((message = plugin_host_receive (host))) {
+    if (g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_RESULT) == 0) {
+      plugin_host_handle_result (host, message, FALSE);
+    } else if (g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_RESOLVED) == 0) {
+      plugin_host_handle_result (host, message, TRUE);
+    } else if (g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_SOURCE) == 0 ||
+               g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_REMOVED) == 0) {
+      plugin_host_source_changed (host, message);
+      continue;
+    }
+    g_strfreev (message);
+  }
+
+  GRL_DEBUG ("Plugin host for '%s' exited", host->plugin_id);
+  plugin_host_exited (host);
+  grl_plugin_host_unref (host);
+
+  return NULL;
+}
+
+static gboolean
+plugin_host_start_reader (GrlPluginHost *host)
+{
+  GThread *thread;
+
+  host->reading = TRUE;
+#if GLIB_CHECK_VERSION(2,31,0)
+  thread = g_thread_try_new ("grl-plugin-host", plugin_host_reader,
+                             plugin_host_ref (host), NULL);
+  if (thread) {
+    g_thread_unref (thread);
+  }
+#else
+  thread = g_thread_create (plugin_host_reader, plugin_host_ref (host),
+                            FALSE, NULL);
+#endif
+
+  if (!thread) {
+    host->reading = FALSE;
+    grl_plugin_host_unref (host);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* ================ Plugin ================ */
+
+static void
+plugin_host_send_config (GrlPluginHost *host,
+                         GrlConfig *config)
+{
+  GString *message;
+  gchar **params;
+  gchar *value;
+  guint i;
+
+  /* Configurations have a variable number of fields */
+  message = g_string_new (GRL_PLUGIN_HOST_CMD_CONFIG);
+  params = grl_config_get_params (config);
+  for (i = 0; params && params[i]; i++) {
+    value = grl_config_get_string (config, params[i]);
+    g_string_append_c (message, '\t');
+    append_field (message, params[i]);
+    g_string_append_c (message, '\t');
+    append_field (message, value);
+    g_free (value);
+  }
+  g_strfreev (params);
+  g_string_append_c (message, '\n');
+
+  plugin_host_write (host, message->str);
+  g_string_free (message, TRUE);
+}
+
+static gboolean
+plugin_host_plugin_init (GrlRegistry *registry,
+                         GrlPlugin *plugin,
+                         GList *configs)
+{
+  GrlPluginHost *host;
+  gchar **message;
+  gboolean loaded = FALSE;
+
+  host = g_object_get_data (G_OBJECT (plugin), PLUGIN_HOST_DATA);
+  g_return_val_if_fail (host, FALSE);
+
+  for (; configs; configs = g_list_next (configs)) {
+    plugin_host_send_config (host, configs->data);
+  }
+  plugin_host_send (host, GRL_PLUGIN_HOST_CMD_LOAD, NULL);
+
+  /* Sources registered while initializing the plugin are there on return,
+     as with plugins loaded in process */
+  while ((message = plugin_host_receive (host))) {
+    if (g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_SOURCE) == 0) {
+      plugin_host_add_source (host, registry, message);
+    } else if (g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_READY) == 0) {
+      loaded = TRUE;
+    } else if (g_strcmp0 (message[0], GRL_PLUGIN_HOST_CMD_FAILED) == 0) {
+      GRL_WARNING ("Plugin host failed to load '%s': %s",
+                   host->plugin_id, message[1]? message[1]: "");
+      g_strfreev (message);
+      break;
+    }
+    g_strfreev (message);
+
+    if (loaded) {
+      break;
+    }
+  }
+
+  if (loaded && !plugin_host_start_reader (host)) {
+    GRL_WARNING ("Failed to start reading from plugin host for '%s'",
+                 host->plugin_id);
+    loaded = FALSE;
+  }
+
+  if (!loaded) {
+    plugin_host_stop (host);
+    plugin_host_remove_sources (host, registry);
+  }
+
+  return loaded;
+}
+
+static void
+plugin_host_plugin_deinit (GrlPlugin *plugin)
+{
+  GrlPluginHost *host;
+
+  host = g_object_get_data (G_OBJECT (plugin), PLUGIN_HOST_DATA);
+  if (host) {
+    plugin_host_stop (host);
+  }
+}
+
+/*
+ * grl_plugin_host_attach:
+ * @host: a plugin host
+ * @plugin: the plugin @host was spawned for
+ *
+ * Makes @plugin load and unload through @host, taking ownership of it.
+ */
+void
+grl_plugin_host_attach (GrlPluginHost *host,
+                        GrlPlugin *plugin)
+{
+  host->plugin = plugin;
+  grl_plugin_set_load_func (plugin, plugin_host_plugin_init);
+  grl_plugin_set_unload_func (plugin, plugin_host_plugin_deinit);
+  g_object_set_data_full (G_OBJECT (plugin), PLUGIN_HOST_DATA, host,
+                          (GDestroyNotify) grl_plugin_host_unref);
+}
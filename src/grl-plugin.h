@@ -41,6 +41,7 @@
 #define GRL_PLUGIN_LICENSE "license"
 #define GRL_PLUGIN_AUTHOR "author"
 #define GRL_PLUGIN_SITE "site"
+#define GRL_PLUGIN_URI_PATTERNS "uri-patterns"
 
 /* Macros */
 
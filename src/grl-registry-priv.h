@@ -34,4 +34,12 @@ GrlKeyID grl_registry_register_metadata_key_full (GrlRegistry *registry,
                                                   GrlKeyID key,
                                                   GError **error);
 
+void grl_registry_report_source_result (GrlRegistry *registry,
+                                        GrlSource *source,
+                                        guint latency,
+                                        gboolean failed);
+
+gboolean grl_registry_source_is_tripped (GrlRegistry *registry,
+                                         GrlSource *source);
+
 #endif /* _GRL_REGISTRY_PRIV_H_ */
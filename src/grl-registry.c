@@ -45,6 +45,9 @@
 
 #include "grl-registry-priv.h"
 #include "grl-plugin-priv.h"
+#include "grl-plugin-host-priv.h"
+#include "grl-marshal.h"
+#include "grl-type-builtins.h"
 #include "grl-log.h"
 #include "grl-error.h"
 
@@ -62,6 +65,18 @@ GRL_LOG_DOMAIN(registry_log_domain);
 
 #define GRL_PLUGIN_INFO_MODULE "module"
 
+/* Weight of the last answer in the error rate and latency of a source */
+#define HEALTH_WEIGHT 0.2
+
+/* Answers needed before the error rate of a source is taken into account */
+#define HEALTH_MIN_SAMPLES 5
+
+/* Error rate from which a source is left aside */
+#define HEALTH_MAX_ERROR_RATE 0.5
+
+/* Time a source is left aside before giving it another chance */
+#define HEALTH_OPEN_TIME (30 * G_USEC_PER_SEC)
+
 #define GRL_REGISTRY_GET_PRIVATE(object)                        \
   (G_TYPE_INSTANCE_GET_PRIVATE((object),                        \
                                GRL_TYPE_REGISTRY,               \
@@ -74,6 +89,14 @@ struct KeyIDHandler {
   gint last_id;
 };
 
+typedef struct {
+  GrlSourceHealth state;
+  gdouble error_rate;
+  gdouble latency;
+  guint samples;
+  gint64 opened_at;
+} SourceHealth;
+
 struct _GrlRegistryPrivate {
   GHashTable *configs;
   GHashTable *plugins;
@@ -81,9 +104,11 @@ struct _GrlRegistryPrivate {
   GHashTable *related_keys;
   GParamSpecPool *system_keys;
   GHashTable *ranks;
+  GHashTable *health;
   GSList *plugins_dir;
   GSList *allowed_plugins;
   gboolean all_plugins_preloaded;
+  gboolean isolate_plugins;
   struct KeyIDHandler key_id_handler;
 };
 
@@ -108,10 +133,14 @@ static GrlKeyID key_id_handler_add (struct KeyIDHandler *handler,
 enum {
   SIG_SOURCE_ADDED,
   SIG_SOURCE_REMOVED,
+  SIG_SOURCE_HEALTH_CHANGED,
   SIG_LAST
 };
 static gint registry_signals[SIG_LAST];
 
+/* Sources report their results from the threads running operations */
+G_LOCK_DEFINE_STATIC (health);
+
 G_DEFINE_TYPE (GrlRegistry, grl_registry, G_TYPE_OBJECT);
 
 static void
@@ -156,6 +185,27 @@ grl_registry_class_init (GrlRegistryClass *klass)
 		 NULL,
 		 g_cclosure_marshal_VOID__OBJECT,
 		 G_TYPE_NONE, 1, GRL_TYPE_SOURCE);
+
+  /**
+   * GrlRegistry::source-health-changed:
+   * @registry: the registry
+   * @source: the source whose health changed
+   * @health: the new #GrlSourceHealth of @source
+   *
+   * Signals that @source started or stopped being left aside because of
+   * failing too many requests.
+   *
+   * Since: 0.2.7
+   */
+  registry_signals[SIG_SOURCE_HEALTH_CHANGED] =
+    g_signal_new("source-health-changed",
+		 G_TYPE_FROM_CLASS(klass),
+		 G_SIGNAL_RUN_LAST,
+		 0,
+		 NULL,
+		 NULL,
+		 grl_marshal_VOID__OBJECT_ENUM,
+		 G_TYPE_NONE, 2, GRL_TYPE_SOURCE, GRL_TYPE_SOURCE_HEALTH);
 }
 
 static void
@@ -171,12 +221,16 @@ grl_registry_init (GrlRegistry *registry)
     g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
   registry->priv->related_keys =
     g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, NULL);
+  registry->priv->health =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
   registry->priv->system_keys =
     g_param_spec_pool_new (FALSE);
 
   key_id_handler_init (&registry->priv->key_id_handler);
 
   grl_registry_setup_ranks (registry);
+
+  registry->priv->isolate_plugins = (g_getenv (GRL_PLUGIN_ISOLATE_VAR) != NULL);
 }
 
 /* ================ Utitilies ================ */
@@ -248,12 +302,94 @@ grl_registry_setup_ranks (GrlRegistry *registry)
   g_strfreev (rank_specs);
 }
 
+static SourceHealth *
+get_source_health (GrlRegistry *registry,
+                   GrlSource *source,
+                   gboolean create)
+{
+  SourceHealth *health;
+
+  health = g_hash_table_lookup (registry->priv->health,
+                                grl_source_get_id (source));
+  if (!health && create) {
+    health = g_new0 (SourceHealth, 1);
+    health->state = GRL_SOURCE_HEALTH_CLOSED;
+    g_hash_table_insert (registry->priv->health,
+                         g_strdup (grl_source_get_id (source)),
+                         health);
+  }
+
+  return health;
+}
+
+/* Returns whether the state changed; it must be notified out of the lock */
+static gboolean
+set_source_health (GrlSource *source,
+                   SourceHealth *health,
+                   GrlSourceHealth state)
+{
+  if (health->state == state) {
+    return FALSE;
+  }
+
+  GRL_DEBUG ("Source '%s' health: %d -> %d (error rate %.2f, latency %.0f ms)",
+             grl_source_get_id (source), health->state, state,
+             health->error_rate, health->latency);
+
+  health->state = state;
+  if (state == GRL_SOURCE_HEALTH_OPEN) {
+    health->opened_at = g_get_monotonic_time ();
+  }
+
+  return TRUE;
+}
+
+/* Gives another chance to the sources left aside long enough */
+static void
+update_source_health (GrlRegistry *registry,
+                      GrlSource *source)
+{
+  SourceHealth *health;
+  gboolean changed = FALSE;
+
+  G_LOCK (health);
+  health = get_source_health (registry, source, FALSE);
+  if (health &&
+      health->state == GRL_SOURCE_HEALTH_OPEN &&
+      g_get_monotonic_time () - health->opened_at >= HEALTH_OPEN_TIME) {
+    changed = set_source_health (source, health, GRL_SOURCE_HEALTH_HALF_OPEN);
+  }
+  G_UNLOCK (health);
+
+  if (changed) {
+    g_signal_emit (registry, registry_signals[SIG_SOURCE_HEALTH_CHANGED], 0,
+                   source, GRL_SOURCE_HEALTH_HALF_OPEN);
+  }
+}
+
 static gint
 compare_by_rank (gconstpointer a,
-                 gconstpointer b) {
+                 gconstpointer b,
+                 gpointer user_data) {
+  GrlRegistry *registry = GRL_REGISTRY (user_data);
+  SourceHealth *health;
+  gboolean tripped_a;
+  gboolean tripped_b;
   gint rank_a;
   gint rank_b;
 
+  /* Sources left aside go after all the others */
+  G_LOCK (health);
+  health = get_source_health (registry, GRL_SOURCE (a), FALSE);
+  tripped_a = health && health->state == GRL_SOURCE_HEALTH_OPEN;
+  health = get_source_health (registry, GRL_SOURCE (b), FALSE);
+  tripped_b = health && health->state == GRL_SOURCE_HEALTH_OPEN;
+  G_UNLOCK (health);
+
+  if (tripped_a != tripped_b) {
+    return tripped_a - tripped_b;
+  }
+
   rank_a = grl_source_get_rank (GRL_SOURCE (a));
   rank_b = grl_source_get_rank (GRL_SOURCE (b));
 
@@ -338,8 +474,10 @@ activate_plugin (GrlRegistry *registry,
                  GRL_CORE_ERROR,
                  GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
                  _("Failed to initialize plugin from %so"), grl_plugin_get_filename (plugin));
-    g_module_close (grl_plugin_get_module (plugin));
-    grl_plugin_set_module (plugin, NULL);
+    if (grl_plugin_get_module (plugin)) {
+      g_module_close (grl_plugin_get_module (plugin));
+      grl_plugin_set_module (plugin, NULL);
+    }
     return FALSE;
   }
 
@@ -724,6 +862,9 @@ grl_registry_unregister_source (GrlRegistry *registry,
 
   if (g_hash_table_remove (registry->priv->sources, id)) {
     GRL_DEBUG ("source '%s' is no longer available", id);
+    G_LOCK (health);
+    g_hash_table_remove (registry->priv->health, id);
+    G_UNLOCK (health);
     g_signal_emit (registry, registry_signals[SIG_SOURCE_REMOVED], 0, source);
     g_object_unref (source);
   } else {
@@ -762,6 +903,124 @@ grl_registry_add_directory (GrlRegistry *registry,
   registry->priv->all_plugins_preloaded = FALSE;
 }
 
+/**
+ * grl_registry_set_plugin_isolation:
+ * @registry: the registry instance
+ * @isolate: whether plugins are loaded in their own process
+ *
+ * Sets whether plugins loaded from now on run in a plugin host process of
+ * their own, instead of being loaded in the application. The sources they
+ * register then forward their operations to the plugin host.
+ *
+ * A plugin leaking memory, blocking or crashing does not affect the
+ * application nor the other plugins. If the plugin host exits, the sources
+ * of its plugin are unregistered and their pending operations fail.
+ *
+ * Only browse, search, query and resolve operations are available in
+ * isolated plugins.
+ *
+ * The default value is %TRUE if the %GRL_PLUGIN_ISOLATE environment variable
+ * is set, and %FALSE otherwise.
+ *
+ * Since: 0.2.7
+ **/
+void
+grl_registry_set_plugin_isolation (GrlRegistry *registry,
+                                   gboolean isolate)
+{
+  g_return_if_fail (GRL_IS_REGISTRY (registry));
+
+  registry->priv->isolate_plugins = isolate;
+}
+
+static GrlPlugin *
+lookup_module_plugin (GrlRegistry *registry,
+                      const gchar *plugin_id,
+                      const gchar *library_filename,
+                      GError **error)
+{
+  GrlPlugin *plugin;
+  gchar *info_dirname;
+  gchar *info_filename;
+
+  /* Check if plugin is preloaded; if not, then create one */
+  plugin = g_hash_table_lookup (registry->priv->plugins, plugin_id);
+
+  if (!plugin) {
+    info_dirname = g_path_get_dirname (library_filename);
+    info_filename = g_strconcat (plugin_id, "." GRL_PLUGIN_INFO_SUFFIX, NULL);
+    plugin = grl_registry_preload_plugin (registry, info_dirname, info_filename);
+    g_free (info_dirname);
+    g_free (info_filename);
+    if (!plugin) {
+      g_set_error (error,
+                   GRL_CORE_ERROR,
+                   GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
+                   _("Unable to load plugin '%s'"), plugin_id);
+      return NULL;
+    }
+  } else {
+    /* Check if the existent plugin is for a different module */
+    if (g_strcmp0 (grl_plugin_get_filename (plugin), library_filename) != 0) {
+      GRL_WARNING ("Plugin '%s' already exists", library_filename);
+      g_set_error (error,
+                   GRL_CORE_ERROR,
+                   GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
+                   _("Plugin '%s' already exists"), library_filename);
+      return NULL;
+    }
+  }
+
+  return plugin;
+}
+
+/* Loads the plugin in its own process, see grl-plugin-host.c */
+static gboolean
+load_isolated_plugin (GrlRegistry *registry,
+                      const gchar *library_filename,
+                      GError **error)
+{
+  GrlPluginHost *host;
+  GrlPlugin *plugin;
+  const gchar *plugin_id;
+  gchar *module_name;
+  gboolean is_loaded;
+
+  host = grl_plugin_host_spawn (library_filename,
+                                registry->priv->plugins_dir,
+                                error);
+  if (!host) {
+    return FALSE;
+  }
+
+  plugin_id = grl_plugin_host_get_plugin_id (host);
+  plugin = lookup_module_plugin (registry, plugin_id, library_filename, error);
+  if (!plugin) {
+    grl_plugin_host_unref (host);
+    return FALSE;
+  }
+
+  /* Keep the host of a loaded plugin */
+  g_object_get (plugin, "loaded", &is_loaded, NULL);
+  if (is_loaded) {
+    GRL_WARNING ("Plugin is already loaded: '%s'", plugin_id);
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
+                 _("Plugin '%s' is already loaded"), plugin_id);
+    grl_plugin_host_unref (host);
+    return FALSE;
+  }
+
+  module_name = g_path_get_basename (library_filename);
+  grl_plugin_set_info (plugin, GRL_PLUGIN_INFO_MODULE, module_name);
+  g_free (module_name);
+
+  grl_plugin_host_attach (host, plugin);
+
+  return activate_plugin (registry, plugin, error);
+}
+
 /**
  * grl_registry_load_plugin:
  * @registry: the registry instance
@@ -770,6 +1029,9 @@ grl_registry_add_directory (GrlRegistry *registry,
  *
  * Loads a module from shared object file stored in @path
  *
+ * If plugin isolation is enabled (see grl_registry_set_plugin_isolation()),
+ * the module is loaded by a plugin host process instead.
+ *
  * Returns: %TRUE if the module is loaded correctly
  *
  * Since: 0.2.0
@@ -783,11 +1045,13 @@ grl_registry_load_plugin (GrlRegistry *registry,
   GrlPluginDescriptor *plugin_desc;
   GrlPlugin *plugin;
   gchar *module_name;
-  gchar *info_dirname;
-  gchar *info_filename;
 
   g_return_val_if_fail (GRL_IS_REGISTRY (registry), FALSE);
 
+  if (registry->priv->isolate_plugins) {
+    return load_isolated_plugin (registry, library_filename, error);
+  }
+
   module = g_module_open (library_filename, G_MODULE_BIND_LOCAL);
   if (!module) {
     GRL_WARNING ("Failed to open module: %s", g_module_error ());
@@ -819,34 +1083,11 @@ grl_registry_load_plugin (GrlRegistry *registry,
     return FALSE;
   }
 
-  /* Check if plugin is preloaded; if not, then create one */
-  plugin = g_hash_table_lookup (registry->priv->plugins,
-                                plugin_desc->plugin_id);
-
+  plugin = lookup_module_plugin (registry, plugin_desc->plugin_id,
+                                 library_filename, error);
   if (!plugin) {
-    info_dirname = g_path_get_dirname (library_filename);
-    info_filename = g_strconcat (plugin_desc->plugin_id, "." GRL_PLUGIN_INFO_SUFFIX, NULL);
-    plugin = grl_registry_preload_plugin (registry, info_dirname, info_filename);
-    g_free (info_dirname);
-    g_free (info_filename);
-    if (!plugin) {
-      g_set_error (error,
-                   GRL_CORE_ERROR,
-                   GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
-                   _("Unable to load plugin '%s'"), plugin_desc->plugin_id);
-      g_module_close (module);
-      return FALSE;
-    }
-  } else {
-    /* Check if the existent plugin is for a different module */
-    if (g_strcmp0 (grl_plugin_get_filename (plugin), library_filename) != 0) {
-      GRL_WARNING ("Plugin '%s' already exists", library_filename);
-      g_set_error (error,
-                   GRL_CORE_ERROR,
-                   GRL_CORE_ERROR_LOAD_PLUGIN_FAILED,
-                   _("Plugin '%s' already exists"), library_filename);
-      return FALSE;
-    }
+    g_module_close (module);
+    return FALSE;
   }
 
   if (!grl_plugin_get_module (plugin)) {
@@ -1036,7 +1277,9 @@ grl_registry_lookup_source (GrlRegistry *registry,
  *
  * This function will return all the available sources in the @registry.
  *
- * If @ranked is %TRUE, the source list will be ordered by rank.
+ * If @ranked is %TRUE, the source list will be ordered by rank. Sources
+ * failing too many requests (see grl_registry_get_source_health()) are put
+ * at the end.
  *
  * Returns: (element-type Grl.Source) (transfer container): a #GList of
  * available #GrlSource<!-- -->s. The content of the list should not be
@@ -1056,11 +1299,12 @@ grl_registry_get_sources (GrlRegistry *registry,
 
   g_hash_table_iter_init (&iter, registry->priv->sources);
   while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &current_source)) {
+    update_source_health (registry, current_source);
     source_list = g_list_prepend (source_list, current_source);
   }
 
   if (ranked) {
-    source_list = g_list_sort (source_list, (GCompareFunc) compare_by_rank);
+    source_list = g_list_sort_with_data (source_list, compare_by_rank, registry);
   }
 
   return source_list;
@@ -1075,7 +1319,9 @@ grl_registry_get_sources (GrlRegistry *registry,
  * Give an array of all the available sources in the @registry capable of
  * perform the operations requested in @ops.
  *
- * If @ranked is %TRUE, the source list will be ordered by rank.
+ * If @ranked is %TRUE, the source list will be ordered by rank. Sources
+ * failing too many requests (see grl_registry_get_source_health()) are put
+ * at the end.
  *
  * Returns: (element-type Grl.Source) (transfer container): a #GList of
  * available #GrlSource<!-- -->s. The content of the list should not be
@@ -1100,12 +1346,13 @@ grl_registry_get_sources_by_operations (GrlRegistry *registry,
     source_ops =
       grl_source_supported_operations (source);
     if ((source_ops & ops) == ops) {
+      update_source_health (registry, source);
       source_list = g_list_prepend (source_list, source);
     }
   }
 
   if (ranked) {
-    source_list = g_list_sort (source_list, compare_by_rank);
+    source_list = g_list_sort_with_data (source_list, compare_by_rank, registry);
   }
 
   return source_list;
@@ -1669,3 +1916,182 @@ grl_registry_add_config_from_file (GrlRegistry *registry,
     return FALSE;
   }
 }
+
+/*
+ * grl_registry_report_source_result:
+ * @registry: the registry instance
+ * @source: a source
+ * @latency: milliseconds @source took to answer
+ * @failed: whether @source failed to answer, as opposed to rejecting the request
+ *
+ * Updates the health of @source with a new answer to a request, leaving it
+ * aside when it fails too often.
+ */
+void
+grl_registry_report_source_result (GrlRegistry *registry,
+                                   GrlSource *source,
+                                   guint latency,
+                                   gboolean failed)
+{
+  SourceHealth *health;
+  GrlSourceHealth state;
+  gboolean changed = FALSE;
+
+  g_return_if_fail (GRL_IS_REGISTRY (registry));
+  g_return_if_fail (GRL_IS_SOURCE (source));
+
+  G_LOCK (health);
+  health = get_source_health (registry, source, TRUE);
+
+  if (health->samples == 0) {
+    health->error_rate = failed? 1.0: 0.0;
+    health->latency = latency;
+  } else {
+    health->error_rate = HEALTH_WEIGHT * (failed? 1.0: 0.0) +
+      (1.0 - HEALTH_WEIGHT) * health->error_rate;
+    health->latency = HEALTH_WEIGHT * latency +
+      (1.0 - HEALTH_WEIGHT) * health->latency;
+  }
+  health->samples++;
+
+  switch (health->state) {
+  case GRL_SOURCE_HEALTH_CLOSED:
+    if (health->samples >= HEALTH_MIN_SAMPLES &&
+        health->error_rate >= HEALTH_MAX_ERROR_RATE) {
+      changed = set_source_health (source, health, GRL_SOURCE_HEALTH_OPEN);
+    }
+    break;
+  case GRL_SOURCE_HEALTH_HALF_OPEN:
+    /* The second chance was either taken or wasted */
+    if (failed) {
+      changed = set_source_health (source, health, GRL_SOURCE_HEALTH_OPEN);
+    } else {
+      health->error_rate = 0.0;
+      changed = set_source_health (source, health, GRL_SOURCE_HEALTH_CLOSED);
+    }
+    break;
+  case GRL_SOURCE_HEALTH_OPEN:
+    /* Requests sent before the source was left aside */
+    break;
+  }
+  state = health->state;
+  G_UNLOCK (health);
+
+  if (changed) {
+    g_signal_emit (registry, registry_signals[SIG_SOURCE_HEALTH_CHANGED], 0,
+                   source, state);
+  }
+}
+
+/*
+ * grl_registry_source_is_tripped:
+ * @registry: the registry instance
+ * @source: a source
+ *
+ * Returns: %TRUE if @source is left aside because of failing too many
+ * requests, and should not be asked unless there is no alternative.
+ */
+gboolean
+grl_registry_source_is_tripped (GrlRegistry *registry,
+                                GrlSource *source)
+{
+  g_return_val_if_fail (GRL_IS_REGISTRY (registry), FALSE);
+  g_return_val_if_fail (GRL_IS_SOURCE (source), FALSE);
+
+  return grl_registry_get_source_health (registry, source) ==
+    GRL_SOURCE_HEALTH_OPEN;
+}
+
+/**
+ * grl_registry_get_source_health:
+ * @registry: the registry instance
+ * @source: a source
+ *
+ * Gets the state of the circuit breaker of @source. Sources failing too many
+ * requests are left aside (%GRL_SOURCE_HEALTH_OPEN) for a while: they are
+ * sorted last in ranked lists, and not used to resolve keys or in
+ * multiple operations if there are other sources available.
+ *
+ * Returns: the #GrlSourceHealth of @source
+ *
+ * Since: 0.2.7
+ */
+GrlSourceHealth
+grl_registry_get_source_health (GrlRegistry *registry,
+                                GrlSource *source)
+{
+  SourceHealth *health;
+  GrlSourceHealth state;
+
+  g_return_val_if_fail (GRL_IS_REGISTRY (registry), GRL_SOURCE_HEALTH_CLOSED);
+  g_return_val_if_fail (GRL_IS_SOURCE (source), GRL_SOURCE_HEALTH_CLOSED);
+
+  update_source_health (registry, source);
+
+  G_LOCK (health);
+  health = get_source_health (registry, source, FALSE);
+  state = health? health->state: GRL_SOURCE_HEALTH_CLOSED;
+  G_UNLOCK (health);
+
+  return state;
+}
+
+/**
+ * grl_registry_get_source_error_rate:
+ * @registry: the registry instance
+ * @source: a source
+ *
+ * Gets the rate of requests @source answered with an error recently, giving
+ * more weight to the last ones.
+ *
+ * Returns: a value between 0 (no errors) and 1 (only errors)
+ *
+ * Since: 0.2.7
+ */
+gdouble
+grl_registry_get_source_error_rate (GrlRegistry *registry,
+                                    GrlSource *source)
+{
+  SourceHealth *health;
+  gdouble error_rate;
+
+  g_return_val_if_fail (GRL_IS_REGISTRY (registry), 0.0);
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0.0);
+
+  G_LOCK (health);
+  health = get_source_health (registry, source, FALSE);
+  error_rate = health? health->error_rate: 0.0;
+  G_UNLOCK (health);
+
+  return error_rate;
+}
+
+/**
+ * grl_registry_get_source_latency:
+ * @registry: the registry instance
+ * @source: a source
+ *
+ * Gets the time @source took to answer recently, giving more weight to the
+ * last requests.
+ *
+ * Returns: the latency of @source in milliseconds, or 0 if unknown
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_registry_get_source_latency (GrlRegistry *registry,
+                                 GrlSource *source)
+{
+  SourceHealth *health;
+  guint latency;
+
+  g_return_val_if_fail (GRL_IS_REGISTRY (registry), 0);
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+
+  G_LOCK (health);
+  health = get_source_health (registry, source, FALSE);
+  latency = health? (guint) (health->latency + 0.5): 0;
+  G_UNLOCK (health);
+
+  return latency;
+}
@@ -40,6 +40,8 @@
 #define GRL_PLUGIN_PATH_VAR "GRL_PLUGIN_PATH"
 #define GRL_PLUGIN_LIST_VAR "GRL_PLUGIN_LIST"
 #define GRL_PLUGIN_RANKS_VAR "GRL_PLUGIN_RANKS"
+#define GRL_PLUGIN_ISOLATE_VAR "GRL_PLUGIN_ISOLATE"
+#define GRL_PLUGIN_HOST_VAR "GRL_PLUGIN_HOST"
 
 /* Macros */
 
@@ -146,6 +148,27 @@ typedef enum {
   GRL_RANK_HIGHEST =  64
 } GrlRank;
 
+/* Source health */
+
+/**
+ * GrlSourceHealth:
+ * @GRL_SOURCE_HEALTH_CLOSED: the source is working fine, and gets requests as
+ * usual
+ * @GRL_SOURCE_HEALTH_OPEN: the source failed too many requests recently, and
+ * is left aside for a while
+ * @GRL_SOURCE_HEALTH_HALF_OPEN: the source was left aside, and is being given
+ * another chance; its next answer decides whether it gets back to
+ * @GRL_SOURCE_HEALTH_CLOSED or @GRL_SOURCE_HEALTH_OPEN
+ *
+ * State of the circuit breaker the registry keeps for each source, following
+ * how the source answered to the last requests.
+ */
+typedef enum {
+  GRL_SOURCE_HEALTH_CLOSED,
+  GRL_SOURCE_HEALTH_OPEN,
+  GRL_SOURCE_HEALTH_HALF_OPEN
+} GrlSourceHealth;
+
 /* GrlRegistry object */
 
 typedef struct _GrlRegistryPrivate GrlRegistryPrivate;
@@ -187,6 +210,9 @@ GrlRegistry *grl_registry_get_default (void);
 void grl_registry_add_directory (GrlRegistry *registry,
                                  const gchar *path);
 
+void grl_registry_set_plugin_isolation (GrlRegistry *registry,
+                                        gboolean isolate);
+
 gboolean grl_registry_load_plugin (GrlRegistry *registry,
                                    const gchar *library_filename,
                                    GError **error);
@@ -269,6 +295,15 @@ gboolean grl_registry_add_config_from_file (GrlRegistry *registry,
                                             const gchar *config_file,
                                             GError **error);
 
+GrlSourceHealth grl_registry_get_source_health (GrlRegistry *registry,
+                                                GrlSource *source);
+
+gdouble grl_registry_get_source_error_rate (GrlRegistry *registry,
+                                            GrlSource *source);
+
+guint grl_registry_get_source_latency (GrlRegistry *registry,
+                                       GrlSource *source);
+
 G_END_DECLS
 
 #endif /* _GRL_REGISTRY_H_ */
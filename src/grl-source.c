@@ -40,13 +40,18 @@
 
 #include "grl-operation.h"
 #include "grl-operation-priv.h"
+#include "grl-operation-options-priv.h"
 #include "grl-marshal.h"
 #include "grl-type-builtins.h"
 #include "grl-sync-priv.h"
-#include "grl-registry.h"
+#include "grl-registry-priv.h"
 #include "grl-error.h"
 #include "grl-log.h"
+#include "grl-value-helper.h"
 #include "data/grl-media.h"
+#include "data/grl-media-audio.h"
+#include "data/grl-media-video.h"
+#include "data/grl-media-image.h"
 
 #include <glib/gi18n-lib.h>
 #include <string.h>
@@ -59,6 +64,39 @@ GRL_LOG_DOMAIN(source_log_domain);
                                GRL_TYPE_SOURCE,    \
                                GrlSourcePrivate))
 
+/* When post-filtering, first ask the source for this many times the
+   requested elements */
+#define POST_FILTER_OVERFETCH 2
+/* Extra elements to ask for on top of the observed filter ratio */
+#define POST_FILTER_MARGIN 1.25
+#define POST_FILTER_MAX_CHUNK 1024
+
+/* Resolution latencies kept per source to compute the hedging delay */
+#define RESOLVE_LATENCY_SAMPLES 32
+/* Do not hedge until there are this many samples */
+#define RESOLVE_HEDGE_MIN_SAMPLES 8
+/* Ask the next candidate when a source is slower than this percentage of
+   its previous resolutions */
+#define RESOLVE_HEDGE_PERCENTILE 95
+
+/* Results kept for the GIO-style API before pausing the operation, if the
+   user did not set a high water mark */
+#define RESULTS_ASYNC_HIGH_WATER_MARK 50
+
+/* Threads shared by all the sources to run their blocking work */
+#define THREAD_POOL_MAX_THREADS 4
+
+/* Results sent from a worker thread are handed out to the operation in
+   batches of this size, or this long (in ms) after the first result of the
+   batch, whichever comes first */
+#define THREAD_JOB_BATCH_SIZE 32
+#define THREAD_JOB_BATCH_INTERVAL 100
+
+/* Idles working for interactive operations go this much ahead of the
+   normal ones, and twice as much behind for background operations (so
+   G_PRIORITY_DEFAULT_IDLE becomes G_PRIORITY_LOW) */
+#define OPERATION_PRIORITY_SPREAD 50
+
 enum {
   PROP_0,
   PROP_ID,
@@ -67,7 +105,10 @@ enum {
   PROP_PLUGIN,
   PROP_RANK,
   PROP_AUTO_SPLIT_THRESHOLD,
-  PROP_SUPPORTED_MEDIA
+  PROP_SUPPORTED_MEDIA,
+  PROP_RESULT_CACHE_SIZE,
+  PROP_CHANGE_WINDOW,
+  PROP_CHANGE_MAX_BATCH
 };
 
 enum {
@@ -89,8 +130,36 @@ struct _GrlSourcePrivate {
   GrlMediaType supported_media;
   guint auto_split_threshold;
   GrlPlugin *plugin;
+  guint result_cache_size;
+  guint result_cache_generation;
+  GHashTable *result_cache;
+  GQueue *result_cache_lru;
+  guint change_window;
+  guint change_max_batch;
+  guint change_timeout_id;
+  GMainContext *change_context;
+  GHashTable *pending_changes;
+  GQueue *pending_changes_order;
+  gboolean pending_changes_overflow;
+  guint resolve_latencies[RESOLVE_LATENCY_SAMPLES];
+  guint resolve_latency_samples;
+  guint resolve_latency_next;
 };
 
+typedef struct {
+  gchar *id;
+  GrlMedia *media;
+  GrlSourceChangeType change_type;
+  gboolean location_unknown;
+} PendingChange;
+
+typedef struct {
+  gchar *signature;
+  GPtrArray *medias;
+  gint length;
+  GList *link;
+} ResultCacheEntry;
+
 typedef struct {
   GrlMedia *media;
   gboolean is_ready;
@@ -114,12 +183,50 @@ struct AutoSplitCtl {
   guint chunk_remaining;
 };
 
+struct PostFilterCtl {
+  GrlOperationOptions *filter;
+  guint skip;
+  gint count;
+  guint delivered;
+  guint matched;
+  guint received;
+  guint source_skip;
+  gint chunk_size;
+  guint chunk_received;
+  GrlMedia *held;
+  gboolean done;
+  gboolean stopped;
+  gboolean decorate;
+  GQueue *queue;
+  GrlKeyID sort_key;
+  GrlSortOrder sort_order;
+  GPtrArray *sorted;
+  guint sequence;
+};
+
+typedef struct {
+  GrlMedia *media;
+  guint sequence;
+} PostFilterSortItem;
+
+typedef struct {
+  GrlMedia *media;
+  gboolean is_ready;
+  guint remaining;
+  GError *error;
+  GError *decoration_error;
+} PostFilterElement;
+
 struct OperationState {
   GrlSource *source;
   guint operation_id;
-  gboolean cancelled;
+  volatile gint cancelled;
+  volatile gint paused;
   gboolean completed;
   gboolean started;
+  gint64 start_time;
+  struct BrowseRelayCb *browse_relay;
+  struct ResolveRelayCb *resolve_relay;
 };
 
 struct ResolveRelayCb {
@@ -133,15 +240,25 @@ struct ResolveRelayCb {
   gpointer user_data;
   GHashTable *map;
   GHashTable *resolve_specs;
+  GHashTable *attempts;
   GList *specs_to_invoke;
   gboolean cancel_invoked;
   GError *error;
+  GMainContext *context;
   union {
     GrlSourceResolveSpec *res;
     GrlSourceMediaFromUriSpec *mfu;
   } spec;
 };
 
+/* A resolve spec sent to a source */
+struct ResolveAttempt {
+  struct ResolveRelayCb *rrc;
+  GrlSource *source;
+  gint64 start_time;
+  guint hedge_id;
+};
+
 struct BrowseRelayCb {
   GrlSource *source;
   GrlSupportedOps operation_type;
@@ -157,7 +274,55 @@ struct BrowseRelayCb {
   } spec;
   GQueue *queue;
   gboolean dispatcher_running;
+  guint high_water_mark;
+  gboolean throttled;
+  gboolean chunk_pending;
+  guint chunk_skip;
+  gint chunk_count;
+  gint64 chunk_start;
   struct AutoSplitCtl *auto_split;
+  struct PostFilterCtl *post_filter;
+  struct OperationState *state;
+  gchar *cache_signature;
+  guint cache_generation;
+  guint cache_position;
+  guint cache_received;
+  gint cache_requested;
+  GList *cache_hits;
+  gboolean cache_tail;
+  gboolean cache_touched;
+};
+
+struct CountRelayCb {
+  GrlSource *source;
+  guint operation_id;
+  guint count;
+  gboolean estimate;
+  gboolean done;
+  GrlSourceCountSpec *spec;
+  GrlSourceCountCb user_callback;
+  gpointer user_data;
+};
+
+struct ResolveAsyncData {
+  GSimpleAsyncResult *result;
+  GCancellable *cancellable;
+  gulong cancel_id;
+  guint operation_id;
+};
+
+/* Results of a browse, search or query started with the GIO-style API,
+   waiting to be requested */
+struct ResultsAsyncData {
+  GrlSource *source;
+  guint operation_id;
+  GQueue *medias;
+  GError *error;
+  gboolean done;
+  guint high_water_mark;
+  GSimpleAsyncResult *pending;
+  GCancellable *cancellable;
+  gulong cancel_id;
 };
 
 struct RemoveRelayCb {
@@ -183,6 +348,34 @@ struct StoreMetadataRelayCb {
   GList *use_sources;
   GList *failed_keys;
   GList *specs;
+  GList *batch_specs;
+  GrlSourceStoreCb user_callback;
+  gpointer user_data;
+};
+
+struct StoreMetadataBatchItem {
+  GrlMedia *media;
+  GList *keys;
+  GList *failed_keys;
+  guint pending;
+};
+
+struct StoreMetadataRoute {
+  GHashTable *map;
+  GList *failed_keys;
+};
+
+struct StoreMetadataBatchRelayCb {
+  GrlSource *source;
+  GrlWriteFlags flags;
+  guint max_concurrent;
+  GQueue *queue;
+  GHashTable *in_flight;
+  GHashTable *routes;
+  GList *specs;
+  GList *batch_specs;
+  gboolean dispatching;
+  gboolean idle_scheduled;
   GrlSourceStoreCb user_callback;
   gpointer user_data;
 };
@@ -207,9 +400,15 @@ struct ResolveFullResolutionDoneCb {
 struct MediaDecorateData {
   GrlSource *source;
   guint operation_id;
+  GrlMedia *media;
+  GList *keys;
   GHashTable *pending_callbacks;
   MediaDecorateCb callback;
   gboolean cancelled;
+  GMainContext *context;
+  guint deadline_id;
+  gboolean expired;
+  gboolean delivered;
   gpointer user_data;
 };
 
@@ -254,6 +453,31 @@ static gboolean resolve_all_done (gpointer user_data);
 
 static void source_cancel_cb (struct OperationState *op_state);
 
+static void source_flow_cb (struct OperationState *op_state);
+
+static void browse_relay_flow_update (struct BrowseRelayCb *brc);
+
+static void result_cache_content_changed_cb (GrlSource *source,
+                                             GPtrArray *changed_medias,
+                                             GrlSourceChangeType change_type,
+                                             gboolean location_unknown,
+                                             gpointer user_data);
+
+static void result_cache_entry_free (ResultCacheEntry *entry);
+
+static guint pending_change_hash (gconstpointer key);
+
+static gboolean pending_change_equal (gconstpointer a,
+                                      gconstpointer b);
+
+static void pending_change_free (PendingChange *change);
+
+static void pending_changes_clear (GrlSource *source);
+
+/* Changes can be notified from any thread, so the pending changes are
+   protected by this lock */
+G_LOCK_DEFINE_STATIC (pending_changes);
+
 /* ================ GrlSource GObject ================ */
 
 G_DEFINE_ABSTRACT_TYPE (GrlSource,
@@ -387,6 +611,57 @@ grl_source_class_init (GrlSourceClass *source_class)
                                                        G_PARAM_READWRITE |
                                                        G_PARAM_CONSTRUCT |
                                                        G_PARAM_STATIC_STRINGS));
+  /**
+   * GrlSource:result-cache-size:
+   *
+   * Maximum number of different browse, search and query requests whose
+   * results are kept in a cache, so further requests with the same shape are
+   * served without invoking the source. Zero disables the cache.
+   *
+   * Since: 0.2.7
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_RESULT_CACHE_SIZE,
+                                   g_param_spec_uint ("result-cache-size",
+                                                      "Result cache size",
+                                                      "Number of requests whose results are cached",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  /**
+   * GrlSource:change-window:
+   *
+   * Time window, in milliseconds, during which changes notified by the source
+   * are coalesced before emitting #GrlSource::content-changed. Zero disables
+   * coalescing, so changes are emitted immediately.
+   *
+   * Since: 0.2.7
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_CHANGE_WINDOW,
+                                   g_param_spec_uint ("change-window",
+                                                      "Change window",
+                                                      "Time window to coalesce changes (ms)",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  /**
+   * GrlSource:change-max-batch:
+   *
+   * Maximum number of different medias that can be coalesced in a time
+   * window. If more medias change, a single change in the root box with
+   * location unknown is notified instead. Zero means no limit.
+   *
+   * Since: 0.2.7
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_CHANGE_MAX_BATCH,
+                                   g_param_spec_uint ("change-max-batch",
+                                                      "Change max batch",
+                                                      "Maximum number of coalesced changes",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
 
   /**
    * GrlSource::content-changed:
@@ -436,6 +711,17 @@ static void
 grl_source_init (GrlSource *source)
 {
   source->priv = GRL_SOURCE_GET_PRIVATE (source);
+  source->priv->result_cache =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           NULL, (GDestroyNotify) result_cache_entry_free);
+  source->priv->result_cache_lru = g_queue_new ();
+  source->priv->pending_changes =
+    g_hash_table_new_full (pending_change_hash, pending_change_equal,
+                           NULL, (GDestroyNotify) pending_change_free);
+  source->priv->pending_changes_order = g_queue_new ();
+
+  g_signal_connect (source, "content-changed",
+                    G_CALLBACK (result_cache_content_changed_cb), NULL);
 }
 
 static void
@@ -448,6 +734,11 @@ grl_source_dispose (GObject *object)
     source->priv->plugin = NULL;
   }
 
+  /* Pending changes are not notified any more */
+  G_LOCK (pending_changes);
+  pending_changes_clear (source);
+  G_UNLOCK (pending_changes);
+
   G_OBJECT_CLASS (grl_source_parent_class)->dispose (object);
 }
 
@@ -459,6 +750,10 @@ grl_source_finalize (GObject *object)
   g_free (source->priv->id);
   g_free (source->priv->name);
   g_free (source->priv->desc);
+  g_queue_free (source->priv->result_cache_lru);
+  g_hash_table_unref (source->priv->result_cache);
+  g_queue_free (source->priv->pending_changes_order);
+  g_hash_table_unref (source->priv->pending_changes);
 
   G_OBJECT_CLASS (grl_source_parent_class)->finalize (object);
 }
@@ -505,6 +800,19 @@ grl_source_set_property (GObject *object,
   case PROP_SUPPORTED_MEDIA:
     source->priv->supported_media = g_value_get_flags (value);
     break;
+  case PROP_RESULT_CACHE_SIZE:
+    grl_source_set_result_cache_size (source, g_value_get_uint (value));
+    break;
+  case PROP_CHANGE_WINDOW:
+    grl_source_set_change_coalescing (source,
+                                      g_value_get_uint (value),
+                                      source->priv->change_max_batch);
+    break;
+  case PROP_CHANGE_MAX_BATCH:
+    grl_source_set_change_coalescing (source,
+                                      source->priv->change_window,
+                                      g_value_get_uint (value));
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (source, prop_id, pspec);
     break;
@@ -543,6 +851,19 @@ grl_source_get_property (GObject *object,
   case PROP_SUPPORTED_MEDIA:
     g_value_set_flags (value, source->priv->supported_media);
     break;
+  case PROP_RESULT_CACHE_SIZE:
+    g_value_set_uint (value, source->priv->result_cache_size);
+    break;
+  case PROP_CHANGE_WINDOW:
+    G_LOCK (pending_changes);
+    g_value_set_uint (value, source->priv->change_window);
+    G_UNLOCK (pending_changes);
+    break;
+  case PROP_CHANGE_MAX_BATCH:
+    G_LOCK (pending_changes);
+    g_value_set_uint (value, source->priv->change_max_batch);
+    G_UNLOCK (pending_changes);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (source, prop_id, pspec);
     break;
@@ -551,9 +872,39 @@ grl_source_get_property (GObject *object,
 
 /* ================ Utilities ================ */
 
+/*
+ * Adjusts the priority of an idle working for an operation to the priority
+ * class of the operation.
+ */
+static gint
+operation_priority (GrlOperationOptions *options,
+                    gint priority)
+{
+  switch (grl_operation_options_get_priority (options)) {
+  case GRL_OPERATION_PRIORITY_INTERACTIVE:
+    return priority - OPERATION_PRIORITY_SPREAD;
+  case GRL_OPERATION_PRIORITY_BACKGROUND:
+    return priority + 2 * OPERATION_PRIORITY_SPREAD;
+  default:
+    return priority;
+  }
+}
+
+/* Priority of the idles relaying the results of an operation */
+static gint
+relay_idle_priority (GrlOperationOptions *options)
+{
+  return operation_priority (options,
+                             grl_operation_options_get_flags (options) & GRL_RESOLVE_IDLE_RELAY?
+                             G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE);
+}
+
 static void
 operation_state_free (struct OperationState *op_state)
 {
+  if (op_state->browse_relay) {
+    op_state->browse_relay->state = NULL;
+  }
   g_object_unref (op_state->source);
   g_free (op_state);
 }
@@ -889,7 +1240,7 @@ operation_set_cancelled (guint operation_id)
   op_state = grl_operation_get_private_data (operation_id);
 
   if (op_state) {
-    op_state->cancelled = TRUE;
+    g_atomic_int_set (&op_state->cancelled, TRUE);
   }
 }
 
@@ -906,7 +1257,7 @@ operation_is_cancelled (guint operation_id)
 
   op_state = grl_operation_get_private_data (operation_id);
 
-  return op_state && op_state->cancelled;
+  return op_state && g_atomic_int_get (&op_state->cancelled);
 }
 
 /*
@@ -925,11 +1276,155 @@ operation_set_ongoing (GrlSource *source, guint operation_id)
   op_state = g_new0 (struct OperationState, 1);
   op_state->source = g_object_ref (source);
   op_state->operation_id = operation_id;
+  op_state->start_time = g_get_monotonic_time ();
 
   grl_operation_set_private_data (operation_id,
                                   op_state,
                                   (GrlOperationCancelCb) source_cancel_cb,
                                   (GDestroyNotify) operation_state_free);
+  grl_operation_set_flow_control (operation_id,
+                                  (GrlOperationFlowCb) source_flow_cb,
+                                  (GrlOperationFlowCb) source_flow_cb);
+}
+
+/*
+ * operation_set_browse_relay:
+ *
+ * Links an ongoing browse, search or query operation with its relay, so it
+ * can be paused and resumed.
+ */
+static void
+operation_set_browse_relay (guint operation_id, struct BrowseRelayCb *brc)
+{
+  struct OperationState *op_state;
+
+  op_state = grl_operation_get_private_data (operation_id);
+
+  if (op_state) {
+    op_state->browse_relay = brc;
+    brc->state = op_state;
+  }
+}
+
+/*
+ * The state of a browse, search or query operation, checked for each result
+ * the source sends. They are read from the state linked to the relay, which
+ * is unlinked once the operation is finished, instead of looking the
+ * operation up every time.
+ */
+static gboolean
+browse_relay_is_cancelled (struct BrowseRelayCb *brc)
+{
+  return brc->state && g_atomic_int_get (&brc->state->cancelled);
+}
+
+static gboolean
+browse_relay_is_completed (struct BrowseRelayCb *brc)
+{
+  return !brc->state || brc->state->completed;
+}
+
+static gboolean
+browse_relay_is_paused (struct BrowseRelayCb *brc)
+{
+  return brc->state && g_atomic_int_get (&brc->state->paused);
+}
+
+/*
+ * operation_set_resolve_relay:
+ *
+ * Links an ongoing resolve operation with its relay, so cancelling it also
+ * cancels the requests to each source involved.
+ */
+static void
+operation_set_resolve_relay (guint operation_id, struct ResolveRelayCb *rrc)
+{
+  struct OperationState *op_state;
+
+  op_state = grl_operation_get_private_data (operation_id);
+
+  if (op_state) {
+    op_state->resolve_relay = rrc;
+  }
+}
+
+/*
+ * Whether @error tells the source failed, rather than the request being
+ * wrong, the media not existing or the operation being cancelled. Only
+ * failures count against the health of the source.
+ */
+static gboolean
+error_is_source_failure (const GError *error)
+{
+  if (!error) {
+    return FALSE;
+  }
+
+  if (error->domain != GRL_CORE_ERROR) {
+    return TRUE;
+  }
+
+  switch (error->code) {
+  case GRL_CORE_ERROR_SEARCH_NULL_UNSUPPORTED:
+  case GRL_CORE_ERROR_MEDIA_NOT_FOUND:
+  case GRL_CORE_ERROR_OPERATION_CANCELLED:
+  case GRL_CORE_ERROR_DEADLINE_EXCEEDED:
+    return FALSE;
+  default:
+    return TRUE;
+  }
+}
+
+/*
+ * operation_get_elapsed:
+ *
+ * Milliseconds since the operation was set as ongoing.
+ */
+static gint64
+operation_get_elapsed (guint operation_id)
+{
+  struct OperationState *op_state;
+
+  op_state = grl_operation_get_private_data (operation_id);
+
+  if (!op_state) {
+    return 0;
+  }
+
+  return (g_get_monotonic_time () - op_state->start_time) / 1000;
+}
+
+/*
+ * Cancels the requests sent to each source in a resolve operation. Only the
+ * operation identifiers are kept, as sources may answer right away.
+ */
+static void
+resolve_relay_cancel_specs (struct ResolveRelayCb *rrc)
+{
+  GrlSourceResolveSpec *rs;
+  GList *specs, *s;
+  GList *ids = NULL;
+
+  if (rrc->cancel_invoked || !rrc->resolve_specs) {
+    return;
+  }
+
+  rrc->cancel_invoked = TRUE;
+
+  specs = g_hash_table_get_values (rrc->resolve_specs);
+  for (s = specs; s; s = g_list_next (s)) {
+    rs = (GrlSourceResolveSpec *) s->data;
+    ids = g_list_prepend (ids, GUINT_TO_POINTER (rs->operation_id));
+  }
+  g_list_free (specs);
+
+  for (s = ids; s; s = g_list_next (s)) {
+    /* Sources not invoked yet are never set as ongoing */
+    if (grl_operation_get_private_data (GPOINTER_TO_UINT (s->data))) {
+      grl_operation_cancel (GPOINTER_TO_UINT (s->data));
+    }
+  }
+  g_list_free (ids);
 }
 
 /*
@@ -945,7 +1440,7 @@ operation_is_ongoing (guint operation_id)
 
   op_state = grl_operation_get_private_data (operation_id);
 
-  return op_state && !op_state->cancelled;
+  return op_state && !g_atomic_int_get (&op_state->cancelled);
 }
 
 static void
@@ -969,14 +1464,37 @@ source_cancel_cb (struct OperationState *op_state)
      signaling so) */
   operation_set_cancelled (op_state->operation_id);
 
+  /* A paused operation must go on to confirm the cancellation */
+  if (op_state->browse_relay) {
+    browse_relay_flow_update (op_state->browse_relay);
+  }
+
+  /* Resolution is split in requests to each source, with their own
+     identifiers */
+  if (op_state->resolve_relay) {
+    resolve_relay_cancel_specs (op_state->resolve_relay);
+  }
+
   /* If the source provides an implementation for operation cancellation,
-     let's use that to avoid further unnecessary processing in the plugin */
+     let's use that to avoid further unnecessary processing in the plugin.
+     Note the operation may be finished after this */
   if (GRL_SOURCE_GET_CLASS (source)->cancel) {
     GRL_SOURCE_GET_CLASS (source)->cancel (source,
                                            op_state->operation_id);
   }
 }
 
+static void
+source_flow_cb (struct OperationState *op_state)
+{
+  g_atomic_int_set (&op_state->paused,
+                    grl_operation_is_paused (op_state->operation_id));
+
+  if (op_state->browse_relay) {
+    browse_relay_flow_update (op_state->browse_relay);
+  }
+}
+
 static void
 cancel_resolve (gpointer source, gpointer operation_id, gpointer user_data)
 {
@@ -1054,6 +1572,14 @@ store_metadata_spec_free (GrlSourceStoreMetadataSpec *spec)
   g_free (spec);
 }
 
+static void
+store_metadata_batch_spec_free (GrlSourceStoreMetadataBatchSpec *spec)
+{
+  g_object_unref (spec->source);
+  g_list_free_full (spec->medias, g_object_unref);
+  g_free (spec);
+}
+
 static void
 resolve_relay_free (struct ResolveRelayCb *rrc)
 {
@@ -1065,6 +1591,7 @@ resolve_relay_free (struct ResolveRelayCb *rrc)
     g_object_unref (rrc->media);
   if (rrc->error)
     g_error_free (rrc->error);
+  g_main_context_unref (rrc->context);
   g_object_unref (rrc->options);
   g_list_free (rrc->keys);
 
@@ -1079,21 +1606,68 @@ resolve_relay_free (struct ResolveRelayCb *rrc)
   if (rrc->resolve_specs)
     g_hash_table_unref (rrc->resolve_specs);
 
+  if (rrc->attempts)
+    g_hash_table_unref (rrc->attempts);
+
   g_slice_free (struct ResolveRelayCb, rrc);
 }
 
+static void
+post_filter_sort_item_free (PostFilterSortItem *item)
+{
+  g_object_unref (item->media);
+  g_slice_free (PostFilterSortItem, item);
+}
+
+static void
+post_filter_element_free (PostFilterElement *element)
+{
+  if (element->media) {
+    g_object_unref (element->media);
+  }
+  if (element->error) {
+    g_error_free (element->error);
+  }
+  if (element->decoration_error) {
+    g_error_free (element->decoration_error);
+  }
+  g_slice_free (PostFilterElement, element);
+}
+
 static void
 browse_relay_free (struct BrowseRelayCb *brc)
 {
+  if (brc->state) {
+    brc->state->browse_relay = NULL;
+  }
   g_object_unref (brc->source);
   g_object_unref (brc->options);
   g_list_free (brc->keys);
   if (brc->auto_split) {
     g_slice_free (struct AutoSplitCtl, brc->auto_split);
   }
+  if (brc->post_filter) {
+    g_object_unref (brc->post_filter->filter);
+    if (brc->post_filter->held) {
+      g_object_unref (brc->post_filter->held);
+    }
+    if (brc->post_filter->sorted) {
+      g_ptr_array_foreach (brc->post_filter->sorted,
+                           (GFunc) post_filter_sort_item_free, NULL);
+      g_ptr_array_free (brc->post_filter->sorted, TRUE);
+    }
+    if (brc->post_filter->queue) {
+      g_queue_foreach (brc->post_filter->queue,
+                       (GFunc) post_filter_element_free, NULL);
+      g_queue_free (brc->post_filter->queue);
+    }
+    g_slice_free (struct PostFilterCtl, brc->post_filter);
+  }
   if (brc->queue) {
     g_queue_free (brc->queue);
   }
+  g_free (brc->cache_signature);
+  g_list_free_full (brc->cache_hits, g_object_unref);
   g_slice_free (struct BrowseRelayCb, brc);
 }
 
@@ -1126,6 +1700,9 @@ store_metadata_relay_free (struct StoreMetadataRelayCb *smrc)
   g_hash_table_unref (smrc->map);
   g_list_free (smrc->use_sources);
   g_list_foreach (smrc->specs, (GFunc) store_metadata_spec_free, NULL);
+  g_list_free (smrc->specs);
+  g_list_foreach (smrc->batch_specs, (GFunc) store_metadata_batch_spec_free, NULL);
+  g_list_free (smrc->batch_specs);
 
   g_slice_free (struct StoreMetadataRelayCb, smrc);
 }
@@ -1485,32 +2062,103 @@ map_sources_new (void)
                                 (GDestroyNotify) resolve_spec_free);
 }
 
+static void
+resolve_attempt_free (struct ResolveAttempt *attempt)
+{
+  if (attempt->hedge_id) {
+    grl_context_source_remove (attempt->rrc->context, attempt->hedge_id);
+  }
+  g_slice_free (struct ResolveAttempt, attempt);
+}
+
 /*
- * Given a (keys, [sources]) @map, builds a map of sources to
- * GrlSourceResolveSpec that can solve @key in @media.  Returns @FALSE if the
- * key can't be mapped (could be, for instance, that it detects a loop)
+ * Create a new (source, attempt) map
  */
-static gboolean
-map_sources_to_specs (GHashTable *specs,
-                      GHashTable *map,
-                      GrlMedia *media,
-                      GrlKeyID key,
-                      GrlOperationOptions *options,
-                      gpointer user_data)
+static GHashTable *
+map_attempts_new (void)
 {
-  GList *map_nodes;
-  MapNode *node;
-  GList *each_required_key;
-  GrlSourceResolveSpec *rs;
-  gboolean success;
+  return g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                NULL,
+                                (GDestroyNotify) resolve_attempt_free);
+}
 
-  /* Search the source candidate to solve the key */
-  map_nodes = g_hash_table_lookup (map, GRLKEYID_TO_POINTER (key));
-  while (map_nodes) {
-    node = (MapNode *) map_nodes->data;
-    if (node->being_queried) {
-      /* If it has required keys and it is marked as being queried, it means we
-         have enter in a loop */
+/* Sources can be used from several threads at once */
+G_LOCK_DEFINE_STATIC (resolve_latencies);
+
+static void
+resolve_latency_add (GrlSource *source, guint latency)
+{
+  GrlSourcePrivate *priv = source->priv;
+
+  G_LOCK (resolve_latencies);
+  priv->resolve_latencies[priv->resolve_latency_next] = latency;
+  priv->resolve_latency_next =
+    (priv->resolve_latency_next + 1) % RESOLVE_LATENCY_SAMPLES;
+  if (priv->resolve_latency_samples < RESOLVE_LATENCY_SAMPLES) {
+    priv->resolve_latency_samples++;
+  }
+  G_UNLOCK (resolve_latencies);
+}
+
+static gint
+compare_latencies (gconstpointer a,
+                   gconstpointer b,
+                   gpointer user_data)
+{
+  return *((const guint *) a) - *((const guint *) b);
+}
+
+/*
+ * Milliseconds to wait for @source before asking the next candidate for the
+ * same keys, or 0 if not known yet.
+ */
+static guint
+resolve_hedge_delay (GrlSource *source)
+{
+  GrlSourcePrivate *priv = source->priv;
+  guint latencies[RESOLVE_LATENCY_SAMPLES];
+  guint n;
+
+  G_LOCK (resolve_latencies);
+  n = priv->resolve_latency_samples;
+  memcpy (latencies, priv->resolve_latencies, n * sizeof (guint));
+  G_UNLOCK (resolve_latencies);
+
+  if (n < RESOLVE_HEDGE_MIN_SAMPLES) {
+    return 0;
+  }
+
+  g_qsort_with_data (latencies, n, sizeof (guint), compare_latencies, NULL);
+
+  return MAX (latencies[(n * RESOLVE_HEDGE_PERCENTILE - 1) / 100], 1);
+}
+
+/*
+ * Given a (keys, [sources]) @map, builds a map of sources to
+ * GrlSourceResolveSpec that can solve @key in @media.  Returns @FALSE if the
+ * key can't be mapped (could be, for instance, that it detects a loop)
+ */
+static gboolean
+map_sources_to_specs (GHashTable *specs,
+                      GHashTable *map,
+                      GrlMedia *media,
+                      GrlKeyID key,
+                      GrlOperationOptions *options,
+                      gpointer user_data)
+{
+  GList *map_nodes;
+  MapNode *node;
+  GList *each_required_key;
+  GrlSourceResolveSpec *rs;
+  gboolean success;
+
+  /* Search the source candidate to solve the key */
+  map_nodes = g_hash_table_lookup (map, GRLKEYID_TO_POINTER (key));
+  while (map_nodes) {
+    node = (MapNode *) map_nodes->data;
+    if (node->being_queried) {
+      /* If it has required keys and it is marked as being queried, it means we
+         have enter in a loop */
       return (node->required_keys == NULL);
     }
     /* Check if it has any dependency */
@@ -1675,6 +2323,150 @@ map_update_unknown_key (GHashTable *map, GrlKeyID key, GrlSource *source)
   }
 }
 
+/*
+ * Checks if any source is currently resolving @key.
+ */
+static gboolean
+map_key_is_queried (GHashTable *map, GrlKeyID key)
+{
+  GList *each_node;
+
+  for (each_node = g_hash_table_lookup (map, GRLKEYID_TO_POINTER (key));
+       each_node;
+       each_node = g_list_next (each_node)) {
+    if (((MapNode *) each_node->data)->being_queried) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*
+ * Adds to @media the keys @other has and @media has not.
+ */
+static void
+media_merge_missing_keys (GrlMedia *media,
+                          GrlMedia *other)
+{
+  GList *keys, *key;
+  GrlKeyID key_id;
+  guint i, length;
+
+  keys = grl_data_get_keys (GRL_DATA (other));
+  for (key = keys; key; key = g_list_next (key)) {
+    key_id = GRLPOINTER_TO_KEYID (key->data);
+    if (grl_data_has_key (GRL_DATA (media), key_id)) {
+      continue;
+    }
+    length = grl_data_length (GRL_DATA (other), key_id);
+    for (i = 0; i < length; i++) {
+      grl_data_add_related_keys (GRL_DATA (media),
+                                 grl_related_keys_dup (grl_data_get_related_keys (GRL_DATA (other),
+                                                                                  key_id,
+                                                                                  i)));
+    }
+  }
+  g_list_free (keys);
+}
+
+/*
+ * Copy of @media for a source that could race with others to resolve the same
+ * keys, so only the answer of the first one is kept.
+ */
+static GrlMedia *
+resolve_scratch_media_new (GrlMedia *media)
+{
+  GrlMedia *scratch;
+
+  scratch = g_object_new (G_OBJECT_TYPE (media), NULL);
+  media_merge_missing_keys (scratch, media);
+
+  return scratch;
+}
+
+/*
+ * Asks @key to the next candidate in @map without waiting for the current
+ * round to finish. Only candidates not depending on other keys, and not
+ * busy with another spec of this operation, are considered; the others are
+ * left for the next round. Returns %TRUE if a candidate was found.
+ */
+static gboolean
+resolve_relay_try_next (struct ResolveRelayCb *rrc, GrlKeyID key)
+{
+  GList *each_node;
+  MapNode *node;
+  GrlSourceResolveSpec *rs;
+
+  for (each_node = g_hash_table_lookup (rrc->map, GRLKEYID_TO_POINTER (key));
+       each_node;
+       each_node = g_list_next (each_node)) {
+    node = (MapNode *) each_node->data;
+    if (node->being_queried ||
+        node->required_keys ||
+        g_hash_table_lookup (rrc->resolve_specs, node->source)) {
+      continue;
+    }
+
+    GRL_DEBUG ("asking %s to '%s'",
+               GRL_METADATA_KEY_GET_NAME (key),
+               grl_source_get_id (node->source));
+
+    rs = g_new (GrlSourceResolveSpec, 1);
+    rs->source = g_object_ref (node->source);
+    rs->media = resolve_scratch_media_new (rrc->media);
+    rs->operation_id = grl_operation_generate_id ();
+    rs->keys = g_list_prepend (NULL, GRLKEYID_TO_POINTER (key));
+    rs->options = g_object_ref (rrc->options);
+    rs->callback = resolve_result_relay_cb;
+    rs->user_data = rrc;
+    g_hash_table_insert (rrc->resolve_specs, g_object_ref (node->source), rs);
+    node->being_queried = TRUE;
+
+    if (!rrc->specs_to_invoke) {
+      grl_context_idle_add (rrc->context,
+                            relay_idle_priority (rrc->options),
+                            resolve_idle,
+                            rrc);
+    }
+    rrc->specs_to_invoke = g_list_append (rrc->specs_to_invoke, rs);
+
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/*
+ * The source has not answered in the usual time: ask the next candidate for
+ * its keys, keeping the first answer that comes.
+ */
+static gboolean
+resolve_hedge_cb (gpointer user_data)
+{
+  struct ResolveAttempt *attempt = (struct ResolveAttempt *) user_data;
+  struct ResolveRelayCb *rrc = attempt->rrc;
+  GrlSourceResolveSpec *rs;
+  GList *key;
+
+  attempt->hedge_id = 0;
+
+  rs = g_hash_table_lookup (rrc->resolve_specs, attempt->source);
+  if (!rs || operation_is_cancelled (rrc->operation_id)) {
+    return FALSE;
+  }
+
+  GRL_DEBUG ("'%s' is late resolving", grl_source_get_id (attempt->source));
+
+  for (key = rs->keys; key; key = g_list_next (key)) {
+    if (g_list_find (rrc->keys, key->data)) {
+      resolve_relay_try_next (rrc, GRLPOINTER_TO_KEYID (key->data));
+    }
+  }
+
+  return FALSE;
+}
+
 static void
 send_decorated_media (GrlMedia *media,
                       gpointer user_data,
@@ -1682,11 +2474,121 @@ send_decorated_media (GrlMedia *media,
 {
   struct ResolveRelayCb *mrc = (struct ResolveRelayCb *) user_data;
 
-  mrc->user_callback (mrc->spec.res->source, mrc->spec.res->operation_id,
+  /* The spec was already freed */
+  mrc->user_callback (mrc->source, mrc->operation_id,
                       media, mrc->user_data, error);
+  operation_set_finished (mrc->operation_id);
   resolve_relay_free (mrc);
 }
 
+static void
+media_decorate_free (struct MediaDecorateData *mdd)
+{
+  if (mdd->deadline_id) {
+    grl_context_source_remove (mdd->context, mdd->deadline_id);
+  }
+  g_main_context_unref (mdd->context);
+  g_object_unref (mdd->source);
+  g_object_unref (mdd->media);
+  g_list_free (mdd->keys);
+  g_hash_table_unref (mdd->pending_callbacks);
+  g_slice_free (struct MediaDecorateData, mdd);
+}
+
+/*
+ * Sends the decorated media. If @expired, the keys not resolved yet are
+ * reported in a non-fatal error.
+ */
+static void
+media_decorate_send (struct MediaDecorateData *mdd,
+                     gboolean expired)
+{
+  GError *_error = NULL;
+  GList *missing_keys;
+  GList *k;
+  GString *names;
+
+  if (mdd->cancelled) {
+    _error = g_error_new (GRL_CORE_ERROR,
+                          GRL_CORE_ERROR_OPERATION_CANCELLED,
+                          _("Operation was cancelled"));
+  } else if (expired) {
+    missing_keys = g_list_reverse (filter_known_keys (mdd->media, mdd->keys));
+    if (missing_keys) {
+      names = g_string_new ("");
+      for (k = missing_keys; k; k = g_list_next (k)) {
+        if (names->len > 0) {
+          g_string_append (names, ", ");
+        }
+        g_string_append (names,
+                         GRL_METADATA_KEY_GET_NAME (GRLPOINTER_TO_KEYID (k->data)));
+      }
+      _error = g_error_new (GRL_CORE_ERROR,
+                            GRL_CORE_ERROR_DEADLINE_EXCEEDED,
+                            _("Deadline expired before resolving: %s"),
+                            names->str);
+      g_string_free (names, TRUE);
+      g_list_free (missing_keys);
+    }
+  }
+
+  mdd->delivered = TRUE;
+  mdd->callback (mdd->media, mdd->user_data, _error);
+  if (_error) {
+    g_error_free (_error);
+  }
+}
+
+static gboolean
+media_decorate_deadline_cb (gpointer user_data)
+{
+  struct MediaDecorateData *mdd = (struct MediaDecorateData *) user_data;
+  GList *pending, *p;
+
+  GRL_DEBUG ("%s: decoration of operation %u expired",
+             __FUNCTION__, mdd->operation_id);
+
+  mdd->deadline_id = 0;
+  mdd->expired = TRUE;
+
+  /* Keep the identifiers only, as the sources may answer as soon as they are
+     cancelled, and @mdd is freed with the last answer */
+  pending = g_hash_table_get_values (mdd->pending_callbacks);
+  media_decorate_send (mdd, TRUE);
+  for (p = pending; p; p = g_list_next (p)) {
+    grl_operation_cancel (GPOINTER_TO_UINT (p->data));
+  }
+  g_list_free (pending);
+
+  return FALSE;
+}
+
+/*
+ * Milliseconds left to decorate a media in @operation_id: 0 if the deadline
+ * expired already, -1 if there is no deadline.
+ */
+static gint
+media_decorate_time_left (guint operation_id,
+                          GrlOperationOptions *options)
+{
+  guint deadline;
+  gint left = -1;
+
+  deadline = grl_operation_options_get_decoration_deadline (options);
+  if (deadline > 0) {
+    left = deadline;
+  }
+
+  deadline = grl_operation_options_get_deadline (options);
+  if (deadline > 0) {
+    deadline = MAX ((gint64) deadline - operation_get_elapsed (operation_id),
+                    0);
+    left = left < 0? (gint) deadline: MIN (left, (gint) deadline);
+  }
+
+  return left;
+}
+
 static void
 media_decorate_cb (GrlSource *source,
                    guint operation_id,
@@ -1695,13 +2597,21 @@ media_decorate_cb (GrlSource *source,
                    const GError *error)
 {
   struct MediaDecorateData *mdd = (struct MediaDecorateData *) user_data;
-  GError *_error = NULL;
   GRL_DEBUG (__FUNCTION__);
 
   if (operation_id > 0) {
     g_hash_table_remove (mdd->pending_callbacks, source);
   }
 
+  /* The deadline expired and the media was sent already: just wait for the
+     cancelled operations */
+  if (mdd->delivered) {
+    if (g_hash_table_size (mdd->pending_callbacks) == 0) {
+      media_decorate_free (mdd);
+    }
+    return;
+  }
+
   /* Check if pending resolutions must be cancelled */
   if (!mdd->cancelled &&
       operation_is_cancelled (mdd->operation_id)) {
@@ -1711,18 +2621,8 @@ media_decorate_cb (GrlSource *source,
 
   /* If all operations are complete, send the element */
   if (g_hash_table_size (mdd->pending_callbacks) == 0) {
-    if (mdd->cancelled) {
-      _error = g_error_new (GRL_CORE_ERROR,
-                            GRL_CORE_ERROR_OPERATION_CANCELLED,
-                            _("Operation was cancelled"));
-    }
-    mdd->callback (media, mdd->user_data, _error);
-    if (_error) {
-      g_error_free (_error);
-    }
-    g_object_unref (mdd->source);
-    g_hash_table_unref (mdd->pending_callbacks);
-    g_slice_free (struct MediaDecorateData, mdd);
+    media_decorate_send (mdd, mdd->expired);
+    media_decorate_free (mdd);
   }
 }
 
@@ -1741,6 +2641,7 @@ media_decorate (GrlSource *main_source,
   GrlOperationOptions *decorate_options;
   GrlOperationOptions *supported_options;
   GrlResolutionFlags flags;
+  gint time_left;
 
   flags = grl_operation_options_get_flags (options);
   if (flags & GRL_RESOLVE_FULL) {
@@ -1757,10 +2658,23 @@ media_decorate (GrlSource *main_source,
   mdd = g_slice_new (struct MediaDecorateData);
   mdd->source = g_object_ref (main_source);
   mdd->operation_id = main_operation_id;
+  mdd->context = grl_operation_ref_context (main_operation_id);
+  mdd->media = g_object_ref (media);
+  mdd->keys = g_list_copy (keys);
   mdd->callback = callback;
   mdd->user_data = user_data;
   mdd->pending_callbacks = g_hash_table_new (g_direct_hash, g_direct_equal);
   mdd->cancelled = FALSE;
+  mdd->deadline_id = 0;
+  mdd->delivered = FALSE;
+
+  /* Do not even ask if the operation is already out of time */
+  time_left = media_decorate_time_left (main_operation_id, options);
+  mdd->expired = (time_left == 0);
+  if (mdd->expired) {
+    g_list_free (sources);
+    sources = NULL;
+  }
 
   for (s = sources; s; s = g_list_next (s)) {
     if (grl_source_supported_operations (s->data) & GRL_OP_RESOLVE) {
@@ -1772,6 +2686,7 @@ media_decorate (GrlSource *main_source,
                                          media_decorate_cb, mdd);
       g_object_unref (supported_options);
       if (operation_id > 0) {
+        grl_operation_set_parent (operation_id, main_operation_id);
         g_hash_table_insert (mdd->pending_callbacks,
                              s->data,
                              GUINT_TO_POINTER (operation_id));
@@ -1782,6 +2697,10 @@ media_decorate (GrlSource *main_source,
   /* Check if nobody can solve the keys */
   if (g_hash_table_size (mdd->pending_callbacks) == 0) {
     media_decorate_cb (NULL, 0, media, mdd, NULL);
+  } else if (time_left > 0) {
+    mdd->deadline_id = grl_context_timeout_add (mdd->context, time_left,
+                                                media_decorate_deadline_cb,
+                                                mdd);
   }
 
   g_object_unref (decorate_options);
@@ -1841,17 +2760,6 @@ media_from_uri_result_relay_cb (GrlSource *source,
   resolve_relay_free (rrc);
 }
 
-static void
-cancel_resolve_spec (GrlSource *source, GrlSourceResolveSpec *spec)
-{
-  struct OperationState *op_state;
-
-  op_state = grl_operation_get_private_data (spec->operation_id);
-  if (op_state) {
-    source_cancel_cb (op_state);
-  }
-}
-
 static void
 resolve_result_relay_cb (GrlSource *source,
                          guint operation_id,
@@ -1860,17 +2768,53 @@ resolve_result_relay_cb (GrlSource *source,
                          const GError *error)
 {
   struct ResolveRelayCb *rrc = (struct ResolveRelayCb *) user_data;
+  struct ResolveAttempt *attempt;
+  GrlSourceResolveSpec *rs;
   GList *each_key;
   GList *delete_key;
+  GList *spec_keys = NULL;
+  GList *losers = NULL;
+  guint latency = 0;
+  GList *specs;
+  GList *s;
 
   GRL_DEBUG (__FUNCTION__);
 
+  rs = g_hash_table_lookup (rrc->resolve_specs, source);
+  if (!rs || rs->operation_id != operation_id) {
+    rs = NULL;
+  }
+
+  /* Cancelled attempts, like the ones losing a race, are recorded too, as
+     leaving them out would make the source look faster than it is */
+  attempt = rs? g_hash_table_lookup (rrc->attempts, source): NULL;
+  if (attempt) {
+    latency = (g_get_monotonic_time () - attempt->start_time) / 1000;
+    resolve_latency_add (source, latency);
+  }
+
   if (!operation_is_cancelled (operation_id)) {
+    if (rs) {
+      spec_keys = g_list_copy (rs->keys);
+      if (attempt) {
+        grl_registry_report_source_result (grl_registry_get_default (),
+                                           source,
+                                           latency,
+                                           error_is_source_failure (error));
+      }
+
+      /* Sources that could race with others got their own copy: keep what
+         they found that no other source found before */
+      if (media && media != rrc->media) {
+        media_merge_missing_keys (rrc->media, media);
+      }
+    }
+
     /* Check which keys are now known */
     each_key = rrc->keys;
     while (each_key) {
-      if (grl_data_has_key (GRL_DATA (media), GRLPOINTER_TO_KEYID (each_key->data))) {
-        map_update_known_key (rrc->map, GRLPOINTER_TO_KEYID (each_key->data), media);
+      if (grl_data_has_key (GRL_DATA (rrc->media), GRLPOINTER_TO_KEYID (each_key->data))) {
+        map_update_known_key (rrc->map, GRLPOINTER_TO_KEYID (each_key->data), rrc->media);
         delete_key = each_key;
         each_key = g_list_next (each_key);
         rrc->keys = g_list_delete_link (rrc->keys, delete_key);
@@ -1879,17 +2823,41 @@ resolve_result_relay_cb (GrlSource *source,
         each_key = g_list_next (each_key);
       }
     }
+  }
 
+  /* The source answered, even if cancelled */
+  if (rs) {
     g_hash_table_remove (rrc->resolve_specs, source);
+    g_hash_table_remove (rrc->attempts, source);
   }
 
   operation_set_finished (operation_id);
 
-  if (operation_is_cancelled (rrc->operation_id) &&
-      !rrc->cancel_invoked) {
-    rrc->cancel_invoked = TRUE;
-    g_hash_table_foreach (rrc->resolve_specs, (GHFunc) cancel_resolve_spec, NULL);
+  if (operation_is_cancelled (rrc->operation_id)) {
+    resolve_relay_cancel_specs (rrc);
+  } else {
+    /* Keys the source failed to resolve go straight to the next candidate,
+       unless another one is already on them */
+    for (each_key = spec_keys; each_key; each_key = g_list_next (each_key)) {
+      if (g_list_find (rrc->keys, each_key->data) &&
+          !map_key_is_queried (rrc->map, GRLPOINTER_TO_KEYID (each_key->data))) {
+        resolve_relay_try_next (rrc, GRLPOINTER_TO_KEYID (each_key->data));
+      }
+    }
+
+    /* Sources still working on keys that are known now lost the race */
+    specs = g_hash_table_get_values (rrc->resolve_specs);
+    for (s = specs; s; s = g_list_next (s)) {
+      rs = (GrlSourceResolveSpec *) s->data;
+      if (rs->source != rrc->source &&
+          !missing_in_data (GRL_DATA (rrc->media), rs->keys) &&
+          g_hash_table_lookup (rrc->attempts, rs->source)) {
+        losers = g_list_prepend (losers, GUINT_TO_POINTER (rs->operation_id));
+      }
+    }
+    g_list_free (specs);
   }
+  g_list_free (spec_keys);
 
   if (error && source == rrc->source && !rrc->error) {
     /* Save error for further sending */
@@ -1901,7 +2869,7 @@ resolve_result_relay_cb (GrlSource *source,
     if (!operation_is_cancelled (rrc->operation_id)) {
       each_key = rrc->keys;
       while (each_key) {
-        if (map_sources_to_specs (rrc->resolve_specs, rrc->map, media,
+        if (map_sources_to_specs (rrc->resolve_specs, rrc->map, rrc->media,
                                   GRLPOINTER_TO_KEYID (each_key->data),
                                   rrc->options, rrc)) {
           each_key = g_list_next (each_key);
@@ -1916,19 +2884,26 @@ resolve_result_relay_cb (GrlSource *source,
 
     rrc->specs_to_invoke = g_hash_table_get_values (rrc->resolve_specs);
     if (rrc->specs_to_invoke) {
-      g_idle_add_full (grl_operation_options_get_flags (rrc->options) & GRL_RESOLVE_IDLE_RELAY?
-                       G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                       resolve_idle,
-                       rrc,
-                       NULL);
+      grl_context_idle_add (rrc->context,
+                            relay_idle_priority (rrc->options),
+                            resolve_idle,
+                            rrc);
     } else {
-      g_idle_add_full (grl_operation_options_get_flags (rrc->options) & GRL_RESOLVE_IDLE_RELAY?
-                       G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                       resolve_all_done,
-                       rrc,
-                       NULL);
+      grl_context_idle_add (rrc->context,
+                            relay_idle_priority (rrc->options),
+                            resolve_all_done,
+                            rrc);
+    }
+  }
+
+  /* Done last, as sources may answer right away; @rrc must not be used after
+     this */
+  for (s = losers; s; s = g_list_next (s)) {
+    if (grl_operation_get_private_data (GPOINTER_TO_UINT (s->data))) {
+      grl_operation_cancel (GPOINTER_TO_UINT (s->data));
     }
   }
+  g_list_free (losers);
 }
 
 static gboolean
@@ -1940,7 +2915,7 @@ queue_process (gpointer user_data)
   struct BrowseRelayCb *brc = (struct BrowseRelayCb *) user_data;
 
   /* Check if operation is cancelled */
-  if (operation_is_cancelled (brc->operation_id)) {
+  if (browse_relay_is_cancelled (brc)) {
     /* This is how this works: if operation is cancelled, no one will add more
        elements to queue. If one with remaining=0 is found, means that the
        browse/search/query operation finished before operation is cancelled. So we
@@ -1964,7 +2939,10 @@ queue_process (gpointer user_data)
       }
       g_free (qelement);
     }
-    if (g_queue_is_empty (brc->queue)) {
+    /* If the source did not send the last element yet, the relay will
+       confirm the cancellation and free the operation */
+    if (g_queue_is_empty (brc->queue) &&
+        browse_relay_is_completed (brc)) {
       operation_set_finished (brc->operation_id);
       browse_relay_free (brc);
       return FALSE;
@@ -1973,6 +2951,12 @@ queue_process (gpointer user_data)
     return FALSE;
   }
 
+  /* Wait for the user to resume the operation */
+  if (browse_relay_is_paused (brc)) {
+    brc->dispatcher_running = FALSE;
+    return FALSE;
+  }
+
   /* Send the last element */
   qelement = (QueueElement *) g_queue_pop_head (brc->queue);
   remaining = qelement->remaining;
@@ -1989,9 +2973,14 @@ queue_process (gpointer user_data)
     return FALSE;
   }
 
+  /* Room was made in the queue */
+  browse_relay_flow_update (brc);
+
   /* Check if should keep running */
   qelement = (QueueElement *) g_queue_peek_head (brc->queue);
-  brc->dispatcher_running = qelement && qelement->is_ready;
+  brc->dispatcher_running = qelement && qelement->is_ready &&
+    (!browse_relay_is_paused (brc) ||
+     browse_relay_is_cancelled (brc));
 
   return brc->dispatcher_running;
 }
@@ -2001,10 +2990,16 @@ queue_start_process (struct BrowseRelayCb *brc)
 {
   QueueElement *qelement;
 
-  if (!brc->dispatcher_running) {
+  if (!brc->dispatcher_running &&
+      (!browse_relay_is_paused (brc) ||
+       browse_relay_is_cancelled (brc))) {
     qelement = g_queue_peek_head (brc->queue);
     if (qelement && qelement->is_ready) {
-      g_idle_add (queue_process,  brc);
+      grl_operation_idle_add (brc->operation_id,
+                              operation_priority (brc->options,
+                                                  G_PRIORITY_DEFAULT_IDLE),
+                              queue_process,
+                              brc);
       brc->dispatcher_running = TRUE;
     }
   }
@@ -2036,6 +3031,14 @@ media_ready_cb (GrlMedia *media,
 
   qelement = (QueueElement *) element->data;
   qelement->is_ready = TRUE;
+
+  /* Keep errors about the decoration, like an expired deadline */
+  if (error && !qelement->error &&
+      !g_error_matches (error, GRL_CORE_ERROR,
+                        GRL_CORE_ERROR_OPERATION_CANCELLED)) {
+    qelement->error = g_error_copy (error);
+  }
+
   queue_start_process (brc);
 }
 
@@ -2056,9 +3059,11 @@ queue_add_media (struct BrowseRelayCb *brc,
   qelement = g_new (QueueElement, 1);
   qelement->media = media;
   qelement->remaining = remaining;
-  /* Media is ready if we do not need to ask other sources to complete it */
+  /* Media is ready if we do not need to ask other sources to complete it;
+     elements filtered by the core were decorated already */
   qelement->is_ready = TRUE;
-  if (grl_operation_options_get_flags (brc->options) & GRL_RESOLVE_FULL) {
+  if (grl_operation_options_get_flags (brc->options) & GRL_RESOLVE_FULL &&
+      !(brc->post_filter && brc->post_filter->decorate)) {
     unknown_keys = filter_known_keys (media, brc->keys);
     if (unknown_keys) {
       qelement->is_ready = FALSE;
@@ -2076,118 +3081,631 @@ queue_add_media (struct BrowseRelayCb *brc,
                     brc->options, media_ready_cb, brc);
   }
 
-  queue_start_process (brc);
+  browse_relay_flow_update (brc);
 }
 
-static struct AutoSplitCtl *
-auto_split_setup (GrlSource *source,
-                  GrlOperationOptions *options)
+static GrlOperationOptions *
+browse_relay_spec_options (struct BrowseRelayCb *brc)
 {
-  struct AutoSplitCtl *as_ctl = NULL;
-  gint count = grl_operation_options_get_count (options);
-
-  if (source->priv->auto_split_threshold > 0 &&
-      count > source->priv->auto_split_threshold) {
-    GRL_DEBUG ("auto-split: enabled");
-
-    as_ctl = g_slice_new (struct AutoSplitCtl);
-    as_ctl->threshold = source->priv->auto_split_threshold;
-    as_ctl->total_remaining = count;
-    as_ctl->chunk_remaining = as_ctl->threshold;
-    count = as_ctl->chunk_remaining;
-    grl_operation_options_set_count (options, count);
-    GRL_DEBUG ("auto-split: requesting chunk (skip=%u, count=%u)",
-               grl_operation_options_get_skip (options),
-               count);
+  switch (brc->operation_type) {
+  case GRL_OP_BROWSE:
+    return brc->spec.browse->options;
+  case GRL_OP_SEARCH:
+    return brc->spec.search->options;
+  case GRL_OP_QUERY:
+    return brc->spec.query->options;
+  default:
+    g_assert_not_reached ();
+    return NULL;
   }
-
-  return as_ctl;
 }
 
 static void
-auto_split_run_next_chunk (struct BrowseRelayCb *brc)
+browse_relay_run_chunk (struct BrowseRelayCb *brc,
+                        guint skip,
+                        gint count)
 {
-  brc->auto_split->chunk_remaining = MIN (brc->auto_split->threshold,
-                                          brc->auto_split->total_remaining);
+  GrlOperationOptions *spec_options = browse_relay_spec_options (brc);
+  GSourceFunc idle_func;
+  gpointer spec;
+
+  /* Too many elements are waiting to be sent: ask for more later */
+  if (brc->throttled) {
+    GRL_DEBUG ("flow-control: delaying chunk (skip=%u, count=%d)",
+               skip, count);
+    brc->chunk_pending = TRUE;
+    brc->chunk_skip = skip;
+    brc->chunk_count = count;
+    return;
+  }
+
+  grl_operation_options_set_skip (spec_options, skip);
+  grl_operation_options_set_count (spec_options, count);
+  GRL_DEBUG ("requesting chunk (skip=%u, count=%d)", skip, count);
 
   switch (brc->operation_type) {
   case GRL_OP_BROWSE:
-    grl_operation_options_set_skip (brc->spec.browse->options,
-                                    grl_operation_options_get_skip (brc->spec.browse->options) +
-                                    brc->auto_split->threshold);
-    grl_operation_options_set_count (brc->spec.browse->options,
-                                     brc->auto_split->chunk_remaining);
-    GRL_DEBUG ("auto-split: requesting chunk (skip=%u, count=%u)",
-               grl_operation_options_get_skip (brc->spec.browse->options),
-               grl_operation_options_get_count (brc->spec.browse->options));
-    g_idle_add_full (grl_operation_options_get_flags (brc->options) & GRL_RESOLVE_IDLE_RELAY?
-                     G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                     browse_idle,
-                     brc->spec.browse,
-                     NULL);
+    idle_func = browse_idle;
+    spec = brc->spec.browse;
     break;
   case GRL_OP_SEARCH:
-    grl_operation_options_set_skip (brc->spec.search->options,
-                                    grl_operation_options_get_skip (brc->spec.search->options) +
-                                    brc->auto_split->threshold);
-    grl_operation_options_set_count (brc->spec.search->options,
-                                     brc->auto_split->chunk_remaining);
-    GRL_DEBUG ("auto-split: requesting chunk (skip=%u, count=%u)",
-               grl_operation_options_get_skip (brc->spec.search->options),
-               grl_operation_options_get_count (brc->spec.search->options));
-    g_idle_add_full (grl_operation_options_get_flags (brc->options) & GRL_RESOLVE_IDLE_RELAY?
-                     G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                     search_idle,
-                     brc->spec.search,
-                     NULL);
+    idle_func = search_idle;
+    spec = brc->spec.search;
     break;
   case GRL_OP_QUERY:
-    grl_operation_options_set_skip (brc->spec.query->options,
-                                    grl_operation_options_get_skip (brc->spec.query->options) +
-                                    brc->auto_split->threshold);
-    grl_operation_options_set_count (brc->spec.query->options,
-                                     brc->auto_split->chunk_remaining);
-    GRL_DEBUG ("auto-split: requesting chunk (skip=%u, count=%u)",
-               grl_operation_options_get_skip (brc->spec.query->options),
-               grl_operation_options_get_count (brc->spec.query->options));
-    g_idle_add_full (grl_operation_options_get_flags (brc->options) & GRL_RESOLVE_IDLE_RELAY?
-                     G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                     query_idle,
-                     brc->spec.query,
-                     NULL);
+    idle_func = query_idle;
+    spec = brc->spec.query;
     break;
   default:
     g_assert_not_reached ();
-    break;
+    return;
   }
+
+  grl_operation_idle_add (brc->operation_id,
+                          relay_idle_priority (brc->options),
+                          idle_func,
+                          spec);
 }
 
-static void
-browse_result_relay_cb (GrlSource *source,
-                        guint operation_id,
-                        GrlMedia *media,
-                        guint remaining,
-                        gpointer user_data,
-                        const GError *error)
+/*
+ * Stops or restarts the flow of elements from the source, depending on
+ * whether the operation is paused or the elements waiting to be sent reached
+ * the high water mark. Once throttled, the flow restarts when half of them
+ * have been sent.
+ */
+static void
+browse_relay_flow_update (struct BrowseRelayCb *brc)
 {
-  GError *_error;
-  struct BrowseRelayCb *brc = (struct BrowseRelayCb *) user_data;
+  GrlSourceClass *source_class = GRL_SOURCE_GET_CLASS (brc->source);
+  gboolean paused = browse_relay_is_paused (brc);
+  gboolean cancelled = browse_relay_is_cancelled (brc);
+  gboolean notify_source;
+  guint waiting;
+
+  waiting = brc->queue? g_queue_get_length (brc->queue): 0;
+  if (brc->post_filter && brc->post_filter->queue) {
+    waiting += g_queue_get_length (brc->post_filter->queue);
+  }
 
-  GRL_DEBUG (__FUNCTION__);
+  /* The source is only running while no chunk is pending */
+  notify_source = !cancelled &&
+    !brc->chunk_pending &&
+    !browse_relay_is_completed (brc);
+
+  if (!brc->throttled) {
+    if (!cancelled &&
+        (paused ||
+         (brc->high_water_mark > 0 && waiting >= brc->high_water_mark))) {
+      GRL_DEBUG ("flow-control: throttling operation %u (%u waiting)",
+                 brc->operation_id, waiting);
+      brc->throttled = TRUE;
+      if (notify_source && source_class->pause) {
+        source_class->pause (brc->source, brc->operation_id);
+      }
+    }
+  } else if (cancelled ||
+             (!paused && waiting <= brc->high_water_mark / 2)) {
+    GRL_DEBUG ("flow-control: releasing operation %u (%u waiting)",
+               brc->operation_id, waiting);
+    brc->throttled = FALSE;
+    if (notify_source && source_class->resume) {
+      source_class->resume (brc->source, brc->operation_id);
+    }
+  }
 
-  /* Ignore elements after operation has completed */
-  if (operation_is_completed (operation_id)) {
-    GRL_WARNING ("Source '%s' emitted 'remaining=0' more than once "
-                 "for operation %d",
-                 grl_source_get_id (source), operation_id);
-    if (media) {
-      g_object_unref (media);
+  if (!brc->throttled && brc->chunk_pending) {
+    brc->chunk_pending = FALSE;
+    browse_relay_run_chunk (brc, brc->chunk_skip, brc->chunk_count);
+  }
+
+  if (brc->queue) {
+    queue_start_process (brc);
+  }
+}
+
+static struct AutoSplitCtl *
+auto_split_setup (GrlSource *source,
+                  GrlOperationOptions *options)
+{
+  struct AutoSplitCtl *as_ctl = NULL;
+  gint count = grl_operation_options_get_count (options);
+
+  if (source->priv->auto_split_threshold > 0 &&
+      count > source->priv->auto_split_threshold) {
+    GRL_DEBUG ("auto-split: enabled");
+
+    as_ctl = g_slice_new (struct AutoSplitCtl);
+    as_ctl->threshold = source->priv->auto_split_threshold;
+    as_ctl->total_remaining = count;
+    as_ctl->chunk_remaining = as_ctl->threshold;
+    count = as_ctl->chunk_remaining;
+    grl_operation_options_set_count (options, count);
+    GRL_DEBUG ("auto-split: requesting chunk (skip=%u, count=%u)",
+               grl_operation_options_get_skip (options),
+               count);
+  }
+
+  return as_ctl;
+}
+
+static void
+auto_split_run_next_chunk (struct BrowseRelayCb *brc)
+{
+  GrlOperationOptions *spec_options = browse_relay_spec_options (brc);
+
+  brc->auto_split->chunk_remaining = MIN (brc->auto_split->threshold,
+                                          brc->auto_split->total_remaining);
+
+  GRL_DEBUG ("auto-split: requesting next chunk");
+  browse_relay_run_chunk (brc,
+                          grl_operation_options_get_skip (spec_options) +
+                          brc->auto_split->threshold,
+                          brc->auto_split->chunk_remaining);
+}
+
+/* ================ Post-filtering ================ */
+
+static gint
+post_filter_chunk_size (GrlSource *source,
+                        struct PostFilterCtl *pf_ctl)
+{
+  gdouble ratio;
+  guint wanted;
+  guint chunk;
+
+  if (pf_ctl->sorted) {
+    /* Sorting needs all the elements */
+    chunk = POST_FILTER_MAX_CHUNK;
+    if (source->priv->auto_split_threshold > 0) {
+      chunk = MIN (chunk, source->priv->auto_split_threshold);
+    }
+    return chunk;
+  }
+
+  if (pf_ctl->count == GRL_COUNT_INFINITY) {
+    return GRL_COUNT_INFINITY;
+  }
+
+  wanted = pf_ctl->skip + pf_ctl->count - pf_ctl->delivered;
+
+  /* Use the ratio of elements passing the filters seen so far to guess how
+     many more must be fetched */
+  if (pf_ctl->received == 0) {
+    ratio = POST_FILTER_OVERFETCH;
+  } else if (pf_ctl->matched == 0) {
+    ratio = POST_FILTER_MAX_CHUNK;
+  } else {
+    ratio = POST_FILTER_MARGIN * pf_ctl->received / pf_ctl->matched;
+  }
+
+  chunk = (guint) MIN (MAX (wanted * ratio, wanted), POST_FILTER_MAX_CHUNK);
+  if (source->priv->auto_split_threshold > 0) {
+    chunk = MIN (chunk, source->priv->auto_split_threshold);
+  }
+
+  return chunk;
+}
+
+static gboolean
+post_filter_match (GrlOperationOptions *filter,
+                   GrlMedia *media)
+{
+  GrlTypeFilter type_filter;
+  GList *keys;
+  GList *key;
+  GValue *filter_value;
+  GValue *min_value;
+  GValue *max_value;
+  const GValue *value;
+  gboolean match = TRUE;
+
+  type_filter = grl_operation_options_get_type_filter (filter);
+  if ((GRL_IS_MEDIA_AUDIO (media) && !(type_filter & GRL_TYPE_FILTER_AUDIO)) ||
+      (GRL_IS_MEDIA_VIDEO (media) && !(type_filter & GRL_TYPE_FILTER_VIDEO)) ||
+      (GRL_IS_MEDIA_IMAGE (media) && !(type_filter & GRL_TYPE_FILTER_IMAGE))) {
+    return FALSE;
+  }
+
+  keys = grl_operation_options_get_key_filter_list (filter);
+  for (key = keys; match && key; key = g_list_next (key)) {
+    filter_value =
+      grl_operation_options_get_key_filter (filter,
+                                            GRLPOINTER_TO_KEYID (key->data));
+    value = grl_data_get (GRL_DATA (media), GRLPOINTER_TO_KEYID (key->data));
+    match = value && grl_g_value_compare (value, filter_value) == 0;
+  }
+  g_list_free (keys);
+
+  keys = grl_operation_options_get_key_range_filter_list (filter);
+  for (key = keys; match && key; key = g_list_next (key)) {
+    grl_operation_options_get_key_range_filter (filter,
+                                                GRLPOINTER_TO_KEYID (key->data),
+                                                &min_value,
+                                                &max_value);
+    value = grl_data_get (GRL_DATA (media), GRLPOINTER_TO_KEYID (key->data));
+    match = value &&
+      (!min_value || grl_g_value_compare (value, min_value) >= 0) &&
+      (!max_value || grl_g_value_compare (value, max_value) <= 0);
+  }
+  g_list_free (keys);
+
+  return match;
+}
+
+/*
+ * Orders elements as they must be sent to the user. Elements lacking the
+ * sort key go last, and ties keep the order in which they were received.
+ */
+static gint
+post_filter_sort_compare (gconstpointer a,
+                          gconstpointer b,
+                          gpointer user_data)
+{
+  struct PostFilterCtl *pf_ctl = (struct PostFilterCtl *) user_data;
+  const PostFilterSortItem *item_a = *((PostFilterSortItem **) a);
+  const PostFilterSortItem *item_b = *((PostFilterSortItem **) b);
+  const GValue *value_a;
+  const GValue *value_b;
+  gint result;
+
+  value_a = grl_data_get (GRL_DATA (item_a->media), pf_ctl->sort_key);
+  value_b = grl_data_get (GRL_DATA (item_b->media), pf_ctl->sort_key);
+
+  if (!value_a || !value_b) {
+    result = (value_a == NULL) - (value_b == NULL);
+  } else {
+    result = grl_g_value_compare (value_a, value_b);
+    if (pf_ctl->sort_order == GRL_SORT_ORDER_DESCENDING) {
+      result = -result;
+    }
+  }
+
+  if (result == 0) {
+    result = (item_a->sequence > item_b->sequence) -
+      (item_a->sequence < item_b->sequence);
+  }
+
+  return result;
+}
+
+#define SORT_ITEM_WORSE(pf_ctl, i, j)                                   \
+  (post_filter_sort_compare (&g_ptr_array_index ((pf_ctl)->sorted, (i)), \
+                             &g_ptr_array_index ((pf_ctl)->sorted, (j)), \
+                             (pf_ctl)) > 0)
+
+static void
+post_filter_sort_swap (GPtrArray *array,
+                       guint i,
+                       guint j)
+{
+  gpointer tmp = g_ptr_array_index (array, i);
+
+  g_ptr_array_index (array, i) = g_ptr_array_index (array, j);
+  g_ptr_array_index (array, j) = tmp;
+}
+
+/*
+ * Keeps the best skip + count elements received so far in a heap, with the
+ * worst of them at the top, so memory does not depend on the size of the
+ * source.
+ */
+static void
+post_filter_sort_add (struct PostFilterCtl *pf_ctl,
+                      GrlMedia *media)
+{
+  GPtrArray *heap = pf_ctl->sorted;
+  PostFilterSortItem *item;
+  guint i, child, parent;
+
+  item = g_slice_new (PostFilterSortItem);
+  item->media = media;
+  item->sequence = pf_ctl->sequence++;
+
+  if (pf_ctl->count == GRL_COUNT_INFINITY ||
+      heap->len < pf_ctl->skip + pf_ctl->count) {
+    /* Sift up */
+    g_ptr_array_add (heap, item);
+    for (i = heap->len - 1; i > 0; i = parent) {
+      parent = (i - 1) / 2;
+      if (!SORT_ITEM_WORSE (pf_ctl, i, parent)) {
+        break;
+      }
+      post_filter_sort_swap (heap, i, parent);
     }
     return;
   }
 
+  if (post_filter_sort_compare (&item, &g_ptr_array_index (heap, 0),
+                                pf_ctl) > 0) {
+    /* Worse than all the elements kept */
+    post_filter_sort_item_free (item);
+    return;
+  }
+
+  /* Replace the top and sift down */
+  post_filter_sort_item_free (g_ptr_array_index (heap, 0));
+  g_ptr_array_index (heap, 0) = item;
+  for (i = 0; (child = 2 * i + 1) < heap->len; i = child) {
+    if (child + 1 < heap->len && SORT_ITEM_WORSE (pf_ctl, child + 1, child)) {
+      child++;
+    }
+    if (!SORT_ITEM_WORSE (pf_ctl, child, i)) {
+      break;
+    }
+    post_filter_sort_swap (heap, i, child);
+  }
+}
+
+/*
+ * Queues the sorted elements to be sent to the user, except the last one,
+ * which is returned in @media.
+ */
+static void
+post_filter_sort_flush (struct BrowseRelayCb *brc,
+                        GrlMedia **media)
+{
+  struct PostFilterCtl *pf_ctl = brc->post_filter;
+  PostFilterSortItem *item;
+  guint i;
+
+  *media = NULL;
+  g_ptr_array_sort_with_data (pf_ctl->sorted, post_filter_sort_compare, pf_ctl);
+
+  for (i = pf_ctl->skip; i < pf_ctl->sorted->len; i++) {
+    item = g_ptr_array_index (pf_ctl->sorted, i);
+    if (!grl_media_get_source (item->media)) {
+      grl_media_set_source (item->media, grl_source_get_id (brc->source));
+    }
+    if (i + 1 < pf_ctl->sorted->len) {
+      queue_add_media (brc, g_object_ref (item->media),
+                       pf_ctl->sorted->len - i - 1, NULL);
+    } else {
+      *media = g_object_ref (item->media);
+    }
+  }
+
+  g_ptr_array_foreach (pf_ctl->sorted, (GFunc) post_filter_sort_item_free, NULL);
+  g_ptr_array_set_size (pf_ctl->sorted, 0);
+}
+
+/*
+ * Sets up the options to send to the source in @spec_options. If @options
+ * contains filters the source can not handle, they are left out and applied
+ * by the core on the results instead; as the source can not tell how many
+ * elements will pass them, it is asked for more elements than requested.
+ * Likewise, if the source can not sort the results, all of them are fetched
+ * and sorted by the core, and the keys needed are added to @keys. With
+ * %GRL_RESOLVE_FULL, the elements are decorated before applying the filters.
+ */
+static struct PostFilterCtl *
+post_filter_setup (GrlSource *source,
+                   GrlSupportedOps operation,
+                   GrlOperationOptions *options,
+                   GrlOperationOptions **spec_options,
+                   GList **keys)
+{
+  struct PostFilterCtl *pf_ctl;
+  GrlCaps *caps;
+  GList *filter_keys;
+  GList *key;
+
+  caps = grl_source_get_caps (source, operation);
+  if (grl_operation_options_obey_caps (options, caps, NULL, NULL)) {
+    *spec_options = grl_operation_options_copy (options);
+    return NULL;
+  }
+
+  GRL_DEBUG ("post-filter: enabled");
+
+  pf_ctl = g_slice_new0 (struct PostFilterCtl);
+  grl_operation_options_obey_caps (options, caps,
+                                   spec_options, &pf_ctl->filter);
+  pf_ctl->skip = grl_operation_options_get_skip (options);
+  pf_ctl->count = grl_operation_options_get_count (options);
+  pf_ctl->sort_key = grl_operation_options_get_sort_key (pf_ctl->filter);
+  pf_ctl->sort_order = grl_operation_options_get_sort_order (pf_ctl->filter);
+  if (pf_ctl->sort_key != GRL_METADATA_KEY_INVALID) {
+    GRL_DEBUG ("post-filter: sorting by '%s'",
+               grl_metadata_key_get_name (pf_ctl->sort_key));
+    pf_ctl->sorted = g_ptr_array_new ();
+  }
+  pf_ctl->chunk_size = post_filter_chunk_size (source, pf_ctl);
+
+  /* Filters can involve keys that only other sources provide */
+  if (grl_operation_options_get_flags (options) & GRL_RESOLVE_FULL) {
+    pf_ctl->decorate = TRUE;
+    pf_ctl->queue = g_queue_new ();
+  }
+
+  /* Make sure the source fills in the keys needed to filter and sort */
+  filter_keys = grl_operation_options_get_key_filter_list (pf_ctl->filter);
+  filter_keys =
+    g_list_concat (filter_keys,
+                   grl_operation_options_get_key_range_filter_list (pf_ctl->filter));
+  if (pf_ctl->sort_key != GRL_METADATA_KEY_INVALID) {
+    filter_keys = g_list_prepend (filter_keys,
+                                  GRLKEYID_TO_POINTER (pf_ctl->sort_key));
+  }
+  for (key = filter_keys; key; key = g_list_next (key)) {
+    if (!g_list_find (*keys, key->data)) {
+      *keys = g_list_append (*keys, key->data);
+    }
+  }
+  g_list_free (filter_keys);
+
+  grl_operation_options_set_skip (*spec_options, 0);
+  grl_operation_options_set_count (*spec_options, pf_ctl->chunk_size);
+  GRL_DEBUG ("post-filter: requesting chunk (skip=0, count=%d)",
+             pf_ctl->chunk_size);
+
+  return pf_ctl;
+}
+
+static guint
+post_filter_remaining (struct PostFilterCtl *pf_ctl,
+                       guint source_remaining)
+{
+  if (pf_ctl->count == GRL_COUNT_INFINITY) {
+    return MAX (source_remaining, 1);
+  } else {
+    return MAX (pf_ctl->count - pf_ctl->delivered, 1);
+  }
+}
+
+/*
+ * Asks the source to stop sending the chunk, as the user got all the elements
+ * requested. It is done in an idle, as sources may answer right away. Sources
+ * that can not cancel operations send the whole chunk.
+ */
+static gboolean
+post_filter_stop_idle (gpointer user_data)
+{
+  guint operation_id = GPOINTER_TO_UINT (user_data);
+  struct OperationState *op_state;
+
+  op_state = grl_operation_get_private_data (operation_id);
+  if (!op_state ||
+      !op_state->browse_relay ||
+      op_state->completed ||
+      g_atomic_int_get (&op_state->cancelled)) {
+    return FALSE;
+  }
+
+  GRL_DEBUG ("post-filter: stopping operation %u", operation_id);
+  GRL_SOURCE_GET_CLASS (op_state->source)->cancel (op_state->source,
+                                                   operation_id);
+
+  return FALSE;
+}
+
+static void
+post_filter_stop (struct BrowseRelayCb *brc)
+{
+  if (GRL_SOURCE_GET_CLASS (brc->source)->cancel) {
+    brc->post_filter->stopped = TRUE;
+    grl_operation_idle_add (brc->operation_id,
+                            relay_idle_priority (brc->options),
+                            post_filter_stop_idle,
+                            GUINT_TO_POINTER (brc->operation_id));
+  }
+}
+
+/*
+ * Applies the filters to an element coming from the source, updating @media,
+ * @remaining and @error with what must be sent to the user. Returns %FALSE
+ * if nothing must be sent.
+ */
+static gboolean
+post_filter_relay (struct BrowseRelayCb *brc,
+                   GrlMedia **media,
+                   guint *remaining,
+                   const GError **error)
+{
+  struct PostFilterCtl *pf_ctl = brc->post_filter;
+  GrlMedia *match = NULL;
+  guint source_remaining = *remaining;
+
+  if (*media) {
+    pf_ctl->received++;
+    pf_ctl->chunk_received++;
+    if (!pf_ctl->done && post_filter_match (pf_ctl->filter, *media)) {
+      pf_ctl->matched++;
+      if (pf_ctl->sorted) {
+        post_filter_sort_add (pf_ctl, g_object_ref (*media));
+      } else if (pf_ctl->skip > 0) {
+        pf_ctl->skip--;
+      } else {
+        match = g_object_ref (*media);
+        pf_ctl->delivered++;
+      }
+    }
+    g_object_unref (*media);
+    *media = NULL;
+  }
+
+  if (source_remaining > 0) {
+    if (match &&
+        pf_ctl->count != GRL_COUNT_INFINITY &&
+        pf_ctl->delivered == (guint) pf_ctl->count) {
+      /* This is the last element the user wants, but the source is still
+         sending: keep it until the source finishes, so it can be sent with
+         remaining=0 */
+      pf_ctl->held = match;
+      pf_ctl->done = TRUE;
+      post_filter_stop (brc);
+      return FALSE;
+    }
+
+    if (!match && (!*error || pf_ctl->done)) {
+      return FALSE;
+    }
+
+    *media = match;
+    *remaining = post_filter_remaining (pf_ctl, source_remaining);
+    return TRUE;
+  }
+
+  /* The source has sent the whole chunk: check if there could be more
+     elements passing the filters */
+  if (!pf_ctl->done &&
+      !*error &&
+      pf_ctl->chunk_size != GRL_COUNT_INFINITY &&
+      pf_ctl->chunk_received == (guint) pf_ctl->chunk_size &&
+      (pf_ctl->sorted ||
+       pf_ctl->count == GRL_COUNT_INFINITY ||
+       pf_ctl->delivered < (guint) pf_ctl->count)) {
+    pf_ctl->source_skip += pf_ctl->chunk_received;
+    pf_ctl->chunk_size = post_filter_chunk_size (brc->source, pf_ctl);
+    pf_ctl->chunk_received = 0;
+    GRL_DEBUG ("post-filter: %u out of %u elements passed the filters",
+               pf_ctl->matched, pf_ctl->received);
+    browse_relay_run_chunk (brc, pf_ctl->source_skip, pf_ctl->chunk_size);
+
+    if (!match) {
+      return FALSE;
+    }
+
+    *media = match;
+    *remaining = post_filter_remaining (pf_ctl, source_remaining);
+    return TRUE;
+  }
+
+  pf_ctl->done = TRUE;
+  if (pf_ctl->sorted) {
+    post_filter_sort_flush (brc, media);
+  } else if (pf_ctl->held) {
+    *media = pf_ctl->held;
+    pf_ctl->held = NULL;
+  } else {
+    *media = match;
+  }
+  *remaining = 0;
+
+  /* The source was asked to stop, so it may be reporting the cancellation */
+  if (pf_ctl->stopped) {
+    *error = NULL;
+  }
+
+  return TRUE;
+}
+
+/*
+ * Sends an element coming from the source to the user, once decorated if the
+ * core applies the filters. @decoration_error is only sent along with the
+ * element that was decorated.
+ */
+static void
+browse_relay_send (struct BrowseRelayCb *brc,
+                   GrlMedia *media,
+                   guint remaining,
+                   const GError *error,
+                   const GError *decoration_error)
+{
+  GError *_error;
+  GrlMedia *decorated = media;
+
   /* Check if cancelled */
-  if (operation_is_cancelled (operation_id)) {
+  if (browse_relay_is_cancelled (brc)) {
     GRL_DEBUG ("Operation is cancelled, skipping result until getting the last one");
     if (media) {
       g_object_unref (media);
@@ -2199,13 +3717,23 @@ browse_result_relay_cb (GrlSource *source,
       _error = g_error_new (GRL_CORE_ERROR,
                             GRL_CORE_ERROR_OPERATION_CANCELLED,
                             _("Operation was cancelled"));
-      brc->user_callback (source, operation_id, NULL, 0,
+      brc->user_callback (brc->source, brc->operation_id, NULL, 0,
                           brc->user_data, _error);
       g_error_free (_error);
       goto free_resources;
     }
   }
 
+  /* Apply the filters the source does not support */
+  if (brc->post_filter &&
+      !post_filter_relay (brc, &media, &remaining, &error)) {
+    return;
+  }
+
+  if (!error && media && media == decorated) {
+    error = decoration_error;
+  }
+
   /* Auto-split management */
   if (brc->auto_split) {
     brc->auto_split->chunk_remaining--;
@@ -2225,15 +3753,19 @@ browse_result_relay_cb (GrlSource *source,
 
   /* Set the source */
   if (media && !grl_media_get_source (media)) {
-    grl_media_set_source (media, grl_source_get_id (source));
+    grl_media_set_source (media, grl_source_get_id (brc->source));
   }
 
-  /* If we need further processing of media, put it in a queue */
-  if (grl_operation_options_get_flags (brc->options) &
+  /* If we need further processing of media, put it in a queue; keep using it
+     if there are already elements waiting there, or the user paused the
+     operation */
+  if (brc->queue ||
+      browse_relay_is_paused (brc) ||
+      grl_operation_options_get_flags (brc->options) &
       (GRL_RESOLVE_FULL | GRL_RESOLVE_IDLE_RELAY)) {
     queue_add_media (brc, media, remaining, error);
   } else {
-    brc->user_callback (source, operation_id, media, remaining,
+    brc->user_callback (brc->source, brc->operation_id, media, remaining,
                         brc->user_data, error);
   }
 
@@ -2241,44 +3773,594 @@ browse_result_relay_cb (GrlSource *source,
   free_resources:
     browse_relay_spec_free (brc);
     if (!brc->queue || g_queue_is_empty (brc->queue)) {
-      operation_set_finished (operation_id);
+      operation_set_finished (brc->operation_id);
       browse_relay_free (brc);
     } else {
       /* There are elements pending to be processed; let's wait to free it in
          the queue */
-      operation_set_completed (operation_id);
+      operation_set_completed (brc->operation_id);
     }
   }
 }
 
+/*
+ * Sends the elements waiting to be filtered, in the order the source sent
+ * them, as soon as they are decorated.
+ */
 static void
-remove_result_relay_cb (GrlSource *source,
-                        GrlMedia *media,
-                        gpointer user_data,
-                        const GError *error)
+post_filter_queue_flush (struct BrowseRelayCb *brc)
 {
-  struct RemoveRelayCb *rrc = (struct RemoveRelayCb *) user_data;
+  PostFilterElement *element;
+  GQueue *queue = brc->post_filter->queue;
+  guint remaining;
+
+  while ((element = g_queue_peek_head (queue)) && element->is_ready) {
+    g_queue_pop_head (queue);
+    remaining = element->remaining;
+    browse_relay_send (brc, element->media, remaining,
+                       element->error, element->decoration_error);
+    element->media = NULL;
+    post_filter_element_free (element);
+
+    /* The relay is freed with the last element */
+    if (remaining == 0) {
+      return;
+    }
+  }
 
-  rrc->user_callback (source, media, rrc->user_data, error);
-  remove_relay_free (rrc);
+  browse_relay_flow_update (brc);
 }
 
-static gboolean
-resolve_idle (gpointer user_data)
+static gint
+compare_post_filter_element (PostFilterElement *element,
+                             GrlMedia *media)
 {
-  struct ResolveRelayCb *rrc = (struct ResolveRelayCb *) user_data;
-  GrlSourceResolveSpec *rs;
-  GList *spec;
-  GList *key;
-  gboolean run_next;
-
-  GRL_DEBUG (__FUNCTION__);
+  return element->media != media;
+}
 
-  /* Abort if operation was cancelled */
-  if (operation_is_cancelled (rrc->operation_id)) {
+static void
+post_filter_ready_cb (GrlMedia *media,
+                      gpointer user_data,
+                      const GError *error)
+{
+  GList *link;
+  PostFilterElement *element;
+  struct BrowseRelayCb *brc = (struct BrowseRelayCb *) user_data;
+
+  link = g_queue_find_custom (brc->post_filter->queue, media,
+                              (GCompareFunc) compare_post_filter_element);
+  if (!link) {
+    GRL_WARNING ("Media not found in the queue!");
+    return;
+  }
+
+  element = (PostFilterElement *) link->data;
+  element->is_ready = TRUE;
+
+  /* Keep errors about the decoration, like an expired deadline */
+  if (error &&
+      !g_error_matches (error, GRL_CORE_ERROR,
+                        GRL_CORE_ERROR_OPERATION_CANCELLED)) {
+    element->decoration_error = g_error_copy (error);
+  }
+
+  post_filter_queue_flush (brc);
+}
+
+/*
+ * Decorates an element before applying the filters, as they can involve keys
+ * the source does not provide.
+ */
+static void
+post_filter_queue_add (struct BrowseRelayCb *brc,
+                       GrlMedia *media,
+                       guint remaining,
+                       const GError *error)
+{
+  PostFilterElement *element;
+  GList *unknown_keys = NULL;
+
+  element = g_slice_new0 (PostFilterElement);
+  element->media = media;
+  element->remaining = remaining;
+  if (error) {
+    element->error = g_error_copy (error);
+  }
+  if (media && !browse_relay_is_cancelled (brc)) {
+    unknown_keys = filter_known_keys (media, brc->keys);
+  }
+  element->is_ready = (unknown_keys == NULL);
+  g_queue_push_tail (brc->post_filter->queue, element);
+
+  if (element->is_ready) {
+    post_filter_queue_flush (brc);
+    return;
+  }
+
+  /* The relay can be freed once the element is decorated */
+  browse_relay_flow_update (brc);
+  if (!grl_media_get_source (media)) {
+    grl_media_set_source (media, grl_source_get_id (brc->source));
+  }
+  media_decorate (brc->source, brc->operation_id, media, unknown_keys,
+                  brc->options, post_filter_ready_cb, brc);
+  g_list_free (unknown_keys);
+}
+
+static void
+browse_result_relay_cb (GrlSource *source,
+                        guint operation_id,
+                        GrlMedia *media,
+                        guint remaining,
+                        gpointer user_data,
+                        const GError *error)
+{
+  struct BrowseRelayCb *brc = (struct BrowseRelayCb *) user_data;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  /* Ignore elements after operation has completed */
+  if (browse_relay_is_completed (brc)) {
+    GRL_WARNING ("Source '%s' emitted 'remaining=0' more than once "
+                 "for operation %d",
+                 grl_source_get_id (source), operation_id);
+    if (media) {
+      g_object_unref (media);
+    }
+    return;
+  }
+
+  /* Keep track of how well the source is answering each request; results
+     served from the cache were not requested to the source */
+  if (remaining == 0 &&
+      brc->chunk_start > 0 &&
+      !browse_relay_is_cancelled (brc) &&
+      !(brc->post_filter && brc->post_filter->stopped)) {
+    grl_registry_report_source_result (grl_registry_get_default (),
+                                       source,
+                                       (g_get_monotonic_time () -
+                                        brc->chunk_start) / 1000,
+                                       error_is_source_failure (error));
+  }
+
+  if (brc->post_filter && brc->post_filter->decorate) {
+    post_filter_queue_add (brc, media, remaining, error);
+  } else {
+    browse_relay_send (brc, media, remaining, error, NULL);
+  }
+}
+
+
+/* ================ Result cache ================ */
+
+/* Operations can be run from several threads at once (synchronous calls
+   off the main thread), so the result caches are protected by this lock */
+G_LOCK_DEFINE_STATIC (result_cache);
+
+static void
+result_cache_entry_free (ResultCacheEntry *entry)
+{
+  g_ptr_array_free (entry->medias, TRUE);
+  g_free (entry->signature);
+  g_slice_free (ResultCacheEntry, entry);
+}
+
+static void
+result_cache_media_free (gpointer media)
+{
+  if (media) {
+    g_object_unref (media);
+  }
+}
+
+/* Must be called with the result_cache lock held */
+static void
+result_cache_trim (GrlSource *source)
+{
+  ResultCacheEntry *entry;
+
+  while (g_queue_get_length (source->priv->result_cache_lru) >
+         source->priv->result_cache_size) {
+    entry = g_queue_pop_head (source->priv->result_cache_lru);
+    g_hash_table_remove (source->priv->result_cache, entry->signature);
+  }
+}
+
+/* Must be called with the result_cache lock held */
+static void
+result_cache_invalidate (GrlSource *source)
+{
+  g_queue_clear (source->priv->result_cache_lru);
+  g_hash_table_remove_all (source->priv->result_cache);
+  /* Results from ongoing operations are not valid any more */
+  source->priv->result_cache_generation++;
+}
+
+static void
+result_cache_content_changed_cb (GrlSource *source,
+                                 GPtrArray *changed_medias,
+                                 GrlSourceChangeType change_type,
+                                 gboolean location_unknown,
+                                 gpointer user_data)
+{
+  G_LOCK (result_cache);
+  if (g_hash_table_size (source->priv->result_cache) > 0) {
+    GRL_DEBUG ("result-cache: content changed in '%s', invalidating",
+               grl_source_get_id (source));
+  }
+
+  result_cache_invalidate (source);
+  G_UNLOCK (result_cache);
+}
+
+/* Must be called with the result_cache lock held */
+static ResultCacheEntry *
+result_cache_get_entry (GrlSource *source,
+                        const gchar *signature,
+                        gboolean create)
+{
+  ResultCacheEntry *entry;
+
+  entry = g_hash_table_lookup (source->priv->result_cache, signature);
+  if (entry) {
+    /* Most recently used goes to the tail */
+    g_queue_unlink (source->priv->result_cache_lru, entry->link);
+    g_queue_push_tail_link (source->priv->result_cache_lru, entry->link);
+    return entry;
+  }
+
+  if (!create) {
+    return NULL;
+  }
+
+  /* Medias are stored as copies, so changes done by the application or by
+     further decoration in the medias it receives do not reach the cache */
+  entry = g_slice_new (ResultCacheEntry);
+  entry->signature = g_strdup (signature);
+  entry->medias = g_ptr_array_new_with_free_func (result_cache_media_free);
+  entry->length = -1;
+
+  g_hash_table_insert (source->priv->result_cache, entry->signature, entry);
+  g_queue_push_tail (source->priv->result_cache_lru, entry);
+  entry->link = g_queue_peek_tail_link (source->priv->result_cache_lru);
+  result_cache_trim (source);
+
+  return entry;
+}
+
+static gint
+compare_key_ids (gconstpointer a,
+                 gconstpointer b)
+{
+  return GRLPOINTER_TO_KEYID (a) - GRLPOINTER_TO_KEYID (b);
+}
+
+/*
+ * Builds the string identifying the shape of a request: operation, container
+ * id or search text or query, set of keys and options (except skip and count,
+ * which determine the range)
+ */
+static gchar *
+result_cache_signature (GrlSupportedOps operation,
+                        const gchar *target,
+                        const GList *keys,
+                        GrlOperationOptions *options)
+{
+  GList *sorted_keys;
+  GList *k;
+  GString *signature;
+  gchar *options_signature;
+
+  signature = g_string_new ("");
+  g_string_append_printf (signature, "%d|", operation);
+  if (target) {
+    g_string_append_printf (signature, "+%s|", target);
+  } else {
+    g_string_append (signature, "-|");
+  }
+
+  sorted_keys = g_list_sort (g_list_copy ((GList *) keys), compare_key_ids);
+  for (k = sorted_keys; k; k = g_list_next (k)) {
+    g_string_append_printf (signature, "%u,", GRLPOINTER_TO_KEYID (k->data));
+  }
+  g_list_free (sorted_keys);
+
+  options_signature = grl_operation_options_get_signature (options);
+  g_string_append_printf (signature, "|%s", options_signature);
+  g_free (options_signature);
+
+  return g_string_free (signature, FALSE);
+}
+
+static void
+result_cache_setup (struct BrowseRelayCb *brc,
+                    const gchar *target,
+                    const GList *keys)
+{
+  brc->cache_signature = NULL;
+  brc->cache_generation = 0;
+  brc->cache_position = 0;
+  brc->cache_received = 0;
+  brc->cache_requested = 0;
+  brc->cache_hits = NULL;
+  brc->cache_tail = FALSE;
+  brc->cache_touched = FALSE;
+
+  /* Filtered results depend on the options the source was not given */
+  if (brc->source->priv->result_cache_size == 0 || brc->post_filter) {
+    return;
+  }
+
+  brc->cache_signature = result_cache_signature (brc->operation_type,
+                                                 target,
+                                                 keys,
+                                                 brc->options);
+  G_LOCK (result_cache);
+  brc->cache_generation = brc->source->priv->result_cache_generation;
+  G_UNLOCK (result_cache);
+  brc->cache_position = grl_operation_options_get_skip (brc->options);
+  brc->cache_requested = grl_operation_options_get_count (brc->options);
+}
+
+static void
+result_cache_store (struct BrowseRelayCb *brc,
+                    GrlMedia *media,
+                    guint remaining)
+{
+  GrlSourcePrivate *priv = brc->source->priv;
+  ResultCacheEntry *entry = NULL;
+  GrlMedia *copy = NULL;
+  gboolean end_reached;
+
+  /* Copy out of the lock; the media sent by the source is not changed */
+  if (media) {
+    copy = GRL_MEDIA (grl_data_dup (GRL_DATA (media)));
+    if (!grl_media_get_source (copy)) {
+      grl_media_set_source (copy, grl_source_get_id (brc->source));
+    }
+  }
+
+  G_LOCK (result_cache);
+
+  if (priv->result_cache_size == 0 ||
+      priv->result_cache_generation != brc->cache_generation) {
+    G_UNLOCK (result_cache);
+    if (copy) {
+      g_object_unref (copy);
+    }
+    return;
+  }
+
+  /* The entry is moved to the tail of the LRU list only with the first
+     result; it could have been dropped by other operations since then */
+  if (brc->cache_touched) {
+    entry = g_hash_table_lookup (priv->result_cache, brc->cache_signature);
+  }
+  if (!entry) {
+    entry = result_cache_get_entry (brc->source, brc->cache_signature, TRUE);
+    brc->cache_touched = TRUE;
+  }
+
+  if (copy) {
+    if (entry->medias->len <= brc->cache_position) {
+      g_ptr_array_set_size (entry->medias, brc->cache_position + 1);
+    }
+    result_cache_media_free (g_ptr_array_index (entry->medias,
+                                                brc->cache_position));
+    g_ptr_array_index (entry->medias, brc->cache_position) = copy;
+    brc->cache_position++;
+    brc->cache_received++;
+  }
+
+  if (remaining == 0) {
+    /* Source has sent less elements than requested: the end of the list has
+       been reached */
+    if (brc->auto_split) {
+      end_reached = brc->auto_split->chunk_remaining > (media? 1: 0);
+    } else {
+      end_reached = brc->cache_requested < 0 ||
+        brc->cache_received < (guint) brc->cache_requested;
+    }
+    if (end_reached) {
+      entry->length = brc->cache_position;
+    }
+  }
+
+  G_UNLOCK (result_cache);
+}
+
+static void
+result_cache_relay_cb (GrlSource *source,
+                       guint operation_id,
+                       GrlMedia *media,
+                       guint remaining,
+                       gpointer user_data,
+                       const GError *error)
+{
+  struct BrowseRelayCb *brc = (struct BrowseRelayCb *) user_data;
+
+  if (!error &&
+      operation_is_ongoing (operation_id) &&
+      !operation_is_completed (operation_id)) {
+    result_cache_store (brc, media, remaining);
+  }
+
+  browse_result_relay_cb (source, operation_id, media, remaining,
+                          user_data, error);
+}
+
+static gboolean
+result_cache_idle (gpointer user_data)
+{
+  struct BrowseRelayCb *brc = (struct BrowseRelayCb *) user_data;
+  GrlOperationOptions *spec_options;
+  GrlSource *source = brc->source;
+  GList *hits;
+  GList *h;
+  gboolean tail;
+  gint tail_count;
+  guint operation_id;
+  guint remaining;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  hits = brc->cache_hits;
+  brc->cache_hits = NULL;
+  tail = brc->cache_tail;
+  spec_options = browse_relay_spec_options (brc);
+  tail_count = grl_operation_options_get_count (spec_options);
+  operation_id = brc->operation_id;
+
+  /* Relay will free brc with the last element, so do not use it after that */
+  remaining = g_list_length (hits);
+  if (tail) {
+    remaining += tail_count > 0? tail_count: 1;
+  }
+
+  if (!hits && !tail) {
+    browse_result_relay_cb (source, operation_id, NULL, 0, brc, NULL);
+  }
+
+  for (h = hits; h; h = g_list_next (h)) {
+    browse_result_relay_cb (source, operation_id, h->data, --remaining,
+                            brc, NULL);
+  }
+  g_list_free (hits);
+
+  if (tail) {
+    /* Fetch the missing elements from the source */
+    brc->auto_split = auto_split_setup (source, spec_options);
+
+    switch (brc->operation_type) {
+    case GRL_OP_BROWSE:
+      browse_idle (brc->spec.browse);
+      break;
+    case GRL_OP_SEARCH:
+      search_idle (brc->spec.search);
+      break;
+    case GRL_OP_QUERY:
+      query_idle (brc->spec.query);
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+  }
+
+  return FALSE;
+}
+
+/*
+ * Checks if the cache has elements for the range requested in the operation.
+ * In that case, it schedules sending them, followed by requesting the source
+ * the missing elements (if any), and returns %TRUE.
+ */
+static gboolean
+result_cache_serve (struct BrowseRelayCb *brc)
+{
+  GrlOperationOptions *spec_options;
+  ResultCacheEntry *entry;
+  GrlMedia *cached;
+  GList *h;
+  gboolean complete;
+  gint count;
+  guint skip;
+  guint n = 0;
+
+  if (!brc->cache_signature) {
+    return FALSE;
+  }
+
+  spec_options = browse_relay_spec_options (brc);
+  skip = grl_operation_options_get_skip (spec_options);
+  count = grl_operation_options_get_count (spec_options);
+
+  G_LOCK (result_cache);
+
+  entry = result_cache_get_entry (brc->source, brc->cache_signature, FALSE);
+  if (!entry) {
+    G_UNLOCK (result_cache);
+    return FALSE;
+  }
+
+  while ((count < 0 || n < (guint) count) &&
+         skip + n < entry->medias->len &&
+         (cached = g_ptr_array_index (entry->medias, skip + n))) {
+    brc->cache_hits = g_list_prepend (brc->cache_hits, g_object_ref (cached));
+    n++;
+  }
+
+  complete = (count >= 0 && n == (guint) count) ||
+    (entry->length >= 0 && skip + n >= (guint) entry->length);
+
+  G_UNLOCK (result_cache);
+
+  /* Each operation gets its own copies, made out of the lock */
+  brc->cache_hits = g_list_reverse (brc->cache_hits);
+  for (h = brc->cache_hits; h; h = g_list_next (h)) {
+    cached = h->data;
+    h->data = grl_data_dup (GRL_DATA (cached));
+    g_object_unref (cached);
+  }
+
+  if (n == 0 && !complete) {
+    return FALSE;
+  }
+
+  if (!complete) {
+    /* Partial hit: only ask the source for the elements we do not have */
+    brc->cache_tail = TRUE;
+    brc->cache_position = skip + n;
+    grl_operation_options_set_skip (spec_options, skip + n);
+    if (count >= 0) {
+      brc->cache_requested = count - n;
+      grl_operation_options_set_count (spec_options, count - n);
+    }
+  }
+
+  GRL_DEBUG ("result-cache: %s hit in '%s' (skip=%u, cached=%u)",
+             complete? "full": "partial",
+             grl_source_get_id (brc->source), skip, n);
+
+  brc->auto_split = NULL;
+  grl_operation_idle_add (brc->operation_id,
+                          relay_idle_priority (brc->options),
+                          result_cache_idle,
+                          brc);
+
+  return TRUE;
+}
+
+static void
+remove_result_relay_cb (GrlSource *source,
+                        GrlMedia *media,
+                        gpointer user_data,
+                        const GError *error)
+{
+  struct RemoveRelayCb *rrc = (struct RemoveRelayCb *) user_data;
+
+  rrc->user_callback (source, media, rrc->user_data, error);
+  remove_relay_free (rrc);
+}
+
+static gboolean
+resolve_idle (gpointer user_data)
+{
+  struct ResolveRelayCb *rrc = (struct ResolveRelayCb *) user_data;
+  GrlSourceResolveSpec *rs;
+  struct ResolveAttempt *attempt;
+  GList *spec;
+  GList *key;
+  gboolean run_next;
+  guint delay;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  /* Abort if operation was cancelled */
+  if (operation_is_cancelled (rrc->operation_id)) {
     for (spec = rrc->specs_to_invoke;
          spec;
-         spec = g_list_next (rs)) {
+         spec = g_list_next (spec)) {
       rs = (GrlSourceResolveSpec *) spec->data;
       g_hash_table_remove (rrc->resolve_specs, rs->source);
     }
@@ -2299,6 +4381,22 @@ resolve_idle (gpointer user_data)
       }
     }
 
+    attempt = g_slice_new0 (struct ResolveAttempt);
+    attempt->rrc = rrc;
+    attempt->source = rs->source;
+    attempt->start_time = g_get_monotonic_time ();
+    delay = resolve_hedge_delay (rs->source);
+    if (delay > 0) {
+      attempt->hedge_id = grl_context_timeout_add (rrc->context, delay,
+                                                   resolve_hedge_cb, attempt);
+      if (rs->media == rrc->media) {
+        g_object_unref (rs->media);
+        rs->media = resolve_scratch_media_new (rrc->media);
+      }
+    }
+    g_hash_table_insert (rrc->attempts, rs->source, attempt);
+
+    grl_operation_set_parent (rs->operation_id, rrc->operation_id);
     operation_set_ongoing (rs->source, rs->operation_id);
     operation_set_started (rs->operation_id);
     GRL_SOURCE_GET_CLASS (rs->source)->resolve (rs->source, rs);
@@ -2361,6 +4459,8 @@ browse_idle (gpointer user_data)
     bs->callback (bs->source, bs->operation_id, NULL, 0, bs->user_data, NULL);
   } else {
     operation_set_started (bs->operation_id);
+    ((struct BrowseRelayCb *) bs->user_data)->chunk_start =
+      g_get_monotonic_time ();
     GRL_SOURCE_GET_CLASS (bs->source)->browse (bs->source, bs);
   }
 
@@ -2379,6 +4479,8 @@ search_idle (gpointer user_data)
     ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, NULL);
   } else {
     operation_set_started (ss->operation_id);
+    ((struct BrowseRelayCb *) ss->user_data)->chunk_start =
+      g_get_monotonic_time ();
     GRL_SOURCE_GET_CLASS (ss->source)->search (ss->source, ss);
   }
 
@@ -2396,6 +4498,8 @@ query_idle (gpointer user_data)
     qs->callback (qs->source, qs->operation_id, NULL, 0, qs->user_data, NULL);
   } else {
     operation_set_started (qs->operation_id);
+    ((struct BrowseRelayCb *) qs->user_data)->chunk_start =
+      g_get_monotonic_time ();
     GRL_SOURCE_GET_CLASS (qs->source)->query (qs->source, qs);
   }
 
@@ -2438,18 +4542,263 @@ resolve_result_async_cb (GrlSource *source,
 }
 
 static void
-multiple_result_async_cb (GrlSource *source,
-                          guint op_id,
-                          GrlMedia *media,
-                          guint remaining,
-                          gpointer user_data,
-                          const GError *error)
+operation_cancelled_cb (GCancellable *cancellable,
+                        gpointer user_data)
 {
-  GrlDataSync *ds = (GrlDataSync *) user_data;
-
-  GRL_DEBUG (__FUNCTION__);
+  grl_operation_cancel (GPOINTER_TO_UINT (user_data));
+}
 
-  if (error) {
+/*
+ * Cancels @operation_id when @cancellable is. Returns the handler to
+ * disconnect when the operation finishes, or 0.
+ */
+static gulong
+operation_connect_cancellable (guint operation_id,
+                               GCancellable *cancellable)
+{
+  if (!cancellable) {
+    return 0;
+  }
+
+  if (g_cancellable_is_cancelled (cancellable)) {
+    grl_operation_cancel (operation_id);
+    return 0;
+  }
+
+  /* Not using g_cancellable_connect(), as the operation might finish from
+     the handler, and g_cancellable_disconnect() would then deadlock */
+  return g_signal_connect (cancellable, "cancelled",
+                           G_CALLBACK (operation_cancelled_cb),
+                           GUINT_TO_POINTER (operation_id));
+}
+
+static void
+resolve_async_cb (GrlSource *source,
+                  guint operation_id,
+                  GrlMedia *media,
+                  gpointer user_data,
+                  const GError *error)
+{
+  struct ResolveAsyncData *rad = (struct ResolveAsyncData *) user_data;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  if (error) {
+    g_simple_async_result_set_from_error (rad->result, error);
+  } else {
+    g_simple_async_result_set_op_res_gpointer (rad->result,
+                                               g_object_ref (media),
+                                               g_object_unref);
+  }
+
+  if (rad->cancel_id) {
+    g_signal_handler_disconnect (rad->cancellable, rad->cancel_id);
+  }
+  if (rad->cancellable) {
+    g_object_unref (rad->cancellable);
+  }
+
+  g_simple_async_result_complete_in_idle (rad->result);
+  g_object_unref (rad->result);
+  g_slice_free (struct ResolveAsyncData, rad);
+}
+
+G_LOCK_DEFINE_STATIC (results_async);
+static GHashTable *results_async = NULL;
+
+static void
+media_list_free (GList *medias)
+{
+  g_list_free_full (medias, g_object_unref);
+}
+
+static void
+results_async_free (struct ResultsAsyncData *rad)
+{
+  G_LOCK (results_async);
+  g_hash_table_remove (results_async, GUINT_TO_POINTER (rad->operation_id));
+  G_UNLOCK (results_async);
+
+  g_queue_foreach (rad->medias, (GFunc) g_object_unref, NULL);
+  g_queue_free (rad->medias);
+  if (rad->error) {
+    g_error_free (rad->error);
+  }
+  if (rad->cancellable) {
+    g_object_unref (rad->cancellable);
+  }
+  g_object_unref (rad->source);
+  g_slice_free (struct ResultsAsyncData, rad);
+}
+
+/*
+ * Sends the user all the results received so far or, once the operation is
+ * done and all of them were sent, the error or the end of the results.
+ */
+static void
+results_async_send (struct ResultsAsyncData *rad)
+{
+  GSimpleAsyncResult *result = rad->pending;
+  GList *medias = NULL;
+  GrlMedia *media;
+  gboolean finished = FALSE;
+
+  rad->pending = NULL;
+
+  if (!g_queue_is_empty (rad->medias)) {
+    while ((media = g_queue_pop_head (rad->medias))) {
+      medias = g_list_prepend (medias, media);
+    }
+    g_simple_async_result_set_op_res_gpointer (result,
+                                               g_list_reverse (medias),
+                                               (GDestroyNotify) media_list_free);
+  } else if (rad->error) {
+    g_simple_async_result_set_from_error (result, rad->error);
+    finished = TRUE;
+  } else {
+    finished = TRUE;
+  }
+
+  g_simple_async_result_complete_in_idle (result);
+  g_object_unref (result);
+
+  if (finished) {
+    results_async_free (rad);
+  } else if (!rad->done && grl_operation_is_paused (rad->operation_id)) {
+    grl_operation_resume (rad->operation_id);
+  }
+}
+
+static void
+results_async_cb (GrlSource *source,
+                  guint operation_id,
+                  GrlMedia *media,
+                  guint remaining,
+                  gpointer user_data,
+                  const GError *error)
+{
+  struct ResultsAsyncData *rad = (struct ResultsAsyncData *) user_data;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  if (media) {
+    g_queue_push_tail (rad->medias, media);
+  }
+
+  if (error && !rad->error) {
+    rad->error = g_error_copy (error);
+  }
+
+  if (remaining == 0) {
+    rad->done = TRUE;
+    if (rad->cancel_id) {
+      g_signal_handler_disconnect (rad->cancellable, rad->cancel_id);
+      rad->cancel_id = 0;
+    }
+
+    /* Nobody will ask for the results of a cancelled operation: drop them,
+       and do not wait for the user to release everything */
+    if (g_error_matches (error,
+                         GRL_CORE_ERROR,
+                         GRL_CORE_ERROR_OPERATION_CANCELLED)) {
+      g_queue_foreach (rad->medias, (GFunc) g_object_unref, NULL);
+      g_queue_clear (rad->medias);
+      if (!rad->pending) {
+        results_async_free (rad);
+        return;
+      }
+    }
+  }
+
+  if (rad->pending && (rad->done || !g_queue_is_empty (rad->medias))) {
+    results_async_send (rad);
+  } else if (!rad->done &&
+             g_queue_get_length (rad->medias) >= rad->high_water_mark) {
+    /* Nobody is asking for them: stop the source until they are */
+    grl_operation_pause (operation_id);
+  }
+}
+
+static guint
+results_async_start (GrlSource *source,
+                     GrlSupportedOps operation_type,
+                     GrlMedia *container,
+                     const gchar *text,
+                     const GList *keys,
+                     GrlOperationOptions *options,
+                     GCancellable *cancellable,
+                     GAsyncReadyCallback callback,
+                     gpointer user_data,
+                     gpointer source_tag)
+{
+  struct ResultsAsyncData *rad;
+  guint operation_id;
+
+  rad = g_slice_new0 (struct ResultsAsyncData);
+  rad->source = g_object_ref (source);
+  rad->medias = g_queue_new ();
+  rad->high_water_mark =
+    grl_operation_options_get_high_water_mark (options);
+  if (rad->high_water_mark == 0) {
+    rad->high_water_mark = RESULTS_ASYNC_HIGH_WATER_MARK;
+  }
+
+  switch (operation_type) {
+  case GRL_OP_BROWSE:
+    operation_id = grl_source_browse (source, container, keys, options,
+                                      results_async_cb, rad);
+    break;
+  case GRL_OP_SEARCH:
+    operation_id = grl_source_search (source, text, keys, options,
+                                      results_async_cb, rad);
+    break;
+  default:
+    operation_id = grl_source_query (source, text, keys, options,
+                                     results_async_cb, rad);
+    break;
+  }
+
+  if (operation_id == 0) {
+    g_queue_free (rad->medias);
+    g_object_unref (rad->source);
+    g_slice_free (struct ResultsAsyncData, rad);
+    return 0;
+  }
+
+  rad->operation_id = operation_id;
+  rad->pending = g_simple_async_result_new (G_OBJECT (source),
+                                            callback,
+                                            user_data,
+                                            source_tag);
+
+  G_LOCK (results_async);
+  if (!results_async) {
+    results_async = g_hash_table_new (g_direct_hash, g_direct_equal);
+  }
+  g_hash_table_insert (results_async, GUINT_TO_POINTER (operation_id), rad);
+  G_UNLOCK (results_async);
+
+  if (cancellable) {
+    rad->cancellable = g_object_ref (cancellable);
+    rad->cancel_id = operation_connect_cancellable (operation_id, cancellable);
+  }
+
+  return operation_id;
+}
+
+static void
+multiple_result_async_cb (GrlSource *source,
+                          guint op_id,
+                          GrlMedia *media,
+                          guint remaining,
+                          gpointer user_data,
+                          const GError *error)
+{
+  GrlDataSync *ds = (GrlDataSync *) user_data;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  if (error) {
     ds->error = g_error_copy (error);
 
     /* Free previous results */
@@ -2681,6 +5030,9 @@ static gboolean
 store_metadata_idle (gpointer user_data)
 {
   GrlSourceStoreMetadataSpec *sms;
+  GrlSourceStoreMetadataBatchSpec *smbs;
+  GrlSource *source;
+  GrlSourceClass *klass;
   gboolean stop;
   struct StoreMetadataRelayCb *smrc;
 
@@ -2688,20 +5040,35 @@ store_metadata_idle (gpointer user_data)
 
   smrc = (struct StoreMetadataRelayCb *) user_data;
 
-  sms = g_new (GrlSourceStoreMetadataSpec, 1);
-
-  sms->source = g_object_ref (g_list_first (smrc->use_sources)->data);
-  sms->keys = g_hash_table_lookup (smrc->map, sms->source);
-  sms->media = g_object_ref (smrc->media);
-  sms->callback = store_metadata_ctl_cb;
-  sms->user_data = smrc;
+  source = GRL_SOURCE (smrc->use_sources->data);
+  klass = GRL_SOURCE_GET_CLASS (source);
 
   /* Remove list header */
-  smrc->use_sources = g_list_remove_link (smrc->use_sources, smrc->use_sources);
-  smrc->specs = g_list_prepend (smrc->specs, sms);
-
+  smrc->use_sources = g_list_delete_link (smrc->use_sources, smrc->use_sources);
   stop = smrc->use_sources == NULL;
-  GRL_SOURCE_GET_CLASS (sms->source)->store_metadata (sms->source, sms);
+
+  if (klass->store_metadata) {
+    sms = g_new0 (GrlSourceStoreMetadataSpec, 1);
+    sms->source = g_object_ref (source);
+    sms->keys = g_hash_table_lookup (smrc->map, source);
+    sms->media = g_object_ref (smrc->media);
+    sms->callback = store_metadata_ctl_cb;
+    sms->user_data = smrc;
+    smrc->specs = g_list_prepend (smrc->specs, sms);
+
+    klass->store_metadata (source, sms);
+  } else {
+    /* The source can only store batches: send a batch of one media */
+    smbs = g_new0 (GrlSourceStoreMetadataBatchSpec, 1);
+    smbs->source = g_object_ref (source);
+    smbs->keys = g_hash_table_lookup (smrc->map, source);
+    smbs->medias = g_list_prepend (NULL, g_object_ref (smrc->media));
+    smbs->callback = store_metadata_ctl_cb;
+    smbs->user_data = smrc;
+    smrc->batch_specs = g_list_prepend (smrc->batch_specs, smbs);
+
+    klass->store_metadata_batch (source, smbs);
+  }
 
   return !stop;
 }
@@ -2743,10 +5110,296 @@ run_store_metadata (GrlSource *source,
   smrc->use_sources = g_hash_table_get_keys (map);
   smrc->failed_keys = failed_keys;
   smrc->specs = NULL;
+  smrc->batch_specs = NULL;
   smrc->user_callback = callback;
   smrc->user_data = user_data;
 
-  g_idle_add (store_metadata_idle, smrc);
+  grl_context_idle_add (NULL, G_PRIORITY_DEFAULT_IDLE, store_metadata_idle, smrc);
+}
+
+static void
+store_metadata_batch_item_free (struct StoreMetadataBatchItem *item)
+{
+  g_object_unref (item->media);
+  g_list_free (item->keys);
+  g_list_free (item->failed_keys);
+  g_slice_free (struct StoreMetadataBatchItem, item);
+}
+
+static void
+store_metadata_route_free (struct StoreMetadataRoute *route)
+{
+  g_hash_table_unref (route->map);
+  g_list_free (route->failed_keys);
+  g_slice_free (struct StoreMetadataRoute, route);
+}
+
+static void
+store_metadata_batch_relay_free (struct StoreMetadataBatchRelayCb *smbrc)
+{
+  g_object_unref (smbrc->source);
+  g_queue_free (smbrc->queue);
+  g_hash_table_unref (smbrc->in_flight);
+  g_list_foreach (smbrc->specs, (GFunc) store_metadata_spec_free, NULL);
+  g_list_free (smbrc->specs);
+  g_list_foreach (smbrc->batch_specs, (GFunc) store_metadata_batch_spec_free, NULL);
+  g_list_free (smbrc->batch_specs);
+  /* Routes must be freed after the specs, as they share the keys */
+  g_hash_table_unref (smbrc->routes);
+
+  g_slice_free (struct StoreMetadataBatchRelayCb, smbrc);
+}
+
+/*
+ * Gets how the keys must be distributed among sources to be written. As
+ * usually all medias have the same keys, this is computed once per key set.
+ */
+static struct StoreMetadataRoute *
+store_metadata_batch_get_route (struct StoreMetadataBatchRelayCb *smbrc,
+                                GList *keys)
+{
+  struct StoreMetadataRoute *route;
+  GList *sorted_keys;
+  GList *k;
+  GString *signature;
+
+  sorted_keys = g_list_sort (g_list_copy (keys), compare_key_ids);
+  signature = g_string_new ("");
+  for (k = sorted_keys; k; k = g_list_next (k)) {
+    g_string_append_printf (signature, "%u,", GRLPOINTER_TO_KEYID (k->data));
+  }
+
+  route = g_hash_table_lookup (smbrc->routes, signature->str);
+  if (route) {
+    g_string_free (signature, TRUE);
+    g_list_free (sorted_keys);
+    return route;
+  }
+
+  route = g_slice_new (struct StoreMetadataRoute);
+  route->map = map_writable_keys (smbrc->source,
+                                  sorted_keys,
+                                  smbrc->flags,
+                                  &route->failed_keys);
+  g_hash_table_insert (smbrc->routes,
+                       g_string_free (signature, FALSE),
+                       route);
+  g_list_free (sorted_keys);
+
+  return route;
+}
+
+static void
+store_metadata_batch_check_done (struct StoreMetadataBatchRelayCb *smbrc);
+
+static void
+store_metadata_batch_item_done (struct StoreMetadataBatchRelayCb *smbrc,
+                                struct StoreMetadataBatchItem *item,
+                                const gchar *error_message)
+{
+  GError *own_error = NULL;
+
+  /* We ignore the plugin errors, instead we create an own error
+     if some keys were not written */
+  if (error_message) {
+    own_error = g_error_new_literal (GRL_CORE_ERROR,
+                                     GRL_CORE_ERROR_STORE_METADATA_FAILED,
+                                     error_message);
+  } else if (item->failed_keys) {
+    own_error = g_error_new (GRL_CORE_ERROR,
+                             GRL_CORE_ERROR_STORE_METADATA_FAILED,
+                             _("Some keys could not be written"));
+  }
+
+  if (smbrc->user_callback) {
+    smbrc->user_callback (smbrc->source,
+                          item->media,
+                          item->failed_keys,
+                          smbrc->user_data,
+                          own_error);
+  }
+
+  if (own_error) {
+    g_error_free (own_error);
+  }
+
+  /* In-flight table owns the items being processed */
+  if (!g_hash_table_remove (smbrc->in_flight, item->media)) {
+    store_metadata_batch_item_free (item);
+  }
+
+  store_metadata_batch_check_done (smbrc);
+}
+
+static void
+store_metadata_batch_ctl_cb (GrlSource *source,
+                             GrlMedia *media,
+                             GList *failed_keys,
+                             gpointer user_data,
+                             const GError *error)
+{
+  struct StoreMetadataBatchRelayCb *smbrc;
+  struct StoreMetadataBatchItem *item;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  smbrc = (struct StoreMetadataBatchRelayCb *) user_data;
+
+  item = g_hash_table_lookup (smbrc->in_flight, media);
+  if (!item || item->pending == 0) {
+    GRL_WARNING ("Source '%s' answered for a media not being stored",
+                 grl_source_get_id (source));
+    return;
+  }
+
+  if (failed_keys) {
+    item->failed_keys = g_list_concat (item->failed_keys, failed_keys);
+  }
+
+  item->pending--;
+  if (item->pending == 0) {
+    store_metadata_batch_item_done (smbrc, item, NULL);
+  }
+}
+
+static void
+store_metadata_batch_dispatch (struct StoreMetadataBatchRelayCb *smbrc,
+                               GrlSource *source,
+                               GList *keys,
+                               GList *medias)
+{
+  GrlSourceClass *klass = GRL_SOURCE_GET_CLASS (source);
+  GrlSourceStoreMetadataBatchSpec *smbs;
+  GrlSourceStoreMetadataSpec *sms;
+  GList *m;
+
+  if (klass->store_metadata_batch) {
+    GRL_DEBUG ("store-metadata-batch: storing %u medias in '%s'",
+               g_list_length (medias), grl_source_get_id (source));
+    smbs = g_new0 (GrlSourceStoreMetadataBatchSpec, 1);
+    smbs->source = g_object_ref (source);
+    smbs->medias = medias;
+    smbs->keys = keys;
+    smbs->flags = smbrc->flags;
+    smbs->callback = store_metadata_batch_ctl_cb;
+    smbs->user_data = smbrc;
+    smbrc->batch_specs = g_list_prepend (smbrc->batch_specs, smbs);
+    klass->store_metadata_batch (source, smbs);
+    return;
+  }
+
+  /* Fallback to storing one by one */
+  for (m = medias; m; m = g_list_next (m)) {
+    sms = g_new0 (GrlSourceStoreMetadataSpec, 1);
+    sms->source = g_object_ref (source);
+    sms->media = m->data;
+    sms->keys = keys;
+    sms->flags = smbrc->flags;
+    sms->callback = store_metadata_batch_ctl_cb;
+    sms->user_data = smbrc;
+    smbrc->specs = g_list_prepend (smbrc->specs, sms);
+    klass->store_metadata (source, sms);
+  }
+  g_list_free (medias);
+}
+
+static gboolean
+store_metadata_batch_idle (gpointer user_data)
+{
+  struct StoreMetadataBatchRelayCb *smbrc;
+  struct StoreMetadataBatchItem *item;
+  struct StoreMetadataRoute *route;
+  GHashTable *groups;
+  GHashTableIter iter;
+  GList *ready = NULL;
+  GList *r;
+  gpointer key;
+  gpointer value;
+  GList *medias;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  smbrc = (struct StoreMetadataBatchRelayCb *) user_data;
+  smbrc->idle_scheduled = FALSE;
+  smbrc->dispatching = TRUE;
+
+  /* Group medias by the source and the keys they need to be written in that
+     source. Note that the same keys list (from the route) is shared by all
+     medias with the same key set */
+  groups = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                  NULL, NULL);
+
+  while (!g_queue_is_empty (smbrc->queue) &&
+         (smbrc->max_concurrent == 0 ||
+          g_hash_table_size (smbrc->in_flight) < smbrc->max_concurrent)) {
+    item = g_queue_pop_head (smbrc->queue);
+    route = store_metadata_batch_get_route (smbrc, item->keys);
+    item->failed_keys = g_list_copy (route->failed_keys);
+
+    if (g_hash_table_size (route->map) == 0) {
+      ready = g_list_prepend (ready, item);
+      continue;
+    }
+
+    item->pending = g_hash_table_size (route->map);
+    g_hash_table_insert (smbrc->in_flight, item->media, item);
+
+    g_hash_table_iter_init (&iter, route->map);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+      medias = g_hash_table_lookup (groups, value);
+      if (!medias) {
+        /* Keep the source in the first element */
+        medias = g_list_prepend (NULL, key);
+      }
+      medias = g_list_insert (medias, g_object_ref (item->media), 1);
+      g_hash_table_insert (groups, value, medias);
+    }
+  }
+
+  g_hash_table_iter_init (&iter, groups);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    medias = (GList *) value;
+    store_metadata_batch_dispatch (smbrc,
+                                   GRL_SOURCE (medias->data),
+                                   (GList *) key,
+                                   g_list_delete_link (medias, medias));
+  }
+  g_hash_table_unref (groups);
+
+  /* Report medias that none of the sources can write */
+  for (r = g_list_reverse (ready); r; r = g_list_next (r)) {
+    store_metadata_batch_item_done (smbrc, r->data,
+                                    _("None of the specified keys are writable"));
+  }
+  g_list_free (ready);
+
+  smbrc->dispatching = FALSE;
+  store_metadata_batch_check_done (smbrc);
+
+  return FALSE;
+}
+
+static void
+store_metadata_batch_check_done (struct StoreMetadataBatchRelayCb *smbrc)
+{
+  if (smbrc->dispatching || smbrc->idle_scheduled) {
+    return;
+  }
+
+  if (!g_queue_is_empty (smbrc->queue)) {
+    /* There is room for more medias */
+    smbrc->idle_scheduled = TRUE;
+    grl_context_idle_add (NULL, G_PRIORITY_DEFAULT_IDLE, store_metadata_batch_idle, smbrc);
+    return;
+  }
+
+  if (g_hash_table_size (smbrc->in_flight) == 0) {
+    /* Everything is done */
+    if (smbrc->user_callback) {
+      smbrc->user_callback (smbrc->source, NULL, NULL, smbrc->user_data, NULL);
+    }
+    store_metadata_batch_relay_free (smbrc);
+  }
 }
 
 static gboolean
@@ -2760,6 +5413,12 @@ check_options (GrlSource *source,
   if (grl_operation_options_get_count (options) == 0)
     return FALSE;
 
+  /* Filters not supported by the source are applied by the core when
+     browsing, searching or querying */
+  if (operation & (GRL_OP_BROWSE | GRL_OP_SEARCH | GRL_OP_QUERY)) {
+    return TRUE;
+  }
+
   /* Check only if the source supports the operation */
   if (grl_source_supported_operations (source) & operation) {
     caps = grl_source_get_caps (source, operation);
@@ -2988,7 +5647,10 @@ grl_source_supported_operations (GrlSource *source)
   if (source_class->remove) {
     ops |= GRL_OP_REMOVE;
   }
-  if (source_class->store_metadata) {
+  if (source_class->count) {
+    ops |= GRL_OP_COUNT;
+  }
+  if (source_class->store_metadata || source_class->store_metadata_batch) {
     ops |= GRL_OP_STORE_METADATA;
   }
 
@@ -3051,6 +5713,61 @@ grl_source_set_auto_split_threshold (GrlSource *source,
   source->priv->auto_split_threshold = threshold;
 }
 
+/**
+ * grl_source_get_result_cache_size:
+ * @source: a source
+ *
+ * Gets the maximum number of browse, search and query requests whose results
+ * are cached.
+ *
+ * See #grl_source_set_result_cache_size()
+ *
+ * Returns: the cache size, or 0 if the cache is disabled
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_source_get_result_cache_size (GrlSource *source)
+{
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+
+  return source->priv->result_cache_size;
+}
+
+/**
+ * grl_source_set_result_cache_size:
+ * @source: a source
+ * @size: maximum number of requests to cache, or 0 to disable the cache
+ *
+ * Enables caching the results of browse, search and query operations in
+ * @source. Results are cached by the shape of the request (container, search
+ * text or query, keys and options), and stored by position, so further
+ * requests asking for a range that is already known are served without
+ * invoking the source. If only the beginning of the range is known, the source
+ * is asked only for the missing elements.
+ *
+ * The cache is invalidated each time the source emits
+ * #GrlSource::content-changed. Least recently used requests are dropped when
+ * there are more than @size requests cached.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_source_set_result_cache_size (GrlSource *source,
+                                  guint size)
+{
+  g_return_if_fail (GRL_IS_SOURCE (source));
+
+  G_LOCK (result_cache);
+  source->priv->result_cache_size = size;
+  if (size == 0) {
+    result_cache_invalidate (source);
+  } else {
+    result_cache_trim (source);
+  }
+  G_UNLOCK (result_cache);
+}
+
 /**
  * grl_source_resolve:
  * @source: a source
@@ -3142,9 +5859,11 @@ grl_source_resolve (GrlSource *source,
      post-processing before handing out the results
      to the user */
   rrc = g_slice_new0 (struct ResolveRelayCb);
+  operation_set_resolve_relay (operation_id, rrc);
   rrc->source = g_object_ref (source);
   rrc->operation_type = GRL_OP_RESOLVE;
   rrc->operation_id = operation_id;
+  rrc->context = grl_operation_ref_context (operation_id);
   rrc->media = g_object_ref (media);
   rrc->user_callback = callback;
   rrc->user_data = user_data;
@@ -3153,11 +5872,10 @@ grl_source_resolve (GrlSource *source,
   /* If there are no sources able to solve just send the media */
   if (g_list_length (sources) == 0) {
     g_list_free (_keys);
-    g_idle_add_full (flags & GRL_RESOLVE_IDLE_RELAY?
-                     G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                     resolve_all_done,
-                     rrc,
-                     NULL);
+    grl_context_idle_add (rrc->context,
+                          relay_idle_priority (options),
+                          resolve_all_done,
+                          rrc);
     return operation_id;
   }
 
@@ -3166,6 +5884,7 @@ grl_source_resolve (GrlSource *source,
   rrc->keys = _keys;
   rrc->map = map_keys_new ();
   rrc->resolve_specs = map_sources_new ();
+  rrc->attempts = map_attempts_new ();
 
   map_keys_to_sources (rrc->map, _keys, sources, media, flags & GRL_RESOLVE_FAST_ONLY);
   g_list_free (sources);
@@ -3185,17 +5904,15 @@ grl_source_resolve (GrlSource *source,
 
   rrc->specs_to_invoke = g_hash_table_get_values (rrc->resolve_specs);
   if (rrc->specs_to_invoke) {
-    g_idle_add_full (flags & GRL_RESOLVE_IDLE_RELAY?
-                     G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                     resolve_idle,
-                     rrc,
-                     NULL);
+    grl_context_idle_add (rrc->context,
+                          relay_idle_priority (options),
+                          resolve_idle,
+                          rrc);
   } else {
-    g_idle_add_full (flags & GRL_RESOLVE_IDLE_RELAY?
-                     G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                     resolve_all_done,
-                     rrc,
-                     NULL);
+    grl_context_idle_add (rrc->context,
+                          relay_idle_priority (options),
+                          resolve_all_done,
+                          rrc);
   }
 
   return operation_id;
@@ -3228,7 +5945,7 @@ grl_source_resolve_sync (GrlSource *source,
 {
   GrlDataSync *ds;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_source_resolve (source,
                           media,
@@ -3246,19 +5963,110 @@ grl_source_resolve_sync (GrlSource *source,
     }
   }
 
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
 
   return media;
 }
 
 /**
- * grl_source_may_resolve:
+ * grl_source_resolve_async:
  * @source: a source
- * @media: a media on which we want more metadata
- * @key_id: the key corresponding to a metadata we might want
- * @missing_keys: (element-type GrlKeyID): an optional originally empty list
+ * @media: (allow-none): a data transfer object
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID<!-- -->s to request
+ * @options: options to pass to this operation
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (scope async): the callback to call when the operation is done
+ * @user_data: the user data to pass to @callback
  *
- * Checks whether @key_id may be resolved with @source for @media, so that the
+ * Asynchronously fetches the requested keys of metadata of @media, the same
+ * way grl_source_resolve() does. When done, @callback is called in the
+ * thread-default main context of the caller; it should call
+ * grl_source_resolve_finish() to get the result.
+ *
+ * The operation can be cancelled either with @cancellable or with
+ * grl_operation_cancel() on the returned identifier.
+ *
+ * Returns: the operation identifier, or 0 if the operation could not be
+ * started
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_source_resolve_async (GrlSource *source,
+                          GrlMedia *media,
+                          const GList *keys,
+                          GrlOperationOptions *options,
+                          GCancellable *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer user_data)
+{
+  struct ResolveAsyncData *rad;
+
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), 0);
+
+  rad = g_slice_new0 (struct ResolveAsyncData);
+  rad->operation_id = grl_source_resolve (source, media, keys, options,
+                                          resolve_async_cb, rad);
+  if (rad->operation_id == 0) {
+    g_slice_free (struct ResolveAsyncData, rad);
+    return 0;
+  }
+
+  rad->result = g_simple_async_result_new (G_OBJECT (source),
+                                           callback,
+                                           user_data,
+                                           grl_source_resolve_async);
+  if (cancellable) {
+    rad->cancellable = g_object_ref (cancellable);
+    rad->cancel_id = operation_connect_cancellable (rad->operation_id,
+                                                    cancellable);
+  }
+
+  return rad->operation_id;
+}
+
+/**
+ * grl_source_resolve_finish:
+ * @source: a source
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a #GError, or %NULL
+ *
+ * Finishes an operation started with grl_source_resolve_async().
+ *
+ * Returns: (transfer full): the resolved #GrlMedia, or %NULL on error
+ *
+ * Since: 0.2.7
+ */
+GrlMedia *
+grl_source_resolve_finish (GrlSource *source,
+                           GAsyncResult *result,
+                           GError **error)
+{
+  GSimpleAsyncResult *res;
+
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (source),
+                                                        grl_source_resolve_async),
+                        NULL);
+
+  res = G_SIMPLE_ASYNC_RESULT (result);
+  if (g_simple_async_result_propagate_error (res, error)) {
+    return NULL;
+  }
+
+  return g_object_ref (g_simple_async_result_get_op_res_gpointer (res));
+}
+
+/**
+ * grl_source_may_resolve:
+ * @source: a source
+ * @media: a media on which we want more metadata
+ * @key_id: the key corresponding to a metadata we might want
+ * @missing_keys: (element-type GrlKeyID): an optional originally empty list
+ *
+ * Checks whether @key_id may be resolved with @source for @media, so that the
  * caller can avoid calling grl_source_resolve() if it can be known in
  * advance it will fail.
  *
@@ -3425,6 +6233,7 @@ grl_source_get_media_from_uri (GrlSource *source,
   rrc->source = g_object_ref (source);
   rrc->operation_type = GRL_OP_MEDIA_FROM_URI;
   rrc->operation_id = operation_id;
+  rrc->context = grl_operation_ref_context (operation_id);
   rrc->keys = _keys;
   rrc->options = g_object_ref (options);
   rrc->user_callback = callback;
@@ -3445,11 +6254,10 @@ grl_source_get_media_from_uri (GrlSource *source,
 
   operation_set_ongoing (source, operation_id);
 
-  g_idle_add_full (flags & GRL_RESOLVE_IDLE_RELAY?
-                   G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                   media_from_uri_idle,
-                   mfus,
-                   NULL);
+  grl_operation_idle_add (operation_id,
+                          relay_idle_priority (options),
+                          media_from_uri_idle,
+                          mfus);
 
   return operation_id;
 }
@@ -3485,7 +6293,7 @@ grl_source_get_media_from_uri_sync (GrlSource *source,
   GrlDataSync *ds;
   GrlMedia *result;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_source_get_media_from_uri (source,
                                      uri,
@@ -3504,7 +6312,7 @@ grl_source_get_media_from_uri_sync (GrlSource *source,
   }
 
   result = (GrlMedia *) ds->data;
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
 
   return result;
 }
@@ -3521,6 +6329,10 @@ grl_source_get_media_from_uri_sync (GrlSource *source,
  *
  * Browse from media elements through an available list.
  *
+ * Type, key and range filters, as well as sorting, in @options that @source
+ * does not support (see grl_source_get_caps()) are applied on the results by
+ * the core.
+ *
  * This method is asynchronous.
  *
  * Returns: the operation identifier
@@ -3579,13 +6391,18 @@ grl_source_browse (GrlSource *source,
   brc->user_data = user_data;
   brc->queue = NULL;
   brc->dispatcher_running = FALSE;
+  brc->high_water_mark = grl_operation_options_get_high_water_mark (options);
+  brc->throttled = FALSE;
+  brc->chunk_pending = FALSE;
+  brc->state = NULL;
 
   bs = g_new (GrlSourceBrowseSpec, 1);
   bs->source = g_object_ref (source);
   bs->operation_id = operation_id;
-  /* _keys is already a copy */
-  bs->keys = _keys;
-  bs->options = grl_operation_options_copy (options);
+  brc->post_filter = post_filter_setup (source, GRL_OP_BROWSE, options,
+                                        &bs->options, &brc->keys);
+  /* brc->keys is already a copy */
+  bs->keys = brc->keys;
   bs->callback = browse_result_relay_cb;
   bs->user_data = brc;
 
@@ -3603,15 +6420,32 @@ grl_source_browse (GrlSource *source,
      the last result */
   brc->spec.browse = bs;
 
-  /* Setup auto-split management if requested */
-  brc->auto_split = auto_split_setup (source, bs->options);
+  /* Setup result cache if enabled */
+  result_cache_setup (brc, grl_media_get_id (bs->container), keys);
+  if (brc->cache_signature) {
+    bs->callback = result_cache_relay_cb;
+  }
 
   operation_set_ongoing (source, operation_id);
+  operation_set_browse_relay (operation_id, brc);
 
-  g_idle_add_full (flags & GRL_RESOLVE_IDLE_RELAY? G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                   browse_idle,
-                   bs,
-                   NULL);
+  /* Serve the results from the cache if possible */
+  if (result_cache_serve (brc)) {
+    return operation_id;
+  }
+
+  /* Setup auto-split management if requested; post-filtering already
+     requests the elements in chunks */
+  if (brc->post_filter) {
+    brc->auto_split = NULL;
+  } else {
+    brc->auto_split = auto_split_setup (source, bs->options);
+  }
+
+  grl_operation_idle_add (operation_id,
+                          relay_idle_priority (options),
+                          browse_idle,
+                          bs);
 
   return operation_id;
 }
@@ -3646,7 +6480,7 @@ grl_source_browse_sync (GrlSource *source,
   GrlDataSync *ds;
   GList *result;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_source_browse (source,
                          container,
@@ -3665,7 +6499,7 @@ grl_source_browse_sync (GrlSource *source,
   }
 
   result = (GList *) ds->data;
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
 
   return result;
 }
@@ -3687,6 +6521,10 @@ grl_source_browse_sync (GrlSource *source,
  * search operations it should notiy the client by setting
  * @GRL_CORE_ERROR_SEARCH_NULL_UNSUPPORTED in @callback's error parameter.
  *
+ * Type, key and range filters, as well as sorting, in @options that @source
+ * does not support (see grl_source_get_caps()) are applied on the results by
+ * the core.
+ *
  * This method is asynchronous.
  *
  * Returns: the operation identifier
@@ -3745,13 +6583,19 @@ grl_source_search (GrlSource *source,
   brc->user_data = user_data;
   brc->queue = NULL;
   brc->dispatcher_running = FALSE;
+  brc->high_water_mark = grl_operation_options_get_high_water_mark (options);
+  brc->throttled = FALSE;
+  brc->chunk_pending = FALSE;
+  brc->state = NULL;
 
   ss = g_new (GrlSourceSearchSpec, 1);
   ss->source = g_object_ref (source);
   ss->operation_id = operation_id;
   ss->text = g_strdup (text);
-  ss->keys = _keys;
-  ss->options = grl_operation_options_copy (options);
+  brc->post_filter = post_filter_setup (source, GRL_OP_SEARCH, options,
+                                        &ss->options, &brc->keys);
+  /* brc->keys is already a copy */
+  ss->keys = brc->keys;
   ss->callback = browse_result_relay_cb;
   ss->user_data = brc;
 
@@ -3760,15 +6604,32 @@ grl_source_search (GrlSource *source,
      the last result */
   brc->spec.search = ss;
 
-  /* Setup auto-split management if requested */
-  brc->auto_split = auto_split_setup (source, ss->options);
+  /* Setup result cache if enabled */
+  result_cache_setup (brc, text, keys);
+  if (brc->cache_signature) {
+    ss->callback = result_cache_relay_cb;
+  }
 
   operation_set_ongoing (source, operation_id);
+  operation_set_browse_relay (operation_id, brc);
 
-  g_idle_add_full (flags & GRL_RESOLVE_IDLE_RELAY? G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                   search_idle,
-                   ss,
-                   NULL);
+  /* Serve the results from the cache if possible */
+  if (result_cache_serve (brc)) {
+    return operation_id;
+  }
+
+  /* Setup auto-split management if requested; post-filtering already
+     requests the elements in chunks */
+  if (brc->post_filter) {
+    brc->auto_split = NULL;
+  } else {
+    brc->auto_split = auto_split_setup (source, ss->options);
+  }
+
+  grl_operation_idle_add (operation_id,
+                          relay_idle_priority (options),
+                          search_idle,
+                          ss);
 
   return operation_id;
 }
@@ -3807,7 +6668,7 @@ grl_source_search_sync (GrlSource *source,
   GrlDataSync *ds;
   GList *result;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_source_search (source,
                          text,
@@ -3826,165 +6687,1025 @@ grl_source_search_sync (GrlSource *source,
   }
 
   result = (GList *) ds->data;
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
+
+  return result;
+}
+
+/**
+ * grl_source_query:
+ * @source: a source
+ * @query: the query to process
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID<!-- -->s to request
+ * @options: options wanted for that operation
+ * @callback: (scope notified): the user defined callback
+ * @user_data: the user data to pass in the callback
+ *
+ * Execute a specialized query (specific for each provider) on a media
+ * repository.
+ *
+ * It is different from grl_source_search() semantically, because the query
+ * implies a carefully crafted string, rather than a simple string to search.
+ *
+ * Type, key and range filters, as well as sorting, in @options that @source
+ * does not support (see grl_source_get_caps()) are applied on the results by
+ * the core.
+ *
+ * This method is asynchronous.
+ *
+ * Returns: the operation identifier
+ *
+ * Since: 0.2.0
+ */
+guint
+grl_source_query (GrlSource *source,
+                  const gchar *query,
+                  const GList *keys,
+                  GrlOperationOptions *options,
+                  GrlSourceResultCb callback,
+                  gpointer user_data)
+{
+  GList *_keys;
+  GrlSourceQuerySpec *qs;
+  guint operation_id;
+  struct BrowseRelayCb *brc;
+  GrlResolutionFlags flags;
+
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+  g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
+  g_return_val_if_fail (query != NULL, 0);
+  g_return_val_if_fail (callback != NULL, 0);
+  g_return_val_if_fail (grl_source_supported_operations (source) &
+                        GRL_OP_QUERY, 0);
+  g_return_val_if_fail (check_options (source, GRL_OP_QUERY, options), 0);
+
+  /* By default assume we will use the parameters specified by the user */
+  _keys = g_list_copy ((GList *) keys);
+
+  flags = grl_operation_options_get_flags (options);
+
+  if (flags & GRL_RESOLVE_FAST_ONLY) {
+    GRL_DEBUG ("requested fast keys");
+    filter_slow (source, &_keys, FALSE);
+  }
+
+  if (flags & GRL_RESOLVE_FULL) {
+    GRL_DEBUG ("requested full metadata");
+    _keys = expand_operation_keys (source, NULL, _keys);
+  }
+
+  operation_id = grl_operation_generate_id ();
+
+  /* Always hook an own relay callback so we can do some
+     post-processing before handing out the results
+     to the user */
+  brc = g_slice_new (struct BrowseRelayCb);
+  brc->source = g_object_ref (source);
+  brc->operation_type = GRL_OP_QUERY;
+  brc->operation_id = operation_id;
+  brc->keys = _keys;
+  brc->options = g_object_ref (options);
+  brc->user_callback = callback;
+  brc->user_data = user_data;
+  brc->queue = NULL;
+  brc->dispatcher_running = FALSE;
+  brc->high_water_mark = grl_operation_options_get_high_water_mark (options);
+  brc->throttled = FALSE;
+  brc->chunk_pending = FALSE;
+  brc->state = NULL;
+
+  qs = g_new (GrlSourceQuerySpec, 1);
+  qs->source = g_object_ref (source);
+  qs->operation_id = operation_id;
+  qs->query = g_strdup (query);
+  brc->post_filter = post_filter_setup (source, GRL_OP_QUERY, options,
+                                        &qs->options, &brc->keys);
+  /* brc->keys is already a copy */
+  qs->keys = brc->keys;
+  qs->callback = browse_result_relay_cb;
+  qs->user_data = brc;
+
+  /* Save a reference to the operaton spec in the relay-cb's
+     user_data so that we can free the spec there when we get
+     the last result */
+  brc->spec.query = qs;
+
+  /* Setup result cache if enabled */
+  result_cache_setup (brc, query, keys);
+  if (brc->cache_signature) {
+    qs->callback = result_cache_relay_cb;
+  }
+
+  operation_set_ongoing (source, operation_id);
+  operation_set_browse_relay (operation_id, brc);
+
+  /* Serve the results from the cache if possible */
+  if (result_cache_serve (brc)) {
+    return operation_id;
+  }
+
+  /* Setup auto-split management if requested; post-filtering already
+     requests the elements in chunks */
+  if (brc->post_filter) {
+    brc->auto_split = NULL;
+  } else {
+    brc->auto_split = auto_split_setup (source, qs->options);
+  }
+
+  grl_operation_idle_add (operation_id,
+                          relay_idle_priority (options),
+                          query_idle,
+                          qs);
+
+  return operation_id;
+}
+
+/**
+ * grl_source_query_sync:
+ * @source: a source
+ * @query: the query to process
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID<!-- -->s to request
+ * @options: options wanted for that operation
+ * @error: a #GError, or @NULL
+ *
+ * Execute a specialized query (specific for each provider) on a media
+ * repository.
+ *
+ * This method is synchronous.
+ *
+ * Returns: (element-type Grl.Media) (transfer full): a #GList with #GrlMedia
+ * elements. After use g_object_unref() every element and g_list_free() the
+ * list.
+ *
+ * Since: 0.2.0
+ */
+GList *
+grl_source_query_sync (GrlSource *source,
+                       const gchar *query,
+                       const GList *keys,
+                       GrlOperationOptions *options,
+                       GError **error)
+{
+  GrlDataSync *ds;
+  GList *result;
+
+  ds = grl_data_sync_new ();
+
+  if (grl_source_query (source,
+                        query,
+                        keys,
+                        options,
+                        multiple_result_async_cb,
+                        ds))
+    grl_wait_for_async_operation_complete (ds);
+
+  if (ds->error) {
+    if (error) {
+      *error = ds->error;
+    } else {
+      g_error_free (ds->error);
+    }
+  }
+
+  result = (GList *) ds->data;
+  grl_data_sync_free (ds);
+
+  return result;
+}
+
+/**
+ * grl_source_browse_async:
+ * @source: a source
+ * @container: (allow-none): a container of data transfer objects
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID<!-- -->s to request
+ * @options: options wanted for that operation
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (scope notified): the callback to call with the first results
+ * @user_data: the user data to pass to @callback
+ *
+ * Browses @container the same way grl_source_browse() does, but handing out
+ * the results in batches instead of one by one.
+ *
+ * @callback is called in the thread-default main context of the caller with
+ * the results received so far, as soon as there is at least one. It should
+ * call grl_source_results_finish() to get them, and then
+ * grl_source_results_next_async() to ask for the following batch. Results
+ * nobody asks for are kept, pausing the operation once there are as many as
+ * the high water mark in @options (or 50 if not set).
+ *
+ * The operation can be cancelled either with @cancellable or with
+ * grl_operation_cancel() on the returned identifier. The results kept are
+ * then dropped. Callers that stop asking for results before getting the
+ * last batch must cancel the operation, or its resources are never
+ * released.
+ *
+ * Returns: the operation identifier, or 0 if the operation could not be
+ * started
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_source_browse_async (GrlSource *source,
+                         GrlMedia *container,
+                         const GList *keys,
+                         GrlOperationOptions *options,
+                         GCancellable *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data)
+{
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), 0);
+
+  return results_async_start (source, GRL_OP_BROWSE, container, NULL,
+                              keys, options, cancellable, callback, user_data,
+                              grl_source_browse_async);
+}
+
+/**
+ * grl_source_search_async:
+ * @source: a source
+ * @text: the text to search
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID<!-- -->s to request
+ * @options: options wanted for that operation
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (scope notified): the callback to call with the first results
+ * @user_data: the user data to pass to @callback
+ *
+ * Searches for @text the same way grl_source_search() does, handing out the
+ * results in batches as described in grl_source_browse_async().
+ *
+ * Returns: the operation identifier, or 0 if the operation could not be
+ * started
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_source_search_async (GrlSource *source,
+                         const gchar *text,
+                         const GList *keys,
+                         GrlOperationOptions *options,
+                         GCancellable *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data)
+{
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), 0);
+
+  return results_async_start (source, GRL_OP_SEARCH, NULL, text,
+                              keys, options, cancellable, callback, user_data,
+                              grl_source_search_async);
+}
+
+/**
+ * grl_source_query_async:
+ * @source: a source
+ * @query: the query to process
+ * @keys: (element-type GrlKeyID): the #GList of
+ * #GrlKeyID<!-- -->s to request
+ * @options: options wanted for that operation
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (scope notified): the callback to call with the first results
+ * @user_data: the user data to pass to @callback
+ *
+ * Runs @query the same way grl_source_query() does, handing out the results
+ * in batches as described in grl_source_browse_async().
+ *
+ * Returns: the operation identifier, or 0 if the operation could not be
+ * started
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_source_query_async (GrlSource *source,
+                        const gchar *query,
+                        const GList *keys,
+                        GrlOperationOptions *options,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
+{
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), 0);
+
+  return results_async_start (source, GRL_OP_QUERY, NULL, query,
+                              keys, options, cancellable, callback, user_data,
+                              grl_source_query_async);
+}
+
+/**
+ * grl_source_results_next_async:
+ * @source: a source
+ * @operation_id: the identifier returned by grl_source_browse_async(),
+ * grl_source_search_async() or grl_source_query_async()
+ * @callback: (scope async): the callback to call with the next results
+ * @user_data: the user data to pass to @callback
+ *
+ * Asks for the next batch of results of @operation_id, once the previous one
+ * was handed out. @callback should call grl_source_results_finish() to get
+ * them. If the operation was cancelled meanwhile, it gets a
+ * %GRL_CORE_ERROR_OPERATION_CANCELLED error.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_source_results_next_async (GrlSource *source,
+                               guint operation_id,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+  struct ResultsAsyncData *rad = NULL;
+
+  g_return_if_fail (GRL_IS_SOURCE (source));
+
+  G_LOCK (results_async);
+  if (results_async) {
+    rad = g_hash_table_lookup (results_async, GUINT_TO_POINTER (operation_id));
+  }
+  G_UNLOCK (results_async);
+
+  /* The operation was cancelled, and its results already dropped */
+  if (!rad) {
+    g_simple_async_report_error_in_idle (G_OBJECT (source),
+                                         callback,
+                                         user_data,
+                                         GRL_CORE_ERROR,
+                                         GRL_CORE_ERROR_OPERATION_CANCELLED,
+                                         _("Operation was cancelled"));
+    return;
+  }
+
+  g_return_if_fail (rad->pending == NULL);
+
+  rad->pending = g_simple_async_result_new (G_OBJECT (source),
+                                            callback,
+                                            user_data,
+                                            grl_source_results_next_async);
+
+  if (rad->done || !g_queue_is_empty (rad->medias)) {
+    results_async_send (rad);
+  }
+}
+
+/**
+ * grl_source_results_finish:
+ * @source: a source
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a #GError, or %NULL
+ *
+ * Gets a batch of results of an operation started with
+ * grl_source_browse_async(), grl_source_search_async() or
+ * grl_source_query_async().
+ *
+ * Returns: (element-type GrlMedia) (transfer full): the results, or %NULL if
+ * there are no more, or on error. Use g_list_free_full() with
+ * g_object_unref() when done.
+ *
+ * Since: 0.2.7
+ */
+GList *
+grl_source_results_finish (GrlSource *source,
+                           GAsyncResult *result,
+                           GError **error)
+{
+  GSimpleAsyncResult *res;
+  GList *medias;
+  GList *m;
+
+  g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (result), NULL);
+
+  res = G_SIMPLE_ASYNC_RESULT (result);
+  if (g_simple_async_result_propagate_error (res, error)) {
+    return NULL;
+  }
+
+  medias = g_list_copy (g_simple_async_result_get_op_res_gpointer (res));
+  for (m = medias; m; m = g_list_next (m)) {
+    g_object_ref (m->data);
+  }
+
+  return medias;
+}
+
+/* ================ Worker threads ================ */
+
+struct _GrlSourceThreadJob {
+  volatile gint ref_count;
+  GrlSource *source;
+  guint operation_id;
+  GrlSourceThreadFunc func;
+  gpointer func_data;
+  GrlSourceResultCb callback;
+  gpointer user_data;
+  GCancellable *cancellable;
+  GMainContext *context;
+  GAsyncQueue *medias;
+  GError *error;
+  volatile gint flush_pending;
+  volatile gint timer_pending;
+  volatile gint done;
+  gboolean finished;
+};
+
+G_LOCK_DEFINE_STATIC (thread_pool);
+static GThreadPool *thread_pool = NULL;
+
+static GrlSourceThreadJob *
+thread_job_ref (GrlSourceThreadJob *job)
+{
+  g_atomic_int_inc (&job->ref_count);
+
+  return job;
+}
+
+static void
+thread_job_unref (GrlSourceThreadJob *job)
+{
+  GrlMedia *media;
+
+  if (!g_atomic_int_dec_and_test (&job->ref_count)) {
+    return;
+  }
+
+  while ((media = g_async_queue_try_pop (job->medias))) {
+    g_object_unref (media);
+  }
+  g_async_queue_unref (job->medias);
+  if (job->error) {
+    g_error_free (job->error);
+  }
+  g_object_unref (job->cancellable);
+  g_main_context_unref (job->context);
+  g_object_unref (job->source);
+  g_slice_free (GrlSourceThreadJob, job);
+}
+
+/*
+ * Hands out the results sent so far by the worker thread. Once the worker is
+ * done, the last one is sent with remaining=0; the job can not be freed here,
+ * as other flushes may be pending.
+ */
+static gboolean
+thread_job_flush (gpointer user_data)
+{
+  GrlSourceThreadJob *job = (GrlSourceThreadJob *) user_data;
+  GrlMedia *media;
+  GrlMedia *last = NULL;
+  gboolean done;
+
+  if (job->finished) {
+    return FALSE;
+  }
+
+  g_atomic_int_set (&job->flush_pending, FALSE);
+
+  /* Once done, the worker does not send anything else, so all the results
+     are already in the queue */
+  done = g_atomic_int_get (&job->done);
+
+  while ((media = g_async_queue_try_pop (job->medias))) {
+    if (last) {
+      job->callback (job->source, job->operation_id, last,
+                     GRL_SOURCE_REMAINING_UNKNOWN, job->user_data, NULL);
+    }
+    last = media;
+  }
+
+  if (!done) {
+    if (last) {
+      job->callback (job->source, job->operation_id, last,
+                     GRL_SOURCE_REMAINING_UNKNOWN, job->user_data, NULL);
+    }
+    return FALSE;
+  }
+
+  job->finished = TRUE;
+
+  if (last && !job->error) {
+    job->callback (job->source, job->operation_id, last, 0,
+                   job->user_data, NULL);
+  } else {
+    if (last) {
+      job->callback (job->source, job->operation_id, last,
+                     GRL_SOURCE_REMAINING_UNKNOWN, job->user_data, NULL);
+    }
+    job->callback (job->source, job->operation_id, NULL, 0,
+                   job->user_data, job->error);
+  }
+
+  return FALSE;
+}
+
+/* Can be called from any thread */
+static void
+thread_job_schedule_flush (GrlSourceThreadJob *job)
+{
+  GSource *source;
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+  g_source_set_callback (source,
+                         thread_job_flush,
+                         thread_job_ref (job),
+                         (GDestroyNotify) thread_job_unref);
+  g_source_attach (source, job->context);
+  g_source_unref (source);
+}
+
+static gboolean
+thread_job_timeout_flush (gpointer user_data)
+{
+  GrlSourceThreadJob *job = (GrlSourceThreadJob *) user_data;
+
+  /* Results queued from now on arm a new timeout, as this flush may miss
+     them */
+  g_atomic_int_set (&job->timer_pending, FALSE);
+
+  return thread_job_flush (job);
+}
+
+/* Can be called from any thread; makes sure the batch that has just been
+   started is handed out in time even if no other result follows it */
+static void
+thread_job_schedule_timeout_flush (GrlSourceThreadJob *job)
+{
+  GSource *source;
+
+  source = g_timeout_source_new (THREAD_JOB_BATCH_INTERVAL);
+  g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+  g_source_set_callback (source,
+                         thread_job_timeout_flush,
+                         thread_job_ref (job),
+                         (GDestroyNotify) thread_job_unref);
+  g_source_attach (source, job->context);
+  g_source_unref (source);
+}
+
+static void
+thread_pool_run (gpointer data,
+                 gpointer user_data)
+{
+  GrlSourceThreadJob *job = (GrlSourceThreadJob *) data;
+
+  /* Do not even start jobs cancelled while waiting their turn */
+  if (!g_cancellable_is_cancelled (job->cancellable)) {
+    job->func (job, job->func_data);
+  }
+
+  g_atomic_int_set (&job->done, TRUE);
+  thread_job_schedule_flush (job);
+  thread_job_unref (job);
+}
+
+/**
+ * grl_source_run_in_thread:
+ * @source: a source
+ * @operation_id: the identifier of the operation the work is done for
+ * @func: (scope async): the blocking function to run
+ * @func_data: the data to pass to @func
+ * @callback: (scope notified): the callback to send the results to
+ * @user_data: the user data to pass to @callback
+ *
+ * Runs @func, which may block (scanning disks, parsing files, reading
+ * databases...), in a pool of worker threads shared by all the sources, so
+ * it does not hold back the results of other operations. This is meant to be
+ * used by sources in their browse(), search() or query() implementations.
+ *
+ * The results @func sends with grl_source_thread_job_send() are handed out
+ * to @callback in batches, in the main context @operation_id was started
+ * in. When @func returns, the last result is sent with remaining=0, or a
+ * %NULL media with the error set with grl_source_thread_job_set_error(), if
+ * any.
+ *
+ * If @operation_id is cancelled, results are not sent any more, and @func is
+ * not run at all if it had not started yet. @callback is always called
+ * with remaining=0 in the end, though.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_source_run_in_thread (GrlSource *source,
+                          guint operation_id,
+                          GrlSourceThreadFunc func,
+                          gpointer func_data,
+                          GrlSourceResultCb callback,
+                          gpointer user_data)
+{
+  GrlSourceThreadJob *job;
+  GCancellable *cancellable;
+
+  g_return_if_fail (GRL_IS_SOURCE (source));
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (callback != NULL);
+
+  cancellable = grl_operation_get_cancellable (operation_id);
+  g_return_if_fail (cancellable != NULL);
+
+  job = g_slice_new0 (GrlSourceThreadJob);
+  job->ref_count = 1;
+  job->source = g_object_ref (source);
+  job->operation_id = operation_id;
+  job->func = func;
+  job->func_data = func_data;
+  job->callback = callback;
+  job->user_data = user_data;
+  job->cancellable = g_object_ref (cancellable);
+  job->context = grl_operation_ref_context (operation_id);
+  job->medias = g_async_queue_new ();
+
+  G_LOCK (thread_pool);
+  if (!thread_pool) {
+    thread_pool = g_thread_pool_new (thread_pool_run, NULL,
+                                     THREAD_POOL_MAX_THREADS, FALSE, NULL);
+  }
+  G_UNLOCK (thread_pool);
+
+  g_thread_pool_push (thread_pool, job, NULL);
+}
+
+/**
+ * grl_source_thread_job_send:
+ * @job: the job being run
+ * @media: (transfer full): a result
+ *
+ * Sends a result of the blocking work. To be called from the
+ * #GrlSourceThreadFunc run by grl_source_run_in_thread().
+ *
+ * Since: 0.2.7
+ */
+void
+grl_source_thread_job_send (GrlSourceThreadJob *job,
+                            GrlMedia *media)
+{
+  g_return_if_fail (job != NULL);
+  g_return_if_fail (GRL_IS_MEDIA (media));
+
+  if (g_cancellable_is_cancelled (job->cancellable)) {
+    g_object_unref (media);
+    return;
+  }
+
+  g_async_queue_push (job->medias, media);
+
+  if (g_async_queue_length (job->medias) >= THREAD_JOB_BATCH_SIZE) {
+    if (g_atomic_int_compare_and_exchange (&job->flush_pending, FALSE, TRUE)) {
+      thread_job_schedule_flush (job);
+    }
+  } else if (g_atomic_int_compare_and_exchange (&job->timer_pending,
+                                                FALSE, TRUE)) {
+    thread_job_schedule_timeout_flush (job);
+  }
+}
+
+/**
+ * grl_source_thread_job_set_error:
+ * @job: the job being run
+ * @error: the error the blocking work failed with
+ *
+ * Sets the error to send along with the last result. To be called from the
+ * #GrlSourceThreadFunc run by grl_source_run_in_thread().
+ *
+ * Since: 0.2.7
+ */
+void
+grl_source_thread_job_set_error (GrlSourceThreadJob *job,
+                                 const GError *error)
+{
+  g_return_if_fail (job != NULL);
+  g_return_if_fail (error != NULL);
+
+  if (job->error) {
+    g_error_free (job->error);
+  }
+  job->error = g_error_copy (error);
+}
+
+/**
+ * grl_source_thread_job_get_cancellable:
+ * @job: the job being run
+ *
+ * Gets a #GCancellable that is cancelled along with the operation. The
+ * #GrlSourceThreadFunc should check it every now and then, and can pass it
+ * to blocking GIO calls.
+ *
+ * Returns: (transfer none): the #GCancellable of the operation
+ *
+ * Since: 0.2.7
+ */
+GCancellable *
+grl_source_thread_job_get_cancellable (GrlSourceThreadJob *job)
+{
+  g_return_val_if_fail (job != NULL, NULL);
+
+  return job->cancellable;
+}
+
+static void
+count_relay_free (struct CountRelayCb *crc)
+{
+  GrlSourceCountSpec *cs = crc->spec;
+
+  if (cs) {
+    g_object_unref (cs->source);
+    if (cs->container) {
+      g_object_unref (cs->container);
+    }
+    g_free (cs->text);
+    g_object_unref (cs->options);
+    g_free (cs);
+  }
+  g_object_unref (crc->source);
+  g_slice_free (struct CountRelayCb, crc);
+}
+
+static void
+count_result_relay_cb (GrlSource *source,
+                       guint operation_id,
+                       guint count,
+                       gpointer user_data,
+                       const GError *error)
+{
+  struct CountRelayCb *crc = (struct CountRelayCb *) user_data;
+  GError *_error = (GError *) error;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  if (operation_is_cancelled (operation_id)) {
+    GRL_DEBUG ("operation was cancelled");
+    _error = g_error_new (GRL_CORE_ERROR,
+                          GRL_CORE_ERROR_OPERATION_CANCELLED,
+                          _("Operation was cancelled"));
+    count = 0;
+  }
+
+  crc->user_callback (source, operation_id, count, crc->user_data, _error);
+  if (_error != error) {
+    g_error_free (_error);
+  }
+
+  operation_set_finished (operation_id);
+  count_relay_free (crc);
+}
+
+/* Used when the source can not count: the results are counted as the
+   source sends them, without handing them to the user */
+static void
+count_fallback_relay_cb (GrlSource *source,
+                         guint operation_id,
+                         GrlMedia *media,
+                         guint remaining,
+                         gpointer user_data,
+                         const GError *error)
+{
+  struct CountRelayCb *crc = (struct CountRelayCb *) user_data;
+
+  if (media) {
+    crc->count++;
+    g_object_unref (media);
+  }
+
+  if (!crc->done) {
+    if (error) {
+      crc->done = TRUE;
+      crc->user_callback (source, operation_id, 0, crc->user_data, error);
+    } else if (remaining == 0) {
+      crc->done = TRUE;
+      crc->user_callback (source, operation_id, crc->count,
+                          crc->user_data, NULL);
+    } else if (crc->estimate &&
+               media &&
+               remaining != GRL_SOURCE_REMAINING_UNKNOWN) {
+      /* Trust the source about the number of results still to come */
+      crc->done = TRUE;
+      crc->user_callback (source, operation_id, crc->count + remaining,
+                          crc->user_data, NULL);
+      grl_operation_cancel (operation_id);
+    }
+  }
+
+  if (remaining == 0) {
+    count_relay_free (crc);
+  }
+}
+
+static gboolean
+count_idle (gpointer user_data)
+{
+  GrlSourceCountSpec *cs = (GrlSourceCountSpec *) user_data;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  /* Abort if operation is cancelled */
+  if (operation_is_cancelled (cs->operation_id)) {
+    cs->callback (cs->source, cs->operation_id, 0, cs->user_data, NULL);
+  } else {
+    operation_set_started (cs->operation_id);
+    GRL_SOURCE_GET_CLASS (cs->source)->count (cs->source, cs);
+  }
+
+  return FALSE;
+}
+
+static guint
+source_count (GrlSource *source,
+              GrlSupportedOps operation,
+              GrlMedia *container,
+              const gchar *text,
+              GrlOperationOptions *options,
+              gboolean estimate,
+              GrlSourceCountCb callback,
+              gpointer user_data)
+{
+  GrlSourceCountSpec *cs;
+  GrlOperationOptions *fallback_options;
+  struct CountRelayCb *crc;
+  guint operation_id;
+
+  crc = g_slice_new0 (struct CountRelayCb);
+  crc->source = g_object_ref (source);
+  crc->estimate = estimate;
+  crc->user_callback = callback;
+  crc->user_data = user_data;
+
+  if (!(grl_source_supported_operations (source) & GRL_OP_COUNT)) {
+    /* Run the operation itself, asking for as little as possible */
+    fallback_options = grl_operation_options_copy (options);
+    grl_operation_options_set_flags (fallback_options,
+                                     grl_operation_options_get_flags (options) &
+                                     ~(GRL_RESOLVE_FULL | GRL_RESOLVE_IDLE_RELAY));
+    grl_operation_options_set_sort (fallback_options,
+                                    GRL_METADATA_KEY_INVALID,
+                                    GRL_SORT_ORDER_ASCENDING);
+
+    switch (operation) {
+    case GRL_OP_BROWSE:
+      operation_id = grl_source_browse (source, container, NULL,
+                                        fallback_options,
+                                        count_fallback_relay_cb, crc);
+      break;
+    case GRL_OP_SEARCH:
+      operation_id = grl_source_search (source, text, NULL,
+                                        fallback_options,
+                                        count_fallback_relay_cb, crc);
+      break;
+    default:
+      operation_id = grl_source_query (source, text, NULL,
+                                       fallback_options,
+                                       count_fallback_relay_cb, crc);
+      break;
+    }
+    g_object_unref (fallback_options);
+
+    crc->operation_id = operation_id;
+    return operation_id;
+  }
+
+  operation_id = grl_operation_generate_id ();
+  crc->operation_id = operation_id;
+
+  cs = g_new0 (GrlSourceCountSpec, 1);
+  cs->source = g_object_ref (source);
+  cs->operation_id = operation_id;
+  cs->operation = operation;
+  cs->container = container? g_object_ref (container): NULL;
+  cs->text = g_strdup (text);
+  cs->options = grl_operation_options_copy (options);
+  cs->estimate = estimate;
+  cs->callback = count_result_relay_cb;
+  cs->user_data = crc;
+
+  /* Save a reference to the operation spec in the relay-cb's
+     user_data so that we can free the spec there */
+  crc->spec = cs;
+
+  operation_set_ongoing (source, operation_id);
+
+  grl_operation_idle_add (operation_id,
+                          relay_idle_priority (options),
+                          count_idle,
+                          cs);
+
+  return operation_id;
+}
+
+/**
+ * grl_source_count_browse:
+ * @source: a source
+ * @container: (allow-none): a container of data transfer objects
+ * @options: options wanted for that operation
+ * @estimate: whether an approximate count is enough
+ * @callback: (scope notified): the user defined callback
+ * @user_data: the user data to pass in the callback
+ *
+ * Counts the elements grl_source_browse() would return for @container and
+ * @options, without retrieving them.
+ *
+ * Sources supporting %GRL_OP_COUNT do it themselves. For other sources the
+ * elements are browsed and counted by the core, without handing them to the
+ * user. If @estimate is %TRUE, an approximate count is enough: the core then
+ * stops as soon as the source tells how many elements remain.
+ *
+ * This method is asynchronous.
+ *
+ * Returns: the operation identifier
+ *
+ * Since: 0.2.7
+ */
+guint
+grl_source_count_browse (GrlSource *source,
+                         GrlMedia *container,
+                         GrlOperationOptions *options,
+                         gboolean estimate,
+                         GrlSourceCountCb callback,
+                         gpointer user_data)
+{
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+  g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
+  g_return_val_if_fail (callback != NULL, 0);
+  g_return_val_if_fail (grl_source_supported_operations (source) &
+                        GRL_OP_BROWSE, 0);
+  g_return_val_if_fail (check_options (source, GRL_OP_BROWSE, options), 0);
 
-  return result;
+  return source_count (source, GRL_OP_BROWSE, container, NULL, options,
+                       estimate, callback, user_data);
 }
 
 /**
- * grl_source_query:
+ * grl_source_count_search:
  * @source: a source
- * @query: the query to process
- * @keys: (element-type GrlKeyID): the #GList of
- * #GrlKeyID<!-- -->s to request
+ * @text: the text to search
  * @options: options wanted for that operation
+ * @estimate: whether an approximate count is enough
  * @callback: (scope notified): the user defined callback
  * @user_data: the user data to pass in the callback
  *
- * Execute a specialized query (specific for each provider) on a media
- * repository.
- *
- * It is different from grl_source_search() semantically, because the query
- * implies a carefully crafted string, rather than a simple string to search.
+ * Counts the elements grl_source_search() would return for @text and
+ * @options, without retrieving them. See grl_source_count_browse().
  *
  * This method is asynchronous.
  *
  * Returns: the operation identifier
  *
- * Since: 0.2.0
+ * Since: 0.2.7
  */
 guint
-grl_source_query (GrlSource *source,
-                  const gchar *query,
-                  const GList *keys,
-                  GrlOperationOptions *options,
-                  GrlSourceResultCb callback,
-                  gpointer user_data)
+grl_source_count_search (GrlSource *source,
+                         const gchar *text,
+                         GrlOperationOptions *options,
+                         gboolean estimate,
+                         GrlSourceCountCb callback,
+                         gpointer user_data)
 {
-  GList *_keys;
-  GrlSourceQuerySpec *qs;
-  guint operation_id;
-  struct BrowseRelayCb *brc;
-  GrlResolutionFlags flags;
-
   g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
   g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
-  g_return_val_if_fail (query != NULL, 0);
   g_return_val_if_fail (callback != NULL, 0);
   g_return_val_if_fail (grl_source_supported_operations (source) &
-                        GRL_OP_QUERY, 0);
-  g_return_val_if_fail (check_options (source, GRL_OP_QUERY, options), 0);
-
-  /* By default assume we will use the parameters specified by the user */
-  _keys = g_list_copy ((GList *) keys);
-
-  flags = grl_operation_options_get_flags (options);
-
-  if (flags & GRL_RESOLVE_FAST_ONLY) {
-    GRL_DEBUG ("requested fast keys");
-    filter_slow (source, &_keys, FALSE);
-  }
-
-  if (flags & GRL_RESOLVE_FULL) {
-    GRL_DEBUG ("requested full metadata");
-    _keys = expand_operation_keys (source, NULL, _keys);
-  }
-
-  operation_id = grl_operation_generate_id ();
-
-  /* Always hook an own relay callback so we can do some
-     post-processing before handing out the results
-     to the user */
-  brc = g_slice_new (struct BrowseRelayCb);
-  brc->source = g_object_ref (source);
-  brc->operation_type = GRL_OP_QUERY;
-  brc->operation_id = operation_id;
-  brc->keys = _keys;
-  brc->options = g_object_ref (options);
-  brc->user_callback = callback;
-  brc->user_data = user_data;
-  brc->queue = NULL;
-  brc->dispatcher_running = FALSE;
-
-  qs = g_new (GrlSourceQuerySpec, 1);
-  qs->source = g_object_ref (source);
-  qs->operation_id = operation_id;
-  qs->query = g_strdup (query);
-  qs->keys = _keys;
-  qs->options = grl_operation_options_copy (options);
-  qs->callback = browse_result_relay_cb;
-  qs->user_data = brc;
-
-  /* Save a reference to the operaton spec in the relay-cb's
-     user_data so that we can free the spec there when we get
-     the last result */
-  brc->spec.query = qs;
-
-  /* Setup auto-split management if requested */
-  brc->auto_split = auto_split_setup (source, qs->options);
-
-  operation_set_ongoing (source, operation_id);
-
-  g_idle_add_full (flags & GRL_RESOLVE_IDLE_RELAY? G_PRIORITY_DEFAULT_IDLE: G_PRIORITY_HIGH_IDLE,
-                   query_idle,
-                   qs,
-                   NULL);
+                        GRL_OP_SEARCH, 0);
+  g_return_val_if_fail (check_options (source, GRL_OP_SEARCH, options), 0);
 
-  return operation_id;
+  return source_count (source, GRL_OP_SEARCH, NULL, text, options,
+                       estimate, callback, user_data);
 }
 
 /**
- * grl_source_query_sync:
+ * grl_source_count_query:
  * @source: a source
  * @query: the query to process
- * @keys: (element-type GrlKeyID): the #GList of
- * #GrlKeyID<!-- -->s to request
  * @options: options wanted for that operation
- * @error: a #GError, or @NULL
+ * @estimate: whether an approximate count is enough
+ * @callback: (scope notified): the user defined callback
+ * @user_data: the user data to pass in the callback
  *
- * Execute a specialized query (specific for each provider) on a media
- * repository.
+ * Counts the elements grl_source_query() would return for @query and
+ * @options, without retrieving them. See grl_source_count_browse().
  *
- * This method is synchronous.
+ * This method is asynchronous.
  *
- * Returns: (element-type Grl.Media) (transfer full): a #GList with #GrlMedia
- * elements. After use g_object_unref() every element and g_list_free() the
- * list.
+ * Returns: the operation identifier
  *
- * Since: 0.2.0
+ * Since: 0.2.7
  */
-GList *
-grl_source_query_sync (GrlSource *source,
-                       const gchar *query,
-                       const GList *keys,
-                       GrlOperationOptions *options,
-                       GError **error)
+guint
+grl_source_count_query (GrlSource *source,
+                        const gchar *query,
+                        GrlOperationOptions *options,
+                        gboolean estimate,
+                        GrlSourceCountCb callback,
+                        gpointer user_data)
 {
-  GrlDataSync *ds;
-  GList *result;
-
-  ds = g_slice_new0 (GrlDataSync);
-
-  if (grl_source_query (source,
-                        query,
-                        keys,
-                        options,
-                        multiple_result_async_cb,
-                        ds))
-    grl_wait_for_async_operation_complete (ds);
-
-  if (ds->error) {
-    if (error) {
-      *error = ds->error;
-    } else {
-      g_error_free (ds->error);
-    }
-  }
-
-  result = (GList *) ds->data;
-  g_slice_free (GrlDataSync, ds);
+  g_return_val_if_fail (GRL_IS_SOURCE (source), 0);
+  g_return_val_if_fail (GRL_IS_OPERATION_OPTIONS (options), 0);
+  g_return_val_if_fail (query != NULL, 0);
+  g_return_val_if_fail (callback != NULL, 0);
+  g_return_val_if_fail (grl_source_supported_operations (source) &
+                        GRL_OP_QUERY, 0);
+  g_return_val_if_fail (check_options (source, GRL_OP_QUERY, options), 0);
 
-  return result;
+  return source_count (source, GRL_OP_QUERY, NULL, query, options,
+                       estimate, callback, user_data);
 }
 
 static gboolean
@@ -4029,7 +7750,7 @@ grl_source_store_remove_impl (GrlSource *source,
     rrc->spec = rs;
   }
 
-  g_idle_add (remove_idle, rrc);
+  grl_context_idle_add (NULL, G_PRIORITY_DEFAULT_IDLE, remove_idle, rrc);
 
   return TRUE;
 }
@@ -4075,7 +7796,7 @@ grl_source_remove_sync (GrlSource *source,
 {
   GrlDataSync *ds;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_source_store_remove_impl (source,
                                     media,
@@ -4091,7 +7812,7 @@ grl_source_remove_sync (GrlSource *source,
     }
   }
 
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
 }
 
 static gboolean
@@ -4131,7 +7852,7 @@ grl_source_store_impl (GrlSource *source,
 
   src->spec = ss;
 
-  g_idle_add (store_idle, ss);
+  grl_context_idle_add (NULL, G_PRIORITY_DEFAULT_IDLE, store_idle, ss);
 
   return TRUE;
 }
@@ -4185,7 +7906,7 @@ grl_source_store_sync (GrlSource *source,
 {
   GrlDataSync *ds;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_source_store_impl (source,
                              parent,
@@ -4203,7 +7924,7 @@ grl_source_store_sync (GrlSource *source,
     }
   }
 
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
 }
 
 static gboolean
@@ -4260,6 +7981,81 @@ grl_source_store_metadata (GrlSource *source,
                                   user_data);
 }
 
+/**
+ * grl_source_store_metadata_batch:
+ * @source: a metadata source
+ * @medias: (element-type GrlMedia GLib.List): a #GHashTable with the
+ * #GrlMedia objects to store as keys, and the #GList of #GrlKeyID whose values
+ * we want to change in each media as values.
+ * @flags: Flags to configure specific behaviors of the operation.
+ * @max_concurrent: maximum number of medias being stored at the same time, or
+ * 0 for no limit
+ * @callback: (scope notified): the callback to execute when each media has
+ * been stored, and once more with a %NULL media when the whole operation is
+ * finished
+ * @user_data: user data set for the @callback
+ *
+ * Stores permanently the values of the specified keys in a set of medias. It is
+ * equivalent to invoking grl_source_store_metadata() for each media, but the
+ * sources in charge of each key are computed only once per set of keys, and
+ * sources implementing the store_metadata_batch() method receive the medias
+ * that have to store together.
+ *
+ * @callback is invoked once for each media, with the list of keys that could
+ * not be written in that media, if any. After all medias have been processed,
+ * @callback is invoked one last time with %NULL media.
+ *
+ * This function is asynchronous and uses the Glib's main loop.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_source_store_metadata_batch (GrlSource *source,
+                                 GHashTable *medias,
+                                 GrlWriteFlags flags,
+                                 guint max_concurrent,
+                                 GrlSourceStoreCb callback,
+                                 gpointer user_data)
+{
+  struct StoreMetadataBatchRelayCb *smbrc;
+  struct StoreMetadataBatchItem *item;
+  GHashTableIter iter;
+  gpointer media;
+  gpointer keys;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  g_return_if_fail (GRL_IS_SOURCE (source));
+  g_return_if_fail (medias != NULL);
+
+  smbrc = g_slice_new0 (struct StoreMetadataBatchRelayCb);
+  smbrc->source = g_object_ref (source);
+  smbrc->flags = flags;
+  smbrc->max_concurrent = max_concurrent;
+  smbrc->queue = g_queue_new ();
+  smbrc->in_flight =
+    g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                           NULL,
+                           (GDestroyNotify) store_metadata_batch_item_free);
+  smbrc->routes =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           g_free,
+                           (GDestroyNotify) store_metadata_route_free);
+  smbrc->user_callback = callback;
+  smbrc->user_data = user_data;
+
+  g_hash_table_iter_init (&iter, medias);
+  while (g_hash_table_iter_next (&iter, &media, &keys)) {
+    item = g_slice_new0 (struct StoreMetadataBatchItem);
+    item->media = g_object_ref (media);
+    item->keys = g_list_copy ((GList *) keys);
+    g_queue_push_tail (smbrc->queue, item);
+  }
+
+  smbrc->idle_scheduled = TRUE;
+  grl_context_idle_add (NULL, G_PRIORITY_DEFAULT_IDLE, store_metadata_batch_idle, smbrc);
+}
+
 /**
  * grl_source_store_metadata_sync:
  * @source: a source
@@ -4290,7 +8086,7 @@ grl_source_store_metadata_sync (GrlSource *source,
   GrlDataSync *ds;
   GList *failed;
 
-  ds = g_slice_new0 (GrlDataSync);
+  ds = grl_data_sync_new ();
 
   if (grl_source_store_metadata_impl (source,
                                       media,
@@ -4310,7 +8106,7 @@ grl_source_store_metadata_sync (GrlSource *source,
 
   failed = ds->data;
 
-  g_slice_free (GrlDataSync, ds);
+  grl_data_sync_free (ds);
 
   return failed;
 }
@@ -4367,6 +8163,277 @@ grl_source_notify_change_stop (GrlSource *source,
   return GRL_SOURCE_GET_CLASS (source)->notify_change_stop (source, error);
 }
 
+/* Changes are identified by the media id, or by the media itself when it
+   has no id */
+static guint
+pending_change_hash (gconstpointer key)
+{
+  const PendingChange *change = (const PendingChange *) key;
+
+  if (change->id) {
+    return g_str_hash (change->id);
+  } else {
+    return g_direct_hash (change->media);
+  }
+}
+
+static gboolean
+pending_change_equal (gconstpointer a,
+                      gconstpointer b)
+{
+  const PendingChange *change_a = (const PendingChange *) a;
+  const PendingChange *change_b = (const PendingChange *) b;
+
+  if (change_a->id && change_b->id) {
+    return g_str_equal (change_a->id, change_b->id);
+  } else if (!change_a->id && !change_b->id) {
+    return change_a->media == change_b->media;
+  } else {
+    return FALSE;
+  }
+}
+
+static void
+pending_change_free (PendingChange *change)
+{
+  g_free (change->id);
+  g_object_unref (change->media);
+  g_slice_free (PendingChange, change);
+}
+
+/* Must be called with the pending_changes lock held */
+static void
+pending_changes_clear (GrlSource *source)
+{
+  if (source->priv->change_timeout_id) {
+    grl_context_source_remove (source->priv->change_context,
+                               source->priv->change_timeout_id);
+    source->priv->change_timeout_id = 0;
+  }
+  if (source->priv->change_context) {
+    g_main_context_unref (source->priv->change_context);
+    source->priv->change_context = NULL;
+  }
+
+  g_queue_clear (source->priv->pending_changes_order);
+  g_hash_table_remove_all (source->priv->pending_changes);
+  source->priv->pending_changes_overflow = FALSE;
+}
+
+static void
+pending_changes_emit (GrlSource *source,
+                      GPtrArray *changed_medias,
+                      GrlSourceChangeType change_type,
+                      gboolean location_unknown)
+{
+  if (changed_medias->len > 0) {
+    g_signal_emit (source,
+                   registry_signals[SIG_CONTENT_CHANGED],
+                   0,
+                   changed_medias,
+                   change_type,
+                   location_unknown);
+  }
+  g_ptr_array_unref (changed_medias);
+}
+
+static void
+pending_changes_flush (GrlSource *source)
+{
+  GPtrArray *batches[3][2];
+  GPtrArray *changed_medias;
+  GrlMedia *root;
+  PendingChange *change;
+  gint type;
+  gint unknown;
+
+  /* The signals are emitted out of the lock, as handlers may notify other
+     changes */
+  G_LOCK (pending_changes);
+
+  if (source->priv->pending_changes_overflow) {
+    /* Too many changes: just tell something happened somewhere */
+    GRL_DEBUG ("coalescing: too many changes in '%s', notifying root",
+               grl_source_get_id (source));
+    pending_changes_clear (source);
+    G_UNLOCK (pending_changes);
+    root = grl_media_box_new ();
+    grl_media_set_source (root, grl_source_get_id (source));
+    changed_medias = g_ptr_array_new_with_free_func (g_object_unref);
+    g_ptr_array_add (changed_medias, root);
+    pending_changes_emit (source, changed_medias, GRL_CONTENT_CHANGED, TRUE);
+    return;
+  }
+
+  /* Group changes by type, keeping the order in which they happened */
+  for (type = 0; type < 3; type++) {
+    for (unknown = 0; unknown < 2; unknown++) {
+      batches[type][unknown] = g_ptr_array_new_with_free_func (g_object_unref);
+    }
+  }
+
+  while ((change = g_queue_pop_head (source->priv->pending_changes_order))) {
+    g_ptr_array_add (batches[change->change_type][change->location_unknown? 1: 0],
+                     g_object_ref (change->media));
+  }
+
+  pending_changes_clear (source);
+
+  G_UNLOCK (pending_changes);
+
+  for (type = 0; type < 3; type++) {
+    for (unknown = 0; unknown < 2; unknown++) {
+      pending_changes_emit (source,
+                            batches[type][unknown],
+                            (GrlSourceChangeType) type,
+                            unknown);
+    }
+  }
+}
+
+static gboolean
+pending_changes_timeout (gpointer user_data)
+{
+  GrlSource *source = GRL_SOURCE (user_data);
+
+  G_LOCK (pending_changes);
+  source->priv->change_timeout_id = 0;
+  g_main_context_unref (source->priv->change_context);
+  source->priv->change_context = NULL;
+  G_UNLOCK (pending_changes);
+
+  g_object_ref (source);
+  pending_changes_flush (source);
+  g_object_unref (source);
+
+  return FALSE;
+}
+
+/*
+ * Merges a new change of @media with the one pending (if any):
+ *  - added + removed cancel each other
+ *  - removed + added becomes changed
+ *  - added + changed is still added
+ *  - otherwise, the last change wins (repeated changes collapse)
+ */
+static void
+pending_changes_add (GrlSource *source,
+                     GrlMedia *media,
+                     GrlSourceChangeType change_type,
+                     gboolean location_unknown)
+{
+  GrlSourcePrivate *priv = source->priv;
+  PendingChange *change;
+  PendingChange key;
+
+  G_LOCK (pending_changes);
+
+  /* The changes are emitted in the thread-default main context of the code
+     notifying the first one */
+  if (!priv->change_timeout_id) {
+    priv->change_context = g_main_context_get_thread_default ();
+    if (!priv->change_context) {
+      priv->change_context = g_main_context_default ();
+    }
+    g_main_context_ref (priv->change_context);
+    priv->change_timeout_id = grl_context_timeout_add (priv->change_context,
+                                                       priv->change_window,
+                                                       pending_changes_timeout,
+                                                       source);
+  }
+
+  if (priv->pending_changes_overflow) {
+    G_UNLOCK (pending_changes);
+    return;
+  }
+
+  key.id = (gchar *) grl_media_get_id (media);
+  key.media = media;
+  change = g_hash_table_lookup (priv->pending_changes, &key);
+  if (!change) {
+    if (priv->change_max_batch > 0 &&
+        g_hash_table_size (priv->pending_changes) >= priv->change_max_batch) {
+      g_queue_clear (priv->pending_changes_order);
+      g_hash_table_remove_all (priv->pending_changes);
+      priv->pending_changes_overflow = TRUE;
+      G_UNLOCK (pending_changes);
+      return;
+    }
+
+    change = g_slice_new (PendingChange);
+    change->id = g_strdup (key.id);
+    change->media = g_object_ref (media);
+    change->change_type = change_type;
+    change->location_unknown = location_unknown;
+    g_hash_table_insert (priv->pending_changes, change, change);
+    g_queue_push_tail (priv->pending_changes_order, change);
+    G_UNLOCK (pending_changes);
+    return;
+  }
+
+  if (change->change_type == GRL_CONTENT_ADDED &&
+      change_type == GRL_CONTENT_REMOVED) {
+    g_queue_remove (priv->pending_changes_order, change);
+    g_hash_table_remove (priv->pending_changes, change);
+    G_UNLOCK (pending_changes);
+    return;
+  }
+
+  if (change->change_type == GRL_CONTENT_REMOVED &&
+      change_type == GRL_CONTENT_ADDED) {
+    change->change_type = GRL_CONTENT_CHANGED;
+  } else if (change->change_type != GRL_CONTENT_ADDED ||
+             change_type != GRL_CONTENT_CHANGED) {
+    change->change_type = change_type;
+  }
+
+  change->location_unknown = change->location_unknown || location_unknown;
+  g_object_unref (change->media);
+  change->media = g_object_ref (media);
+
+  G_UNLOCK (pending_changes);
+}
+
+/**
+ * grl_source_set_change_coalescing:
+ * @source: a source
+ * @window: time window in milliseconds, or 0 to disable coalescing
+ * @max_batch: maximum number of medias to coalesce, or 0 for no limit
+ *
+ * Enables coalescing the changes notified by @source. Instead of emitting
+ * #GrlSource::content-changed for each notified change, changes are
+ * accumulated during @window milliseconds and merged per media: a media that
+ * was added and removed is not notified, and repeated changes are notified
+ * once. After the window, the resulting changes are emitted grouped by kind.
+ *
+ * If more than @max_batch different medias change during the window, a
+ * single change in the root box, with location unknown, is emitted instead.
+ *
+ * Disabling coalescing emits the pending changes immediately.
+ *
+ * Since: 0.2.7
+ */
+void
+grl_source_set_change_coalescing (GrlSource *source,
+                                  guint window,
+                                  guint max_batch)
+{
+  gboolean pending;
+
+  g_return_if_fail (GRL_IS_SOURCE (source));
+
+  G_LOCK (pending_changes);
+  source->priv->change_window = window;
+  source->priv->change_max_batch = max_batch;
+  pending = source->priv->pending_changes_overflow ||
+    g_hash_table_size (source->priv->pending_changes) > 0;
+  G_UNLOCK (pending_changes);
+
+  if (window == 0 && pending) {
+    pending_changes_flush (source);
+  }
+}
+
 /**
  * grl_source_notify_change_list:
  * @source: a source
@@ -4398,6 +8465,8 @@ void grl_source_notify_change_list (GrlSource *source,
                                     gboolean location_unknown)
 {
   const gchar *source_id;
+  guint window;
+  guint i;
 
   g_return_if_fail (GRL_IS_SOURCE (source));
   g_return_if_fail (changed_medias);
@@ -4411,12 +8480,25 @@ void grl_source_notify_change_list (GrlSource *source,
   /* Add hook to free content when freeing the array */
   g_ptr_array_set_free_func (changed_medias, (GDestroyNotify) g_object_unref);
 
-  g_signal_emit (source,
-                 registry_signals[SIG_CONTENT_CHANGED],
-                 0,
-                 changed_medias,
-                 change_type,
-                 location_unknown);
+  G_LOCK (pending_changes);
+  window = source->priv->change_window;
+  G_UNLOCK (pending_changes);
+
+  if (window == 0) {
+    g_signal_emit (source,
+                   registry_signals[SIG_CONTENT_CHANGED],
+                   0,
+                   changed_medias,
+                   change_type,
+                   location_unknown);
+  } else {
+    for (i = 0; i < changed_medias->len; i++) {
+      pending_changes_add (source,
+                           g_ptr_array_index (changed_medias, i),
+                           change_type,
+                           location_unknown);
+    }
+  }
 
   g_ptr_array_unref (changed_medias);
 }
@@ -36,6 +36,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 /* Macros */
 
@@ -92,6 +93,8 @@ struct _GrlSource {
  * @GRL_OP_MEDIA_FROM_URI: Create a #GrlMedia instance from an URI
  * representing a media resource.
  * @GRL_OP_NOTIFY_CHANGE: Notify about changes in the #GrlMediaSource.
+ * @GRL_OP_COUNT: Count the results of browse, search or query operations
+ * without retrieving them.
  *
  * Bitwise flags which reflect the kind of operations that a
  * #GrlSource supports.
@@ -107,7 +110,8 @@ typedef enum {
   GRL_OP_STORE_METADATA  = 1 << 6,
   GRL_OP_REMOVE          = 1 << 7,
   GRL_OP_MEDIA_FROM_URI  = 1 << 8,
-  GRL_OP_NOTIFY_CHANGE   = 1 << 9
+  GRL_OP_NOTIFY_CHANGE   = 1 << 9,
+  GRL_OP_COUNT           = 1 << 10
 } GrlSupportedOps;
 
 /**
@@ -161,6 +165,44 @@ typedef void (*GrlSourceResultCb) (GrlSource *source,
                                    gpointer user_data,
                                    const GError *error);
 
+/**
+ * GrlSourceThreadJob:
+ *
+ * Opaque structure handed to a #GrlSourceThreadFunc, used to send the
+ * results of the blocking work back to the operation.
+ */
+typedef struct _GrlSourceThreadJob GrlSourceThreadJob;
+
+/**
+ * GrlSourceThreadFunc:
+ * @job: the job being run
+ * @user_data: the data passed to grl_source_run_in_thread()
+ *
+ * Prototype for the blocking function run in a worker thread by
+ * grl_source_run_in_thread(). It should send each result with
+ * grl_source_thread_job_send(), and stop as soon as possible once the
+ * cancellable from grl_source_thread_job_get_cancellable() is cancelled.
+ */
+typedef void (*GrlSourceThreadFunc) (GrlSourceThreadJob *job,
+                                     gpointer user_data);
+
+/**
+ * GrlSourceCountCb:
+ * @source: a source
+ * @operation_id: operation identifier
+ * @count: the number of results
+ * @user_data: user data passed to the used method
+ * @error: (type uint): possible #GError generated at processing
+ *
+ * Prototype for the callback passed to grl_source_count_browse(),
+ * grl_source_count_search() and grl_source_count_query()
+ */
+typedef void (*GrlSourceCountCb) (GrlSource *source,
+                                  guint operation_id,
+                                  guint count,
+                                  gpointer user_data,
+                                  const GError *error);
+
 /**
  * GrlSourceRemoveCb:
  * @source: a source
@@ -244,6 +286,38 @@ typedef struct {
   gpointer _grl_reserved[GRL_PADDING];
 } GrlSourceMediaFromUriSpec;
 
+/**
+ * GrlSourceCountSpec:
+ * @source: a source
+ * @operation_id: operation identifier
+ * @operation: the operation to count the results of: %GRL_OP_BROWSE,
+ * %GRL_OP_SEARCH or %GRL_OP_QUERY
+ * @container: the container to browse, for %GRL_OP_BROWSE
+ * @text: the text to search for, or the query, for %GRL_OP_SEARCH and
+ * %GRL_OP_QUERY
+ * @options: options of the operation to count the results of
+ * @estimate: whether an approximate, cheaper to compute, count is enough
+ * @callback: the user defined callback
+ * @user_data: the user data to pass in the callback
+ *
+ * Data transport structure used internally by the plugins which support
+ * count vmethod.
+ */
+typedef struct {
+  GrlSource *source;
+  guint operation_id;
+  GrlSupportedOps operation;
+  GrlMedia *container;
+  gchar *text;
+  GrlOperationOptions *options;
+  gboolean estimate;
+  GrlSourceCountCb callback;
+  gpointer user_data;
+
+  /*< private >*/
+  gpointer _grl_reserved[GRL_PADDING];
+} GrlSourceCountSpec;
+
 /**
  * GrlSourceBrowseSpec:
  * @source: a source
@@ -392,6 +466,30 @@ typedef struct {
   gpointer _grl_reserved[GRL_PADDING];
 } GrlSourceStoreMetadataSpec;
 
+/**
+ * GrlSourceStoreMetadataBatchSpec:
+ * @source: a source
+ * @medias: (element-type GrlMedia): list of #GrlMedia transfer objects
+ * @keys: List of keys to be stored/updated in each media.
+ * @flags: Flags to control specific bahviors of the set metadata operation.
+ * @callback: the callback to invoke once for each media in @medias
+ * @user_data: user data to pass in @callback
+ *
+ * Data transport structure used internally by the plugins which support
+ * store_metadata_batch vmethod.
+ */
+typedef struct {
+  GrlSource *source;
+  GList *medias;
+  GList *keys;
+  GrlWriteFlags flags;
+  GrlSourceStoreCb callback;
+  gpointer user_data;
+
+  /*< private >*/
+  gpointer _grl_reserved[GRL_PADDING];
+} GrlSourceStoreMetadataBatchSpec;
+
 /* GrlSource class */
 
 typedef struct _GrlSourceClass GrlSourceClass;
@@ -420,6 +518,11 @@ typedef struct _GrlSourceClass GrlSourceClass;
  * @cancel: cancel the current operation
  * @notify_change_start: start emitting signals about changes in content
  * @notify_change_stop: stop emitting signals about changes in content
+ * @store_metadata_batch: update metadata values for a set of objects in a
+ * permanent fashion
+ * @count: count the results of a browse, search or query operation
+ * @pause: stop sending results for the current operation until resumed
+ * @resume: resume sending results for the current operation
  *
  * Grilo Source class. Override the vmethods to implement the
  * element functionality.
@@ -469,8 +572,17 @@ struct _GrlSourceClass {
   gboolean (*notify_change_stop) (GrlSource *source,
                                   GError **error);
 
+  void (*store_metadata_batch) (GrlSource *source,
+                                GrlSourceStoreMetadataBatchSpec *smbs);
+
+  void (*count) (GrlSource *source, GrlSourceCountSpec *cs);
+
+  void (*pause) (GrlSource *source, guint operation_id);
+
+  void (*resume) (GrlSource *source, guint operation_id);
+
   /*< private >*/
-  gpointer _grl_reserved[GRL_PADDING];
+  gpointer _grl_reserved[GRL_PADDING - 4];
 };
 
 G_BEGIN_DECLS
@@ -493,6 +605,15 @@ void grl_source_set_auto_split_threshold (GrlSource *source,
 
 guint grl_source_get_auto_split_threshold (GrlSource *source);
 
+void grl_source_set_result_cache_size (GrlSource *source,
+                                       guint size);
+
+guint grl_source_get_result_cache_size (GrlSource *source);
+
+void grl_source_set_change_coalescing (GrlSource *source,
+                                       guint window,
+                                       guint max_batch);
+
 
 guint grl_source_resolve (GrlSource *source,
                           GrlMedia *media,
@@ -507,6 +628,18 @@ GrlMedia *grl_source_resolve_sync (GrlSource *source,
                                    GrlOperationOptions *options,
                                    GError **error);
 
+guint grl_source_resolve_async (GrlSource *source,
+                                GrlMedia *media,
+                                const GList *keys,
+                                GrlOperationOptions *options,
+                                GCancellable *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data);
+
+GrlMedia *grl_source_resolve_finish (GrlSource *source,
+                                     GAsyncResult *result,
+                                     GError **error);
+
 gboolean grl_source_may_resolve (GrlSource *source,
                                  GrlMedia *media,
                                  GrlKeyID key_id,
@@ -567,6 +700,75 @@ GList *grl_source_query_sync (GrlSource *source,
                               GrlOperationOptions *options,
                               GError **error);
 
+guint grl_source_browse_async (GrlSource *source,
+                               GrlMedia *container,
+                               const GList *keys,
+                               GrlOperationOptions *options,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data);
+
+guint grl_source_search_async (GrlSource *source,
+                               const gchar *text,
+                               const GList *keys,
+                               GrlOperationOptions *options,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data);
+
+guint grl_source_query_async (GrlSource *source,
+                              const gchar *query,
+                              const GList *keys,
+                              GrlOperationOptions *options,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data);
+
+void grl_source_results_next_async (GrlSource *source,
+                                    guint operation_id,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+
+GList *grl_source_results_finish (GrlSource *source,
+                                  GAsyncResult *result,
+                                  GError **error);
+
+void grl_source_run_in_thread (GrlSource *source,
+                               guint operation_id,
+                               GrlSourceThreadFunc func,
+                               gpointer func_data,
+                               GrlSourceResultCb callback,
+                               gpointer user_data);
+
+void grl_source_thread_job_send (GrlSourceThreadJob *job,
+                                 GrlMedia *media);
+
+void grl_source_thread_job_set_error (GrlSourceThreadJob *job,
+                                      const GError *error);
+
+GCancellable *grl_source_thread_job_get_cancellable (GrlSourceThreadJob *job);
+
+guint grl_source_count_browse (GrlSource *source,
+                               GrlMedia *container,
+                               GrlOperationOptions *options,
+                               gboolean estimate,
+                               GrlSourceCountCb callback,
+                               gpointer user_data);
+
+guint grl_source_count_search (GrlSource *source,
+                               const gchar *text,
+                               GrlOperationOptions *options,
+                               gboolean estimate,
+                               GrlSourceCountCb callback,
+                               gpointer user_data);
+
+guint grl_source_count_query (GrlSource *source,
+                              const gchar *query,
+                              GrlOperationOptions *options,
+                              gboolean estimate,
+                              GrlSourceCountCb callback,
+                              gpointer user_data);
+
 void grl_source_remove (GrlSource *source,
                         GrlMedia *media,
                         GrlSourceRemoveCb callback,
@@ -596,6 +798,13 @@ void grl_source_store_metadata (GrlSource *source,
                                 GrlSourceStoreCb callback,
                                 gpointer user_data);
 
+void grl_source_store_metadata_batch (GrlSource *source,
+                                      GHashTable *medias,
+                                      GrlWriteFlags flags,
+                                      guint max_concurrent,
+                                      GrlSourceStoreCb callback,
+                                      gpointer user_data);
+
 GList *grl_source_store_metadata_sync (GrlSource *source,
                                        GrlMedia *media,
                                        GList *keys,
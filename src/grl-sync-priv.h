@@ -29,8 +29,16 @@ typedef struct {
   gboolean complete;
   gpointer data;
   GError *error;
+  GMainContext *context;
+  gboolean private_context;
 } GrlDataSync;
 
+GrlDataSync *
+grl_data_sync_new (void);
+
+void
+grl_data_sync_free (GrlDataSync *ds);
+
 void
 grl_wait_for_async_operation_complete (GrlDataSync *ds);
 
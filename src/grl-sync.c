@@ -23,19 +23,65 @@
 
 #include "grl-sync-priv.h"
 
-void
-grl_wait_for_async_operation_complete (GrlDataSync *ds)
+/*
+ * grl_data_sync_new:
+ *
+ * Prepares to run an operation synchronously.
+ *
+ * If the caller has pushed a thread-default main context, the operation is
+ * run there. Otherwise, a private main context is made the thread-default one
+ * until grl_data_sync_free() is called, so the operation is dispatched there
+ * and nothing else runs while waiting for it; the global default context is
+ * never iterated, as it may be owned by another thread.
+ *
+ * Returns: a new #GrlDataSync
+ */
+GrlDataSync *
+grl_data_sync_new (void)
 {
-  GMainLoop *ml;
-  GMainContext *mc;
+  GrlDataSync *ds;
+  GMainContext *context;
 
-  ml = g_main_loop_new (g_main_context_get_thread_default (), TRUE);
-  mc = g_main_loop_get_context (ml);
+  ds = g_slice_new0 (GrlDataSync);
 
- while (!ds->complete) {
-    g_main_context_iteration (mc, TRUE);
+  context = g_main_context_get_thread_default ();
+  if (context && context != g_main_context_default ()) {
+    ds->context = g_main_context_ref (context);
+  } else {
+    ds->context = g_main_context_new ();
+    ds->private_context = TRUE;
+    g_main_context_push_thread_default (ds->context);
   }
 
-  g_main_loop_unref (ml);
+  return ds;
 }
 
+/*
+ * grl_data_sync_free:
+ * @ds: a #GrlDataSync
+ *
+ * Restores the thread-default main context, once the operation is
+ * complete. The data and error are not freed.
+ */
+void
+grl_data_sync_free (GrlDataSync *ds)
+{
+  if (ds->private_context) {
+    /* Let the operation release its resources */
+    while (g_main_context_pending (ds->context)) {
+      g_main_context_iteration (ds->context, FALSE);
+    }
+    g_main_context_pop_thread_default (ds->context);
+  }
+
+  g_main_context_unref (ds->context);
+  g_slice_free (GrlDataSync, ds);
+}
+
+void
+grl_wait_for_async_operation_complete (GrlDataSync *ds)
+{
+  while (!ds->complete) {
+    g_main_context_iteration (ds->context, TRUE);
+  }
+}
@@ -71,3 +71,95 @@ grl_g_value_dup (const GValue *value)
 
   return new_value;
 }
+
+/*
+ * Compares two values of the same (or transformable) type.
+ *
+ * Returns: a negative value if @value1 is lesser than @value2, a positive
+ * value if it is greater, and 0 if they are equal. A %NULL value is lesser
+ * than any other, and values of types that can not be compared are
+ * considered equal.
+ */
+gint
+grl_g_value_compare (const GValue *value1,
+                     const GValue *value2)
+{
+  GValue transformed = { 0 };
+  gint result = 0;
+
+  if (!value1 || !value2) {
+    return (value1 != NULL) - (value2 != NULL);
+  }
+
+  if (G_VALUE_TYPE (value1) != G_VALUE_TYPE (value2)) {
+    g_value_init (&transformed, G_VALUE_TYPE (value1));
+    if (!g_value_transform (value2, &transformed)) {
+      g_value_unset (&transformed);
+      return 0;
+    }
+    value2 = &transformed;
+  }
+
+#define CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (value1))) {
+  case G_TYPE_STRING:
+    result = g_strcmp0 (g_value_get_string (value1),
+                        g_value_get_string (value2));
+    break;
+  case G_TYPE_BOOLEAN:
+    result = CMP (g_value_get_boolean (value1) != FALSE,
+                  g_value_get_boolean (value2) != FALSE);
+    break;
+  case G_TYPE_INT:
+    result = CMP (g_value_get_int (value1), g_value_get_int (value2));
+    break;
+  case G_TYPE_UINT:
+    result = CMP (g_value_get_uint (value1), g_value_get_uint (value2));
+    break;
+  case G_TYPE_LONG:
+    result = CMP (g_value_get_long (value1), g_value_get_long (value2));
+    break;
+  case G_TYPE_ULONG:
+    result = CMP (g_value_get_ulong (value1), g_value_get_ulong (value2));
+    break;
+  case G_TYPE_INT64:
+    result = CMP (g_value_get_int64 (value1), g_value_get_int64 (value2));
+    break;
+  case G_TYPE_UINT64:
+    result = CMP (g_value_get_uint64 (value1), g_value_get_uint64 (value2));
+    break;
+  case G_TYPE_FLOAT:
+    result = CMP (g_value_get_float (value1), g_value_get_float (value2));
+    break;
+  case G_TYPE_DOUBLE:
+    result = CMP (g_value_get_double (value1), g_value_get_double (value2));
+    break;
+  case G_TYPE_ENUM:
+    result = CMP (g_value_get_enum (value1), g_value_get_enum (value2));
+    break;
+  case G_TYPE_FLAGS:
+    result = CMP (g_value_get_flags (value1), g_value_get_flags (value2));
+    break;
+  case G_TYPE_BOXED:
+    if (G_VALUE_HOLDS (value1, G_TYPE_DATE_TIME) &&
+        g_value_get_boxed (value1) && g_value_get_boxed (value2)) {
+      result = g_date_time_compare (g_value_get_boxed (value1),
+                                    g_value_get_boxed (value2));
+    } else {
+      result = (g_value_get_boxed (value1) != NULL) -
+        (g_value_get_boxed (value2) != NULL);
+    }
+    break;
+  default:
+    break;
+  }
+
+#undef CMP
+
+  if (value2 == &transformed) {
+    g_value_unset (&transformed);
+  }
+
+  return result;
+}
@@ -41,6 +41,8 @@ GHashTable *grl_g_value_hashtable_new_direct (void);
 
 GValue *grl_g_value_dup (const GValue *value);
 
+gint grl_g_value_compare (const GValue *value1, const GValue *value2);
+
 G_END_DECLS
 
 #endif /* _GRL_VALUE_HELPER_H_ */
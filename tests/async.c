@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#undef G_DISABLE_ASSERT
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <grilo.h>
+
+#define BROWSE_HITS     10
+#define HIGH_WATER_MARK 3
+
+/* ================ Browsing source ================ */
+
+/* A source browsing BROWSE_HITS elements, one per main loop iteration */
+
+#define TEST_TYPE_BROWSE_SOURCE (test_browse_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+} TestBrowseSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestBrowseSourceClass;
+
+GType test_browse_source_get_type (void);
+
+G_DEFINE_TYPE (TestBrowseSource, test_browse_source, GRL_TYPE_SOURCE);
+
+typedef struct {
+  GrlSourceBrowseSpec *bs;
+  guint sent;
+} BrowseData;
+
+static gboolean
+test_browse_source_browse_idle (gpointer user_data)
+{
+  BrowseData *data = (BrowseData *) user_data;
+  GrlSourceBrowseSpec *bs = data->bs;
+  GrlMedia *media;
+  gchar *id;
+
+  media = grl_media_new ();
+  id = g_strdup_printf ("%u", data->sent);
+  grl_media_set_id (media, id);
+  g_free (id);
+  data->sent++;
+
+  bs->callback (bs->source, bs->operation_id, media, BROWSE_HITS - data->sent,
+                bs->user_data, NULL);
+
+  if (data->sent == BROWSE_HITS) {
+    g_free (data);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+test_browse_source_browse (GrlSource *source,
+                           GrlSourceBrowseSpec *bs)
+{
+  BrowseData *data = g_new0 (BrowseData, 1);
+
+  data->bs = bs;
+  g_idle_add (test_browse_source_browse_idle, data);
+}
+
+static void
+test_browse_source_class_init (TestBrowseSourceClass *klass)
+{
+  GRL_SOURCE_CLASS (klass)->browse = test_browse_source_browse;
+}
+
+static void
+test_browse_source_init (TestBrowseSource *source)
+{
+}
+
+/* ================ Tests ================ */
+
+typedef struct {
+  GMainLoop *loop;
+  guint operation_id;
+  guint received;
+  guint batches;
+} AsyncData;
+
+static void
+results_cb (GObject *object,
+            GAsyncResult *result,
+            gpointer user_data)
+{
+  AsyncData *data = (AsyncData *) user_data;
+  GError *error = NULL;
+  GList *medias;
+
+  medias = grl_source_results_finish (GRL_SOURCE (object), result, &error);
+  g_assert_no_error (error);
+
+  if (!medias) {
+    g_main_loop_quit (data->loop);
+    return;
+  }
+
+  g_assert_cmpuint (g_list_length (medias), <=, HIGH_WATER_MARK);
+  data->received += g_list_length (medias);
+  data->batches++;
+  g_list_free_full (medias, g_object_unref);
+
+  grl_source_results_next_async (GRL_SOURCE (object), data->operation_id,
+                                 results_cb, data);
+}
+
+static void
+async_browse (void)
+{
+  GrlOperationOptions *options;
+  GrlSource *source;
+  AsyncData data = { 0, };
+
+  source = g_object_new (TEST_TYPE_BROWSE_SOURCE,
+                         "source-id", "test-browse",
+                         "source-name", "test-browse",
+                         NULL);
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_high_water_mark (options, HIGH_WATER_MARK);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.operation_id = grl_source_browse_async (source, NULL, NULL, options,
+                                               NULL, results_cb, &data);
+  g_assert_cmpuint (data.operation_id, !=, 0);
+  g_main_loop_run (data.loop);
+
+  g_assert_cmpuint (data.received, ==, BROWSE_HITS);
+  g_assert_cmpuint (data.batches, >, 0);
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (options);
+  g_object_unref (source);
+}
+
+static void
+cancelled_cb (GObject *object,
+              GAsyncResult *result,
+              gpointer user_data)
+{
+  AsyncData *data = (AsyncData *) user_data;
+  GError *error = NULL;
+  GList *medias;
+
+  medias = grl_source_results_finish (GRL_SOURCE (object), result, &error);
+
+  if (medias) {
+    g_list_free_full (medias, g_object_unref);
+    grl_source_results_next_async (GRL_SOURCE (object), data->operation_id,
+                                   cancelled_cb, data);
+    return;
+  }
+
+  g_assert_error (error, GRL_CORE_ERROR, GRL_CORE_ERROR_OPERATION_CANCELLED);
+  g_error_free (error);
+  g_main_loop_quit (data->loop);
+}
+
+static void
+async_cancel (void)
+{
+  GrlOperationOptions *options;
+  GCancellable *cancellable;
+  GrlSource *source;
+  AsyncData data = { 0, };
+
+  source = g_object_new (TEST_TYPE_BROWSE_SOURCE,
+                         "source-id", "test-browse",
+                         "source-name", "test-browse",
+                         NULL);
+
+  options = grl_operation_options_new (NULL);
+  cancellable = g_cancellable_new ();
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.operation_id = grl_source_browse_async (source, NULL, NULL, options,
+                                               cancellable, cancelled_cb,
+                                               &data);
+  g_cancellable_cancel (cancellable);
+  g_main_loop_run (data.loop);
+
+  /* Let the source finish */
+  while (g_main_context_iteration (NULL, FALSE));
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (cancellable);
+  g_object_unref (options);
+  g_object_unref (source);
+}
+
+static void
+first_batch_cb (GObject *object,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+  AsyncData *data = (AsyncData *) user_data;
+  GError *error = NULL;
+  GList *medias;
+
+  medias = grl_source_results_finish (GRL_SOURCE (object), result, &error);
+  g_assert_no_error (error);
+  g_assert (medias != NULL);
+  data->batches++;
+  g_list_free_full (medias, g_object_unref);
+
+  /* Do not ask for more */
+}
+
+static void
+async_cancel_paused (void)
+{
+  GrlOperationOptions *options;
+  GrlSource *source;
+  AsyncData data = { 0, };
+
+  source = g_object_new (TEST_TYPE_BROWSE_SOURCE,
+                         "source-id", "test-browse",
+                         "source-name", "test-browse",
+                         NULL);
+  g_object_add_weak_pointer (G_OBJECT (source), (gpointer *) &source);
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_high_water_mark (options, HIGH_WATER_MARK);
+
+  data.operation_id = grl_source_browse_async (source, NULL, NULL, options,
+                                               NULL, first_batch_cb, &data);
+  while (!grl_operation_is_paused (data.operation_id)) {
+    g_main_context_iteration (NULL, TRUE);
+  }
+  g_assert_cmpuint (data.batches, ==, 1);
+
+  /* The results kept are released without asking for them */
+  grl_operation_cancel (data.operation_id);
+  while (g_main_context_iteration (NULL, FALSE));
+
+  /* Asking for them later reports the cancellation */
+  data.loop = g_main_loop_new (NULL, FALSE);
+  grl_source_results_next_async (source, data.operation_id,
+                                 cancelled_cb, &data);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+
+  g_object_unref (options);
+  g_object_unref (source);
+  g_assert (source == NULL);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  grl_init (&argc, &argv);
+
+  g_test_add_func ("/async/browse", async_browse);
+  g_test_add_func ("/async/cancel", async_cancel);
+  g_test_add_func ("/async/cancel-paused", async_cancel_paused);
+
+  return g_test_run ();
+}
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#undef G_DISABLE_ASSERT
+
+#include <string.h>
+#include <glib.h>
+
+#include <grilo.h>
+
+#define BROWSE_HITS 3
+#define DEADLINE    100
+
+/* ================ Browsing source ================ */
+
+/* A source browsing BROWSE_HITS elements with a title */
+
+#define TEST_TYPE_BROWSE_SOURCE (test_browse_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+} TestBrowseSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestBrowseSourceClass;
+
+GType test_browse_source_get_type (void);
+
+G_DEFINE_TYPE (TestBrowseSource, test_browse_source, GRL_TYPE_SOURCE);
+
+static const GList *
+test_browse_source_supported_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                                      GRL_METADATA_KEY_TITLE,
+                                      GRL_METADATA_KEY_INVALID);
+  }
+
+  return keys;
+}
+
+static gboolean
+test_browse_source_browse_idle (gpointer user_data)
+{
+  GrlSourceBrowseSpec *bs = (GrlSourceBrowseSpec *) user_data;
+  GrlMedia *media;
+  gchar *id;
+  guint i;
+
+  for (i = 0; i < BROWSE_HITS; i++) {
+    media = grl_media_new ();
+    id = g_strdup_printf ("%u", i);
+    grl_media_set_id (media, id);
+    grl_media_set_title (media, id);
+    g_free (id);
+    bs->callback (bs->source, bs->operation_id, media, BROWSE_HITS - i - 1,
+                  bs->user_data, NULL);
+  }
+
+  return FALSE;
+}
+
+static void
+test_browse_source_browse (GrlSource *source,
+                           GrlSourceBrowseSpec *bs)
+{
+  g_idle_add (test_browse_source_browse_idle, bs);
+}
+
+static gboolean
+test_browse_source_search_idle (gpointer user_data)
+{
+  GrlSourceSearchSpec *ss = (GrlSourceSearchSpec *) user_data;
+  GrlMedia *media;
+  gchar *id;
+  guint i;
+
+  for (i = 0; i < BROWSE_HITS; i++) {
+    media = grl_media_new ();
+    id = g_strdup_printf ("%u", i);
+    grl_media_set_id (media, id);
+    grl_media_set_title (media, id);
+    g_free (id);
+    ss->callback (ss->source, ss->operation_id, media, BROWSE_HITS - i - 1,
+                  ss->user_data, NULL);
+  }
+
+  return FALSE;
+}
+
+static void
+test_browse_source_search (GrlSource *source,
+                           GrlSourceSearchSpec *ss)
+{
+  g_idle_add (test_browse_source_search_idle, ss);
+}
+
+static void
+test_browse_source_class_init (TestBrowseSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->supported_keys = test_browse_source_supported_keys;
+  source_class->browse = test_browse_source_browse;
+  source_class->search = test_browse_source_search;
+}
+
+static void
+test_browse_source_init (TestBrowseSource *source)
+{
+}
+
+/* ================ Stalled source ================ */
+
+/* A source claiming to resolve the artist of any media, that never answers
+   unless the operation is cancelled */
+
+#define TEST_TYPE_STALLED_SOURCE (test_stalled_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+  GList *pending;
+} TestStalledSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestStalledSourceClass;
+
+GType test_stalled_source_get_type (void);
+
+G_DEFINE_TYPE (TestStalledSource, test_stalled_source, GRL_TYPE_SOURCE);
+
+static const GList *
+test_stalled_source_supported_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ARTIST,
+                                      GRL_METADATA_KEY_INVALID);
+  }
+
+  return keys;
+}
+
+static gboolean
+test_stalled_source_may_resolve (GrlSource *source,
+                                 GrlMedia *media,
+                                 GrlKeyID key_id,
+                                 GList **missing_keys)
+{
+  return key_id == GRL_METADATA_KEY_ARTIST;
+}
+
+static void
+test_stalled_source_resolve (GrlSource *source,
+                             GrlSourceResolveSpec *rs)
+{
+  TestStalledSource *stalled = (TestStalledSource *) source;
+
+  stalled->pending = g_list_prepend (stalled->pending, rs);
+}
+
+static gboolean
+test_stalled_source_cancel_idle (gpointer user_data)
+{
+  GrlSourceResolveSpec *rs = (GrlSourceResolveSpec *) user_data;
+
+  rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
+
+  return FALSE;
+}
+
+static void
+test_stalled_source_cancel (GrlSource *source,
+                            guint operation_id)
+{
+  TestStalledSource *stalled = (TestStalledSource *) source;
+  GrlSourceResolveSpec *rs;
+  GList *iter;
+
+  for (iter = stalled->pending; iter; iter = g_list_next (iter)) {
+    rs = (GrlSourceResolveSpec *) iter->data;
+    if (rs->operation_id == operation_id) {
+      stalled->pending = g_list_delete_link (stalled->pending, iter);
+      g_idle_add (test_stalled_source_cancel_idle, rs);
+      return;
+    }
+  }
+}
+
+static void
+test_stalled_source_class_init (TestStalledSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->supported_keys = test_stalled_source_supported_keys;
+  source_class->may_resolve = test_stalled_source_may_resolve;
+  source_class->resolve = test_stalled_source_resolve;
+  source_class->cancel = test_stalled_source_cancel;
+}
+
+static void
+test_stalled_source_init (TestStalledSource *source)
+{
+}
+
+/* ================ Tests ================ */
+
+typedef struct {
+  GMainLoop *loop;
+  guint received;
+  guint expired;
+} DeadlineData;
+
+static GrlSource *browse_source = NULL;
+static TestStalledSource *stalled_source = NULL;
+
+static void
+register_sources (void)
+{
+  GrlRegistry *registry;
+  GrlPlugin *plugin;
+
+  registry = grl_registry_get_default ();
+  plugin = g_object_new (GRL_TYPE_PLUGIN, NULL);
+
+  browse_source = g_object_new (TEST_TYPE_BROWSE_SOURCE,
+                                "source-id", "test-browse",
+                                "source-name", "test-browse",
+                                NULL);
+  grl_registry_register_source (registry, plugin, browse_source, NULL);
+
+  stalled_source = g_object_new (TEST_TYPE_STALLED_SOURCE,
+                                 "source-id", "test-stalled",
+                                 "source-name", "test-stalled",
+                                 NULL);
+  grl_registry_register_source (registry, plugin,
+                                GRL_SOURCE (stalled_source), NULL);
+
+  g_object_unref (plugin);
+}
+
+static void
+deadline_cb (GrlSource *source,
+             guint operation_id,
+             GrlMedia *media,
+             guint remaining,
+             gpointer user_data,
+             const GError *error)
+{
+  DeadlineData *data = (DeadlineData *) user_data;
+
+  /* Multiple searches can end with an empty result */
+  if (media || remaining > 0) {
+    g_assert (media);
+    g_assert (grl_media_get_title (media));
+    g_assert (!grl_data_has_key (GRL_DATA (media), GRL_METADATA_KEY_ARTIST));
+    data->received++;
+    g_object_unref (media);
+  }
+
+  if (error) {
+    g_assert_error (error, GRL_CORE_ERROR, GRL_CORE_ERROR_DEADLINE_EXCEEDED);
+    g_assert (strstr (error->message,
+                      GRL_METADATA_KEY_GET_NAME (GRL_METADATA_KEY_ARTIST)));
+    data->expired++;
+  }
+
+  if (remaining == 0) {
+    g_main_loop_quit (data->loop);
+  }
+}
+
+/*
+ * Browses the test source, or searches it through a multiple search if
+ * @multiple is set.
+ */
+static void
+run_operation (GrlOperationOptions *options,
+               gboolean multiple)
+{
+  DeadlineData data = { 0, };
+  GList *keys;
+  GList *sources;
+  gint64 start;
+
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_TITLE,
+                                    GRL_METADATA_KEY_ARTIST,
+                                    GRL_METADATA_KEY_INVALID);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  start = g_get_monotonic_time ();
+  if (multiple) {
+    sources = g_list_prepend (NULL, browse_source);
+    grl_multiple_search (sources, "test", keys, options, deadline_cb, &data);
+    g_list_free (sources);
+  } else {
+    grl_source_browse (browse_source, NULL, keys, options, deadline_cb, &data);
+  }
+  g_main_loop_run (data.loop);
+
+  /* The stalled source did not keep the results back */
+  g_assert_cmpint ((g_get_monotonic_time () - start) / 1000, <, 10 * DEADLINE);
+  g_assert_cmpuint (data.received, ==, BROWSE_HITS);
+  /* Multiple searches do not relay the errors of each result */
+  if (!multiple) {
+    g_assert_cmpuint (data.expired, ==, BROWSE_HITS);
+  }
+
+  /* The requests to the stalled source were cancelled */
+  while (g_main_context_iteration (NULL, FALSE));
+  g_assert (stalled_source->pending == NULL);
+
+  g_main_loop_unref (data.loop);
+  g_list_free (keys);
+}
+
+static void
+deadline_decoration (void)
+{
+  GrlOperationOptions *options;
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_flags (options, GRL_RESOLVE_FULL);
+  grl_operation_options_set_decoration_deadline (options, DEADLINE);
+
+  run_operation (options, FALSE);
+
+  g_object_unref (options);
+}
+
+static void
+deadline_overall (void)
+{
+  GrlOperationOptions *options;
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_flags (options, GRL_RESOLVE_FULL);
+  grl_operation_options_set_deadline (options, DEADLINE);
+
+  run_operation (options, FALSE);
+
+  g_object_unref (options);
+}
+
+static void
+deadline_multiple (void)
+{
+  GrlOperationOptions *options;
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_flags (options, GRL_RESOLVE_FULL);
+  grl_operation_options_set_count (options, BROWSE_HITS);
+  grl_operation_options_set_deadline (options, DEADLINE);
+
+  run_operation (options, TRUE);
+
+  g_object_unref (options);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  grl_init (&argc, &argv);
+
+  register_sources ();
+
+  g_test_add_func ("/deadline/decoration", deadline_decoration);
+  g_test_add_func ("/deadline/overall", deadline_overall);
+  g_test_add_func ("/deadline/multiple", deadline_multiple);
+
+  return g_test_run ();
+}
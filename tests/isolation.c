@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#undef G_DISABLE_ASSERT
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include <grilo.h>
+
+/* See test-plugin.c */
+#define TEST_PLUGIN_HITS 5
+
+static GrlSource *
+get_isolated_source (void)
+{
+  return grl_registry_lookup_source (grl_registry_get_default (),
+                                     "test-isolated");
+}
+
+static GList *
+browse_container (const gchar *container_id,
+                  GError **error)
+{
+  GrlOperationOptions *options;
+  GrlMedia *container;
+  GList *keys;
+  GList *medias;
+
+  container = grl_media_box_new ();
+  grl_media_set_id (container, container_id);
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_TITLE,
+                                    GRL_METADATA_KEY_INVALID);
+  options = grl_operation_options_new (NULL);
+
+  medias = grl_source_browse_sync (get_isolated_source (), container, keys,
+                                   options, error);
+
+  g_object_unref (options);
+  g_list_free (keys);
+  g_object_unref (container);
+
+  return medias;
+}
+
+static void
+isolation_browse (void)
+{
+  GError *error = NULL;
+  GList *medias, *media;
+  gint pid;
+
+  g_assert (get_isolated_source ());
+
+  medias = browse_container ("finite", &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_list_length (medias), ==, TEST_PLUGIN_HITS);
+
+  /* The source ran in another process */
+  for (media = medias; media; media = g_list_next (media)) {
+    g_assert_cmpstr (grl_media_get_source (media->data), ==, "test-isolated");
+    pid = atoi (grl_media_get_title (media->data));
+    g_assert_cmpint (pid, >, 0);
+    g_assert_cmpint (pid, !=, getpid ());
+  }
+
+  g_list_free_full (medias, g_object_unref);
+}
+
+static void
+isolation_resolve (void)
+{
+  GrlOperationOptions *options;
+  GrlMedia *media;
+  GError *error = NULL;
+  GList *keys;
+
+  media = grl_media_new ();
+  grl_media_set_id (media, "0");
+  grl_media_set_source (media, "test-isolated");
+  grl_media_set_title (media, "title");
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ARTIST,
+                                    GRL_METADATA_KEY_INVALID);
+  options = grl_operation_options_new (NULL);
+
+  grl_source_resolve_sync (get_isolated_source (), media, keys, options,
+                           &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (grl_media_get_artist (media), ==, "isolated");
+  g_assert_cmpstr (grl_media_get_title (media), ==, "title");
+
+  g_object_unref (options);
+  g_list_free (keys);
+  g_object_unref (media);
+}
+
+static void
+isolation_values (void)
+{
+  GDateTime *date, *received_date;
+  GTimeZone *time_zone;
+  GrlOperationOptions *options;
+  GrlMedia *media;
+  GError *error = NULL;
+  GList *keys;
+  const guint8 binary[] = { 0, '\t', '\n', '\\', ';', ',', ':', 255 };
+  const guint8 *received;
+  gchar *mime = NULL;
+  gsize size;
+
+  time_zone = g_time_zone_new ("+05:30");
+  received_date = g_date_time_new (time_zone, 2013, 5, 17, 10, 20, 30);
+  date = g_date_time_add (received_date, 123456);
+  g_date_time_unref (received_date);
+  g_time_zone_unref (time_zone);
+
+  media = grl_media_audio_new ();
+  grl_media_set_id (media, "0");
+  grl_media_set_source (media, "test-isolated");
+  grl_media_set_title (media, "tab\tnewline\n%;,:&=");
+  grl_data_set_float (GRL_DATA (media), GRL_METADATA_KEY_RATING, 1.0 / 3);
+  grl_media_set_modification_date (media, date);
+  grl_media_set_thumbnail_binary (media, binary, sizeof (binary));
+  grl_media_set_url_data (media, "file:///first", "audio/ogg");
+  grl_media_add_url_data (media, "file:///second", "audio/mpeg");
+
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ARTIST,
+                                    GRL_METADATA_KEY_INVALID);
+  options = grl_operation_options_new (NULL);
+
+  /* The media goes to the plugin host, and back */
+  grl_source_resolve_sync (get_isolated_source (), media, keys, options,
+                           &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (grl_media_get_artist (media), ==, "isolated");
+
+  g_assert_cmpstr (grl_media_get_title (media), ==, "tab\tnewline\n%;,:&=");
+  g_assert (grl_media_get_rating (media) == (gfloat) (1.0 / 3));
+
+  received_date = grl_media_get_modification_date (media);
+  g_assert (received_date != NULL);
+  g_assert (g_date_time_equal (received_date, date));
+  g_assert_cmpint (g_date_time_get_utc_offset (received_date), ==,
+                   g_date_time_get_utc_offset (date));
+  g_assert_cmpint (g_date_time_get_microsecond (received_date), ==, 123456);
+
+  received = grl_media_get_thumbnail_binary (media, &size);
+  g_assert_cmpuint (size, ==, sizeof (binary));
+  g_assert (memcmp (received, binary, size) == 0);
+
+  /* Related keys stay together, in order */
+  g_assert_cmpstr (grl_media_get_url_data_nth (media, 0, &mime), ==,
+                   "file:///first");
+  g_assert_cmpstr (mime, ==, "audio/ogg");
+  g_assert_cmpstr (grl_media_get_url_data_nth (media, 1, &mime), ==,
+                   "file:///second");
+  g_assert_cmpstr (mime, ==, "audio/mpeg");
+
+  g_date_time_unref (date);
+  g_object_unref (options);
+  g_list_free (keys);
+  g_object_unref (media);
+}
+
+static void
+isolation_crash (void)
+{
+  GError *error = NULL;
+  GList *medias;
+
+  /* The plugin host aborts, but the operation ends */
+  medias = browse_container ("crash", &error);
+  g_assert (medias == NULL);
+  g_assert_error (error, GRL_CORE_ERROR, GRL_CORE_ERROR_BROWSE_FAILED);
+  g_error_free (error);
+
+  /* And its source goes away */
+  while (get_isolated_source ()) {
+    g_main_context_iteration (NULL, TRUE);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  GrlRegistry *registry;
+  GError *error = NULL;
+
+  g_test_init (&argc, &argv, NULL);
+
+  /* Use the plugin host in the build tree */
+  g_setenv (GRL_PLUGIN_HOST_VAR, TEST_PLUGIN_HOST, FALSE);
+
+  grl_init (&argc, &argv);
+
+  registry = grl_registry_get_default ();
+  grl_registry_set_plugin_isolation (registry, TRUE);
+  grl_registry_add_directory (registry, TEST_PLUGIN_DIR);
+  grl_registry_load_plugin_by_id (registry, "grl-test-plugin", &error);
+  g_assert_no_error (error);
+
+  g_test_add_func ("/isolation/browse", isolation_browse);
+  g_test_add_func ("/isolation/resolve", isolation_resolve);
+  g_test_add_func ("/isolation/values", isolation_values);
+  g_test_add_func ("/isolation/crash", isolation_crash);
+
+  return g_test_run ();
+}
@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#undef G_DISABLE_ASSERT
+
+#include <glib.h>
+
+#include <grilo.h>
+
+/* ================ Fake source ================ */
+
+/* A source returning at most "hits" results for any search, after
+   "latency" milliseconds. The n-th result of every source has the same URL */
+
+#define TEST_TYPE_FAKE_SOURCE (test_fake_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+  guint hits;
+  guint latency;
+  guint searches;
+  guint pending;
+} TestFakeSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestFakeSourceClass;
+
+GType test_fake_source_get_type (void);
+
+G_DEFINE_TYPE (TestFakeSource, test_fake_source, GRL_TYPE_SOURCE);
+
+static gboolean
+test_fake_source_search_timeout (gpointer user_data)
+{
+  GrlSourceSearchSpec *ss = (GrlSourceSearchSpec *) user_data;
+  TestFakeSource *source = (TestFakeSource *) ss->source;
+  guint skip, count, i;
+  GrlMedia *media;
+  gchar *id;
+  gchar *url;
+
+  source->pending--;
+
+  skip = grl_operation_options_get_skip (ss->options);
+  count = grl_operation_options_get_count (ss->options);
+
+  if (skip >= source->hits) {
+    count = 0;
+  } else {
+    count = MIN (count, source->hits - skip);
+  }
+
+  if (count == 0) {
+    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, NULL);
+    return FALSE;
+  }
+
+  for (i = 0; i < count; i++) {
+    media = grl_media_new ();
+    id = g_strdup_printf ("%s-%u", grl_source_get_id (ss->source), skip + i);
+    grl_media_set_id (media, id);
+    g_free (id);
+    url = g_strdup_printf ("http://example.com/%u", skip + i);
+    grl_media_set_url (media, url);
+    g_free (url);
+    ss->callback (ss->source, ss->operation_id, media, count - i - 1,
+                  ss->user_data, NULL);
+  }
+
+  return FALSE;
+}
+
+static void
+test_fake_source_search (GrlSource *source,
+                         GrlSourceSearchSpec *ss)
+{
+  TestFakeSource *fake = (TestFakeSource *) source;
+
+  fake->searches++;
+  fake->pending++;
+  g_timeout_add (fake->latency, test_fake_source_search_timeout, ss);
+}
+
+static void
+test_fake_source_class_init (TestFakeSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->search = test_fake_source_search;
+}
+
+static void
+test_fake_source_init (TestFakeSource *source)
+{
+}
+
+static GrlSource *
+test_fake_source_new (const gchar *id, guint hits, guint latency)
+{
+  TestFakeSource *source;
+
+  source = g_object_new (TEST_TYPE_FAKE_SOURCE,
+                         "source-id", id,
+                         "source-name", id,
+                         NULL);
+  source->hits = hits;
+  source->latency = latency;
+
+  return GRL_SOURCE (source);
+}
+
+/* ================ Tests ================ */
+
+typedef struct {
+  GMainLoop *loop;
+  GList *medias;
+} SearchData;
+
+static void
+search_cb (GrlSource *source,
+           guint operation_id,
+           GrlMedia *media,
+           guint remaining,
+           gpointer user_data,
+           const GError *error)
+{
+  SearchData *data = (SearchData *) user_data;
+
+  g_assert_no_error ((GError *) error);
+
+  if (media) {
+    data->medias = g_list_append (data->medias, media);
+  }
+
+  if (remaining == 0) {
+    g_main_loop_quit (data->loop);
+  }
+}
+
+static guint
+count_searches (GList *sources)
+{
+  guint searches = 0;
+
+  for (; sources; sources = g_list_next (sources)) {
+    searches += ((TestFakeSource *) sources->data)->searches;
+  }
+
+  return searches;
+}
+
+static guint
+count_pending (GList *sources)
+{
+  guint pending = 0;
+
+  for (; sources; sources = g_list_next (sources)) {
+    pending += ((TestFakeSource *) sources->data)->pending;
+  }
+
+  return pending;
+}
+
+/* Runs a multiple search until its last result, and waits for the surplus
+   operations to complete, so the next search starts from the same state */
+static GList *
+run_search (GList *sources,
+            const GList *keys,
+            GrlOperationOptions *options)
+{
+  SearchData data = { 0, };
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  grl_multiple_search (sources, "test", keys, options, search_cb, &data);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+
+  while (count_pending (sources) > 0) {
+    g_main_context_iteration (NULL, TRUE);
+  }
+  while (g_main_context_iteration (NULL, FALSE));
+
+  return data.medias;
+}
+
+static void
+multiple_skewed_sources (void)
+{
+  GList *sources = NULL;
+  GList *medias;
+  GrlOperationOptions *options;
+  guint first, steady, i;
+  guint rounds;
+  gdouble elapsed;
+
+  sources = g_list_append (sources, test_fake_source_new ("rich", 1000, 1));
+  sources = g_list_append (sources, test_fake_source_new ("sparse", 1, 1));
+  sources = g_list_append (sources, test_fake_source_new ("empty", 0, 1));
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_count (options, 20);
+
+  /* Without history the count is split evenly, and the rich source has to
+     be asked again for the results the others miss */
+  g_list_free_full (run_search (sources, NULL, options), g_object_unref);
+  first = count_searches (sources);
+
+  rounds = g_test_perf ()? 200: 10;
+  g_test_timer_start ();
+  for (i = 0; i < rounds; i++) {
+    medias = run_search (sources, NULL, options);
+    g_assert_cmpuint (g_list_length (medias), ==, 20);
+    g_list_free_full (medias, g_object_unref);
+  }
+  elapsed = g_test_timer_elapsed ();
+  steady = count_searches (sources) - first;
+
+  g_test_minimized_result ((gdouble) steady / rounds,
+                           "round-trips per search: %u without history, "
+                           "%.1f afterwards",
+                           first, (gdouble) steady / rounds);
+  g_test_minimized_result (elapsed * 1000 / rounds,
+                           "%.2f ms per search", elapsed * 1000 / rounds);
+
+  g_assert_cmpuint (steady, <, first * rounds);
+
+  g_object_unref (options);
+  g_list_free_full (sources, g_object_unref);
+}
+
+static void
+multiple_dedup (void)
+{
+  GList *sources = NULL;
+  GList *keys;
+  GList *medias;
+  GList *m;
+  GHashTable *urls;
+  GrlOperationOptions *options;
+
+  sources = g_list_append (sources, test_fake_source_new ("first", 10, 1));
+  sources = g_list_append (sources, test_fake_source_new ("second", 10, 1));
+
+  keys = g_list_append (NULL, GRLKEYID_TO_POINTER (GRL_METADATA_KEY_URL));
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_count (options, 15);
+  grl_operation_options_set_dedup (options, keys, FALSE);
+
+  /* Both sources have the same 10 URLs: the 5 missing results can not be
+     found anywhere */
+  medias = run_search (sources, keys, options);
+
+  urls = g_hash_table_new (g_str_hash, g_str_equal);
+  for (m = medias; m; m = g_list_next (m)) {
+    g_assert (!g_hash_table_lookup (urls, grl_media_get_url (m->data)));
+    g_hash_table_insert (urls, (gpointer) grl_media_get_url (m->data),
+                         GINT_TO_POINTER (TRUE));
+  }
+  g_assert_cmpuint (g_hash_table_size (urls), ==, 10);
+
+  g_hash_table_unref (urls);
+  g_list_free_full (medias, g_object_unref);
+  g_object_unref (options);
+  g_list_free (keys);
+  g_list_free_full (sources, g_object_unref);
+}
+
+static void
+multiple_dedup_rank (void)
+{
+  GList *sources = NULL;
+  GList *keys;
+  GList *medias;
+  GList *m;
+  GrlSource *high;
+  GrlOperationOptions *options;
+
+  /* The source with the highest rank answers last, and is not the first
+     one given */
+  high = test_fake_source_new ("rank-high", 10, 50);
+  g_object_set (high, "rank", 10, NULL);
+  sources = g_list_append (sources, test_fake_source_new ("rank-low", 10, 1));
+  sources = g_list_append (sources, high);
+
+  keys = g_list_append (NULL, GRLKEYID_TO_POINTER (GRL_METADATA_KEY_URL));
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_count (options, 10);
+  grl_operation_options_set_dedup (options, keys, FALSE);
+
+  /* Without a merge mode, duplicates are still won by the highest rank */
+  medias = run_search (sources, keys, options);
+
+  g_assert_cmpuint (g_list_length (medias), ==, 10);
+  for (m = medias; m; m = g_list_next (m)) {
+    g_assert (g_str_has_prefix (grl_media_get_id (m->data), "rank-high-"));
+  }
+
+  g_list_free_full (medias, g_object_unref);
+  g_object_unref (options);
+  g_list_free (keys);
+  g_list_free_full (sources, g_object_unref);
+}
+
+static void
+multiple_ordered_refill (void)
+{
+  GList *sources = NULL;
+  GList *medias;
+  GList *m;
+  GrlOperationOptions *options;
+  gchar *expected;
+  guint i;
+
+  sources = g_list_append (sources, test_fake_source_new ("ordered-first", 10, 1));
+  sources = g_list_append (sources, test_fake_source_new ("ordered-second", 10, 1));
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_count (options, 12);
+  grl_operation_options_set_merge_mode (options, GRL_MERGE_MODE_ORDERED);
+
+  /* The first source is asked for 6 results first, and has to be asked again
+     for the rest before sending the ones of the second source */
+  medias = run_search (sources, NULL, options);
+
+  g_assert_cmpuint (g_list_length (medias), ==, 12);
+  for (m = medias, i = 0; m; m = g_list_next (m), i++) {
+    if (i < 10) {
+      expected = g_strdup_printf ("ordered-first-%u", i);
+    } else {
+      expected = g_strdup_printf ("ordered-second-%u", i - 10);
+    }
+    g_assert_cmpstr (grl_media_get_id (m->data), ==, expected);
+    g_free (expected);
+  }
+
+  g_list_free_full (medias, g_object_unref);
+  g_object_unref (options);
+  g_list_free_full (sources, g_object_unref);
+}
+
+static void
+multiple_ranked_deadline (void)
+{
+  GList *sources = NULL;
+  GList *medias;
+  GList *m;
+  GrlOperationOptions *options;
+  SearchData data = { 0, };
+  gdouble elapsed;
+
+  sources = g_list_append (sources, test_fake_source_new ("deadline-fast", 10, 1));
+  sources = g_list_append (sources, test_fake_source_new ("deadline-slow", 10, 1000));
+
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_count (options, 10);
+  grl_operation_options_set_merge_mode (options, GRL_MERGE_MODE_RANKED);
+  grl_operation_options_set_merge_deadline (options, 20);
+
+  /* Once the slow source misses its deadline, the fast one is asked again
+     and its new results are not held back by the slow one */
+  data.loop = g_main_loop_new (NULL, FALSE);
+  g_test_timer_start ();
+  grl_multiple_search (sources, "test", NULL, options, search_cb, &data);
+  g_main_loop_run (data.loop);
+  elapsed = g_test_timer_elapsed ();
+  g_main_loop_unref (data.loop);
+  medias = data.medias;
+
+  g_assert_cmpfloat (elapsed, <, 0.5);
+  g_assert_cmpuint (g_list_length (medias), ==, 10);
+  for (m = medias; m; m = g_list_next (m)) {
+    g_assert (g_str_has_prefix (grl_media_get_id (m->data), "deadline-fast-"));
+  }
+
+  while (count_pending (sources) > 0) {
+    g_main_context_iteration (NULL, TRUE);
+  }
+  while (g_main_context_iteration (NULL, FALSE));
+
+  g_list_free_full (medias, g_object_unref);
+  g_object_unref (options);
+  g_list_free_full (sources, g_object_unref);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  grl_init (&argc, &argv);
+
+  g_test_add_func ("/multiple/skewed-sources", multiple_skewed_sources);
+  g_test_add_func ("/multiple/dedup", multiple_dedup);
+  g_test_add_func ("/multiple/dedup-rank", multiple_dedup_rank);
+  g_test_add_func ("/multiple/ordered-refill", multiple_ordered_refill);
+  g_test_add_func ("/multiple/ranked-deadline", multiple_ranked_deadline);
+
+  return g_test_run ();
+}
@@ -49,6 +49,46 @@ registry_load_error_handler (const gchar *log_domain,
 }
 #endif
 
+/* A source failing all the searches */
+
+#define TEST_TYPE_FAILING_SOURCE (test_failing_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+} TestFailingSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestFailingSourceClass;
+
+GType test_failing_source_get_type (void);
+
+G_DEFINE_TYPE (TestFailingSource, test_failing_source, GRL_TYPE_SOURCE);
+
+static void
+test_failing_source_search (GrlSource *source,
+                            GrlSourceSearchSpec *ss)
+{
+  GError *error;
+
+  error = g_error_new_literal (GRL_CORE_ERROR,
+                               GRL_CORE_ERROR_SEARCH_FAILED,
+                               "Failed");
+  ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, error);
+  g_error_free (error);
+}
+
+static void
+test_failing_source_class_init (TestFailingSourceClass *klass)
+{
+  GRL_SOURCE_CLASS (klass)->search = test_failing_source_search;
+}
+
+static void
+test_failing_source_init (TestFailingSource *source)
+{
+}
+
 typedef struct {
   GrlRegistry *registry;
   GMainLoop *loop;
@@ -121,6 +161,85 @@ registry_unregister (RegistryFixture *fixture, gconstpointer data)
   g_assert_cmpint (i, ==, 0);
 }
 
+static void
+health_changed_cb (GrlRegistry *registry,
+                   GrlSource *source,
+                   GrlSourceHealth health,
+                   gpointer user_data)
+{
+  *((GrlSourceHealth *) user_data) = health;
+}
+
+static void
+search_failed_cb (GrlSource *source,
+                  guint operation_id,
+                  GrlMedia *media,
+                  guint remaining,
+                  gpointer user_data,
+                  const GError *error)
+{
+  g_assert_error (error, GRL_CORE_ERROR, GRL_CORE_ERROR_SEARCH_FAILED);
+  g_main_loop_quit ((GMainLoop *) user_data);
+}
+
+static void
+registry_source_health (RegistryFixture *fixture, gconstpointer data)
+{
+  GrlOperationOptions *options;
+  GrlPlugin *plugin;
+  GrlSource *source;
+  GrlSource *healthy;
+  GrlSourceHealth health = GRL_SOURCE_HEALTH_CLOSED;
+  GList *sources;
+  guint i;
+
+  plugin = g_object_new (GRL_TYPE_PLUGIN, NULL);
+  source = g_object_new (TEST_TYPE_FAILING_SOURCE,
+                         "source-id", "test-failing",
+                         "source-name", "test-failing",
+                         "rank", GRL_RANK_HIGHEST,
+                         NULL);
+  grl_registry_register_source (fixture->registry, plugin, source, NULL);
+  healthy = g_object_new (TEST_TYPE_FAILING_SOURCE,
+                          "source-id", "test-healthy",
+                          "source-name", "test-healthy",
+                          NULL);
+  grl_registry_register_source (fixture->registry, plugin, healthy, NULL);
+  g_object_unref (plugin);
+
+  g_signal_connect (fixture->registry, "source-health-changed",
+                    G_CALLBACK (health_changed_cb), &health);
+
+  options = grl_operation_options_new (NULL);
+  for (i = 0;
+       grl_registry_get_source_health (fixture->registry, source) ==
+         GRL_SOURCE_HEALTH_CLOSED;
+       i++) {
+    g_assert_cmpuint (i, <, 10);
+    grl_source_search (source, "test", NULL, options,
+                       search_failed_cb, fixture->loop);
+    g_main_loop_run (fixture->loop);
+  }
+  g_object_unref (options);
+
+  g_assert_cmpint (health, ==, GRL_SOURCE_HEALTH_OPEN);
+  g_assert_cmpfloat (grl_registry_get_source_error_rate (fixture->registry,
+                                                          source), >=, 0.5);
+
+  /* The source is demoted despite its rank */
+  sources = grl_registry_get_sources_by_operations (fixture->registry,
+                                                    GRL_OP_SEARCH,
+                                                    TRUE);
+  g_assert (g_list_last (sources)->data == source);
+  g_assert (g_list_find (sources, healthy));
+  g_list_free (sources);
+
+  g_signal_handlers_disconnect_by_func (fixture->registry,
+                                        health_changed_cb, &health);
+  grl_registry_unregister_source (fixture->registry, source, NULL);
+  grl_registry_unregister_source (fixture->registry, healthy, NULL);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -145,5 +264,11 @@ main (int argc, char **argv)
               registry_unregister,
               registry_fixture_teardown);
 
+  g_test_add ("/registry/source-health",
+              RegistryFixture, NULL,
+              registry_fixture_setup,
+              registry_source_health,
+              registry_fixture_teardown);
+
   return g_test_run ();
 }
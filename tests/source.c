@@ -0,0 +1,976 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#undef G_DISABLE_ASSERT
+
+#include <glib.h>
+
+#include <grilo.h>
+
+#define BROWSE_HITS 20
+/* Resolutions needed before the core hedges a slow source */
+#define HEDGE_SAMPLES 8
+#define SLOW_DELAY 500
+
+/* ================ Browsing source ================ */
+
+/* A source browsing BROWSE_HITS elements, whose id and title is their
+   position, keeping track of what it is asked for. All of them have the
+   same rating and modification date, to check values that do not survive
+   a conversion to text */
+
+#define TEST_TYPE_BROWSE_SOURCE (test_browse_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+  guint browses;
+  guint last_skip;
+  gint last_count;
+} TestBrowseSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestBrowseSourceClass;
+
+GType test_browse_source_get_type (void);
+
+G_DEFINE_TYPE (TestBrowseSource, test_browse_source, GRL_TYPE_SOURCE);
+
+static const GList *
+test_browse_source_supported_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                                      GRL_METADATA_KEY_TITLE,
+                                      GRL_METADATA_KEY_INVALID);
+  }
+
+  return keys;
+}
+
+static GDateTime *
+test_browse_source_date (void)
+{
+  GTimeZone *tz;
+  GDateTime *date;
+
+  tz = g_time_zone_new ("+05:30");
+  date = g_date_time_new (tz, 2012, 6, 15, 10, 20, 30.25);
+  g_time_zone_unref (tz);
+
+  return date;
+}
+
+static gboolean
+test_browse_source_browse_idle (gpointer user_data)
+{
+  GrlSourceBrowseSpec *bs = (GrlSourceBrowseSpec *) user_data;
+  GrlMedia *media;
+  GDateTime *date;
+  gchar *id;
+  guint skip, count, i;
+
+  skip = grl_operation_options_get_skip (bs->options);
+  count = grl_operation_options_get_count (bs->options);
+  count = skip < BROWSE_HITS? MIN (count, BROWSE_HITS - skip): 0;
+
+  if (count == 0) {
+    bs->callback (bs->source, bs->operation_id, NULL, 0, bs->user_data, NULL);
+    return FALSE;
+  }
+
+  for (i = 0; i < count; i++) {
+    media = grl_media_new ();
+    id = g_strdup_printf ("%u", skip + i);
+    grl_media_set_id (media, id);
+    grl_media_set_title (media, id);
+    g_free (id);
+    grl_data_set_float (GRL_DATA (media), GRL_METADATA_KEY_RATING, 1.0 / 3);
+    date = test_browse_source_date ();
+    grl_media_set_modification_date (media, date);
+    g_date_time_unref (date);
+    bs->callback (bs->source, bs->operation_id, media, count - i - 1,
+                  bs->user_data, NULL);
+  }
+
+  return FALSE;
+}
+
+static void
+test_browse_source_browse (GrlSource *source,
+                           GrlSourceBrowseSpec *bs)
+{
+  TestBrowseSource *browse_source = (TestBrowseSource *) source;
+
+  browse_source->browses++;
+  browse_source->last_skip = grl_operation_options_get_skip (bs->options);
+  browse_source->last_count = grl_operation_options_get_count (bs->options);
+  g_idle_add (test_browse_source_browse_idle, bs);
+}
+
+static void
+test_browse_source_class_init (TestBrowseSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->supported_keys = test_browse_source_supported_keys;
+  source_class->browse = test_browse_source_browse;
+}
+
+static void
+test_browse_source_init (TestBrowseSource *source)
+{
+}
+
+static TestBrowseSource *
+test_browse_source_new (void)
+{
+  return g_object_new (TEST_TYPE_BROWSE_SOURCE,
+                       "source-id", "test-browse",
+                       "source-name", "test-browse",
+                       NULL);
+}
+
+/* ================ Writing sources ================ */
+
+/* Sources writing the title of medias: the first one implements only
+   store_metadata(), and the second one only store_metadata_batch() */
+
+#define TEST_TYPE_STORE_SOURCE (test_store_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+  guint calls;
+  guint stored;
+} TestStoreSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestStoreSourceClass;
+
+GType test_store_source_get_type (void);
+
+G_DEFINE_TYPE (TestStoreSource, test_store_source, GRL_TYPE_SOURCE);
+
+static const GList *
+test_store_source_writable_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_TITLE,
+                                      GRL_METADATA_KEY_INVALID);
+  }
+
+  return keys;
+}
+
+static void
+test_store_source_store_metadata (GrlSource *source,
+                                  GrlSourceStoreMetadataSpec *sms)
+{
+  TestStoreSource *store_source = (TestStoreSource *) source;
+
+  store_source->calls++;
+  store_source->stored++;
+  sms->callback (sms->source, sms->media, NULL, sms->user_data, NULL);
+}
+
+static void
+test_store_source_class_init (TestStoreSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->writable_keys = test_store_source_writable_keys;
+  source_class->store_metadata = test_store_source_store_metadata;
+}
+
+static void
+test_store_source_init (TestStoreSource *source)
+{
+}
+
+#define TEST_TYPE_BATCH_STORE_SOURCE (test_batch_store_source_get_type ())
+
+typedef struct {
+  TestStoreSource parent;
+} TestBatchStoreSource;
+
+typedef struct {
+  TestStoreSourceClass parent_class;
+} TestBatchStoreSourceClass;
+
+GType test_batch_store_source_get_type (void);
+
+G_DEFINE_TYPE (TestBatchStoreSource, test_batch_store_source,
+               TEST_TYPE_STORE_SOURCE);
+
+static void
+test_batch_store_source_store_metadata_batch (GrlSource *source,
+                                              GrlSourceStoreMetadataBatchSpec *smbs)
+{
+  TestStoreSource *store_source = (TestStoreSource *) source;
+  GList *m;
+
+  store_source->calls++;
+  for (m = smbs->medias; m; m = g_list_next (m)) {
+    store_source->stored++;
+    smbs->callback (smbs->source, m->data, NULL, smbs->user_data, NULL);
+  }
+}
+
+static void
+test_batch_store_source_class_init (TestBatchStoreSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->store_metadata = NULL;
+  source_class->store_metadata_batch =
+    test_batch_store_source_store_metadata_batch;
+}
+
+static void
+test_batch_store_source_init (TestBatchStoreSource *source)
+{
+}
+
+/* ================ Resolving sources ================ */
+
+/* A source resolving the artist of any media after some delay, setting it to
+   its own identifier, or not finding it at all */
+
+#define TEST_TYPE_RESOLVE_SOURCE (test_resolve_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+  gboolean finds;
+  guint delay;
+  guint pending;
+} TestResolveSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestResolveSourceClass;
+
+GType test_resolve_source_get_type (void);
+
+G_DEFINE_TYPE (TestResolveSource, test_resolve_source, GRL_TYPE_SOURCE);
+
+static const GList *
+test_resolve_source_supported_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ARTIST,
+                                      GRL_METADATA_KEY_INVALID);
+  }
+
+  return keys;
+}
+
+static gboolean
+test_resolve_source_may_resolve (GrlSource *source,
+                                 GrlMedia *media,
+                                 GrlKeyID key_id,
+                                 GList **missing_keys)
+{
+  return key_id == GRL_METADATA_KEY_ARTIST;
+}
+
+static gboolean
+test_resolve_source_resolve_timeout (gpointer user_data)
+{
+  GrlSourceResolveSpec *rs = (GrlSourceResolveSpec *) user_data;
+  TestResolveSource *resolve_source = (TestResolveSource *) rs->source;
+
+  if (resolve_source->finds) {
+    grl_media_set_artist (rs->media, grl_source_get_id (rs->source));
+  }
+  resolve_source->pending--;
+  rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
+
+  return FALSE;
+}
+
+static void
+test_resolve_source_resolve (GrlSource *source,
+                             GrlSourceResolveSpec *rs)
+{
+  TestResolveSource *resolve_source = (TestResolveSource *) source;
+
+  resolve_source->pending++;
+  g_timeout_add (resolve_source->delay,
+                 test_resolve_source_resolve_timeout, rs);
+}
+
+static void
+test_resolve_source_class_init (TestResolveSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->supported_keys = test_resolve_source_supported_keys;
+  source_class->may_resolve = test_resolve_source_may_resolve;
+  source_class->resolve = test_resolve_source_resolve;
+}
+
+static void
+test_resolve_source_init (TestResolveSource *source)
+{
+}
+
+/* Registers a resolving source, as only those are asked to complete medias */
+static TestResolveSource *
+test_resolve_source_new (const gchar *id,
+                         gint rank,
+                         gboolean finds)
+{
+  TestResolveSource *source;
+  GrlPlugin *plugin;
+
+  source = g_object_new (TEST_TYPE_RESOLVE_SOURCE,
+                         "source-id", id,
+                         "source-name", id,
+                         NULL);
+  source->finds = finds;
+
+  plugin = g_object_new (GRL_TYPE_PLUGIN, NULL);
+  grl_registry_register_source (grl_registry_get_default (), plugin,
+                                GRL_SOURCE (source), NULL);
+  g_object_set (source, "rank", rank, NULL);
+  g_object_unref (plugin);
+
+  return source;
+}
+
+static void
+test_resolve_source_free (TestResolveSource *source)
+{
+  /* Let the source answer the requests it lost */
+  while (source->pending > 0) {
+    g_main_context_iteration (NULL, TRUE);
+  }
+
+  grl_registry_unregister_source (grl_registry_get_default (),
+                                  GRL_SOURCE (source), NULL);
+}
+
+/* ================ Result cache ================ */
+
+typedef struct {
+  GMainLoop *loop;
+  GList *medias;
+} BrowseData;
+
+static void
+browse_cb (GrlSource *source,
+           guint operation_id,
+           GrlMedia *media,
+           guint remaining,
+           gpointer user_data,
+           const GError *error)
+{
+  BrowseData *data = (BrowseData *) user_data;
+
+  g_assert_no_error ((GError *) error);
+
+  if (media) {
+    data->medias = g_list_append (data->medias, media);
+  }
+
+  if (remaining == 0) {
+    g_main_loop_quit (data->loop);
+  }
+}
+
+/* Browses [skip, skip + count) in @container and checks the ids received */
+static GList *
+run_browse (TestBrowseSource *source,
+            GrlMedia *container,
+            guint skip,
+            guint count)
+{
+  BrowseData data = { 0, };
+  GrlOperationOptions *options;
+  GList *keys;
+  GList *m;
+  gchar *id;
+
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_TITLE,
+                                    GRL_METADATA_KEY_INVALID);
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_skip (options, skip);
+  grl_operation_options_set_count (options, count);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  grl_source_browse (GRL_SOURCE (source), container, keys, options,
+                     browse_cb, &data);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+
+  g_assert_cmpuint (g_list_length (data.medias), ==,
+                    MIN (count, BROWSE_HITS - skip));
+  for (m = data.medias; m; m = g_list_next (m), skip++) {
+    id = g_strdup_printf ("%u", skip);
+    g_assert_cmpstr (grl_media_get_id (m->data), ==, id);
+    g_free (id);
+  }
+
+  g_object_unref (options);
+  g_list_free (keys);
+
+  return data.medias;
+}
+
+static void
+source_cache_hits (void)
+{
+  TestBrowseSource *source;
+  GList *medias;
+
+  source = test_browse_source_new ();
+  grl_source_set_result_cache_size (GRL_SOURCE (source), 4);
+
+  medias = run_browse (source, NULL, 0, 5);
+  g_assert_cmpuint (source->browses, ==, 1);
+
+  /* Changing the medias received does not change the cached ones */
+  grl_media_set_title (medias->data, "changed");
+  g_list_free_full (medias, g_object_unref);
+
+  medias = run_browse (source, NULL, 0, 5);
+  g_assert_cmpuint (source->browses, ==, 1);
+  g_assert_cmpstr (grl_media_get_title (medias->data), ==, "0");
+  g_list_free_full (medias, g_object_unref);
+
+  /* A subrange is known too */
+  g_list_free_full (run_browse (source, NULL, 1, 3), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 1);
+
+  g_object_unref (source);
+}
+
+static void
+source_cache_values (void)
+{
+  TestBrowseSource *source;
+  GDateTime *expected;
+  GDateTime *date;
+  GList *medias;
+
+  source = test_browse_source_new ();
+  grl_source_set_result_cache_size (GRL_SOURCE (source), 4);
+
+  g_list_free_full (run_browse (source, NULL, 0, 5), g_object_unref);
+
+  /* Cached medias keep the exact values sent by the source */
+  medias = run_browse (source, NULL, 0, 5);
+  g_assert_cmpuint (source->browses, ==, 1);
+
+  g_assert_cmpfloat (grl_data_get_float (GRL_DATA (medias->data),
+                                         GRL_METADATA_KEY_RATING),
+                     ==, (gfloat) (1.0 / 3));
+
+  expected = test_browse_source_date ();
+  date = grl_media_get_modification_date (medias->data);
+  g_assert (date != NULL);
+  g_assert (g_date_time_equal (date, expected));
+  g_assert_cmpint (g_date_time_get_utc_offset (date), ==,
+                   g_date_time_get_utc_offset (expected));
+  g_assert_cmpfloat (g_date_time_get_seconds (date), ==,
+                     g_date_time_get_seconds (expected));
+  g_date_time_unref (expected);
+
+  g_list_free_full (medias, g_object_unref);
+  g_object_unref (source);
+}
+
+static void
+source_cache_ranges (void)
+{
+  TestBrowseSource *source;
+
+  source = test_browse_source_new ();
+  grl_source_set_result_cache_size (GRL_SOURCE (source), 4);
+
+  g_list_free_full (run_browse (source, NULL, 0, 5), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 1);
+
+  /* Only the missing elements are requested */
+  g_list_free_full (run_browse (source, NULL, 3, 5), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 2);
+  g_assert_cmpuint (source->last_skip, ==, 5);
+  g_assert_cmpint (source->last_count, ==, 3);
+
+  g_list_free_full (run_browse (source, NULL, 0, 8), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 2);
+
+  /* The end of the list is known after the source returns less elements than
+     requested */
+  g_list_free_full (run_browse (source, NULL, 15, 10), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 3);
+  g_list_free_full (run_browse (source, NULL, 15, 10), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 3);
+
+  g_object_unref (source);
+}
+
+static void
+source_cache_invalidation (void)
+{
+  TestBrowseSource *source;
+  GrlMedia *container;
+
+  source = test_browse_source_new ();
+  grl_source_set_result_cache_size (GRL_SOURCE (source), 4);
+
+  g_list_free_full (run_browse (source, NULL, 0, 5), g_object_unref);
+  grl_source_notify_change (GRL_SOURCE (source), NULL,
+                            GRL_CONTENT_CHANGED, TRUE);
+  g_list_free_full (run_browse (source, NULL, 0, 5), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 2);
+
+  /* Least recently used requests are dropped */
+  container = grl_media_box_new ();
+  grl_media_set_id (container, "other");
+  grl_source_set_result_cache_size (GRL_SOURCE (source), 1);
+  g_list_free_full (run_browse (source, container, 0, 5), g_object_unref);
+  g_list_free_full (run_browse (source, NULL, 0, 5), g_object_unref);
+  g_assert_cmpuint (source->browses, ==, 4);
+
+  g_object_unref (container);
+  g_object_unref (source);
+}
+
+/* ================ Change coalescing ================ */
+
+#define CHANGE_WINDOW 50
+
+typedef struct {
+  GMainLoop *loop;
+  guint emissions;
+  guint changes[3];
+  GPtrArray *changed;
+  gboolean location_unknown;
+} ChangesData;
+
+static void
+content_changed_cb (GrlSource *source,
+                    GPtrArray *changed_medias,
+                    GrlSourceChangeType change_type,
+                    gboolean location_unknown,
+                    gpointer user_data)
+{
+  ChangesData *data = (ChangesData *) user_data;
+  guint i;
+
+  data->emissions++;
+  data->changes[change_type] += changed_medias->len;
+  data->location_unknown = data->location_unknown || location_unknown;
+  if (change_type == GRL_CONTENT_CHANGED) {
+    for (i = 0; i < changed_medias->len; i++) {
+      g_ptr_array_add (data->changed,
+                       g_object_ref (g_ptr_array_index (changed_medias, i)));
+    }
+  }
+
+  g_main_loop_quit (data->loop);
+}
+
+static GrlMedia *
+media_new_with_id (const gchar *id)
+{
+  GrlMedia *media;
+
+  media = grl_media_new ();
+  grl_media_set_id (media, id);
+
+  return media;
+}
+
+static void
+notify_change (GrlSource *source,
+               GrlMedia *media,
+               GrlSourceChangeType change_type)
+{
+  grl_source_notify_change (source, media, change_type, FALSE);
+}
+
+static void
+source_changes_coalescing (void)
+{
+  ChangesData data = { 0, };
+  TestBrowseSource *source;
+  GrlMedia *added, *removed, *unknown1, *unknown2;
+  gint64 start;
+
+  source = test_browse_source_new ();
+  grl_source_set_change_coalescing (GRL_SOURCE (source), CHANGE_WINDOW, 0);
+  g_signal_connect (source, "content-changed",
+                    G_CALLBACK (content_changed_cb), &data);
+
+  added = media_new_with_id ("added");
+  removed = media_new_with_id ("removed");
+  unknown1 = grl_media_new ();
+  unknown2 = grl_media_new ();
+
+  notify_change (GRL_SOURCE (source), added, GRL_CONTENT_ADDED);
+  notify_change (GRL_SOURCE (source), added, GRL_CONTENT_CHANGED);
+  notify_change (GRL_SOURCE (source), removed, GRL_CONTENT_ADDED);
+  notify_change (GRL_SOURCE (source), removed, GRL_CONTENT_REMOVED);
+  notify_change (GRL_SOURCE (source), unknown1, GRL_CONTENT_CHANGED);
+  notify_change (GRL_SOURCE (source), unknown2, GRL_CONTENT_CHANGED);
+  notify_change (GRL_SOURCE (source), unknown1, GRL_CONTENT_CHANGED);
+
+  /* Nothing is notified until the window ends */
+  g_assert_cmpuint (data.emissions, ==, 0);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.changed = g_ptr_array_new_with_free_func (g_object_unref);
+  start = g_get_monotonic_time ();
+  g_main_loop_run (data.loop);
+
+  g_assert_cmpint ((g_get_monotonic_time () - start) / 1000, >=,
+                   CHANGE_WINDOW - 1);
+  g_assert_cmpuint (data.emissions, ==, 2);
+  g_assert_cmpuint (data.changes[GRL_CONTENT_ADDED], ==, 1);
+  g_assert_cmpuint (data.changes[GRL_CONTENT_REMOVED], ==, 0);
+  g_assert (!data.location_unknown);
+
+  /* Medias without id are kept apart */
+  g_assert_cmpuint (data.changed->len, ==, 2);
+  g_assert (g_ptr_array_index (data.changed, 0) == unknown1);
+  g_assert (g_ptr_array_index (data.changed, 1) == unknown2);
+
+  g_ptr_array_unref (data.changed);
+  g_main_loop_unref (data.loop);
+  g_object_unref (added);
+  g_object_unref (removed);
+  g_object_unref (unknown1);
+  g_object_unref (unknown2);
+  g_object_unref (source);
+}
+
+static void
+source_changes_overflow (void)
+{
+  ChangesData data = { 0, };
+  TestBrowseSource *source;
+  GrlMedia *media;
+  guint i;
+
+  source = test_browse_source_new ();
+  grl_source_set_change_coalescing (GRL_SOURCE (source), CHANGE_WINDOW, 3);
+  g_signal_connect (source, "content-changed",
+                    G_CALLBACK (content_changed_cb), &data);
+
+  for (i = 0; i < 5; i++) {
+    media = grl_media_new ();
+    notify_change (GRL_SOURCE (source), media, GRL_CONTENT_ADDED);
+    g_object_unref (media);
+  }
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.changed = g_ptr_array_new_with_free_func (g_object_unref);
+  g_main_loop_run (data.loop);
+
+  /* Too many changes: the whole source changed */
+  g_assert_cmpuint (data.emissions, ==, 1);
+  g_assert_cmpuint (data.changes[GRL_CONTENT_CHANGED], ==, 1);
+  g_assert (data.location_unknown);
+  g_assert (GRL_IS_MEDIA_BOX (g_ptr_array_index (data.changed, 0)));
+
+  g_ptr_array_unref (data.changed);
+  g_main_loop_unref (data.loop);
+  g_object_unref (source);
+}
+
+/* ================ Store metadata ================ */
+
+typedef struct {
+  GMainLoop *loop;
+  guint stored;
+} StoreData;
+
+static void
+store_cb (GrlSource *source,
+          GrlMedia *media,
+          GList *failed_keys,
+          gpointer user_data,
+          const GError *error)
+{
+  StoreData *data = (StoreData *) user_data;
+
+  g_assert_no_error ((GError *) error);
+  g_assert (failed_keys == NULL);
+
+  data->stored++;
+  g_main_loop_quit (data->loop);
+}
+
+static void
+store_batch_cb (GrlSource *source,
+                GrlMedia *media,
+                GList *failed_keys,
+                gpointer user_data,
+                const GError *error)
+{
+  StoreData *data = (StoreData *) user_data;
+
+  g_assert_no_error ((GError *) error);
+  g_assert (failed_keys == NULL);
+
+  /* The last call comes without media */
+  if (media) {
+    data->stored++;
+  } else {
+    g_main_loop_quit (data->loop);
+  }
+}
+
+static void
+run_store (GrlSource *source)
+{
+  StoreData data = { 0, };
+  GrlMedia *media;
+  GList *keys;
+
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_TITLE,
+                                    GRL_METADATA_KEY_INVALID);
+  media = grl_media_new ();
+  grl_media_set_title (media, "title");
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  grl_source_store_metadata (source, media, keys, GRL_WRITE_NORMAL,
+                             store_cb, &data);
+  g_main_loop_run (data.loop);
+  g_assert_cmpuint (data.stored, ==, 1);
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (media);
+  g_list_free (keys);
+}
+
+static void
+run_store_batch (GrlSource *source,
+                 guint n_medias)
+{
+  StoreData data = { 0, };
+  GHashTable *medias;
+  GrlMedia *media;
+  GList *keys;
+  guint i;
+
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_TITLE,
+                                    GRL_METADATA_KEY_INVALID);
+  medias = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                  g_object_unref, NULL);
+  for (i = 0; i < n_medias; i++) {
+    media = grl_media_new ();
+    grl_media_set_title (media, "title");
+    g_hash_table_insert (medias, media, keys);
+  }
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  grl_source_store_metadata_batch (source, medias, GRL_WRITE_NORMAL, 0,
+                                   store_batch_cb, &data);
+  g_main_loop_run (data.loop);
+  g_assert_cmpuint (data.stored, ==, n_medias);
+
+  g_main_loop_unref (data.loop);
+  g_hash_table_unref (medias);
+  g_list_free (keys);
+}
+
+static void
+source_store_single (void)
+{
+  TestStoreSource *source;
+
+  source = g_object_new (TEST_TYPE_STORE_SOURCE,
+                         "source-id", "test-store",
+                         NULL);
+  g_assert (grl_source_supported_operations (GRL_SOURCE (source)) &
+            GRL_OP_STORE_METADATA);
+
+  run_store (GRL_SOURCE (source));
+  g_assert_cmpuint (source->calls, ==, 1);
+
+  /* Batches are stored one by one */
+  run_store_batch (GRL_SOURCE (source), 3);
+  g_assert_cmpuint (source->calls, ==, 4);
+  g_assert_cmpuint (source->stored, ==, 4);
+
+  g_object_unref (source);
+}
+
+static void
+source_store_batch (void)
+{
+  TestStoreSource *source;
+
+  source = g_object_new (TEST_TYPE_BATCH_STORE_SOURCE,
+                         "source-id", "test-batch-store",
+                         NULL);
+  g_assert (grl_source_supported_operations (GRL_SOURCE (source)) &
+            GRL_OP_STORE_METADATA);
+
+  /* Single medias are stored as batches of one */
+  run_store (GRL_SOURCE (source));
+  g_assert_cmpuint (source->calls, ==, 1);
+
+  run_store_batch (GRL_SOURCE (source), 3);
+  g_assert_cmpuint (source->calls, ==, 2);
+  g_assert_cmpuint (source->stored, ==, 4);
+
+  g_object_unref (source);
+}
+
+/* ================ Resolution ================ */
+
+typedef struct {
+  GMainLoop *loop;
+  GrlMedia *media;
+} ResolveData;
+
+static void
+resolve_cb (GrlSource *source,
+            guint operation_id,
+            GrlMedia *media,
+            gpointer user_data,
+            const GError *error)
+{
+  ResolveData *data = (ResolveData *) user_data;
+
+  g_assert_no_error ((GError *) error);
+
+  data->media = media;
+  g_main_loop_quit (data->loop);
+}
+
+/* Resolves the artist of a new media, asking the registered sources */
+static GrlMedia *
+run_resolve (void)
+{
+  ResolveData data = { 0, };
+  GrlOperationOptions *options;
+  TestBrowseSource *source;
+  GrlMedia *media;
+  GList *keys;
+
+  source = test_browse_source_new ();
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ARTIST,
+                                    GRL_METADATA_KEY_INVALID);
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_flags (options, GRL_RESOLVE_FULL);
+  media = media_new_with_id ("media");
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  grl_source_resolve (GRL_SOURCE (source), media, keys, options,
+                      resolve_cb, &data);
+  g_main_loop_run (data.loop);
+  g_assert (data.media == media);
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (options);
+  g_list_free (keys);
+  g_object_unref (source);
+
+  return media;
+}
+
+static void
+source_resolve_fallback (void)
+{
+  TestResolveSource *first;
+  TestResolveSource *second;
+  GrlMedia *media;
+
+  first = test_resolve_source_new ("test-first", 10, FALSE);
+  second = test_resolve_source_new ("test-second", 5, TRUE);
+
+  /* The artist is asked to the second source once the first fails */
+  media = run_resolve ();
+  g_assert_cmpstr (grl_media_get_artist (media), ==, "test-second");
+  g_object_unref (media);
+
+  test_resolve_source_free (first);
+  test_resolve_source_free (second);
+}
+
+static void
+source_resolve_hedging (void)
+{
+  TestResolveSource *slow;
+  TestResolveSource *fast;
+  GrlMedia *media;
+  gint64 start;
+  guint i;
+
+  slow = test_resolve_source_new ("test-slow", 10, TRUE);
+  fast = test_resolve_source_new ("test-fast", 5, TRUE);
+
+  /* Learn how long the first source usually takes */
+  slow->delay = 1;
+  for (i = 0; i < HEDGE_SAMPLES; i++) {
+    media = run_resolve ();
+    g_assert_cmpstr (grl_media_get_artist (media), ==, "test-slow");
+    g_object_unref (media);
+  }
+
+  /* Once it is late, the second one is asked too and answers first */
+  slow->delay = SLOW_DELAY;
+  start = g_get_monotonic_time ();
+  media = run_resolve ();
+  g_assert_cmpint ((g_get_monotonic_time () - start) / 1000, <, SLOW_DELAY);
+  g_assert_cmpstr (grl_media_get_artist (media), ==, "test-fast");
+
+  /* The late answer does not change the media sent */
+  test_resolve_source_free (slow);
+  g_assert_cmpstr (grl_media_get_artist (media), ==, "test-fast");
+  g_assert_cmpuint (grl_data_length (GRL_DATA (media),
+                                     GRL_METADATA_KEY_ARTIST), ==, 1);
+  g_object_unref (media);
+
+  test_resolve_source_free (fast);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  grl_init (&argc, &argv);
+
+  g_test_add_func ("/source/cache/hits", source_cache_hits);
+  g_test_add_func ("/source/cache/values", source_cache_values);
+  g_test_add_func ("/source/cache/ranges", source_cache_ranges);
+  g_test_add_func ("/source/cache/invalidation", source_cache_invalidation);
+  g_test_add_func ("/source/changes/coalescing", source_changes_coalescing);
+  g_test_add_func ("/source/changes/overflow", source_changes_overflow);
+  g_test_add_func ("/source/store/single", source_store_single);
+  g_test_add_func ("/source/store/batch", source_store_batch);
+  g_test_add_func ("/source/resolve/fallback", source_resolve_fallback);
+  g_test_add_func ("/source/resolve/hedging", source_resolve_hedging);
+
+  return g_test_run ();
+}
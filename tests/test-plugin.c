@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* A plugin providing a source that browses TEST_PLUGIN_HITS elements, titled
+   after the process running it, and resolves their artist. Browsing the
+   "crash" container aborts the process */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include <grilo.h>
+
+#define TEST_PLUGIN_HITS 5
+
+#define TEST_TYPE_ISOLATED_SOURCE (test_isolated_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+} TestIsolatedSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestIsolatedSourceClass;
+
+GType test_isolated_source_get_type (void);
+
+G_DEFINE_TYPE (TestIsolatedSource, test_isolated_source, GRL_TYPE_SOURCE);
+
+static const GList *
+test_isolated_source_supported_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                                      GRL_METADATA_KEY_TITLE,
+                                      GRL_METADATA_KEY_ARTIST,
+                                      GRL_METADATA_KEY_INVALID);
+  }
+
+  return keys;
+}
+
+static gboolean
+test_isolated_source_browse_idle (gpointer user_data)
+{
+  GrlSourceBrowseSpec *bs = (GrlSourceBrowseSpec *) user_data;
+  GrlMedia *media;
+  gchar *id, *title;
+  guint i;
+
+  if (g_strcmp0 (grl_media_get_id (bs->container), "crash") == 0) {
+    abort ();
+  }
+
+  title = g_strdup_printf ("%d", (gint) getpid ());
+  for (i = 0; i < TEST_PLUGIN_HITS; i++) {
+    media = grl_media_new ();
+    id = g_strdup_printf ("%u", i);
+    grl_media_set_id (media, id);
+    grl_media_set_title (media, title);
+    g_free (id);
+    bs->callback (bs->source, bs->operation_id, media,
+                  TEST_PLUGIN_HITS - i - 1, bs->user_data, NULL);
+  }
+  g_free (title);
+
+  return FALSE;
+}
+
+static void
+test_isolated_source_browse (GrlSource *source,
+                             GrlSourceBrowseSpec *bs)
+{
+  g_idle_add (test_isolated_source_browse_idle, bs);
+}
+
+static void
+test_isolated_source_resolve (GrlSource *source,
+                              GrlSourceResolveSpec *rs)
+{
+  grl_media_set_artist (rs->media, "isolated");
+  rs->callback (source, rs->operation_id, rs->media, rs->user_data, NULL);
+}
+
+static void
+test_isolated_source_class_init (TestIsolatedSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->supported_keys = test_isolated_source_supported_keys;
+  source_class->browse = test_isolated_source_browse;
+  source_class->resolve = test_isolated_source_resolve;
+}
+
+static void
+test_isolated_source_init (TestIsolatedSource *source)
+{
+}
+
+static gboolean
+test_plugin_init (GrlRegistry *registry,
+                  GrlPlugin *plugin,
+                  GList *configs)
+{
+  GrlSource *source;
+
+  source = g_object_new (TEST_TYPE_ISOLATED_SOURCE,
+                         "source-id", "test-isolated",
+                         "source-name", "test-isolated",
+                         NULL);
+
+  return grl_registry_register_source (registry, plugin, source, NULL);
+}
+
+GRL_PLUGIN_REGISTER (test_plugin_init, NULL, "grl-test-plugin");
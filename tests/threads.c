@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#undef G_DISABLE_ASSERT
+
+#include <glib.h>
+
+#include <grilo.h>
+
+#define BROWSE_HITS 100
+#define SYNC_THREADS 8
+#define SYNC_ROUNDS  10
+
+/* ================ Blocking source ================ */
+
+/* A source browsing BROWSE_HITS elements from a worker thread, or an endless
+   list of them if the container is "endless" */
+
+#define TEST_TYPE_BLOCKING_SOURCE (test_blocking_source_get_type ())
+
+typedef struct {
+  GrlSource parent;
+} TestBlockingSource;
+
+typedef struct {
+  GrlSourceClass parent_class;
+} TestBlockingSourceClass;
+
+GType test_blocking_source_get_type (void);
+
+G_DEFINE_TYPE (TestBlockingSource, test_blocking_source, GRL_TYPE_SOURCE);
+
+static GThread *main_thread = NULL;
+
+static void
+test_blocking_source_scan (GrlSourceThreadJob *job,
+                           gpointer user_data)
+{
+  GrlSourceBrowseSpec *bs = (GrlSourceBrowseSpec *) user_data;
+  GCancellable *cancellable = grl_source_thread_job_get_cancellable (job);
+  gboolean endless;
+  GrlMedia *media;
+  gchar *id;
+  guint i;
+
+  g_assert (g_thread_self () != main_thread);
+
+  endless = g_strcmp0 (grl_media_get_id (bs->container), "endless") == 0;
+
+  for (i = 0; endless || i < BROWSE_HITS; i++) {
+    if (g_cancellable_is_cancelled (cancellable)) {
+      return;
+    }
+    media = grl_media_new ();
+    id = g_strdup_printf ("%u", i);
+    grl_media_set_id (media, id);
+    g_free (id);
+    grl_source_thread_job_send (job, media);
+    g_usleep (100);
+  }
+}
+
+static void
+test_blocking_source_browse (GrlSource *source,
+                             GrlSourceBrowseSpec *bs)
+{
+  grl_source_run_in_thread (source, bs->operation_id,
+                            test_blocking_source_scan, bs,
+                            bs->callback, bs->user_data);
+}
+
+static void
+test_blocking_source_class_init (TestBlockingSourceClass *klass)
+{
+  GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
+
+  source_class->browse = test_blocking_source_browse;
+}
+
+static void
+test_blocking_source_init (TestBlockingSource *source)
+{
+}
+
+/* ================ Tests ================ */
+
+typedef struct {
+  GMainLoop *loop;
+  guint received;
+  gboolean cancel;
+  gboolean cancelled;
+} ThreadData;
+
+static GrlSource *blocking_source = NULL;
+
+static void
+register_sources (void)
+{
+  GrlRegistry *registry;
+  GrlPlugin *plugin;
+
+  registry = grl_registry_get_default ();
+  plugin = g_object_new (GRL_TYPE_PLUGIN, NULL);
+
+  blocking_source = g_object_new (TEST_TYPE_BLOCKING_SOURCE,
+                                  "source-id", "test-blocking",
+                                  "source-name", "test-blocking",
+                                  NULL);
+  grl_registry_register_source (registry, plugin, blocking_source, NULL);
+
+  g_object_unref (plugin);
+}
+
+static void
+browse_cb (GrlSource *source,
+           guint operation_id,
+           GrlMedia *media,
+           guint remaining,
+           gpointer user_data,
+           const GError *error)
+{
+  ThreadData *data = (ThreadData *) user_data;
+
+  /* Results are handed out where the operation was started */
+  g_assert (g_thread_self () == main_thread);
+
+  if (media) {
+    data->received++;
+    g_object_unref (media);
+    if (data->cancel) {
+      data->cancel = FALSE;
+      grl_operation_cancel (operation_id);
+    }
+  }
+
+  if (error) {
+    g_assert_error (error, GRL_CORE_ERROR, GRL_CORE_ERROR_OPERATION_CANCELLED);
+    data->cancelled = TRUE;
+  }
+
+  if (remaining == 0) {
+    g_main_loop_quit (data->loop);
+  }
+}
+
+static void
+run_browse (const gchar *container_id, ThreadData *data)
+{
+  GrlOperationOptions *options;
+  GrlMedia *container;
+
+  container = grl_media_box_new ();
+  grl_media_set_id (container, container_id);
+  options = grl_operation_options_new (NULL);
+
+  data->loop = g_main_loop_new (NULL, FALSE);
+  grl_source_browse (blocking_source, container, NULL, options,
+                     browse_cb, data);
+  g_main_loop_run (data->loop);
+  g_main_loop_unref (data->loop);
+
+  g_object_unref (options);
+  g_object_unref (container);
+}
+
+static void
+threads_run (void)
+{
+  ThreadData data = { 0, };
+
+  run_browse ("finite", &data);
+
+  g_assert_cmpuint (data.received, ==, BROWSE_HITS);
+  g_assert (!data.cancelled);
+}
+
+static void
+threads_cancel (void)
+{
+  ThreadData data = { 0, };
+
+  /* The worker only stops if it notices the cancellation */
+  data.cancel = TRUE;
+  run_browse ("endless", &data);
+
+  g_assert (data.cancelled);
+}
+
+static void
+sync_browse_thread (gpointer data,
+                    gpointer user_data)
+{
+  volatile gint *browsed = (volatile gint *) user_data;
+  GrlOperationOptions *options;
+  GrlMedia *container;
+  GError *error = NULL;
+  GList *medias;
+  guint i;
+
+  container = grl_media_box_new ();
+  grl_media_set_id (container, "finite");
+  options = grl_operation_options_new (NULL);
+
+  for (i = 0; i < SYNC_ROUNDS; i++) {
+    medias = grl_source_browse_sync (blocking_source, container, NULL,
+                                     options, &error);
+    g_assert_no_error (error);
+    g_atomic_int_add (browsed, g_list_length (medias));
+    g_list_free_full (medias, g_object_unref);
+  }
+
+  g_object_unref (options);
+  g_object_unref (container);
+}
+
+static void
+threads_sync_stress (void)
+{
+  GThreadPool *pool;
+  volatile gint browsed = 0;
+  guint i;
+
+  /* Each thread waits for its own operations only */
+  pool = g_thread_pool_new (sync_browse_thread, (gpointer) &browsed,
+                            SYNC_THREADS, TRUE, NULL);
+  for (i = 0; i < SYNC_THREADS; i++) {
+    g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+  }
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  g_assert_cmpint (browsed, ==, SYNC_THREADS * SYNC_ROUNDS * BROWSE_HITS);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  grl_init (&argc, &argv);
+
+  main_thread = g_thread_self ();
+  register_sources ();
+
+  g_test_add_func ("/threads/run", threads_run);
+  g_test_add_func ("/threads/cancel", threads_cancel);
+  g_test_add_func ("/threads/sync-stress", threads_sync_stress);
+
+  return g_test_run ();
+}
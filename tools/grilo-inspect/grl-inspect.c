@@ -22,6 +22,7 @@
 
 #include <grilo.h>
 #include <glib.h>
+#include <string.h>
 
 #include "config.h"
 #include "grl-core-keys.h"
@@ -36,6 +37,12 @@ static gchar *conffile = NULL;
 static GrlRegistry *registry = NULL;
 static gboolean version;
 static gboolean keys;
+static gchar *bench_source = NULL;
+static gchar *bench_op = NULL;
+static gchar *bench_keys = NULL;
+static gchar *bench_flags = NULL;
+static gint bench_count = 20;
+static gint bench_repeat = 1;
 
 static GOptionEntry entries[] = {
   { "delay", 'd', 0,
@@ -54,6 +61,30 @@ static GOptionEntry entries[] = {
     G_OPTION_ARG_NONE, &version,
     "Print version",
     NULL },
+  { "bench", 'b', 0,
+    G_OPTION_ARG_STRING, &bench_source,
+    "Benchmark an operation in the given source",
+    "SOURCE" },
+  { "op", 'o', 0,
+    G_OPTION_ARG_STRING, &bench_op,
+    "Operation to benchmark: browse, search or resolve (default browse)",
+    "OP" },
+  { "count", 'n', 0,
+    G_OPTION_ARG_INT, &bench_count,
+    "Number of elements to request in each benchmark round (default 20)",
+    "N" },
+  { "bench-keys", 'K', 0,
+    G_OPTION_ARG_STRING, &bench_keys,
+    "Comma-separated list of keys to request (default id,title)",
+    "KEYS" },
+  { "flags", 'f', 0,
+    G_OPTION_ARG_STRING, &bench_flags,
+    "Comma-separated resolution flags: full, fast-only, idle-relay",
+    "FLAGS" },
+  { "repeat", 'r', 0,
+    G_OPTION_ARG_INT, &bench_repeat,
+    "Number of benchmark rounds (default 1)",
+    "R" },
   { G_OPTION_REMAINING, '\0', 0,
     G_OPTION_ARG_STRING_ARRAY, &introspect_elements,
     "Elements to introspect",
@@ -293,6 +324,7 @@ introspect_source (const gchar *source_id)
   GrlPlugin *plugin;
   GrlSource *source;
   GrlSupportedOps supported_ops;
+  const gchar *health;
   const gchar *value;
   gchar *key;
 
@@ -328,6 +360,21 @@ introspect_source (const gchar *source_id)
              grl_source_get_description (source));
     g_print ("  %-20s %d\n", "Rank:",
              grl_source_get_rank (source));
+    switch (grl_registry_get_source_health (registry, source)) {
+    case GRL_SOURCE_HEALTH_CLOSED:
+      health = "healthy";
+      break;
+    case GRL_SOURCE_HEALTH_HALF_OPEN:
+      health = "recovering";
+      break;
+    default:
+      health = "failing";
+      break;
+    }
+    g_print ("  %-20s %s (%.0f%% errors, %u ms)\n", "Health:",
+             health,
+             100 * grl_registry_get_source_error_rate (registry, source),
+             grl_registry_get_source_latency (registry, source));
 
     g_print ("\n");
 
@@ -374,6 +421,9 @@ introspect_source (const gchar *source_id)
     if (supported_ops & GRL_OP_REMOVE) {
       g_print ("  grl_media_source_remove():\t\tRemove Media\n");
     }
+    if (supported_ops & GRL_OP_COUNT) {
+      g_print ("  grl_source_count_browse():\t\tCount Results\n");
+    }
     g_print ("\n");
 
     /* Print supported signals */
@@ -444,11 +494,418 @@ introspect_key (const gchar *key_name)
   g_print ("\n");
 }
 
+typedef enum {
+  BENCH_OP_BROWSE,
+  BENCH_OP_SEARCH,
+  BENCH_OP_RESOLVE
+} BenchOp;
+
+typedef struct {
+  GrlSource *source;
+  BenchOp op;
+  GList *keys;
+  GrlOperationOptions *options;
+  const gchar *target;
+  gint round;
+  guint round_items;
+  guint round_requests;
+  guint errors;
+  guint total_items;
+  gint64 total_time;
+  gint64 round_start;
+  gint64 last_result;
+  GArray *latencies;
+  GArray *first_results;
+} BenchData;
+
+static void bench_run_round (BenchData *bd);
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  gdouble da = *((const gdouble *) a);
+  gdouble db = *((const gdouble *) b);
+
+  return (da > db) - (da < db);
+}
+
+static gdouble
+percentile (GArray *sorted, guint p)
+{
+  guint rank;
+
+  if (sorted->len == 0) {
+    return 0.0;
+  }
+
+  /* Nearest-rank method */
+  rank = (p * sorted->len + 99) / 100;
+  rank = CLAMP (rank, 1, sorted->len);
+
+  return g_array_index (sorted, gdouble, rank - 1);
+}
+
+static gchar *
+get_peak_rss (void)
+{
+  gchar *contents = NULL;
+  gchar **lines;
+  gchar **line;
+  gchar *rss = NULL;
+
+  /* VmHWM is the "high water mark" of the resident set size */
+  if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL)) {
+    return g_strdup ("--");
+  }
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (line = lines; *line && !rss; line++) {
+    if (g_str_has_prefix (*line, "VmHWM:")) {
+      rss = g_strstrip (g_strdup (*line + strlen ("VmHWM:")));
+    }
+  }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  return rss? rss: g_strdup ("--");
+}
+
+static void
+bench_report (BenchData *bd)
+{
+  gdouble seconds;
+  gdouble first_avg = 0.0;
+  gchar *rss;
+  guint i;
+
+  seconds = bd->total_time / (gdouble) G_USEC_PER_SEC;
+
+  for (i = 0; i < bd->first_results->len; i++) {
+    first_avg += g_array_index (bd->first_results, gdouble, i);
+  }
+  if (bd->first_results->len > 0) {
+    first_avg /= bd->first_results->len;
+  }
+
+  g_array_sort (bd->latencies, compare_doubles);
+  rss = get_peak_rss ();
+
+  g_print ("Benchmark Results:\n");
+  g_print ("  %-24s %s\n", "Source:", grl_source_get_id (bd->source));
+  g_print ("  %-24s %s\n", "Operation:",
+           bd->op == BENCH_OP_BROWSE? "browse":
+           bd->op == BENCH_OP_SEARCH? "search": "resolve");
+  g_print ("  %-24s %d\n", "Rounds:", bd->round);
+  g_print ("  %-24s %u\n", "Items:", bd->total_items);
+  g_print ("  %-24s %u\n", "Errors:", bd->errors);
+  g_print ("  %-24s %.3f s\n", "Total time:", seconds);
+  g_print ("  %-24s %.2f\n", "Items/sec:",
+           seconds > 0.0? bd->total_items / seconds: 0.0);
+  g_print ("  %-24s %.3f ms\n", "Time to first result:", first_avg);
+  g_print ("  %-24s %.3f ms\n", "Latency p50:", percentile (bd->latencies, 50));
+  g_print ("  %-24s %.3f ms\n", "Latency p95:", percentile (bd->latencies, 95));
+  g_print ("  %-24s %.3f ms\n", "Latency p99:", percentile (bd->latencies, 99));
+  g_print ("  %-24s %s\n", "Peak RSS:", rss);
+  g_print ("\n");
+
+  g_free (rss);
+}
+
+static void
+bench_data_free (BenchData *bd)
+{
+  g_list_free (bd->keys);
+  g_object_unref (bd->options);
+  g_array_unref (bd->latencies);
+  g_array_unref (bd->first_results);
+  g_slice_free (BenchData, bd);
+}
+
+static void
+bench_add_result (BenchData *bd)
+{
+  gint64 now = g_get_monotonic_time ();
+  gdouble elapsed;
+
+  if (bd->round_items == 0) {
+    elapsed = (now - bd->round_start) / 1000.0;
+    g_array_append_val (bd->first_results, elapsed);
+  }
+
+  elapsed = (now - bd->last_result) / 1000.0;
+  g_array_append_val (bd->latencies, elapsed);
+  bd->last_result = now;
+  bd->round_items++;
+}
+
+static void
+bench_finish_round (BenchData *bd)
+{
+  bd->total_time += g_get_monotonic_time () - bd->round_start;
+  bd->total_items += bd->round_items;
+  bd->round++;
+
+  if (bd->round < bench_repeat) {
+    bench_run_round (bd);
+  } else {
+    bench_report (bd);
+    bench_data_free (bd);
+    g_main_loop_quit (mainloop);
+  }
+}
+
+static void
+bench_result_cb (GrlSource *source,
+                 guint operation_id,
+                 GrlMedia *media,
+                 guint remaining,
+                 gpointer user_data,
+                 const GError *error)
+{
+  BenchData *bd = (BenchData *) user_data;
+
+  if (error) {
+    g_printerr ("Operation failed: %s\n", error->message);
+    bd->errors++;
+  }
+
+  if (media) {
+    bench_add_result (bd);
+    g_object_unref (media);
+  }
+
+  if (remaining == 0) {
+    bench_finish_round (bd);
+  }
+}
+
+static void bench_resolve_next (BenchData *bd);
+
+static void
+bench_resolve_cb (GrlSource *source,
+                  guint operation_id,
+                  GrlMedia *media,
+                  gpointer user_data,
+                  const GError *error)
+{
+  BenchData *bd = (BenchData *) user_data;
+
+  if (error) {
+    g_printerr ("Operation failed: %s\n", error->message);
+    bd->errors++;
+  } else {
+    bench_add_result (bd);
+  }
+
+  if (media) {
+    g_object_unref (media);
+  }
+
+  if (bd->round_requests < (guint) bench_count) {
+    bench_resolve_next (bd);
+  } else {
+    bench_finish_round (bd);
+  }
+}
+
+static void
+bench_resolve_next (BenchData *bd)
+{
+  GrlMedia *media;
+
+  media = grl_media_new ();
+  if (bd->target) {
+    grl_media_set_id (media, bd->target);
+  }
+
+  bd->round_requests++;
+  bd->last_result = g_get_monotonic_time ();
+  grl_source_resolve (bd->source,
+                      media,
+                      bd->keys,
+                      bd->options,
+                      bench_resolve_cb,
+                      bd);
+}
+
+static void
+bench_run_round (BenchData *bd)
+{
+  GrlMedia *container = NULL;
+
+  bd->round_items = 0;
+  bd->round_requests = 0;
+  bd->round_start = g_get_monotonic_time ();
+  bd->last_result = bd->round_start;
+
+  switch (bd->op) {
+  case BENCH_OP_BROWSE:
+    if (bd->target) {
+      container = grl_media_box_new ();
+      grl_media_set_id (container, bd->target);
+    }
+    grl_source_browse (bd->source,
+                       container,
+                       bd->keys,
+                       bd->options,
+                       bench_result_cb,
+                       bd);
+    if (container) {
+      g_object_unref (container);
+    }
+    break;
+  case BENCH_OP_SEARCH:
+    grl_source_search (bd->source,
+                       bd->target,
+                       bd->keys,
+                       bd->options,
+                       bench_result_cb,
+                       bd);
+    break;
+  case BENCH_OP_RESOLVE:
+    bench_resolve_next (bd);
+    break;
+  }
+}
+
+static GList *
+bench_parse_keys (void)
+{
+  GList *key_list = NULL;
+  GrlKeyID key;
+  gchar **names;
+  gchar **name;
+
+  if (!bench_keys) {
+    return grl_metadata_key_list_new (GRL_METADATA_KEY_ID,
+                                      GRL_METADATA_KEY_TITLE,
+                                      GRL_METADATA_KEY_INVALID);
+  }
+
+  names = g_strsplit (bench_keys, ",", -1);
+  for (name = names; *name; name++) {
+    key = grl_registry_lookup_metadata_key (registry, g_strstrip (*name));
+    if (key == GRL_METADATA_KEY_INVALID) {
+      g_printerr ("Metadata Key Not Found: %s\n", *name);
+    } else {
+      key_list = g_list_append (key_list, GRLKEYID_TO_POINTER (key));
+    }
+  }
+  g_strfreev (names);
+
+  return key_list;
+}
+
+static gboolean
+bench_parse_flags (GrlResolutionFlags *flags)
+{
+  gchar **names;
+  gchar **name;
+  gboolean ok = TRUE;
+
+  *flags = GRL_RESOLVE_NORMAL;
+
+  if (!bench_flags) {
+    return TRUE;
+  }
+
+  names = g_strsplit (bench_flags, ",", -1);
+  for (name = names; *name; name++) {
+    g_strstrip (*name);
+    if (g_strcmp0 (*name, "full") == 0) {
+      *flags |= GRL_RESOLVE_FULL;
+    } else if (g_strcmp0 (*name, "fast-only") == 0) {
+      *flags |= GRL_RESOLVE_FAST_ONLY;
+    } else if (g_strcmp0 (*name, "idle-relay") == 0) {
+      *flags |= GRL_RESOLVE_IDLE_RELAY;
+    } else if (g_strcmp0 (*name, "normal") != 0) {
+      g_printerr ("Unknown resolution flag: %s\n", *name);
+      ok = FALSE;
+    }
+  }
+  g_strfreev (names);
+
+  return ok;
+}
+
+/* Returns TRUE if the benchmark has been started; it will quit the mainloop
+   once all the rounds are done */
+static gboolean
+bench_start (void)
+{
+  BenchData *bd;
+  GrlResolutionFlags flags;
+  GrlSource *source;
+  GrlSupportedOps op;
+  BenchOp bench_operation;
+
+  source = grl_registry_lookup_source (registry, bench_source);
+  if (!source) {
+    g_printerr ("Source Not Found: %s\n\n", bench_source);
+    return FALSE;
+  }
+
+  if (!bench_op || g_strcmp0 (bench_op, "browse") == 0) {
+    bench_operation = BENCH_OP_BROWSE;
+    op = GRL_OP_BROWSE;
+  } else if (g_strcmp0 (bench_op, "search") == 0) {
+    bench_operation = BENCH_OP_SEARCH;
+    op = GRL_OP_SEARCH;
+  } else if (g_strcmp0 (bench_op, "resolve") == 0) {
+    bench_operation = BENCH_OP_RESOLVE;
+    op = GRL_OP_RESOLVE;
+  } else {
+    g_printerr ("Unknown operation: %s\n\n", bench_op);
+    return FALSE;
+  }
+
+  if (!(grl_source_supported_operations (source) & op)) {
+    g_printerr ("Operation not supported by %s: %s\n\n",
+                bench_source, bench_op? bench_op: "browse");
+    return FALSE;
+  }
+
+  if (!bench_parse_flags (&flags)) {
+    return FALSE;
+  }
+
+  if (bench_count <= 0 || bench_repeat <= 0) {
+    g_printerr ("Count and repeat must be positive numbers\n\n");
+    return FALSE;
+  }
+
+  bd = g_slice_new0 (BenchData);
+  bd->source = source;
+  bd->op = bench_operation;
+  bd->keys = bench_parse_keys ();
+  bd->target = introspect_elements? introspect_elements[0]: NULL;
+  bd->latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  bd->first_results = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  bd->options = grl_operation_options_new (grl_source_get_caps (source, op));
+  grl_operation_options_set_flags (bd->options, flags);
+  if (op != GRL_OP_RESOLVE) {
+    grl_operation_options_set_count (bd->options, bench_count);
+  }
+
+  bench_run_round (bd);
+
+  return TRUE;
+}
+
 static gboolean
 run (gpointer data)
 {
   gchar **s;
 
+  if (bench_source) {
+    if (!bench_start ()) {
+      g_main_loop_quit (mainloop);
+    }
+    return FALSE;
+  }
+
   if (keys) {
     if (introspect_elements) {
       for (s = introspect_elements; *s; s++) {
@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2013 Igalia S.L.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Loads a single plugin on behalf of an application with plugin isolation
+ * enabled, and runs the operations the application forwards to its sources.
+ * See src/grl-plugin-host.c for the other end.
+ */
+
+#include <grilo.h>
+#include <glib.h>
+#include <gmodule.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "grl-plugin-host-priv.h"
+
+#define GRL_LOG_DOMAIN_DEFAULT grl_plugin_host_log_domain
+GRL_LOG_DOMAIN_STATIC(grl_plugin_host_log_domain);
+
+typedef struct {
+  guint core_id;
+  guint id;
+  GrlCoreError error_code;
+} HostedOperation;
+
+static GMainLoop *mainloop = NULL;
+static GIOChannel *channel = NULL;
+static GrlRegistry *registry = NULL;
+static gchar *plugin_id = NULL;
+/* Operation ids in the application -> HostedOperation */
+static GHashTable *operations = NULL;
+
+static void
+send_message (const gchar *command,
+              ...)
+{
+  va_list args;
+  gchar *message;
+
+  va_start (args, command);
+  message = grl_plugin_host_message_valist (command, args);
+  va_end (args);
+
+  if (g_io_channel_write_chars (channel, message, -1,
+                                NULL, NULL) != G_IO_STATUS_NORMAL ||
+      g_io_channel_flush (channel, NULL) != G_IO_STATUS_NORMAL) {
+    /* The application is gone */
+    g_main_loop_quit (mainloop);
+  }
+
+  g_free (message);
+}
+
+static void
+error_to_fields (const GError *error,
+                 GrlCoreError error_code,
+                 gchar **code,
+                 const gchar **message)
+{
+  if (!error) {
+    *code = g_strdup ("0");
+    *message = "";
+    return;
+  }
+
+  /* Only core errors can be rebuilt in the application */
+  if (error->domain == GRL_CORE_ERROR) {
+    error_code = error->code;
+  }
+  *code = g_strdup_printf ("%d", error_code);
+  *message = error->message;
+}
+
+static HostedOperation *
+hosted_operation_new (guint core_id,
+                      GrlCoreError error_code)
+{
+  HostedOperation *op;
+
+  op = g_slice_new0 (HostedOperation);
+  op->core_id = core_id;
+  op->error_code = error_code;
+
+  return op;
+}
+
+static void
+hosted_operation_free (HostedOperation *op)
+{
+  g_slice_free (HostedOperation, op);
+}
+
+static void
+send_result (HostedOperation *op,
+             GrlMedia *media,
+             guint remaining,
+             const GError *error)
+{
+  gchar *id, *count, *serial, *code;
+  const gchar *message;
+
+  id = g_strdup_printf ("%u", op->core_id);
+  count = g_strdup_printf ("%u", remaining);
+  serial = grl_plugin_host_media_to_string (media);
+  error_to_fields (error, op->error_code, &code, &message);
+
+  send_message (GRL_PLUGIN_HOST_CMD_RESULT, id, count, serial, code, message,
+                NULL);
+
+  g_free (id);
+  g_free (count);
+  g_free (serial);
+  g_free (code);
+}
+
+static void
+send_resolved (HostedOperation *op,
+               GrlMedia *media,
+               const GError *error)
+{
+  gchar *id, *serial, *code;
+  const gchar *message;
+
+  id = g_strdup_printf ("%u", op->core_id);
+  serial = grl_plugin_host_media_to_string (media);
+  error_to_fields (error, op->error_code, &code, &message);
+
+  send_message (GRL_PLUGIN_HOST_CMD_RESOLVED, id, serial, code, message, NULL);
+
+  g_free (id);
+  g_free (serial);
+  g_free (code);
+}
+
+/* ================ Sources ================ */
+
+static void
+source_added_cb (GrlRegistry *registry,
+                 GrlSource *source,
+                 gpointer user_data)
+{
+  gchar *rank, *ops, *media, *keys, *slow_keys;
+
+  rank = g_strdup_printf ("%d", grl_source_get_rank (source));
+  ops = g_strdup_printf ("%d", grl_source_supported_operations (source));
+  media = g_strdup_printf ("%d", grl_source_get_supported_media (source));
+  keys = grl_plugin_host_keys_to_string (grl_source_supported_keys (source));
+  slow_keys = grl_plugin_host_keys_to_string (grl_source_slow_keys (source));
+
+  send_message (GRL_PLUGIN_HOST_CMD_SOURCE,
+                grl_source_get_id (source),
+                grl_source_get_name (source),
+                grl_source_get_description (source)?
+                grl_source_get_description (source): "",
+                rank, ops, media, keys, slow_keys,
+                NULL);
+
+  g_free (rank);
+  g_free (ops);
+  g_free (media);
+  g_free (keys);
+  g_free (slow_keys);
+}
+
+static void
+source_removed_cb (GrlRegistry *registry,
+                   GrlSource *source,
+                   gpointer user_data)
+{
+  send_message (GRL_PLUGIN_HOST_CMD_REMOVED, grl_source_get_id (source), NULL);
+}
+
+/* ================ Operations ================ */
+
+static void
+result_cb (GrlSource *source,
+           guint operation_id,
+           GrlMedia *media,
+           guint remaining,
+           gpointer user_data,
+           const GError *error)
+{
+  HostedOperation *op = (HostedOperation *) user_data;
+
+  send_result (op, media, remaining, error);
+
+  if (media) {
+    g_object_unref (media);
+  }
+
+  if (remaining == 0) {
+    g_hash_table_remove (operations, GUINT_TO_POINTER (op->core_id));
+  }
+}
+
+static void
+resolve_cb (GrlSource *source,
+            guint operation_id,
+            GrlMedia *media,
+            gpointer user_data,
+            const GError *error)
+{
+  HostedOperation *op = (HostedOperation *) user_data;
+
+  send_resolved (op, media, error);
+
+  g_object_unref (media);
+  g_hash_table_remove (operations, GUINT_TO_POINTER (op->core_id));
+}
+
+static GrlOperationOptions *
+options_from_fields (const gchar *skip,
+                     const gchar *count,
+                     const gchar *flags,
+                     const gchar *type_filter)
+{
+  GrlOperationOptions *options;
+
+  options = grl_operation_options_new (NULL);
+  if (skip) {
+    grl_operation_options_set_skip (options, strtoul (skip, NULL, 10));
+  }
+  if (count) {
+    grl_operation_options_set_count (options, atoi (count));
+  }
+  grl_operation_options_set_flags (options, atoi (flags));
+  if (type_filter) {
+    grl_operation_options_set_type_filter (options, atoi (type_filter));
+  }
+
+  return options;
+}
+
+static void
+run_results_operation (gchar **fields)
+{
+  GError *error;
+  GrlCoreError error_code;
+  GrlMedia *container;
+  GrlOperationOptions *options;
+  GrlSource *source;
+  HostedOperation *op;
+  GList *keys;
+
+  if (g_strv_length (fields) < 9) {
+    return;
+  }
+
+  if (g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_BROWSE) == 0) {
+    error_code = GRL_CORE_ERROR_BROWSE_FAILED;
+  } else if (g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_SEARCH) == 0) {
+    error_code = GRL_CORE_ERROR_SEARCH_FAILED;
+  } else {
+    error_code = GRL_CORE_ERROR_QUERY_FAILED;
+  }
+
+  op = hosted_operation_new (strtoul (fields[1], NULL, 10), error_code);
+
+  source = grl_registry_lookup_source (registry, fields[2]);
+  if (!source) {
+    error = g_error_new (GRL_CORE_ERROR, error_code,
+                         "Source '%s' not found", fields[2]);
+    send_result (op, NULL, 0, error);
+    g_error_free (error);
+    hosted_operation_free (op);
+    return;
+  }
+
+  keys = grl_plugin_host_keys_from_string (fields[4]);
+  options = options_from_fields (fields[5], fields[6], fields[7], fields[8]);
+  g_hash_table_insert (operations, GUINT_TO_POINTER (op->core_id), op);
+
+  switch (error_code) {
+  case GRL_CORE_ERROR_BROWSE_FAILED:
+    container = grl_plugin_host_media_from_string (fields[3]);
+    op->id = grl_source_browse (source, container, keys, options,
+                                result_cb, op);
+    if (container) {
+      g_object_unref (container);
+    }
+    break;
+  case GRL_CORE_ERROR_SEARCH_FAILED:
+    op->id = grl_source_search (source, *fields[3]? fields[3]: NULL, keys,
+                                options, result_cb, op);
+    break;
+  default:
+    op->id = grl_source_query (source, fields[3], keys, options,
+                               result_cb, op);
+  }
+
+  g_object_unref (options);
+  g_list_free (keys);
+}
+
+static void
+run_resolve (gchar **fields)
+{
+  GError *error;
+  GrlMedia *media;
+  GrlOperationOptions *options;
+  GrlSource *source;
+  HostedOperation *op;
+  GList *keys;
+
+  if (g_strv_length (fields) < 6) {
+    return;
+  }
+
+  op = hosted_operation_new (strtoul (fields[1], NULL, 10),
+                             GRL_CORE_ERROR_RESOLVE_FAILED);
+
+  source = grl_registry_lookup_source (registry, fields[2]);
+  media = grl_plugin_host_media_from_string (fields[3]);
+  if (!source || !media) {
+    error = g_error_new (GRL_CORE_ERROR, GRL_CORE_ERROR_RESOLVE_FAILED,
+                         "Cannot resolve in source '%s'", fields[2]);
+    send_resolved (op, NULL, error);
+    g_error_free (error);
+    hosted_operation_free (op);
+    if (media) {
+      g_object_unref (media);
+    }
+    return;
+  }
+
+  keys = grl_plugin_host_keys_from_string (fields[4]);
+  options = options_from_fields (NULL, NULL, fields[5], NULL);
+  g_hash_table_insert (operations, GUINT_TO_POINTER (op->core_id), op);
+
+  op->id = grl_source_resolve (source, media, keys, options, resolve_cb, op);
+
+  g_object_unref (options);
+  g_list_free (keys);
+}
+
+static void
+cancel_operation (gchar **fields)
+{
+  HostedOperation *op;
+
+  if (!fields[1]) {
+    return;
+  }
+
+  op = g_hash_table_lookup (operations,
+                            GUINT_TO_POINTER (strtoul (fields[1], NULL, 10)));
+  if (op) {
+    grl_operation_cancel (op->id);
+  }
+}
+
+/* ================ Plugin ================ */
+
+static void
+add_config (gchar **fields)
+{
+  GrlConfig *config;
+  guint i;
+
+  config = grl_config_new (plugin_id, NULL);
+  for (i = 1; fields[i] && fields[i + 1]; i += 2) {
+    grl_config_set_string (config, fields[i], fields[i + 1]);
+  }
+  grl_registry_add_config (registry, config, NULL);
+}
+
+static void
+load_plugin (void)
+{
+  GError *error = NULL;
+
+  if (grl_registry_load_plugin_by_id (registry, plugin_id, &error)) {
+    send_message (GRL_PLUGIN_HOST_CMD_READY, NULL);
+  } else {
+    send_message (GRL_PLUGIN_HOST_CMD_FAILED, error->message, NULL);
+    g_error_free (error);
+  }
+}
+
+/* Tells the plugin id before initializing it */
+static gchar *
+open_plugin (const gchar *library_filename)
+{
+  GModule *module;
+  GrlPluginDescriptor *plugin_desc;
+
+  module = g_module_open (library_filename, G_MODULE_BIND_LOCAL);
+  if (!module) {
+    GRL_WARNING ("Failed to open module: %s", g_module_error ());
+    return NULL;
+  }
+
+  /* The registry opens it again when loading the plugin */
+  if (!g_module_symbol (module, "GRL_PLUGIN_DESCRIPTOR",
+                        (gpointer) &plugin_desc) ||
+      !plugin_desc->plugin_id) {
+    GRL_WARNING ("Plugin descriptor not found in '%s'", library_filename);
+    g_module_close (module);
+    return NULL;
+  }
+
+  return g_strdup (plugin_desc->plugin_id);
+}
+
+static void
+handle_message (gchar **fields)
+{
+  if (g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_BROWSE) == 0 ||
+      g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_SEARCH) == 0 ||
+      g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_QUERY) == 0) {
+    run_results_operation (fields);
+  } else if (g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_RESOLVE) == 0) {
+    run_resolve (fields);
+  } else if (g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_CANCEL) == 0) {
+    cancel_operation (fields);
+  } else if (g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_CONFIG) == 0) {
+    add_config (fields);
+  } else if (g_strcmp0 (fields[0], GRL_PLUGIN_HOST_CMD_LOAD) == 0) {
+    load_plugin ();
+  } else {
+    GRL_WARNING ("Unknown message '%s'", fields[0]);
+  }
+}
+
+static gboolean
+channel_cb (GIOChannel *source,
+            GIOCondition condition,
+            gpointer user_data)
+{
+  GIOStatus status;
+  gchar **fields;
+  gchar *line;
+
+  do {
+    status = g_io_channel_read_line (channel, &line, NULL, NULL, NULL);
+    if (status == G_IO_STATUS_NORMAL) {
+      fields = grl_plugin_host_parse_message (line);
+      handle_message (fields);
+      g_strfreev (fields);
+      g_free (line);
+    }
+  } while (status == G_IO_STATUS_NORMAL &&
+           (g_io_channel_get_buffer_condition (channel) & G_IO_IN));
+
+  if (status == G_IO_STATUS_EOF || status == G_IO_STATUS_ERROR) {
+    /* The application unloaded the plugin, or is gone */
+    g_main_loop_quit (mainloop);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar **dirs, **dir;
+
+  grl_init (&argc, &argv);
+  GRL_LOG_DOMAIN_INIT (grl_plugin_host_log_domain, "grl-plugin-host");
+
+  if (argc != 3) {
+    g_printerr ("Usage: %s PLUGIN-FILE PLUGIN-PATH\n", argv[0]);
+    g_printerr ("This program is run by Grilo to load plugins "
+                "in their own process\n");
+    return 1;
+  }
+
+  registry = grl_registry_get_default ();
+  grl_registry_set_plugin_isolation (registry, FALSE);
+
+  dirs = g_strsplit (argv[2], G_SEARCHPATH_SEPARATOR_S, 0);
+  for (dir = dirs; *dir; dir++) {
+    grl_registry_add_directory (registry, *dir);
+  }
+  g_strfreev (dirs);
+
+  channel = g_io_channel_unix_new (GRL_PLUGIN_HOST_FD);
+  g_io_channel_set_encoding (channel, NULL, NULL);
+
+  plugin_id = open_plugin (argv[1]);
+  if (!plugin_id) {
+    return 1;
+  }
+
+  mainloop = g_main_loop_new (NULL, FALSE);
+  operations = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                      (GDestroyNotify) hosted_operation_free);
+
+  g_signal_connect (registry, "source-added",
+                    G_CALLBACK (source_added_cb), NULL);
+  g_signal_connect (registry, "source-removed",
+                    G_CALLBACK (source_removed_cb), NULL);
+
+  send_message (GRL_PLUGIN_HOST_CMD_PLUGIN, plugin_id, NULL);
+
+  g_io_add_watch (channel, G_IO_IN | G_IO_HUP | G_IO_ERR, channel_cb, NULL);
+  g_main_loop_run (mainloop);
+
+  return 0;
+}